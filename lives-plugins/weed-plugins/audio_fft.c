@@ -8,7 +8,7 @@
 
 ///////////////////////////////////////////////////////////////////
 
-static int package_version = 1; // version of this package
+static int package_version = 2; // version of this package
 
 //////////////////////////////////////////////////////////////////
 
@@ -106,6 +106,19 @@ static weed_error_t fftw_process(weed_plant_t *inst, weed_timecode_t tc) {
 
   rate = weed_channel_get_audio_rate(in_channel);
 
+  if (weed_plant_has_leaf(in_channel, "host_spectrum") && !weed_get_int_value(in_channel, "host_spectrum_window", NULL)) {
+    // the host has already transformed this packet for us, unwindowed as below (magnitudes averaged over channels)
+    double *mags;
+    int nbins;
+    nsamps = weed_get_int_value(in_channel, "host_spectrum_size", NULL);
+    k = freq / (double)rate * (double)nsamps;
+    mags = weed_get_double_array_counted(in_channel, "host_spectrum", &nbins);
+    weed_set_double_value(out_param, WEED_LEAF_VALUE, k < nbins ? mags[k] : 0.);
+    weed_free(mags);
+    weed_free(src);
+    return WEED_SUCCESS;
+  }
+
   // which element do we want for output ?
   // out array goes from 0 to (nsamps/2 + 1) [div b y 2 rounded down]
 
@@ -146,6 +159,8 @@ static weed_error_t fftw_process(weed_plant_t *inst, weed_timecode_t tc) {
 WEED_SETUP_START(200, 200) {
   if (create_plans() != WEED_SUCCESS) return NULL;
   weed_plant_t *in_chantmpls[] = {weed_audio_channel_template_init("in channel 0", 0), NULL};
+  // ask the host for its spectral data, if it knows how, we can skip our own transform
+  weed_set_boolean_value(in_chantmpls[0], "host_spectrum_req", WEED_TRUE);
   weed_plant_t *in_params[] = {weed_float_init("freq", "_Frequency", 2000., 0.0, 22000.0), NULL};
   weed_plant_t *out_params[] = {weed_out_param_float_init(WEED_LEAF_VALUE, 0., 0., 1.), NULL};
   weed_plant_t *filter_class = weed_filter_class_init("audio fft analyser", "salsaman", 1, 0, NULL, NULL, fftw_process,
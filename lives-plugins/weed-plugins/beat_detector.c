@@ -8,7 +8,7 @@
 
 ///////////////////////////////////////////////////////////////////
 
-static int package_version = 1; // version of this package
+static int package_version = 2; // version of this package
 
 //////////////////////////////////////////////////////////////////
 
@@ -141,8 +141,9 @@ static weed_error_t beat_process(weed_plant_t *inst, weed_timecode_t timestamp)
 
     _sdata *sdata = weed_get_instance_data(inst, sdata);
 
-    double var, av;
+    double var, av, *hmags = NULL;
     float tot = 0., totx;
+    int nchans = chans;
 
     weed_free(in_params);
 
@@ -192,20 +193,29 @@ static weed_error_t beat_process(weed_plant_t *inst, weed_timecode_t timestamp)
     base = rndlog2(onsamps);
     nsamps = twopow(base);
 
-    for (i = 0; i < chans; i++) {
-      // do transform for each channel
+    if (weed_plant_has_leaf(in_channel, "host_spectrum")
+        && weed_get_int_value(in_channel, "host_spectrum_window", NULL) == (hamming == WEED_TRUE ? 1 : 0)) {
+      // the host has already done the transform, with the same window, and magnitudes averaged over channels
+      nsamps = weed_get_int_value(in_channel, "host_spectrum_size", NULL);
+      hmags = weed_get_double_array(in_channel, "host_spectrum", NULL);
+      nchans = 1;
+    }
 
-      // copy in data to sdata->in
-      if (hamming == WEED_TRUE) {
-        for (j = 0; j < nsamps; j++) {
-          ins[base][j] = src[i][j] * (0.54f - 0.46f * cosf(TWO_PI * (float)j / (float)(nsamps - 1.)));
+    for (i = 0; i < nchans; i++) {
+      // do transform for each channel
+      if (!hmags) {
+        // copy in data to sdata->in
+        if (hamming == WEED_TRUE) {
+          for (j = 0; j < nsamps; j++) {
+            ins[base][j] = src[i][j] * (0.54f - 0.46f * cosf(TWO_PI * (float)j / (float)(nsamps - 1.)));
+          }
+        } else {
+          weed_memcpy(ins[base], src[i], nsamps * sizf);
         }
-      } else {
-        weed_memcpy(ins[base], src[i], nsamps * sizf);
-      }
 
-      //fprintf(stderr,"executing plan of size %d\n",sdata->size);
-      fftwf_execute(plans[base]);
+        //fprintf(stderr,"executing plan of size %d\n",sdata->size);
+        fftwf_execute(plans[base]);
+      }
 
       okmin = kmin = 0;
 
@@ -239,7 +249,8 @@ static weed_error_t beat_process(weed_plant_t *inst, weed_timecode_t timestamp)
           for (k = rkmin; k <= rkmax; k++) {
             // sum values over range
             // average over range
-            totx += sqrtf(outs[base][k][0] * outs[base][k][0] + outs[base][k][1] * outs[base][k][1]);
+            if (hmags) totx += (float)hmags[k];
+            else totx += sqrtf(outs[base][k][0] * outs[base][k][0] + outs[base][k][1] * outs[base][k][1]);
           }
 
           // average over bandwidth
@@ -251,7 +262,7 @@ static weed_error_t beat_process(weed_plant_t *inst, weed_timecode_t timestamp)
           // store this value in the buffer
 
           /// crash ???
-          sdata->buf[s][sdata->bufidx] += totx / (float)chans;
+          sdata->buf[s][sdata->bufidx] += totx / (float)nchans;
 
           okmin = kmin;
           kmin = kmax;
@@ -259,6 +270,7 @@ static weed_error_t beat_process(weed_plant_t *inst, weed_timecode_t timestamp)
       } // done for all slices
     } // done for all channels
 
+    if (hmags) weed_free(hmags);
     weed_free(src);
 
     if (!has_data) {
@@ -344,6 +356,11 @@ WEED_SETUP_START(200, 200) {
     weed_plant_t *filter_class = weed_filter_class_init("beat detector", "salsaman", 1, 0, NULL,
                                  beat_init, beat_process, beat_deinit, in_chantmpls, NULL, in_params, out_params);
 
+    // use the host spectral data when available; we ask for a Hamming window (1), as that is the default here.
+    // If the user switches it off, the window will not match and we do our own transform
+    weed_set_boolean_value(in_chantmpls[0], "host_spectrum_req", WEED_TRUE);
+    weed_set_int_value(in_chantmpls[0], "host_spectrum_window", 1);
+
     weed_plant_t *gui = weed_paramtmpl_get_gui(in_params[0]);
     weed_set_boolean_value(gui, WEED_LEAF_HIDDEN, WEED_TRUE);
 
@@ -177,74 +177,282 @@ void audio_free_fnames(void) {
 }
 
 
-static size_t arena_write(void *dst, void *src, size_t offset, size_t nsamples, size_t sampsize) {
-  size_t space = ABUF_ARENA_SIZE - offset;
-  if (space > nsamples) space = nsamples;
-  lives_memcpy(dst + offset * sampsize, src, space * sampsize);
-  offset += nsamples;
-  if (nsamples > space) {
-    nsamples -= space;
-    lives_memcpy(dst, src + space * sampsize, nsamples * sampsize);
-    offset = nsamples;
-  }
-  return offset;
+/// audio arena
+/// there is a single writer (the audio player, or for external audio the analyser hook), and up to AARENA_MAX_READERS
+/// readers, none of which can block the writer. The writer announces the range it is about to overwrite (wlimit),
+/// writes the samples, and only then advances wpos. Readers are handed pointers directly into the arena, and on release
+/// check wlimit to see if the writer lapped them meanwhile.
+/// The first AARENA_MIRROR samples of each channel are duplicated after the end, so that any read up to that size is contiguous
+
+lives_aarena_t *aarena_new(int nchans, int arate) {
+  static uint64_t last_id = 0;
+  lives_aarena_t *aar;
+  if (nchans <= 0) return NULL;
+  aar = (lives_aarena_t *)lives_calloc(1, sizeof(lives_aarena_t));
+  aar->id = __atomic_add_fetch(&last_id, 1, __ATOMIC_RELAXED);
+  aar->nchans = nchans;
+  aar->arate = arate;
+  aar->data = (float **)lives_calloc(nchans, sizeof(float *));
+  for (int i = 0; i < nchans; i++)
+    aar->data[i] = (float *)lives_calloc(AARENA_SIZE + AARENA_MIRROR, sizeof(float));
+  return aar;
 }
 
 
-static size_t arena_read(void *dst, void *src, size_t offset, size_t nsamples, size_t sampsize) {
-  size_t space = ABUF_ARENA_SIZE - offset;
-  if (space > nsamples) space = nsamples;
-  lives_memcpy(dst, src + offset * sampsize, space * sampsize);
-  if (nsamples > space) {
-    nsamples -= space;
-    lives_memcpy(dst + space * sampsize, src, nsamples * sampsize);
-  }
-  return nsamples;
+void aarena_free(lives_aarena_t *aar) {
+  if (!aar) return;
+  for (int i = 0; i < aar->nchans; i++) lives_free(aar->data[i]);
+  lives_free(aar->data);
+  for (int i = 0; i < AARENA_MAX_READERS; i++) lives_freep((void **)&aar->readers[i].scratch);
+  lives_freep((void **)&aar->wbuf);
+  lives_free(aar);
 }
 
 
-void append_to_audio_bufferf(float *src, uint64_t nsamples, int channum) {
-  // append float audio to the audio frame buffer
-  ssize_t write_offset;
-  boolean increment = FALSE;
-  lives_audio_buf_t *abuf;
+void aarena_write(lives_aarena_t *aar, int chan, const float *src, uint64_t nsamps) {
+  // copy nsamps to chan at the current write position; readers will not see them until aarena_publish() is called
+  uint64_t wpos, wlimit, offs, space;
+  float *dst;
 
-  if (!prefs->push_audio_to_gens) return;
-  abuf = mainw->afbuffer;
+  if (!aar || chan < 0 || chan >= aar->nchans || !nsamps) return;
 
-  if (!abuf) return;
+  wpos = aar->wpos;
+  wlimit = wpos + nsamps;
+  if (wlimit > aar->wlimit) {
+    __atomic_store_n(&aar->wlimit, wlimit, __ATOMIC_RELAXED);
+    // the announcement must be visible before any of the data is overwritten
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  }
 
-  if (!abuf->bufferf) {
-    //free_audio_frame_buffer(abuf);
-    abuf->out_achans = 0;
+  if (nsamps > AARENA_SIZE - AARENA_MIRROR) {
+    // only the tail could ever be read
+    uint64_t skip = nsamps - (AARENA_SIZE - AARENA_MIRROR);
+    src += skip;
+    wpos += skip;
+    nsamps -= skip;
   }
 
-  if (channum < 0) {
-    channum = -channum;
-    increment = TRUE;
+  dst = aar->data[chan];
+  offs = wpos & AARENA_MASK;
+  space = AARENA_SIZE - offs;
+  if (space > nsamps) space = nsamps;
+
+  lives_memcpy(dst + offs, src, space * sizeof(float));
+  if (offs < AARENA_MIRROR)
+    lives_memcpy(dst + AARENA_SIZE + offs, src, (space < AARENA_MIRROR - offs ? space : AARENA_MIRROR - offs)
+                 * sizeof(float));
+  if (nsamps > space) {
+    src += space;
+    nsamps -= space;
+    lives_memcpy(dst, src, nsamps * sizeof(float));
+    lives_memcpy(dst + AARENA_SIZE, src, (nsamps < AARENA_MIRROR ? nsamps : AARENA_MIRROR) * sizeof(float));
   }
+}
+
+
+void aarena_publish(lives_aarena_t *aar, uint64_t nsamps, ticks_t tc) {
+  // make the last nsamps written (to all channels) visible to readers, tagging them with tc
+  lives_aarena_seg_t *seg;
+  uint64_t wpos, nsegs;
+  if (!aar || !nsamps) return;
+  wpos = aar->wpos;
+  nsegs = aar->nsegs;
+  seg = &aar->segs[nsegs % AARENA_NSEGS];
+  seg->start = wpos;
+  seg->nsamps = nsamps;
+  seg->tc = tc;
+  __atomic_store_n(&aar->nsegs, nsegs + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&aar->wpos, wpos + nsamps, __ATOMIC_RELEASE);
+}
+
 
-  if (!abuf->bufferf || channum > abuf->out_achans) {
-    if (!abuf->bufferf) abuf->write_pos = abuf->vclient_readpos = abuf->vclient_readlevel
-                                            = abuf->aclient_readpos = abuf->aclient_readlevel = 0;
-    abuf->bufferf = (float **)lives_realloc(abuf->bufferf, (channum + 1) * sizeof(float *));
-    for (int i = abuf->out_achans; i < channum; i++) {
-      abuf->bufferf[i] = (float *)lives_calloc(ABUF_ARENA_SIZE, 4);
+static ticks_t aarena_get_tc(lives_aarena_t *aar, uint64_t pos) {
+  // find the segment containing pos and interpolate its timecode; segments older than the ring are lost
+  uint64_t nsegs = __atomic_load_n(&aar->nsegs, __ATOMIC_ACQUIRE);
+  for (uint64_t i = nsegs; i > 0 && i + AARENA_NSEGS > nsegs; i--) {
+    lives_aarena_seg_t *seg = &aar->segs[(i - 1) % AARENA_NSEGS];
+    if (seg->start <= pos) {
+      if (aar->arate <= 0) return seg->tc;
+      return seg->tc + (ticks_t)((double)(pos - seg->start) / (double)aar->arate * TICKS_PER_SECOND_DBL);
     }
-    abuf->out_achans = channum;
   }
+  return -1;
+}
 
-  channum--;
 
-  if (!abuf->bufferf[channum]) {
-    abuf->bufferf[channum] = (float *)lives_calloc(ABUF_ARENA_SIZE, 4);
-    abuf->write_pos = 0;
+int aarena_add_reader(lives_aarena_t *aar, uint64_t *gen) {
+  // claim a reader slot; the reader starts at the current write position
+  // slots whose owners have not read for AARENA_STALE_TIME are reclaimed if none are free
+  // the slot's new generation is returned in gen; the owner must pass it back to check or remove the reader
+  uint64_t rgen;
+  ticks_t now;
+  if (!aar) return -1;
+  now = lives_get_current_ticks();
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < AARENA_MAX_READERS; i++) {
+      lives_aarena_reader_t *rdr = &aar->readers[i];
+      int expected = 0;
+      if (pass && rdr->in_use && now - rdr->last_read > AARENA_STALE_TIME) {
+        expected = 1;
+        rdr->last_read = now;
+      }
+      if (__atomic_compare_exchange_n(&rdr->in_use, &expected, 2, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        rdr->rpos = __atomic_load_n(&aar->wpos, __ATOMIC_ACQUIRE);
+        rdr->pending = 0;
+        rdr->overruns = rdr->samples_lost = 0;
+        rdr->last_read = now;
+        rgen = __atomic_add_fetch(&rdr->gen, 1, __ATOMIC_ACQ_REL);
+        if (gen) *gen = rgen;
+        __atomic_store_n(&rdr->in_use, 1, __ATOMIC_RELEASE);
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+
+boolean aarena_reader_valid(lives_aarena_t *aar, int reader, uint64_t gen) {
+  // check that reader is still the slot claimed with generation gen
+  lives_aarena_reader_t *rdr;
+  if (!aar || reader < 0 || reader >= AARENA_MAX_READERS) return FALSE;
+  rdr = &aar->readers[reader];
+  return __atomic_load_n(&rdr->in_use, __ATOMIC_ACQUIRE) == 1 && __atomic_load_n(&rdr->gen, __ATOMIC_ACQUIRE) == gen;
+}
+
+
+void aarena_remove_reader(lives_aarena_t *aar, int reader, uint64_t gen) {
+  // free the slot, unless it was reclaimed meanwhile and now belongs to another client
+  lives_aarena_reader_t *rdr;
+  if (!aarena_reader_valid(aar, reader, gen)) return;
+  rdr = &aar->readers[reader];
+  rdr->pending = 0;
+  lives_freep((void **)&rdr->scratch);
+  rdr->scratch_size = 0;
+  __atomic_store_n(&rdr->in_use, 0, __ATOMIC_RELEASE);
+}
+
+
+int64_t aarena_peek(lives_aarena_t *aar, int reader, uint64_t maxsamps, const float **ptrs, ticks_t *tc) {
+  // get pointers to the unread samples for each channel, at most min(maxsamps, AARENA_MIRROR)
+  // (maxsamps of 0 means no limit); if maxsamps is exceeded we skip to the most recent audio
+  // ptrs remain valid until aarena_release() is called, which is done implicitly on the next peek
+  // the data is shared with all other readers, so it must not be written to
+  // returns the number of samples, or -1 if reader is invalid
+  lives_aarena_reader_t *rdr;
+  uint64_t wpos, rpos, avail;
+
+  if (!aar || reader < 0 || reader >= AARENA_MAX_READERS) return -1;
+  rdr = &aar->readers[reader];
+  if (rdr->in_use != 1) return -1;
+  if (rdr->pending) aarena_release(aar, reader);
+
+  rdr->last_read = lives_get_current_ticks();
+  wpos = __atomic_load_n(&aar->wpos, __ATOMIC_ACQUIRE);
+  rpos = rdr->rpos;
+
+  if (wpos > rpos + AARENA_SIZE - AARENA_MIRROR) {
+    // the writer has lapped us, skip to the oldest data which is still safe to read
+    uint64_t npos = wpos - (AARENA_SIZE - AARENA_MIRROR);
+    rdr->overruns++;
+    rdr->samples_lost += npos - rpos;
+    rpos = npos;
   }
-  write_offset = arena_write(abuf->bufferf[channum], src, abuf->write_pos, nsamples, 4);
-  if (increment) {
-    // only update when all channels written
-    abuf->write_pos = write_offset;
+
+  avail = wpos - rpos;
+  if (maxsamps && avail > maxsamps) {
+    rpos = wpos - maxsamps;
+    avail = maxsamps;
   }
+  if (avail > AARENA_MIRROR) avail = AARENA_MIRROR;
+
+  rdr->rpos = rpos;
+  rdr->pending = avail;
+
+  if (ptrs) for (int i = 0; i < aar->nchans; i++) ptrs[i] = aar->data[i] + (rpos & AARENA_MASK);
+  if (tc) *tc = avail ? aarena_get_tc(aar, rpos) : -1;
+  return (int64_t)avail;
+}
+
+
+boolean aarena_release(lives_aarena_t *aar, int reader) {
+  // advance past the samples from the last peek; returns FALSE if the writer overwrote any of them while they were in use
+  lives_aarena_reader_t *rdr;
+  uint64_t rpos, wlimit;
+
+  if (!aar || reader < 0 || reader >= AARENA_MAX_READERS) return FALSE;
+  rdr = &aar->readers[reader];
+  if (!rdr->pending) return TRUE;
+
+  rpos = rdr->rpos;
+  // all reads of the data must complete before we check wlimit
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  wlimit = __atomic_load_n(&aar->wlimit, __ATOMIC_ACQUIRE);
+
+  rdr->rpos = rpos + rdr->pending;
+  rdr->pending = 0;
+
+  if (wlimit > rpos + AARENA_SIZE) {
+    uint64_t lost = wlimit - rpos - AARENA_SIZE;
+    if (lost > rdr->rpos - rpos) lost = rdr->rpos - rpos;
+    rdr->overruns++;
+    rdr->samples_lost += lost;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+char *aarena_report(lives_aarena_t *aar) {
+  uint64_t wpos;
+  char *msg, *tmp;
+  if (!aar) return lives_strdup("");
+  wpos = __atomic_load_n(&aar->wpos, __ATOMIC_ACQUIRE);
+  msg = lives_strdup_printf(_("Audio arena: %d clients, %d channels at %d Hz\n"), aar->nclients, aar->nchans, aar->arate);
+  for (int i = 0; i < AARENA_MAX_READERS; i++) {
+    lives_aarena_reader_t *rdr = &aar->readers[i];
+    if (rdr->in_use != 1) continue;
+    tmp = lives_strdup_printf(_("%s  reader %d: lag %.2f ms, overruns %lu, samples lost %lu\n"), msg, i,
+                              aar->arate > 0 ? (double)(wpos - rdr->rpos) / (double)aar->arate * 1000. : 0.,
+                              rdr->overruns, rdr->samples_lost);
+    lives_free(msg);
+    msg = tmp;
+  }
+  return msg;
+}
+
+
+static volatile int aarena_users = 0;
+static LiVESList *retired_aarenas = NULL;
+
+lives_aarena_t *audio_arena_ref(void) {
+  // the count is raised before mainw->aarena is loaded, so an arena detached by retire_audio_arena() is
+  // never freed while anybody may still be using it. Returns NULL, holding no reference, if there is no arena
+  lives_aarena_t *aar;
+  __atomic_add_fetch(&aarena_users, 1, __ATOMIC_SEQ_CST);
+  aar = __atomic_load_n(&mainw->aarena, __ATOMIC_SEQ_CST);
+  if (!aar) audio_arena_unref();
+  return aar;
+}
+
+
+void audio_arena_unref(void) {__atomic_sub_fetch(&aarena_users, 1, __ATOMIC_SEQ_CST);}
+
+
+void append_to_audio_bufferf(lives_aarena_t *aar, float *src, uint64_t nsamples, int channum) {
+  // append float audio to the audio arena, aar being a reference held by the caller for all the channels
+  // channum counts from 1; a negative value denotes the final channel, after which the samples are published
+  boolean publish = FALSE;
+
+  if (!prefs->push_audio_to_gens || !aar) return;
+
+  if (channum < 0) {
+    channum = -channum;
+    publish = TRUE;
+  }
+
+  aarena_write(aar, channum - 1, src, nsamples);
+  if (publish) aarena_publish(aar, nsamples, mainw->currticks);
 }
 
 
@@ -282,88 +490,101 @@ void append_to_aux_audio_bufferf(float *src, uint64_t nsamples, int channum) {
 }
 
 
-void append_to_audio_buffer16(void *src, uint64_t nsamples, int nchans) {
-  // append float audio to the audio frame buffer
-  ssize_t write_offset;
-  lives_audio_buf_t *abuf;
-
-  if (!prefs->push_audio_to_gens) return;
-  abuf = mainw->afbuffer;
+void append_to_audio_buffer16(lives_aarena_t *aar, void *src, uint64_t nsamples, int nchans) {
+  // append interleaved S16 audio to the audio arena, converting to float
+  float clipvol = 1.;
+  int afile;
 
-  if (!abuf) return;
+  if (!prefs->push_audio_to_gens || !aar || !nsamples) return;
 
-  if (!abuf->buffer16) {
-    abuf->out_achans = 0;
+  if (aar->wbuf_size < nsamples) {
+    aar->wbuf = (float *)lives_realloc(aar->wbuf, nsamples * sizeof(float));
+    aar->wbuf_size = nsamples;
   }
 
-  if (!abuf->buffer16 || nchans > abuf->out_achans) {
-    if (!abuf->buffer16) abuf->buffer16 = (short **)lives_calloc(1, sizeof(short *));
-    abuf->buffer16[0] = (short *)lives_recalloc(abuf->buffer16[0], ABUF_ARENA_SIZE * nchans, ABUF_ARENA_SIZE * abuf->out_achans, 2);
-    abuf->out_achans = nchans;
-  }
+  afile = get_aplay_clipno();
+  if (CLIP_HAS_AUDIO(afile)) clipvol = lives_vol_from_linear(mainw->files[afile]->vol);
 
-  if (!abuf->buffer16[0]) {
-    abuf->buffer16[0] = (short *)lives_calloc(ABUF_ARENA_SIZE, 2 * nchans);
-    abuf->write_pos = 0;
+  for (int i = 0; i < nchans && i < aar->nchans; i++) {
+    sample_move_d16_float(aar->wbuf, (short *)src + i, nsamples, nchans, AFORM_SIGNED, FALSE, clipvol);
+    aarena_write(aar, i, aar->wbuf, nsamples);
   }
-
-  write_offset = arena_write(abuf->buffer16[0], src, abuf->write_pos, nsamples, 2);
-  abuf->write_pos = write_offset;
+  aarena_publish(aar, nsamples, mainw->currticks);
   //#define DEBUG_AFB
 #ifdef DEBUG_AFB
-  g_print("append16 %lu to afb %p and %p %d %lu\n", nsamples, abuf, abuf->buffer16, ((short *)src)[0], write_offset);
+  g_print("append16 %lu to arena %p %d %lu\n", nsamples, aar, ((short *)src)[0], aar->wpos);
 #endif
 }
 
 
-void init_audio_frame_buffers(short aplayer) {
+static void free_retired_arenas(void) {
+  // once the count is seen at zero, nobody can hold an arena which was detached before
+  int i;
+  if (!retired_aarenas) return;
+  for (i = 0; i < AARENA_RETIRE_TRIES && __atomic_load_n(&aarena_users, __ATOMIC_SEQ_CST); i++)
+    lives_nanosleep(AARENA_RETIRE_WAIT);
+  // if still busy, try again next time
+  if (i == AARENA_RETIRE_TRIES) return;
+  for (LiVESList *list = retired_aarenas; list; list = list->next) aarena_free((lives_aarena_t *)list->data);
+  lives_list_free(retired_aarenas);
+  retired_aarenas = NULL;
+}
+
+
+void init_audio_arena(short aplayer) {
   // function should be called when the first video generator with audio input is enabled
   // (or audio player needing external audio)
-  lives_audio_buf_t *abuf = (lives_audio_buf_t *)lives_calloc(1, sizeof(lives_audio_buf_t));
+  int nchans = 0, arate = 0;
 
-  abuf->samples_filled = 0;
-  abuf->swap_endian = FALSE;
-  abuf->out_achans = 0;
-  abuf->start_sample = 0;
-  abuf->write_pos = 0;
+  if (mainw->aarena) return;
 
   switch (aplayer) {
 #ifdef HAVE_PULSE_AUDIO
   case AUD_PLAYER_PULSE:
-    abuf->in_interleaf = abuf->out_interleaf = TRUE;
-    abuf->s16_signed = TRUE;
     if (mainw->pulsed_read) {
-      abuf->in_achans = abuf->out_achans = mainw->pulsed_read->in_achans;
-      abuf->arate = mainw->pulsed_read->in_arate;
+      nchans = mainw->pulsed_read->in_achans;
+      arate = mainw->pulsed_read->in_arate;
     } else if (mainw->pulsed) {
-      abuf->in_achans = abuf->out_achans = mainw->pulsed->out_achans;
-      abuf->arate = mainw->pulsed->out_arate;
+      nchans = mainw->pulsed->out_achans;
+      arate = mainw->pulsed->out_arate;
     }
     break;
 #endif
 #ifdef ENABLE_JACK
   case AUD_PLAYER_JACK:
-    abuf->in_interleaf = abuf->out_interleaf = FALSE;
     if (mainw->jackd_read && mainw->jackd_read->in_use) {
-      abuf->in_achans = abuf->out_achans = mainw->jackd_read->num_input_channels;
-      abuf->arate = mainw->jackd_read->sample_in_rate;
+      nchans = mainw->jackd_read->num_input_channels;
+      arate = mainw->jackd_read->sample_in_rate;
     } else if (mainw->jackd) {
-      abuf->in_achans = abuf->out_achans = mainw->jackd->num_output_channels;
-      abuf->arate = mainw->jackd->sample_out_rate;
+      nchans = mainw->jackd->num_output_channels;
+      arate = mainw->jackd->sample_out_rate;
     }
     break;
 #endif
   default:
     break;
   }
-  mainw->afbuffer = abuf;
+  if (nchans <= 0) nchans = DEFAULT_AUDIO_CHANS;
+  if (arate <= 0) arate = DEFAULT_AUDIO_RATE;
+
+  free_retired_arenas();
 
+  mainw->aarena = aarena_new(nchans, arate);
 #ifdef DEBUG_AFB
-  g_print("init afb\n");
+  g_print("init arena\n");
 #endif
 }
 
 
+void retire_audio_arena(void) {
+  // detach the arena; the audio thread or a reader may still hold a reference, so it is only freed
+  // once the references have been dropped
+  lives_aarena_t *aar = __atomic_exchange_n(&mainw->aarena, NULL, __ATOMIC_SEQ_CST);
+  if (aar) retired_aarenas = lives_list_prepend(retired_aarenas, aar);
+  free_retired_arenas();
+}
+
+
 void init_aux_audio_frame_buffers(short aplayer) {
   for (int i = 0; i < 2; i++) {
     lives_audio_buf_t *abuf;
@@ -448,11 +669,6 @@ void free_audio_frame_buffer(lives_audio_buf_t *abuf) {
     abuf->samples_filled = 0;
     abuf->out_achans = 0;
     abuf->start_sample = 0;
-    abuf->write_pos = 0;
-    abuf->aclients = abuf->vclients = 0;
-    abuf->aclients_read = abuf->vclients_read = 0;
-    abuf->aclient_readpos = abuf->vclient_readpos = 0;
-    abuf->aclient_readlevel = abuf->vclient_readlevel = 0;
   }
 #ifdef DEBUG_AFB
   g_print("clear afb %p\n", abuf);
@@ -667,6 +883,499 @@ float get_float_audio_val_at_time(int fnum, int afd, double secs, int chnum, int
 }
 
 
+//////////////////////////// waveform peak cache ////////////////////////////////
+//
+// for each clip with audio we can hold a "peak pyramid": level 0 holds the min, max and rms values
+// for every PEAK_BASE_FRAMES audio frames, and each following level halves the resolution of the level below.
+// The timeline and multitrack can then draw any zoom level in O(pixels) without re-reading the audio file.
+//
+// the pyramid is built on a single background thread which works through a queue of clips; results are saved
+// alongside the audio in PEAK_CACHE_FILENAME and reloaded on demand. reget_afilesize() is called after audio is imported,
+// recorded or edited; it queues the clip for building and discards any cache which no longer matches the audio file.
+
+struct _lives_peak_cache {
+  uint64_t clip_uid;
+  int achans, asampsize, signed_endian;
+  off_t afilesize; // size of audio file covered
+  int64_t mtime; // mtime of audio file covered, in nsec, since in place edits keep the size
+  int64_t nframes; // audio frames covered when complete
+  volatile int64_t built_frames; // values are valid for audio frames up to here
+  int nlevels;
+  int64_t nbins[PEAK_MAX_LEVELS];
+  lives_peak_t *levels[PEAK_MAX_LEVELS]; // each level is interleaved: bin * achans + channel
+  volatile boolean cancelled;
+  boolean orphaned; // removed while being built, the builder will free it
+  pthread_mutex_t mutex;
+};
+
+typedef struct _lives_peak_cache lives_peak_cache_t;
+
+typedef struct {
+  char magic[8];
+  int32_t version;
+  int32_t achans, asampsize, signed_endian;
+  int32_t nlevels, pad;
+  int64_t afilesize, mtime, nframes;
+} lives_peak_hdr_t;
+
+// peak_mutex protects the list, the queue and peak_building; the lock order is peak_mutex -> pc->mutex
+static LiVESList *peak_caches = NULL;
+static LiVESList *peak_queue = NULL;
+static lives_peak_cache_t *peak_building = NULL;
+static lives_proc_thread_t peak_builder = NULL;
+static pthread_mutex_t peak_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static lives_peak_cache_t *peak_cache_find(uint64_t uid) {
+  for (LiVESList *list = peak_caches; list; list = list->next) {
+    lives_peak_cache_t *pc = (lives_peak_cache_t *)list->data;
+    if (pc->clip_uid == uid) return pc;
+  }
+  return NULL;
+}
+
+
+static int clipno_for_uid(uint64_t uid) {
+  for (int i = 1; i <= MAX_FILES; i++) {
+    if (mainw->files[i] && mainw->files[i]->unique_id == uid) return i;
+  }
+  return -1;
+}
+
+
+static char *get_peak_file_name(int clipno) {
+  char *clipdir = get_clip_dir(clipno);
+  char *fname = lives_build_filename(clipdir, PEAK_CACHE_FILENAME, NULL);
+  lives_free(clipdir);
+  return fname;
+}
+
+
+static boolean get_audio_file_stat(int clipno, off_t *size, int64_t *mtime) {
+  struct stat st;
+  char *fname = lives_get_audio_file_name(clipno);
+  int ret = stat(fname, &st);
+  lives_free(fname);
+  if (ret) return FALSE;
+  *size = st.st_size;
+  *mtime = (int64_t)st.st_mtim.tv_sec * ONE_BILLION + st.st_mtim.tv_nsec;
+  return TRUE;
+}
+
+
+static void peak_cache_set_size(lives_peak_cache_t *pc, int64_t nframes) {
+  // (re)allocate the levels to cover nframes; existing values are retained
+  int64_t nbins = (nframes + PEAK_BASE_FRAMES - 1) / PEAK_BASE_FRAMES;
+  int lev;
+  if (nbins < 1) nbins = 1;
+  for (lev = 0; lev < PEAK_MAX_LEVELS; lev++) {
+    if (nbins != pc->nbins[lev] || !pc->levels[lev]) {
+      pc->levels[lev] = (lives_peak_t *)lives_realloc(pc->levels[lev], nbins * pc->achans * sizeof(lives_peak_t));
+      if (nbins > pc->nbins[lev])
+        lives_memset(pc->levels[lev] + pc->nbins[lev] * pc->achans, 0,
+                     (nbins - pc->nbins[lev]) * pc->achans * sizeof(lives_peak_t));
+      pc->nbins[lev] = nbins;
+    }
+    if (nbins == 1) break;
+    nbins = (nbins + 1) >> 1;
+  }
+  for (int i = lev + 1; i < pc->nlevels; i++) {
+    lives_freep((void **)&pc->levels[i]);
+    pc->nbins[i] = 0;
+  }
+  pc->nlevels = lev + 1;
+  pc->nframes = nframes;
+}
+
+
+static void peak_cache_free(lives_peak_cache_t *pc) {
+  for (int lev = 0; lev < pc->nlevels; lev++) lives_freep((void **)&pc->levels[lev]);
+  pthread_mutex_destroy(&pc->mutex);
+  lives_free(pc);
+}
+
+
+static boolean peak_cache_load(lives_peak_cache_t *pc, int clipno) {
+  // reload a complete pyramid written by peak_cache_save(); returns FALSE if it is missing or stale
+  lives_peak_hdr_t hdr;
+  char *fname = get_peak_file_name(clipno);
+  boolean ok = FALSE;
+  int fd;
+
+  if (!lives_file_test(fname, LIVES_FILE_TEST_EXISTS)) {
+    lives_free(fname);
+    return FALSE;
+  }
+  fd = lives_open_buffered_rdonly(fname);
+  if (fd >= 0) {
+    if (lives_read_buffered(fd, &hdr, sizeof(hdr), TRUE) == sizeof(hdr)
+        && !lives_memcmp(hdr.magic, PEAK_CACHE_MAGIC, 8) && hdr.version == PEAK_CACHE_VERSION
+        && hdr.achans == pc->achans && hdr.asampsize == pc->asampsize
+        && hdr.signed_endian == pc->signed_endian && hdr.afilesize == pc->afilesize
+        && hdr.mtime == pc->mtime && hdr.nframes == pc->nframes && hdr.nlevels == pc->nlevels) {
+      ok = TRUE;
+      pthread_mutex_lock(&pc->mutex);
+      for (int lev = 0; lev < pc->nlevels; lev++) {
+        size_t bytes = pc->nbins[lev] * pc->achans * sizeof(lives_peak_t);
+        if (lives_read_buffered(fd, pc->levels[lev], bytes, TRUE) != bytes) {
+          ok = FALSE;
+          break;
+        }
+      }
+      if (ok) pc->built_frames = pc->nframes;
+      pthread_mutex_unlock(&pc->mutex);
+    }
+    lives_close_buffered(fd);
+  }
+  if (!ok) lives_rm(fname);
+  lives_free(fname);
+  return ok;
+}
+
+
+static void peak_cache_save(lives_peak_cache_t *pc, int clipno) {
+  lives_peak_hdr_t hdr;
+  char *fname = get_peak_file_name(clipno);
+  int fd = lives_create_buffered(fname, DEF_FILE_PERMS);
+  if (fd >= 0) {
+    lives_memset(&hdr, 0, sizeof(hdr));
+    lives_memcpy(hdr.magic, PEAK_CACHE_MAGIC, 8);
+    hdr.version = PEAK_CACHE_VERSION;
+    hdr.achans = pc->achans;
+    hdr.asampsize = pc->asampsize;
+    hdr.signed_endian = pc->signed_endian;
+    hdr.nlevels = pc->nlevels;
+    hdr.afilesize = pc->afilesize;
+    hdr.mtime = pc->mtime;
+    hdr.nframes = pc->nframes;
+    THREADVAR(write_failed) = 0;
+    lives_write_buffered(fd, (const char *)&hdr, sizeof(hdr), TRUE);
+    for (int lev = 0; lev < pc->nlevels; lev++)
+      lives_write_buffered(fd, (const char *)pc->levels[lev], pc->nbins[lev] * pc->achans * sizeof(lives_peak_t), TRUE);
+    lives_close_buffered(fd);
+    if (THREADVAR(write_failed) || pc->cancelled) {
+      THREADVAR(write_failed) = 0;
+      lives_rm(fname);
+    }
+  }
+  lives_free(fname);
+}
+
+
+LIVES_LOCAL_INLINE float peak_sample_val(const uint8_t *ptr, int asampsize, int signed_endian) {
+  // c.f. get_float_audio_val_at_time()
+  float val;
+  if (asampsize == 8) {
+    if (!(signed_endian & AFORM_UNSIGNED)) val = (int8_t)ptr[0];
+    else val = (int)ptr[0] - 127;
+    return val > 0. ? val / 127. : val / 128.;
+  } else {
+    uint16_t val16;
+    if (signed_endian & AFORM_BIG_ENDIAN) val16 = (uint16_t)(ptr[0] << 8) + ptr[1];
+    else val16 = (uint16_t)(ptr[1] << 8) + ptr[0];
+    if (!(signed_endian & AFORM_UNSIGNED)) val = (int16_t)val16;
+    else val = (int)val16 - 32767;
+    return val > 0. ? val / 32767. : val / 32768.;
+  }
+}
+
+
+static void peak_cache_merge_up(lives_peak_cache_t *pc, int64_t from_bin, int64_t to_bin) {
+  // recompute the higher levels from level 0 bins [from_bin, to_bin); must be called with pc->mutex locked
+  for (int lev = 1; lev < pc->nlevels; lev++) {
+    lives_peak_t *src = pc->levels[lev - 1], *dst = pc->levels[lev];
+    int64_t nsrc = pc->nbins[lev - 1];
+    from_bin >>= 1;
+    to_bin = (to_bin + 1) >> 1;
+    if (to_bin > pc->nbins[lev]) to_bin = pc->nbins[lev];
+    for (int64_t b = from_bin; b < to_bin; b++) {
+      for (int c = 0; c < pc->achans; c++) {
+        lives_peak_t *a = &src[(b << 1) * pc->achans + c], *d = &dst[b * pc->achans + c];
+        if ((b << 1) + 1 < nsrc) {
+          lives_peak_t *z = a + pc->achans;
+          d->min = a->min < z->min ? a->min : z->min;
+          d->max = a->max > z->max ? a->max : z->max;
+          d->rms = (uint16_t)sqrtf(((float)a->rms * (float)a->rms + (float)z->rms * (float)z->rms) * .5f);
+        } else *d = *a;
+      }
+    }
+  }
+}
+
+
+static boolean peak_cache_build(lives_peak_cache_t *pc, int clipno) {
+  // fill level 0 from built_frames onwards, PEAK_CHUNK_BINS at a time, merging each chunk up the pyramid
+  // the cache can be queried (up to built_frames) while this runs
+  size_t fsize = pc->achans * (pc->asampsize >> 3);
+  size_t bsize = PEAK_BASE_FRAMES * fsize;
+  int64_t bin = pc->built_frames / PEAK_BASE_FRAMES;
+  lives_peak_t *chunk;
+  uint8_t *buf;
+  char *fname;
+  int afd;
+
+  fname = lives_get_audio_file_name(clipno);
+  afd = lives_open_buffered_rdonly(fname);
+  lives_free(fname);
+  if (afd < 0) return FALSE;
+
+  buf = (uint8_t *)lives_malloc(bsize * PEAK_CHUNK_BINS);
+  chunk = (lives_peak_t *)lives_malloc(PEAK_CHUNK_BINS * pc->achans * sizeof(lives_peak_t));
+
+  lives_lseek_buffered_rdonly_absolute(afd, bin * bsize);
+
+  while (bin < pc->nbins[0] && !pc->cancelled && !mainw->is_exiting) {
+    int64_t cbins = pc->nbins[0] - bin, done;
+    ssize_t bytes;
+    if (cbins > PEAK_CHUNK_BINS) cbins = PEAK_CHUNK_BINS;
+    bytes = lives_read_buffered(afd, buf, cbins * bsize, TRUE);
+    if (bytes <= 0) break;
+    cbins = (bytes + bsize - 1) / bsize;
+
+    for (int64_t b = 0; b < cbins; b++) {
+      size_t boffs = b * bsize;
+      int64_t nf = ((size_t)bytes - boffs) / fsize;
+      if (nf > PEAK_BASE_FRAMES) nf = PEAK_BASE_FRAMES;
+      for (int c = 0; c < pc->achans; c++) {
+        lives_peak_t *pk = &chunk[b * pc->achans + c];
+        const uint8_t *ptr = buf + boffs + c * (pc->asampsize >> 3);
+        float vmin = 0., vmax = 0., sumsq = 0.;
+        for (int64_t f = 0; f < nf; f++, ptr += fsize) {
+          float val = peak_sample_val(ptr, pc->asampsize, pc->signed_endian);
+          if (val < vmin) vmin = val;
+          if (val > vmax) vmax = val;
+          sumsq += val * val;
+        }
+        pk->min = (int16_t)(vmin * PEAK_SCALE);
+        pk->max = (int16_t)(vmax * PEAK_SCALE);
+        pk->rms = nf ? (uint16_t)(sqrtf(sumsq / (float)nf) * PEAK_SCALE) : 0;
+      }
+    }
+
+    pthread_mutex_lock(&pc->mutex);
+    if (bin + cbins > pc->nbins[0]) cbins = pc->nbins[0] - bin;
+    lives_memcpy(pc->levels[0] + bin * pc->achans, chunk, cbins * pc->achans * sizeof(lives_peak_t));
+    peak_cache_merge_up(pc, bin, bin + cbins);
+    bin += cbins;
+    done = bin * PEAK_BASE_FRAMES;
+    pc->built_frames = done > pc->nframes ? pc->nframes : done;
+    pthread_mutex_unlock(&pc->mutex);
+
+    if (bytes < cbins * bsize) break;
+  }
+
+  lives_close_buffered(afd);
+  lives_free(buf);
+  lives_free(chunk);
+  return pc->built_frames >= pc->nframes;
+}
+
+
+static void peak_builder_func(void) {
+  // process queued clips one at a time; the thread exits when the queue is empty
+  while (1) {
+    lives_peak_cache_t *pc = NULL;
+    boolean complete = FALSE;
+    uint64_t uid;
+    int clipno;
+
+    pthread_mutex_lock(&peak_mutex);
+    if (!peak_queue || mainw->is_exiting) {
+      lives_list_free(peak_queue);
+      peak_queue = NULL;
+      peak_builder = NULL;
+      pthread_mutex_unlock(&peak_mutex);
+      break;
+    }
+    uid = (uint64_t)peak_queue->data;
+    peak_queue = lives_list_delete_link(peak_queue, peak_queue);
+    clipno = clipno_for_uid(uid);
+    if (clipno != -1) pc = peak_cache_find(uid);
+    peak_building = pc;
+    pthread_mutex_unlock(&peak_mutex);
+
+    if (!pc) continue;
+
+    if (!pc->built_frames) complete = peak_cache_load(pc, clipno);
+    if (!complete && peak_cache_build(pc, clipno) && !pc->cancelled) peak_cache_save(pc, clipno);
+
+    pthread_mutex_lock(&peak_mutex);
+    peak_building = NULL;
+    if (pc->orphaned) peak_cache_free(pc);
+    pthread_mutex_unlock(&peak_mutex);
+  }
+}
+
+
+static void peak_queue_clip(uint64_t uid) {
+  // must be called with peak_mutex locked
+  if (!lives_list_find(peak_queue, (livespointer)uid))
+    peak_queue = lives_list_append(peak_queue, (livespointer)uid);
+  if (!peak_builder)
+    peak_builder = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, (lives_funcptr_t)peak_builder_func, -1, "", NULL);
+}
+
+
+static void peak_cache_remove(lives_peak_cache_t *pc, int clipno, boolean remove_file) {
+  // must be called with peak_mutex locked
+  peak_caches = lives_list_remove(peak_caches, pc);
+  pc->cancelled = TRUE;
+  if (remove_file) {
+    char *fname = get_peak_file_name(clipno);
+    lives_rm(fname);
+    lives_free(fname);
+  }
+  if (pc == peak_building) pc->orphaned = TRUE;
+  else {
+    // wait for any query to finish
+    pthread_mutex_lock(&pc->mutex);
+    pthread_mutex_unlock(&pc->mutex);
+    peak_cache_free(pc);
+  }
+}
+
+
+boolean clip_peaks_ensure(int clipno) {
+  // make sure a peak cache exists for clipno, queueing it for loading / building if not
+  // returns TRUE if any values can be queried yet
+  lives_clip_t *sfile = RETURN_NORMAL_CLIP(clipno);
+  lives_peak_cache_t *pc;
+  boolean avail;
+
+  if (!sfile || !CLIP_HAS_AUDIO(clipno) || sfile->opening) return FALSE;
+  if (sfile->asampsize != 8 && sfile->asampsize != 16) return FALSE;
+
+  pthread_mutex_lock(&peak_mutex);
+  pc = peak_cache_find(sfile->unique_id);
+  if (!pc) {
+    off_t afilesize;
+    int64_t mtime;
+    if (!get_audio_file_stat(clipno, &afilesize, &mtime) || !afilesize) {
+      pthread_mutex_unlock(&peak_mutex);
+      return FALSE;
+    }
+    pc = (lives_peak_cache_t *)lives_calloc(1, sizeof(lives_peak_cache_t));
+    pc->clip_uid = sfile->unique_id;
+    pc->achans = sfile->achans;
+    pc->asampsize = sfile->asampsize;
+    pc->signed_endian = sfile->signed_endian;
+    pc->afilesize = afilesize;
+    pc->mtime = mtime;
+    pthread_mutex_init(&pc->mutex, NULL);
+    peak_cache_set_size(pc, afilesize / (pc->achans * (pc->asampsize >> 3)));
+    peak_caches = lives_list_prepend(peak_caches, pc);
+    peak_queue_clip(pc->clip_uid);
+  }
+  avail = pc->built_frames > 0;
+  pthread_mutex_unlock(&peak_mutex);
+  return avail;
+}
+
+
+void clip_peaks_update(int clipno) {
+  // called from reget_afilesize(): discard the cache if the audio changed, then (re)queue the clip for building
+  lives_clip_t *sfile = RETURN_NORMAL_CLIP(clipno);
+  lives_peak_cache_t *pc;
+  off_t afilesize;
+  int64_t mtime;
+
+  if (!sfile) return;
+  pthread_mutex_lock(&peak_mutex);
+  if ((pc = peak_cache_find(sfile->unique_id))) {
+    if (!get_audio_file_stat(clipno, &afilesize, &mtime) || afilesize != pc->afilesize || mtime != pc->mtime
+        || sfile->achans != pc->achans || sfile->asampsize != pc->asampsize
+        || sfile->signed_endian != pc->signed_endian)
+      peak_cache_remove(pc, clipno, TRUE);
+  }
+  pthread_mutex_unlock(&peak_mutex);
+  clip_peaks_ensure(clipno);
+}
+
+
+void clip_peaks_free(int clipno) {
+  // called when closing a clip; the saved file is kept with the clip's other files
+  lives_clip_t *sfile = RETURN_VALID_CLIP(clipno);
+  lives_peak_cache_t *pc;
+  if (!sfile) return;
+  pthread_mutex_lock(&peak_mutex);
+  if ((pc = peak_cache_find(sfile->unique_id))) peak_cache_remove(pc, clipno, FALSE);
+  pthread_mutex_unlock(&peak_mutex);
+}
+
+
+int clip_peaks_query(int clipno, int chan, double stime, double secs_per_pixel, int npix,
+                     float *mins, float *maxs, float *rms) {
+  // fill up to npix values; the first pixel starts at stime (seconds), each one spanning secs_per_pixel
+  // any of mins, maxs, rms may be NULL
+  // returns the number of pixels filled, which may be fewer than npix whilst the cache is being built
+  // the level is chosen so that at most a handful of bins are combined for each pixel
+  lives_clip_t *sfile = RETURN_NORMAL_CLIP(clipno);
+  lives_peak_cache_t *pc;
+  lives_peak_t *level;
+  double fpp, f0;
+  int64_t span = PEAK_BASE_FRAMES, nbins;
+  int lev = 0, pix;
+
+  if (!sfile || chan < 0 || chan >= sfile->achans || secs_per_pixel <= 0. || stime < 0.
+      || sfile->arate <= 0 || npix <= 0) return 0;
+  if (!clip_peaks_ensure(clipno)) return 0;
+
+  pthread_mutex_lock(&peak_mutex);
+  if (!(pc = peak_cache_find(sfile->unique_id))) {
+    pthread_mutex_unlock(&peak_mutex);
+    return 0;
+  }
+  pthread_mutex_lock(&pc->mutex);
+  pthread_mutex_unlock(&peak_mutex);
+
+  fpp = secs_per_pixel * (double)sfile->arate;
+  while (lev < pc->nlevels - 1 && (double)(span << 1) <= fpp) {
+    lev++;
+    span <<= 1;
+  }
+  level = pc->levels[lev];
+  nbins = pc->nbins[lev];
+
+  for (pix = 0; pix < npix; pix++) {
+    int64_t b0, b1;
+    float vmin = 0., vmax = 0., vrms = 0.;
+    f0 = (stime + (double)pix * secs_per_pixel) * (double)sfile->arate;
+    if ((int64_t)f0 >= pc->built_frames) break;
+    b0 = (int64_t)f0 / span;
+    b1 = (int64_t)(f0 + fpp + span - 1.) / span;
+    if (b1 > nbins) b1 = nbins;
+    if (b1 <= b0) b1 = b0 + 1;
+    for (int64_t b = b0; b < b1 && b < nbins; b++) {
+      lives_peak_t *pk = &level[b * pc->achans + chan];
+      if (pk->min < vmin * PEAK_SCALE) vmin = (float)pk->min / PEAK_SCALE;
+      if (pk->max > vmax * PEAK_SCALE) vmax = (float)pk->max / PEAK_SCALE;
+      vrms += (float)pk->rms * (float)pk->rms;
+    }
+    if (mins) mins[pix] = vmin;
+    if (maxs) maxs[pix] = vmax;
+    if (rms) rms[pix] = sqrtf(vrms / (float)(b1 - b0)) / PEAK_SCALE;
+  }
+
+  pthread_mutex_unlock(&pc->mutex);
+  return pix;
+}
+
+
+int clip_peaks_get_waveform(int clipno, int chan, float *wave, int start, int end, double secs_per_pixel, float scale) {
+  // fill wave[start] to wave[end - 1] with the largest (signed) excursion for each pixel, multiplied by scale
+  // pixel i starts at time i * secs_per_pixel
+  // returns the index after the last value filled, i.e. start if nothing could be filled
+  float *mins, *maxs;
+  int npix = end - start, n;
+  if (npix <= 0) return start;
+  mins = (float *)lives_malloc(npix * sizeof(float));
+  maxs = (float *)lives_malloc(npix * sizeof(float));
+  n = clip_peaks_query(clipno, chan, (double)start * secs_per_pixel, secs_per_pixel, npix, mins, maxs, NULL);
+  for (int i = 0; i < n; i++) wave[start + i] = scale * (maxs[i] >= -mins[i] ? maxs[i] : mins[i]);
+  lives_free(mins); lives_free(maxs);
+  return start + n;
+}
+
+
 LIVES_GLOBAL_INLINE void sample_silence_dS(float *dst, uint64_t nsamples) {
   // send silence to the jack player
   lives_memset(dst, 0, nsamples * sizeof(float));
@@ -982,77 +1691,6 @@ float sample_move_d16_float(float *dst, short *src, uint64_t nsamples, uint64_t
 }
 
 
-float sample_move_d16_float_arena(float *dst, short *src, size_t offset, uint64_t nsamples, uint64_t src_skip,
-                                  int is_unsigned, boolean rev_endian, float vol) {
-  // convert 16 bit audio to float audio
-
-  // returns abs(maxvol heard)
-
-  float svolp, svoln;
-  size_t doffs = mainw->afbuffer->write_pos;
-
-#ifdef ENABLE_OIL
-  float val = 0.; // set a value to stop valgrind complaining
-  float maxval = 0.;
-  double xn, xp, xa;
-  double y = 0.f;
-#else
-  float val;
-  float maxval = 0.;
-  short valss;
-#endif
-  size_t xoffs = offset;
-  uint8_t srcx[2];
-  short srcxs;
-  short *srcp;
-
-  if (vol == 0.) vol = 0.0000001f;
-  svolp = SAMPLE_MAX_16BIT_P / vol;
-  svoln = SAMPLE_MAX_16BIT_N / vol;
-
-#ifdef ENABLE_OIL
-  xp = 1. / svolp;
-  xn = 1. / svoln;
-  xa = 2. * vol / (SAMPLE_MAX_16BIT_P + SAMPLE_MAX_16BIT_N);
-#endif
-
-  while (nsamples--) {
-    if (rev_endian) {
-      lives_memcpy(&srcx, src + xoffs, 2);
-      srcxs = ((srcx[1] & 0xFF)  << 8) + (srcx[0] & 0xFF);
-      srcp = &srcxs;
-    } else srcp = src + xoffs;
-
-    if (!is_unsigned) {
-#ifdef ENABLE_OIL
-      oil_scaleconv_f32_s16(&val, srcp, 1, &y, val > 0 ? &xp : &xn);
-#else
-      if ((val = (float)((float)(*srcp) / (*srcp > 0 ? svolp : svoln))) > 1.0f) val = 1.0f;
-      else if (val < -1.0f) val = -1.0f;
-#endif
-    } else {
-#ifdef ENABLE_OIL
-      oil_scaleconv_f32_u16(&val, (unsigned short *)srcp, 1, &y, &xa);
-      val -= vol;
-#else
-      valss = (unsigned short) * srcp - SAMPLE_MAX_16BITI;
-      if ((val = (float)((float)(valss) / (valss > 0 ? svolp : svoln))) > 1.0f) val = 1.0f;
-      else if (val < -1.0f) val = -1.0f;
-#endif
-    }
-
-    if (*srcp > maxval) maxval = *srcp;
-    else if (-*srcp > maxval) maxval = -*srcp;
-
-    dst[doffs] = val;
-    if (++doffs >= ABUF_ARENA_SIZE) doffs = 0;
-    xoffs += src_skip;
-    if (xoffs >= ABUF_ARENA_SIZE * 2) xoffs = 0;
-  }
-  return maxval;
-}
-
-
 size64_t sample_move_float_float(float *dst, float *src, size64_t in_samples, double scale, int dst_skip, float vol,
                                  size64_t out_samples) {
   // copy one channel of float to a buffer, applying the scale (scale 2.0 to halve the rate, etc)
@@ -1096,76 +1734,6 @@ size64_t sample_move_float_float(float *dst, float *src, size64_t in_samples, do
 }
 
 
-//abuf->vclient_readlevel = sample_move_float_float_arena(dst[i], src, abuf->vclient_readpos, alen, scale, 1, 1.);
-
-static size64_t sample_move_float_float_arena(float *dst, float *src, size_t offset, size64_t in_samples, double scale,
-    int dst_skip,
-    float vol, size64_t out_samples) {
-  // copy one channel of float to a buffer, applying the scale (scale 2.0 to halve the rate, etc)
-  double offs_d = 0.;
-  off64_t offs = 0, xoffs;
-  size64_t outsamps = 0;
-  size64_t space = ABUF_ARENA_SIZE - offset;
-
-#ifdef USE_INTRINSICSx
-  boolean can_intrin;
-  off64_t xxoffs;
-#endif
-
-  if (scale == 1. && dst_skip == 1 && vol == 1. && in_samples <= space) {
-    lives_memcpy((void *)dst, (void *)src, in_samples * sizeof(float));
-    return in_samples;
-  }
-
-  if (scale < 0.f) {
-    offs_d = (1. - (double)in_samples * scale);
-    offs = (off64_t)offs_d;
-  }
-
-  while (1) {
-    if ((scale > 0. && offs > (off64_t)in_samples)
-        || (scale < 0. && offs < 0)) break;
-
-    xoffs = offset + offs;
-
-    if (xoffs >= ABUF_ARENA_SIZE) {
-      xoffs -= ABUF_ARENA_SIZE;
-      offs_d -= (double)ABUF_ARENA_SIZE;
-    } else if (xoffs < 0) {
-      xoffs += ABUF_ARENA_SIZE;
-      offs_d += (double)ABUF_ARENA_SIZE;
-    }
-
-#ifdef USE_INTRINSICSx
-    can_intrin = FALSE;
-    if (scale < 0.) {
-      xxoffs = (off64_t)((offs_d + scale * 4.) - .4999);
-      if (xxoffs >= 0) can_intrin = TRUE;
-    } else {
-      xxoffs = (off64_t)((offs_d + scale * 4.) + .4999);
-      if (xxoffs < in_samples && xoffs < ABUF_ARENA_SIZE) can_intrin = TRUE;
-    }
-    if (can_intrin) {
-      offs_d = intrin_resample_vol(&dst[dst_skip * outsamps], dst_skip, src, offs_d, scale, vol);
-      outsamps += 4;
-      continue;
-    }
-#endif
-
-    dst[dst_skip * outsamps] = src[xoffs] * vol;
-    if (scale < 0.) {
-      offs = (off64_t)((offs_d += scale) - .4999);
-      if (offs < 0) break;
-    } else {
-      offs = (off64_t)((offs_d += scale) + .4999);
-      if (offs >= in_samples) break;
-    }
-    outsamps++;
-  }
-  return outsamps;
-}
-
-
 #define CLIP_DECAY ((double)16535. / (double)16536.)
 
 #define CLIP_LIMIT 1.
@@ -2853,6 +3421,104 @@ boolean write_aud_data_cb(lives_obj_instance_t *aplayer, void *xdets) {
 }
 
 
+// host spectral analysis service
+// analysers which set host_spectrum_req in their audio in chantmpl receive the spectrum and log band energies
+// of each packet, with the window set in host_spectrum_window, computed once here instead of each plugin
+// running its own FFT over the same data
+
+static pthread_mutex_t spec_win_mutex = PTHREAD_MUTEX_INITIALIZER;
+static float *spec_windows[SPECTRUM_MAX_LOG2 + 1];
+
+static const float *get_spectrum_window(int log2n) {
+  // Hamming windows are cached per size, the aplayers may call this concurrently
+  float *win;
+  pthread_mutex_lock(&spec_win_mutex);
+  if (!(win = spec_windows[log2n])) {
+    int n = 1 << log2n;
+    win = (float *)lives_malloc(n * sizeof(float));
+    if (win) {
+      for (int i = 0; i < n; i++) win[i] = 0.54f - 0.46f * cosf(2.f * M_PI * (float)i / (float)(n - 1));
+      spec_windows[log2n] = win;
+    }
+  }
+  pthread_mutex_unlock(&spec_win_mutex);
+  return win;
+}
+
+
+boolean audio_spectrum_analyse(weed_plant_t *layer, float **abuf, int nchans, int nframes, int arate, int windows) {
+  // FFT size is the largest power of 2 <= nframes, taken from the start of the packet (as the plugins did)
+  // magnitudes are averaged over channels; band energies are the mean power in SPECTRUM_NBANDS log spaced bands
+  // from 0 Hz -> SPECTRUM_FMIN ... nyquist
+  // a separate spectrum is made for each window requested, so each analyser gets the same values as its own FFT would
+  double bfreqs[SPECTRUM_NBANDS], benergies[SPECTRUM_NBANDS];
+  double *mags, fmax, bw;
+  const float *win;
+  float *re, *im;
+  char lkey[64];
+  int log2n = 0, n, nbins, k;
+
+  if (!layer || !abuf || nchans <= 0 || nframes < 2 || arate <= 0) return FALSE;
+
+  while ((2 << log2n) <= nframes && log2n < SPECTRUM_MAX_LOG2) log2n++;
+  n = 1 << log2n;
+  nbins = (n >> 1) + 1;
+
+  mags = (double *)lives_malloc(nbins * sizeof(double));
+  re = (float *)lives_malloc(n * sizeof(float));
+  im = (float *)lives_malloc(n * sizeof(float));
+  if (!mags || !re || !im) goto specfail;
+
+  fmax = (double)arate / 2.;
+  bw = (double)arate / (double)n; // bin width in Hz
+
+  for (int b = 0; b < SPECTRUM_NBANDS; b++)
+    bfreqs[b] = SPECTRUM_FMIN * pow(fmax / SPECTRUM_FMIN, (double)b / (double)(SPECTRUM_NBANDS - 1));
+
+  for (int window = 0; window < N_HOST_SPECTRUM_WINDOWS; window++) {
+    if (!(windows & (1 << window))) continue;
+    win = NULL;
+    if (window == HOST_SPECTRUM_WINDOW_HAMMING && !(win = get_spectrum_window(log2n))) continue;
+
+    lives_memset(mags, 0, nbins * sizeof(double));
+    for (int c = 0; c < nchans; c++) {
+      if (!abuf[c]) continue;
+      if (win) for (int i = 0; i < n; i++) re[i] = abuf[c][i] * win[i];
+      else lives_memcpy(re, abuf[c], n * sizeof(float));
+      lives_memset(im, 0, n * sizeof(float));
+      lives_fft(re, im, log2n);
+      for (int i = 0; i < nbins; i++) mags[i] += sqrt(re[i] * re[i] + im[i] * im[i]) / (double)nchans;
+    }
+
+    k = 0;
+    for (int b = 0; b < SPECTRUM_NBANDS; b++) {
+      double tot = 0.;
+      int nb = 0;
+      for (; k < nbins && (double)k * bw <= bfreqs[b]; k++, nb++) tot += mags[k] * mags[k];
+      benergies[b] = nb ? tot / (double)nb : 0.;
+    }
+
+    weed_set_double_array(layer, host_spectrum_layer_key(lkey, 64, WEED_LEAF_HOST_SPECTRUM, window), nbins, mags);
+    weed_set_int_value(layer, host_spectrum_layer_key(lkey, 64, WEED_LEAF_HOST_SPECTRUM_SIZE, window), n);
+    weed_set_double_array(layer, host_spectrum_layer_key(lkey, 64, WEED_LEAF_HOST_BAND_ENERGIES, window),
+                          SPECTRUM_NBANDS, benergies);
+    weed_set_double_array(layer, host_spectrum_layer_key(lkey, 64, WEED_LEAF_HOST_BAND_FREQS, window),
+                          SPECTRUM_NBANDS, bfreqs);
+  }
+
+  lives_free(mags);
+  lives_free(re);
+  lives_free(im);
+  return TRUE;
+
+specfail:
+  lives_freep((void **)&mags);
+  lives_freep((void **)&re);
+  lives_freep((void **)&im);
+  return FALSE;
+}
+
+
 /* sample_move_d16_float(fltbuf[i], (short *)pulsed->sound_buffer + i, */
 /* 						 nsamples, pulsed->out_achans, FALSE, FALSE, 1.0); */
 
@@ -2867,9 +3533,10 @@ static boolean analyse_audio_rt(lives_obj_t *aplayer) {
   // for filters with only audio in, and nothing else we push the new audio directly to them
   // since they should be running in the audio cycle
   GET_PROC_THREAD_SELF(self);
+  lives_aarena_t *aar;
   float maxvol_heard = 0.;
   size_t nframes;
-  int arate, nchans;
+  int arate, nchans, windows;
   boolean is_float;
   boolean alock_mixer = FALSE;
 
@@ -2922,16 +3589,19 @@ static boolean analyse_audio_rt(lives_obj_t *aplayer) {
       }
     }
 
-    if (mainw->afbuffer) {
+    if ((aar = audio_arena_ref())) {
       // if we have audio triggered gens., push audio to it
       // or if we want loopback to player
       for (int i = 0; i < nchans; i++) {
-        append_to_audio_bufferf(in_buffer[i], nframes, (i == nchans - 1) ? -i - 1 : i + 1);
+        append_to_audio_bufferf(aar, in_buffer[i], nframes, (i == nchans - 1) ? -i - 1 : i + 1);
       }
+      audio_arena_unref();
     }
 
     // apply any audio effects with in_channels and no out_channels
     weed_layer_set_audio_data(layer, in_buffer, arate, nchans, nframes);
+    // this runs async in the DATA_READY hook, so the analysis is done here once per packet, off the player thread
+    if ((windows = has_spectrum_analysers())) audio_spectrum_analyse(layer, in_buffer, nchans, nframes, arate, windows);
     weed_apply_audio_effects_rt(layer, tc, TRUE, TRUE);
     weed_layer_set_audio_data(layer, NULL, 0, 0, 0);
     weed_layer_unref(layer);
@@ -2992,6 +3662,144 @@ void audio_analyser_end(int source) {
 }
 
 
+// latency monitoring for the realtime players
+// the player calls alat_callback() at the start of each process callback, and we measure how far the interval
+// deviates from the duration of the data requested last time. The cache thread lead time and server reported
+// underruns are also tracked, and alat_adapt() then derives how much audio the player ought to keep queued
+
+void alat_reset(lives_alatency_t *alat, int64_t target_frames) {
+  lives_memset(alat, 0, sizeof(lives_alatency_t));
+  alat->lead_min = TICKS_PER_SECOND;
+  alat->target_frames = target_frames;
+}
+
+
+void alat_callback(lives_alatency_t *alat, int64_t nframes, int rate) {
+  ticks_t now = lives_get_current_ticks(), jitter;
+  int bin = 0;
+
+  if (rate <= 0) return;
+
+  if (alat->last_cb && alat->period) {
+    jitter = now - alat->last_cb - alat->period;
+    if (jitter < 0) jitter = -jitter;
+    // a very long gap means we were paused or stopped, not late
+    if (jitter < alat->period * 8) {
+      if (alat->nsamples == ALAT_WINDOW) {
+        // remove the oldest value from the histogram
+        ticks_t old = alat->jitter[alat->jidx];
+        int obin = 0;
+        while (obin < ALAT_NBINS - 1 && old >= (ALAT_BIN_BASE << obin)) obin++;
+        alat->hist[obin]--;
+      } else alat->nsamples++;
+      alat->jitter[alat->jidx] = jitter;
+      if (++alat->jidx == ALAT_WINDOW) alat->jidx = 0;
+      while (bin < ALAT_NBINS - 1 && jitter >= (ALAT_BIN_BASE << bin)) bin++;
+      alat->hist[bin]++;
+    }
+  }
+  alat->last_cb = now;
+  alat->period = (ticks_t)((double)nframes / (double)rate * TICKS_PER_SECOND_DBL);
+}
+
+
+void alat_cache_lead(lives_alatency_t *alat, ticks_t lead) {
+  if (lead < 0) alat->cache_misses++;
+  if (lead < alat->lead_min) alat->lead_min = lead;
+  alat->lead_last = lead;
+}
+
+
+LIVES_GLOBAL_INLINE void alat_underrun(lives_alatency_t *alat) {alat->underruns++;}
+
+
+static int cmp_ticks(const void *a, const void *b) {
+  ticks_t ta = *(const ticks_t *)a, tb = *(const ticks_t *)b;
+  return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+
+static ticks_t alat_hist_percentile(lives_alatency_t *alat, int pct) {
+  // upper edge of the histogram bin holding the pct percentile; this is cheap enough for the process callback
+  // the last bin is open ended, so we take twice its lower edge
+  int n = alat->nsamples, want, tot = 0, bin;
+  if (!n) return 0;
+  want = (n - 1) * pct / 100 + 1;
+  for (bin = 0; bin < ALAT_NBINS - 1; bin++) {
+    tot += alat->hist[bin];
+    if (tot >= want) break;
+  }
+  return ALAT_BIN_BASE << bin;
+}
+
+
+ticks_t alat_jitter_percentile(lives_alatency_t *alat, int pct) {
+  // exact value, for reporting
+  ticks_t vals[ALAT_WINDOW];
+  int n = alat->nsamples;
+  if (!n) return 0;
+  lives_memcpy(vals, alat->jitter, n * sizeof(ticks_t));
+  qsort(vals, n, sizeof(ticks_t), cmp_ticks);
+  return vals[(n - 1) * pct / 100];
+}
+
+
+boolean alat_adapt(lives_alatency_t *alat, int rate, int64_t min_frames, int64_t max_frames) {
+  // returns TRUE if target_frames was changed
+  // this is called from the player's process callback, so it must not sort, allocate or block
+  // we want to hold one period plus twice the high percentile jitter, plus any shortfall from the cache thread
+  // after an underrun we grow by at least half; when things are quiet we shrink back slowly
+  ticks_t now = lives_get_current_ticks(), need;
+  int64_t want, target = alat->target_frames;
+
+  if (now - alat->last_adapt < ALAT_ADAPT_INTERVAL || rate <= 0) return FALSE;
+  alat->last_adapt = now;
+  if (alat->nsamples < (ALAT_WINDOW >> 3)) return FALSE;
+
+  need = alat->period + 2 * alat_hist_percentile(alat, ALAT_PCT);
+  if (alat->lead_min < 0) need -= alat->lead_min;
+  alat->lead_min = TICKS_PER_SECOND;
+
+  want = (int64_t)((double)need / TICKS_PER_SECOND_DBL * (double)rate);
+
+  if (alat->underruns != alat->last_underruns) {
+    alat->last_underruns = alat->underruns;
+    if (want < target + (target >> 1)) want = target + (target >> 1);
+  } else if (want < target) want = target - ((target - want) >> 2);
+
+  if (want < min_frames) want = min_frames;
+  if (want > max_frames) want = max_frames;
+
+  // hysteresis, avoid changing the server buffers for small differences
+  if (target && llabs(want - target) < (target >> 3)) return FALSE;
+  alat->target_frames = want;
+  return TRUE;
+}
+
+
+char *alat_report(lives_alatency_t *alat, int rate) {
+  char *hist = lives_strdup(""), *tmp, *msg;
+  for (int i = 0; i < ALAT_NBINS; i++) {
+    if (i < ALAT_NBINS - 1)
+      tmp = lives_strdup_printf("%s <%.1f: %d", hist, (double)(ALAT_BIN_BASE << i) / TICKS_PER_SECOND_DBL * 1000.,
+                                alat->hist[i]);
+    else tmp = lives_strdup_printf("%s more: %d", hist, alat->hist[i]);
+    lives_free(hist);
+    hist = tmp;
+  }
+  msg = lives_strdup_printf(_("Audio callback jitter (ms) p50 %.2f, p%d %.2f, max %.2f\n"
+                              "Jitter histogram (ms):%s\n"
+                              "Cache lead %.2f ms, misses %lu, underruns %lu, target latency %.2f ms\n"),
+                            (double)alat_jitter_percentile(alat, 50) / TICKS_PER_SECOND_DBL * 1000.,
+                            ALAT_PCT, (double)alat_jitter_percentile(alat, ALAT_PCT) / TICKS_PER_SECOND_DBL * 1000.,
+                            (double)alat_jitter_percentile(alat, 100) / TICKS_PER_SECOND_DBL * 1000., hist,
+                            (double)alat->lead_last / TICKS_PER_SECOND_DBL * 1000., alat->cache_misses, alat->underruns,
+                            rate > 0 ? (double)alat->target_frames / (double)rate * 1000. : 0.);
+  lives_free(hist);
+  return msg;
+}
+
+
 lives_proc_thread_t start_audio_rec(lives_obj_instance_t *aplayer) {
   // if the user activates recording during playback, prepare to start recording audio
   //  in this case we record only if the audio source is external, or an audio generator is running
@@ -3727,6 +4535,7 @@ LIVES_GLOBAL_INLINE boolean avsync_force(void) {
   }
   mainw->avsync_time = lives_get_session_ticks();
   pthread_mutex_unlock(&mainw->avseek_mutex);
+  avsync_ctl_reset();
   return TRUE;
 }
 
@@ -3851,6 +4660,141 @@ boolean resync_audio(int clipno, double frameno) {
 }
 
 
+static lives_avsync_ctl_t avctl;
+
+static void avsync_ctl_restart(void) {
+  // re-measure the baseline and restart the controller from neutral, keeping the stats
+  avctl.nsettle = AVSYNC_SETTLE_FRAMES;
+  avctl.baseline = avctl.drift = avctl.integ = avctl.corr = 0.;
+}
+
+
+void avsync_ctl_reset(void) {
+  // called after any forced resync
+  avsync_ctl_restart();
+  avctl.forced_syncs++;
+}
+
+
+/**
+   @brief continuous a/v sync controller
+
+   called once per player cycle, returns the value for mainw->audio_stretch
+
+   the drift is the difference between the audio player position and the position implied by the current video frame
+   and elapsed time. Immediately after a resync we average a few measurements to get the baseline, which is mostly the audio
+   buffering latency, and subsequently we track changes relative to that. Small drift is absorbed by a PI controller varying
+   the audio rate within +- AVSYNC_MAX_CORR, so there is no audible glitch and no video jump. Only if the drift exceeds
+   AVSYNC_HARD_THRESH we set SCRATCH_JUMP, so that the player does a hard resync in the usual way.
+*/
+double avsync_ctl_update(int clipno) {
+  static const double binms[AVSYNC_NBINS - 1] = {1., 2., 5., 10., 20., 50., 100.};
+  lives_clip_t *sfile = RETURN_NORMAL_CLIP(clipno);
+  double apos, vpos, drift, adrift, dir, corr;
+  off_t aoffs;
+  int bin;
+
+  if (mainw->play_sequence != avctl.pseq) {
+    // new playback, clear the stats
+    lives_memset(&avctl, 0, sizeof(lives_avsync_ctl_t));
+    avctl.pseq = mainw->play_sequence;
+    avctl.clipno = clipno;
+    avsync_ctl_restart();
+  }
+
+  if (clipno != avctl.clipno) {
+    avctl.clipno = clipno;
+    avsync_ctl_restart();
+  }
+
+  // resync would be meaningless in these cases, so we leave the audio alone
+  if (!sfile || sfile->fps <= 0. || !CLIP_HAS_AUDIO(clipno) || !LIVES_CE_PLAYBACK || !AV_CLIPS_EQUAL
+      || AUD_SRC_EXTERNAL || !APLAYER_REALTIME || mainw->foreign || sfile->play_paused
+      || (mainw->event_list && !mainw->record && !mainw->record_paused)
+      || mainw->agen_key != 0 || mainw->agen_needs_reinit
+      || !mainw->video_seek_ready || !mainw->audio_seek_ready || mainw->scratch != SCRATCH_NONE) {
+    avsync_ctl_restart();
+    return 1.;
+  }
+
+  aoffs = get_aplay_offset();
+  if (aoffs < 0 || !sfile->arate || !sfile->achans || !sfile->asampsize) return 1.;
+
+  dir = sfile->pb_fps < 0. ? -1. : 1.;
+  apos = (double)aoffs / (double)(abs(sfile->arate) * sfile->achans * (sfile->asampsize >> 3));
+  vpos = ((double)sfile->last_frameno - 1.) / sfile->fps
+         + (double)(mainw->currticks - mainw->startticks) / TICKS_PER_SECOND_DBL * sfile->pb_fps / sfile->fps;
+  drift = (apos - vpos) * dir;
+
+  if (avctl.nsettle > 0) {
+    avctl.baseline += drift / (double)AVSYNC_SETTLE_FRAMES;
+    avctl.nsettle--;
+    return 1.;
+  }
+
+  // the audio position only moves once per audio period, so the raw value is noisy
+  avctl.drift += (drift - avctl.baseline - avctl.drift) * AVSYNC_FILTER;
+  adrift = fabs(avctl.drift);
+
+  avctl.nmeas++;
+  avctl.drift_sum += avctl.drift;
+  avctl.drift_sqsum += avctl.drift * avctl.drift;
+  if (adrift > avctl.drift_max) avctl.drift_max = adrift;
+  for (bin = 0; bin < AVSYNC_NBINS - 1 && adrift * 1000. >= binms[bin]; bin++);
+  avctl.hist[bin]++;
+
+  if (adrift > AVSYNC_HARD_THRESH) {
+    // too far out to absorb; the player will resync, and avsync_force() restarts us
+    avctl.hard_seeks++;
+    mainw->scratch = SCRATCH_JUMP;
+    avsync_ctl_restart();
+    return 1.;
+  }
+
+  // audio ahead -> stretch > 1. -> fewer input samples per output sample -> audio slows
+  avctl.integ += avctl.drift * AVSYNC_KI;
+  if (avctl.integ > AVSYNC_MAX_CORR) avctl.integ = AVSYNC_MAX_CORR;
+  else if (avctl.integ < -AVSYNC_MAX_CORR) avctl.integ = -AVSYNC_MAX_CORR;
+
+  corr = avctl.drift * AVSYNC_KP + avctl.integ;
+  if (corr > AVSYNC_MAX_CORR) corr = AVSYNC_MAX_CORR;
+  else if (corr < -AVSYNC_MAX_CORR) corr = -AVSYNC_MAX_CORR;
+
+  avctl.corr = corr;
+  if (fabs(corr) > avctl.corr_max) avctl.corr_max = fabs(corr);
+  if (fabs(corr) >= AVSYNC_MAX_CORR / 100.) avctl.ncorr++;
+  return 1. + corr;
+}
+
+
+char *avsync_ctl_report(void) {
+  static const int binms[AVSYNC_NBINS - 1] = {1, 2, 5, 10, 20, 50, 100};
+  char *hist, *tmp, *msg;
+  double n = (double)avctl.nmeas, mean;
+
+  if (!avctl.nmeas) return lives_strdup("");
+
+  hist = lives_strdup("");
+  for (int i = 0; i < AVSYNC_NBINS; i++) {
+    if (i < AVSYNC_NBINS - 1) tmp = lives_strdup_printf("%s <%d: %d", hist, binms[i], avctl.hist[i]);
+    else tmp = lives_strdup_printf("%s more: %d", hist, avctl.hist[i]);
+    lives_free(hist);
+    hist = tmp;
+  }
+
+  mean = avctl.drift_sum / n;
+  msg = lives_strdup_printf(_("A/V drift (ms) now %.2f, mean %.2f, rms %.2f, max %.2f\n"
+                              "Drift histogram (ms):%s\n"
+                              "Rate correction %.3f %% (max %.3f %%, active %.1f %% of the time), "
+                              "resyncs %lu (%lu due to drift)\n"),
+                            avctl.drift * 1000., mean * 1000., sqrt(avctl.drift_sqsum / n) * 1000.,
+                            avctl.drift_max * 1000., hist, avctl.corr * 100., avctl.corr_max * 100.,
+                            (double)avctl.ncorr / n * 100., avctl.forced_syncs, avctl.hard_seeks);
+  lives_free(hist);
+  return msg;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 static lives_audio_buf_t *cache_buffer = NULL;
 static lives_audio_buf_t *cache_buffera = NULL;
@@ -3880,6 +4824,8 @@ static void *cache_my_audio(void *arg) {
   char *filename;
   int i;
 
+  sched_policy_apply(SCHED_CLASS_AUDIO);
+
   while (!((*pcbuffer)->die)) {
     // wait for request from client (setting cbuffer->is_ready or cbuffer->die)
     while ((*pcbuffer)->is_ready && !(*pcbuffer)->die && mainw->abufs_to_fill <= 0) {
@@ -4235,6 +5181,7 @@ static void *cache_my_audio(void *arg) {
 
     // if our out_asamps is 16, we are done
 
+    cbuffer->ready_ticks = lives_get_current_ticks();
     cbuffer->is_ready = TRUE;
     pthread_mutex_unlock(&cbuffer->atomic_mutex);
   }
@@ -4723,183 +5670,165 @@ boolean apply_rte_audio(int64_t nframes) {
 }
 
 
-/**
-   @brief fill the audio channel(s) for effects with mixed audio / video
-   This is called from fill_audio_channel(filter, achan, is_vid) [is_vid may be unnecessary ?]
-   The client (filter) must first register with register_audio_client(is_vid) to ensure that all clients
-   are serviced before the offet is advanced.
-
-   when we have clients registered, the audio arena is constantly filled from the audio thread
-
-   This is necessary since the audio readers / writers run with a different cycle to the video player, thus we need to buffer one video frame's
-   worth of audio data, but without holding up the audio cycles. The arean should be suffiicently large so that the audio readers/writers can continue
-   writing without looping back whilst the already written data is passed to all video filters.
-
-   When audio data is requested by a video filter, we pull the latest data from the arena and fill the audio channel with this
-   all registered clients will get this same buffer and we only advance it after clients have read. This ensures that no client
-   has skipped data.. The buffer size can vary from frame to frame, it is up to each client to handle this
-
-   if player is jack, we will have non-interleaved float, if player is pulse, we will have interleaved S16 so we have to convert to float and
-   then back again.
-
-   (this is currently only used to push audio to generators,
-   since there are currently no filters which allow both video and audio input)
-*/
-boolean push_audio_to_channel(weed_plant_t *filter, weed_plant_t *achan, lives_audio_buf_t *abuf, boolean is_vid) {
-  float **dst, *src;
-
-  weed_plant_t *ctmpl;
-
-  double scale = 1., clipvol = 1.;
-
-  ssize_t samps, offs = 0;
-  boolean rvary = FALSE, lvary = FALSE;
-  int trate, tchans, xnchans, flags;
-  size_t alen, olen;
-  int afile;
-  int i;
-
-  // copy the part from readpos -> readlevel
-  // after all clients served, readpos -> readlevel, readlevel - > write_pos
-  if (is_vid) samps = abuf->vclient_readlevel - abuf->vclient_readpos;
-  else samps = abuf->aclient_readlevel - abuf->aclient_readpos;
-
-  if (!samps || !abuf->arate) {
-    weed_layer_set_audio_data(achan, NULL, 0, 0, 0);
-    return FALSE;
-  }
-
-  if (samps < 0) samps += ABUF_ARENA_SIZE;
-
+static void get_achan_format(weed_plant_t *filter, weed_plant_t *achan, int *trate, int *tchans, int *maxlen) {
+  // get the rate, channels and maximum length (0 for unlimited) that an audio channel wants
+  // with a NULL filter we use any values already set in achan
+  *maxlen = 0;
   if (filter) {
-    ctmpl = weed_get_plantptr_value(achan, WEED_LEAF_TEMPLATE, NULL);
-
-    flags = weed_get_int_value(filter, WEED_LEAF_FLAGS, NULL);
+    weed_plant_t *ctmpl = weed_get_plantptr_value(achan, WEED_LEAF_TEMPLATE, NULL);
+    int flags = weed_get_int_value(filter, WEED_LEAF_FLAGS, NULL);
+    boolean rvary = FALSE, lvary = FALSE;
     if (flags & WEED_FILTER_AUDIO_RATES_MAY_VARY) rvary = TRUE;
     if (flags & WEED_FILTER_CHANNEL_LAYOUTS_MAY_VARY) lvary = TRUE;
 
     if (!has_audio_chans_out(filter, FALSE)) {
-      int maxlen = weed_chantmpl_get_max_audio_length(ctmpl);
-      if (maxlen > 0) {
-        if (abuf->in_interleaf) maxlen *= abuf->in_achans;
-        if (maxlen < samps) {
-          offs = samps - maxlen;
-          samps = maxlen;
-        }
-      }
+      *maxlen = weed_chantmpl_get_max_audio_length(ctmpl);
+      if (*maxlen < 0) *maxlen = 0;
     }
 
     // TODO: can be list
     if (rvary && weed_plant_has_leaf(ctmpl, WEED_LEAF_AUDIO_RATE))
-      trate = weed_get_int_value(ctmpl, WEED_LEAF_AUDIO_RATE, NULL);
+      *trate = weed_get_int_value(ctmpl, WEED_LEAF_AUDIO_RATE, NULL);
     else if (weed_plant_has_leaf(filter, WEED_LEAF_AUDIO_RATE))
-      trate = weed_get_int_value(filter, WEED_LEAF_AUDIO_RATE, NULL);
-    else trate = DEFAULT_AUDIO_RATE;
+      *trate = weed_get_int_value(filter, WEED_LEAF_AUDIO_RATE, NULL);
+    else *trate = DEFAULT_AUDIO_RATE;
 
-    tchans = DEFAULT_AUDIO_CHANS;
+    *tchans = DEFAULT_AUDIO_CHANS;
     if (lvary && weed_plant_has_leaf(ctmpl, WEED_LEAF_AUDIO_CHANNELS))
-      tchans = weed_get_int_value(ctmpl, WEED_LEAF_AUDIO_CHANNELS, NULL);
+      *tchans = weed_get_int_value(ctmpl, WEED_LEAF_AUDIO_CHANNELS, NULL);
     else if (weed_plant_has_leaf(filter, WEED_LEAF_MAX_AUDIO_CHANNELS)) {
-      xnchans = weed_get_int_value(filter, WEED_LEAF_MAX_AUDIO_CHANNELS, NULL);
-      if (xnchans > 0 && xnchans < tchans) tchans = xnchans;
+      int xnchans = weed_get_int_value(filter, WEED_LEAF_MAX_AUDIO_CHANNELS, NULL);
+      if (xnchans > 0 && xnchans < *tchans) *tchans = xnchans;
     }
   } else {
-    trate = weed_channel_get_audio_rate(achan);
-    if (!trate) trate = abuf->arate;
-    tchans = weed_channel_get_naudchans(achan);
-    if (!tchans) tchans = abuf->out_achans;
+    *trate = weed_channel_get_audio_rate(achan);
+    *tchans = weed_channel_get_naudchans(achan);
   }
+}
 
-#ifdef DEBUG_AFB
-  g_print("push from afb %ld %p and %p\n", abuf->samples_filled, abuf->bufferf, abuf->buffer16);
-#endif
 
-  // plugin will get float, so we first convert to that
-  if (abuf->in_asamps < 32) {
+/**
+   @brief fill the audio channel(s) for effects with mixed audio / video, from the audio arena
+   This is called from fill_audio_channel(filter, achan). Each client has its own reader in the arena
+   (stored in the channel, see fill_audio_channel()), so clients read independently and at their own pace.
+   The arena is constantly filled from the audio thread whilst any clients are registered.
+
+   The audio readers / writers run with a different cycle to the video player, so we buffer one video frame's
+   worth (or more) of audio, but without ever holding up the audio cycles. If a client falls behind by more than the arena size
+   it is moved forward and an overrun is counted for it.
+
+   For host readers (filter NULL) with matching rate, the channel gets pointers directly into the arena, which remain
+   valid until the reader is released (the next fill, or release_audio_channel()); these must be treated as read only.
+   Plugins get a copy in the reader's scratch buffer, resampled if necessary, since the arena is shared by all readers
+   and a plugin could write to its input. In neither case should the channel audio_data be freed by the caller.
+*/
+boolean push_arena_to_channel(weed_plant_t *filter, weed_plant_t *achan, lives_aarena_t *aar, int reader) {
+  lives_aarena_reader_t *rdr;
+  const float **src;
+  float **dst;
+  ticks_t tc;
+  int64_t samps;
+  size_t olen;
+  int trate, tchans, maxlen, nused;
+
+  get_achan_format(filter, achan, &trate, &tchans, &maxlen);
+  if (!trate) trate = aar->arate;
+  if (!tchans) tchans = aar->nchans;
+
+  // maxlen is at the target rate
+  if (maxlen > 0 && trate != aar->arate) maxlen = (int)((double)maxlen * (double)aar->arate / (double)trate + .5);
+
+  src = (const float **)lives_calloc(aar->nchans, sizeof(float *));
+  samps = aarena_peek(aar, reader, maxlen, src, &tc);
+
+  if (samps <= 0) {
+    lives_free(src);
+    weed_layer_set_audio_data(achan, NULL, 0, 0, 0);
+    return FALSE;
+  }
 
-    // try 8 bit -> 16
-    if (abuf->buffer8 && !abuf->buffer16) {
-      int swap = 0;
-      if (!abuf->s8_signed) swap = SWAP_U_TO_S;
-      abuf->s16_signed = TRUE;
-      abuf->buffer16 = (short **)lives_calloc(abuf->out_achans, sizeof(short *));
-      for (i = 0; i < abuf->out_achans; i++) {
-        abuf->buffer16[i] = (short *)lives_calloc_safety(samps, sizeof(short));
-        sample_move_d8_d16(abuf->buffer16[i], &abuf->buffer8[i][offs], samps, samps * sizeof(short),
-                           1.0, abuf->out_achans, abuf->out_achans, swap);
+  dst = (float **)lives_calloc(tchans, sizeof(float *));
+  nused = tchans < aar->nchans ? tchans : aar->nchans;
 
-      }
+  if (trate == aar->arate && !filter) {
+    olen = samps;
+    for (int i = 0; i < tchans; i++) dst[i] = (float *)src[i % nused];
+  } else {
+    // copy, resampling if needed; scale is the step through the source per output sample
+    double scale = (double)aar->arate / (double)trate;
+    size_t stride;
+    olen = trate == aar->arate ? (size_t)samps : (size_t)((double)samps / scale + .5);
+    stride = olen + 2;
+    rdr = &aar->readers[reader];
+    if (rdr->scratch_size < stride * tchans) {
+      rdr->scratch = (float *)lives_realloc(rdr->scratch, stride * tchans * sizeof(float));
+      rdr->scratch_size = stride * tchans;
+    }
+    // each channel gets its own copy, so that a plugin writing to one cannot affect another
+    for (int i = 0; i < tchans; i++) {
+      dst[i] = rdr->scratch + i * stride;
+      if (trate == aar->arate) lives_memcpy(dst[i], src[i % nused], olen * sizeof(float));
+      else sample_move_float_float(dst[i], (float *)src[i % nused], samps, scale, 1, 1., olen);
     }
+  }
 
-    // try convert S16 -> float
-    if (abuf->buffer16) {
-      size_t sampstart = abuf->start_sample;
-      if (!abuf->in_interleaf) samps /= abuf->in_achans;
-      if (!abuf->bufferf) {
-        abuf->bufferf = (float **)lives_calloc(abuf->out_achans, sizeof(float *));
-        abuf->write_pos = 0;
-      }
+  // set channel values
+  weed_channel_set_audio_data(achan, dst, trate, tchans, olen);
+  if (tc >= 0) weed_set_int64_value(achan, WEED_LEAF_HOST_TC, tc);
+  lives_free(dst);
+  lives_free(src);
+  return TRUE;
+}
 
-      afile = get_aplay_clipno();
-      if (CLIP_HAS_AUDIO(afile)) clipvol = lives_vol_from_linear(mainw->files[afile]->vol);
-      for (i = 0; i < abuf->out_achans; i++) {
-        // get buffer16 write_pos
-        // write to abuf->bufferf at write_pos, from
-        if (!abuf->bufferf[i]) abuf->bufferf[i] = (float *)lives_calloc(ABUF_ARENA_SIZE, 4);
-        if (!abuf->in_interleaf) {
-          sample_move_d16_float_arena(abuf->bufferf[i], abuf->buffer16[i], sampstart, samps, 1,
-                                      (abuf->s16_signed ? AFORM_SIGNED : AFORM_UNSIGNED),
-                                      abuf->swap_endian, clipvol);
-        } else {
-          sample_move_d16_float_arena(abuf->bufferf[i], &abuf->buffer16[0][i], sampstart,
-                                      samps, abuf->in_achans,
-                                      (abuf->s16_signed ? AFORM_SIGNED : AFORM_UNSIGNED),
-                                      abuf->swap_endian, clipvol);
-        }
-        abuf->start_sample += samps;
-        if (abuf->start_sample >= ABUF_ARENA_SIZE) abuf->start_sample -= ABUF_ARENA_SIZE;
-      }
-      abuf->out_interleaf = FALSE;
-    }
+
+/**
+   @brief copy the contents of a linear audio buffer to an audio channel
+   used for the aux inputs, where abuf holds samples_filled non-interleaved float samples.
+   The channel gets newly allocated copies of the audio, resampled if necessary.
+*/
+boolean push_audio_to_channel(weed_plant_t *filter, weed_plant_t *achan, lives_audio_buf_t *abuf) {
+  float **dst;
+  double scale = 1.;
+  ssize_t samps, offs = 0;
+  size_t olen;
+  int trate, tchans, maxlen;
+
+  samps = abuf->samples_filled;
+
+  if (samps <= 0 || !abuf->arate || !abuf->bufferf || abuf->out_achans <= 0) {
+    weed_layer_set_audio_data(achan, NULL, 0, 0, 0);
+    return FALSE;
   }
 
-  if (!abuf->bufferf) return FALSE;
-  // now we should have float
+  get_achan_format(filter, achan, &trate, &tchans, &maxlen);
+  if (!trate) trate = abuf->arate;
+  if (!tchans) tchans = abuf->out_achans;
 
-  // push to achan "audio_data", taking into account "audio_data_length" and "audio_channels"
+  if (maxlen > 0 && maxlen < samps) {
+    offs = samps - maxlen;
+    samps = maxlen;
+  }
+
+#ifdef DEBUG_AFB
+  g_print("push from afb %ld %p\n", abuf->samples_filled, abuf->bufferf);
+#endif
 
-  olen = alen = samps;
+  olen = samps;
   if (abuf->arate != trate) {
-    scale = (double)trate / (double)abuf->arate;
-    olen = (size_t)(fabs(((double)alen * scale)) + .49999);
+    scale = (double)abuf->arate / (double)trate;
+    olen = (size_t)((double)samps / scale + .5);
   }
 
-  // malloc audio_data
   dst = (float **)lives_calloc(tchans, sizeof(float *));
 
-  for (i = 0; i < tchans; i++) {
-    src = abuf->bufferf[i % abuf->out_achans];
+  for (int i = 0; i < tchans; i++) {
+    float *src = abuf->bufferf[i % abuf->out_achans];
     if (src) {
-      if (scale == 1.) {
-        dst[i] = lives_calloc(olen, sizeof(float));
-        if (is_vid) {
-          arena_read((void *)dst[i], (void *)src, abuf->vclient_readpos, alen, 4);
-        } else
-          arena_read((void *)dst[i], (void *)src, abuf->aclient_readpos, alen, 4);
-      } else {
-        // needs resample
-        dst[i] = (float *)lives_calloc(olen * 2, sizeof(float));
-        if (is_vid)
-          olen = sample_move_float_float_arena(dst[i], src, abuf->vclient_readpos, alen, scale, 1, 1., 0);
-        else
-          olen = sample_move_float_float_arena(dst[i], src, abuf->aclient_readpos, alen, scale, 1, 1., 0);
-
-      }
-    } else dst[i] = NULL;
+      dst[i] = (float *)lives_calloc(olen + 2, sizeof(float));
+      sample_move_float_float(dst[i], src + offs, samps, scale, 1, 1., olen);
+    }
   }
 
-  // set channel values
-  //  g_print("SET achan %p from %p %d %d %lu\n", achan, dst, trate, tchans, olen);
   weed_channel_set_audio_data(achan, dst, trate, tchans, olen);
   lives_free(dst);
   return TRUE;
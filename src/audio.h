@@ -104,8 +104,15 @@ weed_error_t lives_aplayer_set_data(lives_obj_t *aplayer, void *data);
 # define DEFAULT_AUDIO_SIGNED8 (AFORM_UNSIGNED)
 # define DEFAULT_AUDIO_SIGNED16 (!AFORM_UNSIGNED)
 
-// for afbuffer
-#define ABUF_ARENA_SIZE 768000
+// audio arena, for feeding player audio to video filters / generators
+#define AARENA_SIZE (1 << 19) ///< samples per channel, must be a power of 2
+#define AARENA_MASK (AARENA_SIZE - 1)
+#define AARENA_MIRROR 65536 ///< samples duplicated past the end, reads up to this size are always contiguous
+#define AARENA_MAX_READERS 16
+#define AARENA_NSEGS 256 ///< ring of timestamped segments (one per published packet)
+#define AARENA_STALE_TIME (TICKS_PER_SECOND * 5) ///< a reader idle for this long may be reclaimed
+#define AARENA_RETIRE_WAIT 1000000 ///< nsec to wait for arena references to be dropped before freeing a retired arena
+#define AARENA_RETIRE_TRIES 100 ///< after which freeing is left to the next init or retire
 
 #define AREC_BUF_SIZE 2 * 1024 * 1024
 
@@ -187,13 +194,6 @@ typedef struct {
   int swap_endian;
   double shrink_factor;  ///< resampling ratio
 
-  // this is for the afbuffer (bufferf is an arena)
-  int vclients, aclients;
-  int vclients_read, aclients_read;
-  size_t vclient_readpos, aclient_readpos;
-  size_t vclient_readlevel, aclient_readlevel;
-  volatile ssize_t write_pos;
-
   size_t samp_space; ///< buffer space in samples (* by sizeof(type) to get bytesize) [if interleaf, also * by chans]
 
   boolean sequential; ///< hint that we will read sequentially starting from seek
@@ -231,11 +231,51 @@ typedef struct {
   int _casamps; ///< current out_asamps
   double _shrink_factor;  ///< resampling ratio
 
+  ticks_t ready_ticks; ///< time when the cache thread last finished filling this (for latency stats)
+
   pthread_mutex_t atomic_mutex; ///<  ensures all buffer info updated together
 
   volatile boolean die;  ///< set to TRUE to shut down thread
 } lives_audio_buf_t;
 
+/// lock free ring arena with a single writer (the audio player) and multiple readers
+/// the writer never waits; each reader has its own cursor, and if it falls too far behind it is moved forward
+/// and an overrun is counted against it. Readers get pointers directly into the arena, which remain valid
+/// until the writer laps them; this is checked when the read is released.
+/// Each arena has a unique id and each claim of a reader slot a new generation, so that a client holding a stale
+/// (arena id, reader, gen) triple can detect that the slot was freed or reclaimed and given to another client
+typedef struct {
+  uint64_t start; ///< absolute sample position of the segment
+  uint64_t nsamps;
+  ticks_t tc; ///< playback ticks when it was written
+} lives_aarena_seg_t;
+
+typedef struct {
+  volatile int in_use; ///< 0 free, 1 in use, 2 being claimed
+  volatile uint64_t gen; ///< incremented each time the slot is claimed
+  volatile uint64_t rpos; ///< absolute read cursor
+  uint64_t pending; ///< samples handed out by aarena_peek() and not yet released
+  ticks_t last_read;
+  uint64_t overruns; ///< number of times the writer caught up with this reader
+  uint64_t samples_lost;
+  float *scratch; ///< for readers needing a resampled copy
+  size_t scratch_size;
+} lives_aarena_reader_t;
+
+typedef struct {
+  uint64_t id; ///< unique per arena, never reused
+  int nchans, arate;
+  float **data; ///< nchans buffers of AARENA_SIZE + AARENA_MIRROR samples
+  volatile uint64_t wpos; ///< absolute write position, only advanced after the data is written
+  volatile uint64_t wlimit; ///< furthest position the writer may be touching, set before the data is written
+  float *wbuf; ///< writer scratch for converting 16 bit input
+  size_t wbuf_size;
+  volatile uint64_t nsegs;
+  lives_aarena_seg_t segs[AARENA_NSEGS];
+  volatile int nclients; ///< registered clients, the arena is retired when this reaches zero
+  lives_aarena_reader_t readers[AARENA_MAX_READERS];
+} lives_aarena_t;
+
 //////////////////////////////////////////
 
 typedef enum lives_audio_loop {
@@ -245,6 +285,27 @@ typedef enum lives_audio_loop {
 } lives_audio_loop_t;
 
 float get_float_audio_val_at_time(int fnum, int afd, double secs, int chnum, int chans) GNU_HOT;
+
+/// waveform peak cache
+#define PEAK_CACHE_MAGIC "LiVESpks"
+#define PEAK_CACHE_VERSION 2 ///< 2: mtime is in nsec
+
+#define PEAK_BASE_FRAMES 256 ///< audio frames per bin at the finest level
+#define PEAK_MAX_LEVELS 40
+#define PEAK_CHUNK_BINS 4096 ///< bins processed per step when building
+#define PEAK_SCALE 32767.f
+
+typedef struct {
+  int16_t min, max;
+  uint16_t rms;
+} lives_peak_t;
+
+boolean clip_peaks_ensure(int clipno);
+void clip_peaks_update(int clipno);
+void clip_peaks_free(int clipno);
+int clip_peaks_query(int clipno, int chan, double stime, double secs_per_pixel, int npix,
+                     float *mins, float *maxs, float *rms);
+int clip_peaks_get_waveform(int clipno, int chan, float *wave, int start, int end, double secs_per_pixel, float scale);
 float audiofile_get_maxvol(int fnum, double start, double end, float thresh);
 double audiofile_get_silent(int fnum, double start, double end, int dir, float thresh);
 
@@ -324,6 +385,73 @@ typedef enum {
 #define APLAYER_STATUS_DISCONNECTED	(1ull << 33)
 #define APLAYER_STATUS_BLOCKED		(1ull << 34)
 
+/// latency monitoring for the realtime audio players
+#define ALAT_WINDOW 512 ///< number of callbacks in the rolling window
+#define ALAT_NBINS 10 ///< jitter histogram bins; bin 0 is < ALAT_BIN_BASE, bin n < ALAT_BIN_BASE * 2 ** n
+#define ALAT_BIN_BASE (TICKS_PER_SECOND / 10000) ///< 100 usec
+#define ALAT_PCT 95 ///< headroom must cover this percentile of callback jitter
+#define ALAT_ADAPT_INTERVAL TICKS_PER_SECOND ///< minimum time between adjustments
+
+typedef struct {
+  ticks_t last_cb; ///< time of the previous callback
+  ticks_t period; ///< nominal duration of the data requested in the previous callback
+  ticks_t jitter[ALAT_WINDOW]; ///< ring of |actual - nominal| callback intervals
+  int jidx, nsamples;
+  uint32_t hist[ALAT_NBINS]; ///< histogram of the values currently in the ring
+  ticks_t lead_min; ///< least cache thread lead time in the current interval (negative: player had to wait)
+  ticks_t lead_last;
+  uint64_t cache_misses;
+  volatile uint64_t underruns; ///< xruns / underflows reported by the server
+  uint64_t last_underruns;
+  ticks_t last_adapt;
+  int64_t target_frames; ///< output frames we aim to keep queued, adapted to the jitter
+} lives_alatency_t;
+
+void alat_reset(lives_alatency_t *, int64_t target_frames);
+void alat_callback(lives_alatency_t *, int64_t nframes, int rate);
+void alat_cache_lead(lives_alatency_t *, ticks_t lead);
+void alat_underrun(lives_alatency_t *);
+ticks_t alat_jitter_percentile(lives_alatency_t *, int pct);
+boolean alat_adapt(lives_alatency_t *, int rate, int64_t min_frames, int64_t max_frames);
+char *alat_report(lives_alatency_t *, int rate);
+
+/// continuous a/v sync: the drift between the audio player position and the video position is filtered and
+/// absorbed by varying mainw->audio_stretch within +- AVSYNC_MAX_CORR; only past AVSYNC_HARD_THRESH do we hard seek the audio
+#define AVSYNC_SETTLE_FRAMES 8 ///< measurements averaged for the baseline (constant latency) after each resync
+#define AVSYNC_FILTER .05 ///< smoothing coefficient for the measured drift (per video frame)
+#define AVSYNC_KP .05 ///< proportional gain, stretch per second of drift
+#define AVSYNC_KI .005 ///< integral gain, per second of drift per frame
+#define AVSYNC_MAX_CORR .005 ///< maximum rate deviation (0.5 %, less than 10 cents of pitch change)
+#define AVSYNC_HARD_THRESH .1 ///< seconds of drift at which we give up and resync
+#define AVSYNC_NBINS 8 ///< |drift| histogram, see avsync_ctl_report()
+
+typedef struct {
+  int pseq, clipno;
+  int nsettle; ///< measurements still needed for the baseline, 0 once locked
+  double baseline; ///< offset due to buffering latency, measured after each resync
+  double drift; ///< filtered drift, seconds, positive when audio leads in the direction of play
+  double integ;
+  double corr; ///< current correction, audio_stretch - 1.
+  uint64_t nmeas;
+  double drift_sum, drift_sqsum, drift_max;
+  double corr_max;
+  uint64_t ncorr; ///< measurements where a correction was being applied
+  uint64_t hard_seeks, forced_syncs;
+  uint32_t hist[AVSYNC_NBINS];
+} lives_avsync_ctl_t;
+
+void avsync_ctl_reset(void);
+double avsync_ctl_update(int clipno);
+char *avsync_ctl_report(void);
+
+/// host spectral analysis for audio analysers (see WEED_LEAF_HOST_SPECTRUM_REQ)
+#define SPECTRUM_MAX_LOG2 18 ///< largest FFT is 2 ** 18 samples
+#define SPECTRUM_NBANDS 32
+#define SPECTRUM_FMIN 20. ///< upper frequency of the lowest band
+
+/// windows is a bitmap of (1 << HOST_SPECTRUM_WINDOW_*), one spectrum is computed for each
+boolean audio_spectrum_analyse(weed_plant_t *layer, float **abuf, int nchans, int nframes, int arate, int windows);
+
 void audio_analyser_start(int source);
 void audio_analyser_end(int source);
 
@@ -388,13 +516,31 @@ boolean apply_rte_audio_init(void);
 void apply_rte_audio_end(boolean del);
 boolean apply_rte_audio(int64_t nframes);
 
-void init_audio_frame_buffers(short aplayer);
+lives_aarena_t *aarena_new(int nchans, int arate);
+void aarena_free(lives_aarena_t *);
+void aarena_write(lives_aarena_t *, int chan, const float *src, uint64_t nsamps);
+void aarena_publish(lives_aarena_t *, uint64_t nsamps, ticks_t tc);
+int aarena_add_reader(lives_aarena_t *, uint64_t *gen);
+boolean aarena_reader_valid(lives_aarena_t *, int reader, uint64_t gen);
+void aarena_remove_reader(lives_aarena_t *, int reader, uint64_t gen);
+int64_t aarena_peek(lives_aarena_t *, int reader, uint64_t maxsamps, const float **ptrs, ticks_t *tc);
+boolean aarena_release(lives_aarena_t *, int reader);
+char *aarena_report(lives_aarena_t *);
+
+void init_audio_arena(short aplayer);
+void retire_audio_arena(void);
+
+/// anything using mainw->aarena from another thread (the audio writer, readers) must use it via a reference
+lives_aarena_t *audio_arena_ref(void);
+void audio_arena_unref(void);
+
 void init_aux_audio_frame_buffers(short aplayer);
 void free_audio_frame_buffer(lives_audio_buf_t *abuf);
-void append_to_audio_bufferf(float *src, size64_t nsamples, int channum);
+void append_to_audio_bufferf(lives_aarena_t *, float *src, size64_t nsamples, int channum);
 void append_to_aux_audio_bufferf(float *src, size64_t nsamples, int channum);
-void append_to_audio_buffer16(void *src, size64_t nsamples, int channum);
-boolean push_audio_to_channel(weed_plant_t *filter, weed_plant_t *achan, lives_audio_buf_t *abuf, boolean is_vid);
+void append_to_audio_buffer16(lives_aarena_t *, void *src, size64_t nsamples, int channum);
+boolean push_audio_to_channel(weed_plant_t *filter, weed_plant_t *achan, lives_audio_buf_t *abuf);
+boolean push_arena_to_channel(weed_plant_t *filter, weed_plant_t *achan, lives_aarena_t *, int reader);
 boolean start_audio_stream(void);
 void stop_audio_stream(void);
 void clear_audio_stream(void);
@@ -25,6 +25,8 @@
 #include "startup.h"
 #include "diagnostics.h"
 #include "multitrack-gui.h"
+#include "thumbcache.h"
+#include "costmodel.h"
 
 #ifdef LIBAV_TRANSCODE
 #include "transcode.h"
@@ -131,6 +133,10 @@ void lives_exit(int signum) {
       autolives_toggle(NULL, NULL);
     }
 
+    thumb_service_shutdown();
+    cost_model_save();
+    cost_model_free();
+
 #ifdef VALGRIND_ON
     if (mainw->stored_event_list || mainw->sl_undo_mem) {
       stored_event_list_free_all(FALSE);
@@ -18,6 +18,7 @@
 #include "paramwindow.h"
 #include "ce_thumbs.h"
 #include "callbacks.h"
+#include "thumbcache.h"
 #include "multitrack-gui.h"
 #include "rte_window.h"
 
@@ -145,6 +146,21 @@ static void clip_area_toggled(LiVESToggleButton * t, livespointer parea) {
 
 #define SPARE_CLIP_BOXES 100
 
+#if LIVES_HAS_GRID_WIDGET
+static void ce_thumb_ready(int clipno, frames_t frame, int width, int height, LiVESPixbuf *thumbnail,
+                           livespointer data) {
+  // a thumbnail requested by start_ce_thumb_mode() is ready
+  int count = LIVES_POINTER_TO_INT(data);
+  if (mainw->ce_thumbs && clip_boxes && count < n_clip_boxes && clip_boxes[count]
+      && LIVES_POINTER_TO_INT(lives_widget_object_get_data(LIVES_WIDGET_OBJECT(clip_boxes[count]), "clipno")) == clipno) {
+    LiVESWidget *thumb_image = (LiVESWidget *)lives_widget_object_get_data(LIVES_WIDGET_OBJECT(clip_boxes[count]),
+                               "thumb_image");
+    if (thumb_image) lives_image_set_from_pixbuf(LIVES_IMAGE(thumb_image), thumbnail);
+  }
+  lives_widget_object_unref(thumbnail);
+}
+#endif
+
 void start_ce_thumb_mode(void) {
 #if LIVES_HAS_GRID_WIDGET
 
@@ -374,8 +390,11 @@ void start_ce_thumb_mode(void) {
       continue;
     }
 
-    // make a small thumbnail, add it to the clips box
-    thumbnail = mt_make_thumb(NULL, i, width, height, mainw->files[i]->start, LIVES_INTERP_NORMAL, TRUE);
+    // make a small thumbnail, add it to the clips box; if possible this is done in the background
+    thumbnail = NULL;
+    if (!thumb_request(i, mainw->files[i]->start, width, height, TRUE, count, ce_thumb_ready,
+                       LIVES_INT_TO_POINTER(count)))
+      thumbnail = mt_make_thumb(NULL, i, width, height, mainw->files[i]->start, LIVES_INTERP_NORMAL, TRUE);
 
     clip_boxes[count] = lives_event_box_new();
     lives_widget_object_set_data(LIVES_WIDGET_OBJECT(clip_boxes[count]), "clipno", LIVES_INT_TO_POINTER(i));
@@ -391,6 +410,7 @@ void start_ce_thumb_mode(void) {
     align = lives_alignment_new(.5, .5, 0., 0.);
 
     thumb_image = lives_image_new();
+    lives_widget_object_set_data(LIVES_WIDGET_OBJECT(clip_boxes[count]), "thumb_image", thumb_image);
     lives_image_set_from_pixbuf(LIVES_IMAGE(thumb_image), thumbnail);
     if (thumbnail) lives_widget_object_unref(thumbnail);
     lives_container_add(LIVES_CONTAINER(clip_boxes[count]), align);
@@ -448,7 +468,7 @@ void end_ce_thumb_mode(void) {
   if (prefs->show_msg_area) lives_widget_show(mainw->message_box);
   lives_free(fxcombos); lives_free(pscrolls); lives_free(combo_entries);
   lives_free(key_checks); lives_free(rb_fx_areas); lives_free(rb_clip_areas);
-  lives_free(clip_boxes); lives_free(ch_fns); lives_free(rb_clip_fns);
+  lives_freep((void **)&clip_boxes); lives_free(ch_fns); lives_free(rb_clip_fns);
   lives_free(rb_fx_fns);
 }
 
@@ -1095,6 +1095,7 @@ int close_temp_handle(int new_clip) {
   }
 
   srcgrps_free_all(clipno);
+  clip_peaks_free(clipno);
 
   lives_freep((void **)&mainw->files[clipno]);
 
@@ -2529,6 +2530,7 @@ int close_current_file(int file_to_switch_to) {
   if (cfile->subt) subtitles_free(cfile);
 
   srcgrps_free_all(mainw->current_file);
+  clip_peaks_free(mainw->current_file);
 
   if (cfile->audio_waveform) {
     drawtl_cancel();
@@ -3419,6 +3421,16 @@ boolean check_for_recovery_files(boolean auto_recover, boolean no_recover) {
                                 luid, lgid, lpid);
     lives_mv(recovery_numbering_file, xfile);
     lives_free(xfile);
+    // changes since the last full auto backup
+    recfname = lives_strdup_printf("%s/%s.%d.%d.%d.%s", prefs->workdir, LAYOUT_FILENAME, luid, lgid, recpid,
+                                   LIVES_FILE_EXT_LAYOUT_JOURNAL);
+    if (lives_file_test(recfname, LIVES_FILE_TEST_EXISTS)) {
+      xfile = lives_strdup_printf("%s/keep_%s.%d.%d.%d.%s", prefs->workdir, LAYOUT_FILENAME, luid, lgid, lpid,
+                                  LIVES_FILE_EXT_LAYOUT_JOURNAL);
+      lives_mv(recfname, xfile);
+      lives_free(xfile);
+    }
+    lives_free(recfname);
     mainw->recoverable_layout = TRUE;
   }
 
@@ -3464,6 +3476,15 @@ cleanse:
                                 luid, lgid, lpid);
     lives_mv(xfile, recovery_numbering_file);
     lives_free(xfile);
+    xfile = lives_strdup_printf("%s/keep_%s.%d.%d.%d.%s", prefs->workdir, LAYOUT_FILENAME, luid, lgid, lpid,
+                                LIVES_FILE_EXT_LAYOUT_JOURNAL);
+    if (lives_file_test(xfile, LIVES_FILE_TEST_EXISTS)) {
+      recfname = lives_strdup_printf("%s/%s.%d.%d.%d.%s", prefs->workdir, LAYOUT_FILENAME, luid, lgid, lpid,
+                                     LIVES_FILE_EXT_LAYOUT_JOURNAL);
+      lives_mv(xfile, recfname);
+      lives_free(recfname);
+    }
+    lives_free(xfile);
   }
 
   recording_file = lives_strdup_printf("%s/%s-%s.%d.%d.%d.%s", prefs->workdir, RECORDED_LITERAL,
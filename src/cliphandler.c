@@ -12,6 +12,7 @@
 #include "effects.h"
 #include "videodev.h"
 #include "ce_thumbs.h"
+#include "thumbcache.h"
 
 #ifdef HAVE_YUV4MPEG
 #include "lives-yuv4mpeg.h"
@@ -673,6 +674,7 @@ size_t reget_afilesize(int fileno) {
   off_t res = reget_afilesize_inner(fileno);
   if (res > 0) sfile->afilesize = res;
   else sfile->afilesize = 0;
+  clip_peaks_update(fileno);
   if (mainw->multitrack) return sfile->afilesize;
 
   if (!sfile->afilesize) {
@@ -3351,6 +3353,8 @@ LIVES_GLOBAL_INLINE void srcgrps_free_all(int nclip) {
   // free all srcgrps, does locking but  ignores nofree flag
   lives_clip_t *sfile = RETURN_VALID_CLIP(nclip);
   if (sfile) {
+    // the thumbnail service must stop using the clip first
+    thumb_service_drop_clip(nclip);
     pthread_mutex_lock(&sfile->srcgrp_mutex);
     while (sfile->n_src_groups) {
       lives_clipsrc_group_t *srcgrp = sfile->src_groups[0];
@@ -188,6 +188,8 @@ typedef enum {
 #define SRC_PURPOSE_PRECACHE		8
 // source used for creating thumbnail images
 #define SRC_PURPOSE_THUMBNAIL		9
+// clone source for a segment of a parallel render, track is the segment number
+#define SRC_PURPOSE_RENDER		10
 
 // for srcs used in nodemodel
 #define SRC_PURPOSE_MODEL		128
@@ -0,0 +1,264 @@
+// costmodel.c
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// learned time costs for the node model
+// see costmodel.h for an overview
+
+#include "main.h"
+#include "costmodel.h"
+
+#define COST_TABLE_MIN 64 ///< initial size of the hash table, must be a power of 2
+#define COST_MODEL_VERSION 1
+
+#define MPIX 1000000. ///< sizes are stored in megapixels, which keeps the sums in a sensible range
+
+typedef struct {
+  uint64_t hash;
+  uint64_t key;
+  int op, in_pal, out_pal, nthreads;
+  // decayed, weighted sums for the least squares fit
+  double w, sx, sy, sxx, sxy;
+  double ref_y; ///< mean time when the generation was last changed for this entry, 0. if not usable then
+} cost_entry_t;
+
+static cost_entry_t *entries = NULL;
+static size_t nslots = 0, nentries = 0;
+
+static boolean loaded = FALSE, dirty = FALSE;
+static uint64_t generation = 1;
+
+// predicted vs actual plan durations, in seconds
+static int nplans_reported = 0;
+static double tot_abs_err = 0.;
+
+static pthread_mutex_t cost_model_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static uint64_t entry_hash(int op, uint64_t key, int in_pal, int out_pal, int nthreads) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  uint64_t vals[5] = {(uint64_t)op, key, (uint64_t)in_pal, (uint64_t)out_pal, (uint64_t)nthreads};
+  for (int i = 0; i < 5; i++) {
+    hash ^= vals[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash ? hash : 1;
+}
+
+
+static void cost_table_grow(void) {
+  cost_entry_t *oentries = entries;
+  size_t onslots = nslots, mask, j;
+
+  nslots = nslots ? nslots << 1 : COST_TABLE_MIN;
+  mask = nslots - 1;
+  entries = (cost_entry_t *)lives_calloc(nslots, sizeof(cost_entry_t));
+
+  for (size_t i = 0; i < onslots; i++) {
+    if (!oentries[i].hash) continue;
+    for (j = oentries[i].hash & mask; entries[j].hash; j = (j + 1) & mask);
+    entries[j] = oentries[i];
+  }
+  lives_freep((void **)&oentries);
+}
+
+
+static cost_entry_t *cost_entry_find(int op, uint64_t key, int in_pal, int out_pal, int nthreads, boolean create) {
+  uint64_t hash = entry_hash(op, key, in_pal, out_pal, nthreads);
+  cost_entry_t *ent;
+  size_t mask, i;
+
+  if (nslots) {
+    mask = nslots - 1;
+    for (i = hash & mask; entries[i].hash; i = (i + 1) & mask) {
+      ent = &entries[i];
+      if (ent->hash == hash && ent->op == op && ent->key == key && ent->in_pal == in_pal
+          && ent->out_pal == out_pal && ent->nthreads == nthreads) return ent;
+    }
+  }
+  if (!create) return NULL;
+
+  if ((nentries + 1) << 1 > nslots) cost_table_grow();
+  mask = nslots - 1;
+  for (i = hash & mask; entries[i].hash; i = (i + 1) & mask);
+  ent = &entries[i];
+  ent->hash = hash;
+  ent->op = op;
+  ent->key = key;
+  ent->in_pal = in_pal;
+  ent->out_pal = out_pal;
+  ent->nthreads = nthreads;
+  nentries++;
+  return ent;
+}
+
+
+static char *cost_model_filename(void) {
+  return lives_build_filename(prefs->config_datadir, COST_MODEL_FILE, NULL);
+}
+
+
+static void cost_model_load(void) {
+  // must be called with cost_model_mutex locked
+  char *fname;
+  FILE *cfile;
+  cost_entry_t rd, *ent;
+  int version;
+
+  loaded = TRUE;
+  if (!*prefs->config_datadir) return;
+
+  fname = cost_model_filename();
+  cfile = fopen(fname, "r");
+  lives_free(fname);
+  if (!cfile) return;
+
+  if (fscanf(cfile, "LiVES cost model %d\n", &version) == 1 && version == COST_MODEL_VERSION) {
+    while (fscanf(cfile, "%d %"SCNu64" %d %d %d %lf %lf %lf %lf %lf\n", &rd.op, &rd.key, &rd.in_pal,
+                  &rd.out_pal, &rd.nthreads, &rd.w, &rd.sx, &rd.sy, &rd.sxx, &rd.sxy) == 10) {
+      if (rd.op < 0 || rd.op >= N_COST_OPS || rd.w <= 0.) continue;
+      ent = cost_entry_find(rd.op, rd.key, rd.in_pal, rd.out_pal, rd.nthreads, TRUE);
+      ent->w = rd.w;
+      ent->sx = rd.sx;
+      ent->sy = rd.sy;
+      ent->sxx = rd.sxx;
+      ent->sxy = rd.sxy;
+      if (ent->w >= COST_MODEL_MIN_SAMPLES) ent->ref_y = ent->sy / ent->w;
+    }
+  }
+  fclose(cfile);
+}
+
+
+void cost_model_save(void) {
+  char *fname;
+  FILE *cfile;
+
+  pthread_mutex_lock(&cost_model_mutex);
+  if (!dirty || !*prefs->config_datadir) {
+    pthread_mutex_unlock(&cost_model_mutex);
+    return;
+  }
+
+  fname = cost_model_filename();
+  cfile = fopen(fname, "w");
+  if (!cfile) {
+    d_print_debug("Unable to write cost model to %s\n", fname);
+  } else {
+    fprintf(cfile, "LiVES cost model %d\n", COST_MODEL_VERSION);
+    for (size_t i = 0; i < nslots; i++) {
+      cost_entry_t *ent = &entries[i];
+      if (!ent->hash) continue;
+      fprintf(cfile, "%d %"PRIu64" %d %d %d %.12g %.12g %.12g %.12g %.12g\n", ent->op, ent->key,
+              ent->in_pal, ent->out_pal, ent->nthreads, ent->w, ent->sx, ent->sy, ent->sxx, ent->sxy);
+    }
+    fclose(cfile);
+    dirty = FALSE;
+  }
+  pthread_mutex_unlock(&cost_model_mutex);
+  lives_free(fname);
+}
+
+
+void cost_model_add_sample(lives_cost_op_t op, uint64_t key, int in_pal, int out_pal, double size, double secs) {
+  cost_entry_t *ent;
+  double x = size / MPIX;
+
+  if (secs < 0. || size <= 0.) return;
+
+  pthread_mutex_lock(&cost_model_mutex);
+  if (!loaded) cost_model_load();
+  ent = cost_entry_find(op, key, in_pal, out_pal, prefs->nfx_threads, TRUE);
+  ent->w = ent->w * COST_MODEL_DECAY + 1.;
+  ent->sx = ent->sx * COST_MODEL_DECAY + x;
+  ent->sy = ent->sy * COST_MODEL_DECAY + secs;
+  ent->sxx = ent->sxx * COST_MODEL_DECAY + x * x;
+  ent->sxy = ent->sxy * COST_MODEL_DECAY + x * secs;
+  if (ent->w >= COST_MODEL_MIN_SAMPLES) {
+    double my = ent->sy / ent->w;
+    if (ent->ref_y <= 0. || fabs(my - ent->ref_y) > ent->ref_y * COST_MODEL_CHANGE) {
+      ent->ref_y = my;
+      generation++;
+    }
+  }
+  dirty = TRUE;
+  pthread_mutex_unlock(&cost_model_mutex);
+}
+
+
+double cost_model_predict(lives_cost_op_t op, uint64_t key, int in_pal, int out_pal, double size) {
+  cost_entry_t *ent;
+  double x = size / MPIX, mx, my, var, b, est = -1.;
+
+  pthread_mutex_lock(&cost_model_mutex);
+  if (!loaded) cost_model_load();
+  ent = cost_entry_find(op, key, in_pal, out_pal, prefs->nfx_threads, FALSE);
+  if (ent && ent->w >= COST_MODEL_MIN_SAMPLES) {
+    mx = ent->sx / ent->w;
+    my = ent->sy / ent->w;
+    var = ent->sxx / ent->w - mx * mx;
+    if (var > mx * mx * .0001) {
+      b = (ent->sxy / ent->w - mx * my) / var;
+      if (b >= 0.) est = my + b * (x - mx);
+    }
+    // if all samples were at (nearly) the same size, or the slope came out negative,
+    // assume time is proportional to size
+    if (est < 0.) est = mx > 0. ? my * x / mx : my;
+  }
+  pthread_mutex_unlock(&cost_model_mutex);
+  return est;
+}
+
+
+uint64_t cost_model_generation(void) {
+  uint64_t gen;
+  pthread_mutex_lock(&cost_model_mutex);
+  gen = generation;
+  pthread_mutex_unlock(&cost_model_mutex);
+  return gen;
+}
+
+
+uint64_t cost_model_filter_key(weed_filter_t *filter) {
+  char *name, *author, *tmp;
+  uint64_t key;
+  if (!filter) return 0;
+  // computed once and kept in the filter, since this is called for every instance step of every cycle
+  key = (uint64_t)weed_get_int64_value(filter, LIVES_LEAF_COST_KEY, NULL);
+  if (key) return key;
+  name = weed_get_string_value(filter, WEED_LEAF_NAME, NULL);
+  author = weed_get_string_value(filter, WEED_LEAF_AUTHOR, NULL);
+  tmp = lives_strdup_printf("%s|%s", name ? name : "", author ? author : "");
+  key = fast_hash64(tmp);
+  lives_free(tmp);
+  if (name) lives_free(name);
+  if (author) lives_free(author);
+  if (!key) key = 1;
+  weed_set_int64_value(filter, LIVES_LEAF_COST_KEY, (int64_t)key);
+  return key;
+}
+
+
+void cost_model_report_plan(double predicted, double actual) {
+  double mean_err;
+  int nplans;
+  if (predicted <= 0. || actual <= 0.) return;
+  pthread_mutex_lock(&cost_model_mutex);
+  nplans = ++nplans_reported;
+  tot_abs_err += fabs(predicted - actual);
+  mean_err = tot_abs_err / (double)nplans;
+  pthread_mutex_unlock(&cost_model_mutex);
+  d_print_debug("COST MODEL: predicted %.4f msec, actual %.4f msec (%+.2f %%), mean abs error %.4f msec over %d cycles\n",
+                predicted * 1000., actual * 1000., (predicted - actual) / actual * 100., mean_err * 1000., nplans);
+}
+
+
+void cost_model_free(void) {
+  pthread_mutex_lock(&cost_model_mutex);
+  lives_freep((void **)&entries);
+  nslots = nentries = 0;
+  loaded = dirty = FALSE;
+  pthread_mutex_unlock(&cost_model_mutex);
+}
@@ -0,0 +1,54 @@
+// costmodel.h
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// learned time costs for the node model
+
+#ifndef HAS_LIVES_COSTMODEL_H
+#define HAS_LIVES_COSTMODEL_H
+
+// the plan runner reports the time taken by each palette conversion, resize, gamma conversion and instance
+// application, and the cost model fits a line, time = a + b * size, separately for each operation, palette pair
+// and number of fx threads (and for instances, each filter). Size is measured in pixels.
+// Older samples are gradually discounted, so the fit follows changes in machine load.
+//
+// once an operation has enough samples, get_pconv_cost() etc. return the fitted time rather than
+// their static estimate, so map_least_cost_palettes() plans with real timings.
+// The fits are saved in the config directory when playback ends and on exit, and loaded at the start of the next session
+
+#define COST_MODEL_FILE "costmodel"
+
+#define LIVES_LEAF_COST_KEY "host_cost_key" ///< cached result of cost_model_filter_key()
+
+#define COST_MODEL_MIN_SAMPLES 8. ///< effective number of samples needed before a fit is used
+#define COST_MODEL_DECAY .98 ///< weight of older samples is multiplied by this for each new sample
+#define COST_MODEL_CHANGE .1 ///< fraction by which a fit must move before costs computed from it are stale
+
+typedef enum {
+  COST_OP_PCONV,
+  COST_OP_RESIZE,
+  COST_OP_GAMMA,
+  COST_OP_PROC,
+  N_COST_OPS
+} lives_cost_op_t;
+
+void cost_model_add_sample(lives_cost_op_t, uint64_t key, int in_pal, int out_pal, double size, double secs);
+
+/// returns predicted time in seconds, or a negative value if there are not enough samples
+double cost_model_predict(lives_cost_op_t, uint64_t key, int in_pal, int out_pal, double size);
+
+/// changes whenever a fit becomes usable, or its mean time moves by more than COST_MODEL_CHANGE,
+/// so results computed from predictions can be cached against it
+uint64_t cost_model_generation(void);
+
+uint64_t cost_model_filter_key(weed_filter_t *); ///< key for COST_OP_PROC, 0 for other ops
+
+/// compare the total of the estimated step times for a plan cycle with the measured total
+void cost_model_report_plan(double predicted, double actual);
+
+void cost_model_save(void); ///< does file I/O, so not to be called from the plan runner
+void cost_model_free(void);
+
+#endif
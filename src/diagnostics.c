@@ -11,6 +11,9 @@
 #include "callbacks.h"
 #include "startup.h"
 #include "maths.h"
+#include "layoutfmt.h"
+#include "effects.h"
+#include "resample.h"
 
 
 /* void test_brkpt(void) { */
@@ -399,6 +402,7 @@ char *get_stats_msg(boolean calc_only) {
   static double av_offs = 0.;
   static int last_pfile = -1;
   static int pseq = -1;
+  lives_aarena_t *aar;
   volatile float const *cpuload;
   float load;
   lives_clip_t *sfile = mainw->files[mainw->playing_file];
@@ -433,6 +437,45 @@ char *get_stats_msg(boolean calc_only) {
   //currticks = lives_get_current_ticks();
 
   if (calc_only) return NULL;
+
+#ifdef ENABLE_JACK
+  if (prefs->audio_player == AUD_PLAYER_JACK && mainw->jackd) {
+    lives_free(msg2);
+    msg2 = alat_report(&mainw->jackd->alat, mainw->jackd->sample_out_rate);
+  }
+#endif
+#ifdef HAVE_PULSE_AUDIO
+  if (prefs->audio_player == AUD_PLAYER_PULSE && mainw->pulsed) {
+    lives_free(msg2);
+    msg2 = alat_report(&mainw->pulsed->alat, mainw->pulsed->out_arate);
+  }
+#endif
+  if (AUD_SRC_INTERNAL) {
+    char *amsg = avsync_ctl_report();
+    tmp = lives_strdup_printf("%s%s", msg2, amsg);
+    lives_free(amsg); lives_free(msg2);
+    msg2 = tmp;
+  }
+  if (LIVES_IS_PLAYING) {
+    char *fmsg = fpacer_report();
+    tmp = lives_strdup_printf("%s%s", msg2, fmsg);
+    lives_free(fmsg); lives_free(msg2);
+    msg2 = tmp;
+  }
+  if (sched_policy_active()) {
+    char *pmsg = get_thread_placement();
+    tmp = lives_strdup_printf("%s%s", msg2, pmsg);
+    lives_free(pmsg); lives_free(msg2);
+    msg2 = tmp;
+  }
+  if ((aar = audio_arena_ref())) {
+    char *amsg = aarena_report(aar);
+    audio_arena_unref();
+    tmp = lives_strdup_printf("%s%s", msg2, amsg);
+    lives_free(amsg); lives_free(msg2);
+    msg2 = tmp;
+  }
+
   cpuload = get_core_loadvar(0);
   load = (float) * cpuload;
 
@@ -492,6 +535,7 @@ char *get_stats_msg(boolean calc_only) {
                               bgmsg ? bgmsg : "");
     lives_freep((void **)&bgmsg);
     lives_freep((void **)&tmp);
+    lives_freep((void **)&msg2);
   }
   return msg;
 }
@@ -2457,6 +2501,613 @@ void test_procthreads(void) {
 }
 
 
+typedef struct {
+  void *ptr;
+  int64_t idx;
+} lbtest_map_t;
+
+static int lbtest_cmp(const void *a, const void *b) {
+  const lbtest_map_t *ma = (const lbtest_map_t *)a, *mb = (const lbtest_map_t *)b;
+  return ma->ptr < mb->ptr ? -1 : ma->ptr > mb->ptr ? 1 : 0;
+}
+
+
+static uint64_t lbtest_xlate(uint64_t val, lbtest_map_t *map, int64_t nevents, weed_event_t **orig) {
+  // translate a pointer / id to an event in the reloaded list into the original event
+  lbtest_map_t key, *found;
+  key.ptr = (void *)val;
+  found = (lbtest_map_t *)bsearch(&key, map, nevents, sizeof(lbtest_map_t), lbtest_cmp);
+  return found ? (uint64_t)orig[found->idx] : val;
+}
+
+
+static int lbtest_compare(weed_event_list_t *old, weed_event_list_t *new, weed_event_t **orig, int64_t nevents) {
+  // compare a list loaded from the serialised format with one loaded from the binary format
+  // pointers and ids are compared via the original events they refer to
+  // returns the number of mismatches
+  lbtest_map_t *map = (lbtest_map_t *)lives_calloc(nevents + 1, sizeof(lbtest_map_t));
+  weed_event_t *oev, *nev;
+  int64_t i = 0;
+  int errs = 0;
+
+  for (nev = get_first_event(new); nev && i < nevents; nev = get_next_event(nev), i++) {
+    map[i].ptr = nev;
+    map[i].idx = i;
+  }
+  qsort(map, nevents, sizeof(lbtest_map_t), lbtest_cmp);
+
+  for (oev = get_first_event(old), nev = get_first_event(new); oev && nev;
+       oev = get_next_event(oev), nev = get_next_event(nev)) {
+    char **leaves = weed_plant_list_leaves(oev, NULL);
+    for (int k = 0; leaves[k]; k++) {
+      const char *key = leaves[k];
+      int ost, nst, ne;
+      if (!lives_strcmp(key, WEED_LEAF_NEXT) || !lives_strcmp(key, WEED_LEAF_PREVIOUS)
+          || !lives_strcmp(key, WEED_LEAF_HINT)) goto next;
+      ost = weed_leaf_seed_type(oev, key);
+      nst = weed_leaf_seed_type(nev, key);
+      if (ost == WEED_SEED_PLANTPTR) ost = WEED_SEED_VOIDPTR;
+      if (nst == WEED_SEED_PLANTPTR) nst = WEED_SEED_VOIDPTR;
+      ne = weed_leaf_num_elements(oev, key);
+      if (ost != nst || ne != weed_leaf_num_elements(nev, key)) {
+        d_print("layout test: leaf %s differs in type or size at tc %"PRId64"\n", key, get_event_timecode(oev));
+        errs++;
+        goto next;
+      }
+      for (int j = 0; j < ne; j++) {
+        if (ost == WEED_SEED_STRING) {
+          char *ostr = NULL, *nstr = NULL;
+          weed_leaf_get(oev, key, j, &ostr);
+          weed_leaf_get(nev, key, j, &nstr);
+          if (lives_strcmp(ostr, nstr)) errs++;
+        } else {
+          uint64_t oval = 0, nval = 0;
+          weed_leaf_get(oev, key, j, &oval);
+          weed_leaf_get(nev, key, j, &nval);
+          if (ost == WEED_SEED_VOIDPTR || ost == WEED_SEED_INT64) nval = lbtest_xlate(nval, map, nevents, orig);
+          if (oval != nval) {
+            d_print("layout test: value of leaf %s differs at tc %"PRId64"\n", key, get_event_timecode(oev));
+            errs++;
+          }
+        }
+      }
+next:
+      _ext_free(leaves[k]);
+    }
+    _ext_free(leaves);
+  }
+  if (oev || nev) {
+    d_print("layout test: event counts differ\n");
+    errs++;
+  }
+  lives_free(map);
+  return errs;
+}
+
+
+static weed_event_list_t *lbtest_serialise(weed_event_list_t *event_list, const char *ofile, ticks_t *tsave,
+    ticks_t *tload) {
+  // save event_list in the serialised format and load it back, without rectifying the ids
+  weed_event_list_t *old_list;
+  weed_event_t *event;
+  ticks_t t0 = lives_get_current_ticks();
+  int fd = lives_create_buffered(ofile, DEF_FILE_PERMS);
+  save_event_list_inner(NULL, fd, event_list, NULL);
+  lives_close_buffered(fd);
+  *tsave = lives_get_current_ticks() - t0;
+
+  t0 = lives_get_current_ticks();
+  fd = lives_open_buffered_rdonly(ofile);
+  lives_buffered_rdonly_slurp(fd, 0);
+  old_list = weed_plant_deserialise(fd, NULL, NULL);
+  weed_set_voidptr_value(old_list, WEED_LEAF_FIRST, NULL);
+  weed_set_voidptr_value(old_list, WEED_LEAF_LAST, NULL);
+  while ((event = weed_plant_deserialise(fd, NULL, NULL)) != NULL) {
+    weed_event_t *prev = get_last_event(old_list);
+    weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, prev);
+    weed_set_voidptr_value(event, WEED_LEAF_NEXT, NULL);
+    if (prev) weed_set_voidptr_value(prev, WEED_LEAF_NEXT, event);
+    else weed_set_voidptr_value(old_list, WEED_LEAF_FIRST, event);
+    weed_set_voidptr_value(old_list, WEED_LEAF_LAST, event);
+  }
+  // linked directly, so any index for a list previously at this address is no longer valid
+  event_list_index_invalidate();
+  lives_close_buffered(fd);
+  *tload = lives_get_current_ticks() - t0;
+  return old_list;
+}
+
+
+static weed_event_t **lbtest_get_orig(weed_event_list_t *event_list, int64_t *nevents) {
+  weed_event_t *event, **orig;
+  int64_t i = 0;
+  *nevents = 0;
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) (*nevents)++;
+  orig = (weed_event_t **)lives_calloc(*nevents + 1, sizeof(weed_event_t *));
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) orig[i++] = event;
+  return orig;
+}
+
+
+static int lbtest_journal(weed_event_list_t *event_list, const char *ofile) {
+  // make a series of small edits, journalling each, then replay the journal over the base
+  // and compare the result with the edited list
+  char *jbfile = lives_build_filename(prefs->workdir, "layout_test_base.lbin", NULL);
+  char *jfile = lives_build_filename(prefs->workdir, "layout_test.jnl", NULL);
+  lives_layout_jnl_t *jnl = layout_jnl_new(jbfile, jfile);
+  weed_event_list_t *old_list, *new_list = NULL;
+  weed_event_t *event, *next, **orig;
+  lives_layout_bin_t *lb;
+  ticks_t t0, t_comp, t_rec = 0, t_replay, t_osave, t_oload;
+  int64_t nevents, nblocks = -1;
+  int count = 0, errs = 0;
+
+  t0 = lives_get_current_ticks();
+  layout_jnl_compact(jnl, event_list, FALSE);
+  t_comp = lives_get_current_ticks() - t0;
+
+  for (int round = 0; round < 20; round++) {
+    for (event = get_first_event(event_list); event; event = next) {
+      next = get_next_event(event);
+      if (++count % 1499) continue;
+      if (WEED_EVENT_IS_FRAME(event) && !WEED_EVENT_IS_AUDIO_FRAME(event)) delete_event(event_list, event);
+      else if (WEED_EVENT_IS_PARAM_CHANGE(event)) {
+        weed_set_double_value(event, WEED_LEAF_VALUE, (double)round);
+        event_changed(event);
+      }
+    }
+    t0 = lives_get_current_ticks();
+    if (layout_jnl_record(jnl, event_list, TRUE) < 0) errs++;
+    t_rec += lives_get_current_ticks() - t0;
+  }
+  layout_jnl_free(jnl);
+
+  t0 = lives_get_current_ticks();
+  lb = layout_bin_map_file(jbfile);
+  if (lb) {
+    new_list = layout_bin_materialise(lb);
+    nblocks = layout_jnl_replay(lb, new_list, jfile);
+    layout_bin_unmap(lb);
+  }
+  t_replay = lives_get_current_ticks() - t0;
+
+  if (nblocks < 0) {
+    d_print("layout test: FAILED to replay journal\n");
+    errs++;
+  } else {
+    old_list = lbtest_serialise(event_list, ofile, &t_osave, &t_oload);
+    orig = lbtest_get_orig(event_list, &nevents);
+    errs += lbtest_compare(old_list, new_list, orig, nevents);
+    event_list_free(old_list);
+    lives_free(orig);
+  }
+
+  d_print("journal: %"PRId64" blocks, %s\n", nblocks, errs ? "FAILED" : "passed");
+  d_print("journal: full write %.2f ms, 20 incremental records %.2f ms, replay %.2f ms\n",
+          (double)t_comp / TICKS_PER_SECOND_DBL * 1000., (double)t_rec / TICKS_PER_SECOND_DBL * 1000.,
+          (double)t_replay / TICKS_PER_SECOND_DBL * 1000.);
+
+  if (new_list) event_list_free(new_list);
+  lives_rm(jbfile);
+  lives_rm(jfile);
+  lives_free(jbfile);
+  lives_free(jfile);
+  return errs;
+}
+
+
+void test_layout_binary(void) {
+  // round trip a synthetic layout through the serialised and binary layout formats, check both give the same
+  // result, and compare timings
+  weed_event_list_t *event_list = NULL, *old_list, *new_list;
+  weed_event_t *event, *init_event = NULL, **orig;
+  lives_layout_bin_t *lb;
+  char *ofile = lives_build_filename(prefs->workdir, "layout_test.lay", NULL);
+  char *bfile = lives_build_filename(prefs->workdir, "layout_test.lbin", NULL);
+  ticks_t t0, t_osave, t_oload, t_bsave, t_bload;
+  int64_t nevents = 0, i;
+  int clips[2] = {1, 2};
+  frames64_t frames[2];
+  int fd, errs;
+
+  for (i = 0; i < 20000; i++) {
+    weed_timecode_t tc = i * TICKS_PER_SECOND / 25;
+    frames[0] = i + 1;
+    frames[1] = 20000 - i;
+    if (i % 500 == 0) {
+      // add a filter init, deinit, filter map and param change
+      int in_tracks[2] = {0, 1}, out_tracks[1] = {0};
+      void *ievs[1];
+      if (init_event) {
+        event = weed_plant_new(WEED_PLANT_EVENT);
+        weed_set_int_value(event, WEED_LEAF_EVENT_TYPE, WEED_EVENT_TYPE_FILTER_DEINIT);
+        weed_event_set_timecode(event, tc);
+        weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+        weed_set_voidptr_value(init_event, WEED_LEAF_DEINIT_EVENT, event);
+        if (!insert_event_after(get_last_event(event_list), event))
+          weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+      }
+      init_event = weed_plant_new(WEED_PLANT_EVENT);
+      weed_set_int_value(init_event, WEED_LEAF_EVENT_TYPE, WEED_EVENT_TYPE_FILTER_INIT);
+      weed_event_set_timecode(init_event, tc);
+      weed_set_string_value(init_event, WEED_LEAF_FILTER, "layout test filter");
+      weed_set_int_array(init_event, WEED_LEAF_IN_TRACKS, 2, in_tracks);
+      weed_set_int_array(init_event, WEED_LEAF_OUT_TRACKS, 1, out_tracks);
+      event_list = append_marker_event(event_list, tc, EVENT_MARKER_BLOCK_START);
+      if (!insert_event_after(get_last_event(event_list), init_event))
+        weed_set_voidptr_value(event_list, WEED_LEAF_LAST, init_event);
+
+      event = weed_plant_new(WEED_PLANT_EVENT);
+      weed_set_int_value(event, WEED_LEAF_EVENT_TYPE, WEED_EVENT_TYPE_FILTER_MAP);
+      weed_event_set_timecode(event, tc);
+      ievs[0] = init_event;
+      weed_set_voidptr_array(event, WEED_LEAF_INIT_EVENTS, 1, ievs);
+      if (!insert_event_after(get_last_event(event_list), event))
+        weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+
+      event = weed_plant_new(WEED_PLANT_EVENT);
+      weed_set_int_value(event, WEED_LEAF_EVENT_TYPE, WEED_EVENT_TYPE_PARAM_CHANGE);
+      weed_event_set_timecode(event, tc);
+      weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+      weed_set_int_value(event, WEED_LEAF_INDEX, 0);
+      weed_set_double_value(event, WEED_LEAF_VALUE, (double)i / 20000.);
+      if (!insert_event_after(get_last_event(event_list), event))
+        weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+    }
+    event_list = append_frame_event(event_list, tc, 2, clips, frames);
+  }
+  weed_set_double_value(event_list, WEED_LEAF_FPS, 25.);
+
+  orig = lbtest_get_orig(event_list, &nevents);
+
+  // serialised format
+  old_list = lbtest_serialise(event_list, ofile, &t_osave, &t_oload);
+
+  // binary format
+  t0 = lives_get_current_ticks();
+  fd = lives_create_buffered(bfile, DEF_FILE_PERMS);
+  layout_bin_save(fd, event_list);
+  lives_close_buffered(fd);
+  t_bsave = lives_get_current_ticks() - t0;
+
+  t0 = lives_get_current_ticks();
+  lb = layout_bin_map_file(bfile);
+  new_list = lb ? layout_bin_materialise(lb) : NULL;
+  layout_bin_unmap(lb);
+  t_bload = lives_get_current_ticks() - t0;
+
+  if (!new_list) {
+    d_print("layout test: FAILED to load binary layout\n");
+    errs = 1;
+  } else errs = lbtest_compare(old_list, new_list, orig, nevents);
+
+  d_print("layout test: %"PRId64" events, %s\n", nevents, errs ? "FAILED" : "passed");
+  d_print("serialised format: save %.2f ms, load %.2f ms\n", (double)t_osave / TICKS_PER_SECOND_DBL * 1000.,
+          (double)t_oload / TICKS_PER_SECOND_DBL * 1000.);
+  d_print("binary format: save %.2f ms, load %.2f ms\n", (double)t_bsave / TICKS_PER_SECOND_DBL * 1000.,
+          (double)t_bload / TICKS_PER_SECOND_DBL * 1000.);
+
+  event_list_free(old_list);
+  event_list_free(new_list);
+  lives_free(orig);
+
+  lbtest_journal(event_list, ofile);
+
+  event_list_free(event_list);
+  lives_rm(ofile);
+  lives_rm(bfile);
+  lives_free(ofile);
+  lives_free(bfile);
+}
+
+
+static weed_event_t *qtest_add_event(weed_event_list_t *event_list, int etype, weed_timecode_t tc) {
+  weed_event_t *event = weed_plant_new(WEED_PLANT_EVENT);
+  weed_set_int_value(event, WEED_LEAF_EVENT_TYPE, etype);
+  weed_event_set_timecode(event, tc);
+  if (!get_first_event(event_list)) {
+    weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, event);
+    weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+  } else if (!insert_event_after(get_last_event(event_list), event))
+    weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+  return event;
+}
+
+
+static int qtest_check(weed_event_list_t *event_list, int64_t *npchanges) {
+  // check the list is in timecode order, and that every param change can be reached via its chain, in order
+  weed_event_t *event, *pchange;
+  weed_timecode_t tc = 0;
+  int64_t nlinked = 0;
+  int errs = 0;
+  *npchanges = 0;
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) {
+    if (get_event_timecode(event) < tc) errs++;
+    tc = get_event_timecode(event);
+    if (WEED_EVENT_IS_PARAM_CHANGE(event)) (*npchanges)++;
+    else if (WEED_EVENT_IS_FILTER_INIT(event)) {
+      int nparams;
+      void **pchanges = weed_get_voidptr_array_counted(event, WEED_LEAF_IN_PARAMETERS, &nparams);
+      for (int i = 0; i < nparams; i++) {
+        weed_timecode_t ptc = 0;
+        for (pchange = (weed_event_t *)pchanges[i]; pchange;
+             pchange = weed_get_voidptr_value(pchange, WEED_LEAF_NEXT_CHANGE, NULL)) {
+          if (get_event_timecode(pchange) < ptc) errs++;
+          ptc = get_event_timecode(pchange);
+          nlinked++;
+        }
+      }
+      lives_freep((void **)&pchanges);
+    }
+  }
+  if (nlinked != *npchanges) errs++;
+  return errs;
+}
+
+
+void test_quantise_events(void) {
+  // quantise a synthetic recording of 100000 events - frames at irregular timecodes, with a param change
+  // at every frame - then shrink and restore one filter instance, checking the ordering
+  // and the param change chains after each step
+  weed_event_list_t *event_list = NULL, *qevent_list;
+  weed_event_t *event, *init_event = NULL, *deinit_event;
+  weed_plant_t *filter = NULL;
+  char *hashname;
+  ticks_t t0, t_quant, t_rescale;
+  weed_timecode_t tc = 0, init_tc, deinit_tc;
+  int64_t nevents = 0, npchanges, i;
+  int clips[1] = {1};
+  frames64_t frames[1];
+  int nparams = 0, idx, errs;
+
+  for (idx = 0; idx < rte_get_numfilters(); idx++) {
+    filter = get_weed_filter(idx);
+    if (filter && (nparams = num_in_params(filter, FALSE, FALSE)) > 0) break;
+  }
+  if (idx == rte_get_numfilters()) {
+    d_print("quantise test: no filter with parameters, skipped\n");
+    return;
+  }
+  hashname = make_weed_hashname(idx, TRUE, FALSE, 0, FALSE);
+
+  for (i = 0; i < 50000; i++) {
+    // about 30 fps, with some jitter
+    tc += TICKS_PER_SECOND / 30 + ((i * 7919) % 13 - 6) * TICKS_PER_SECOND / 2000;
+    if (i % 10000 == 0) {
+      void **pchanges = (void **)lives_calloc(nparams, sizeof(void *));
+      void *ievs[1];
+      if (init_event) {
+        event = qtest_add_event(event_list, WEED_EVENT_TYPE_FILTER_DEINIT, tc);
+        weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+        weed_set_voidptr_value(init_event, WEED_LEAF_DEINIT_EVENT, event);
+      }
+      if (!event_list) event_list = lives_event_list_new(NULL, NULL);
+      init_event = qtest_add_event(event_list, WEED_EVENT_TYPE_FILTER_INIT, tc);
+      weed_set_string_value(init_event, WEED_LEAF_FILTER, hashname);
+      for (int j = 0; j < nparams; j++) {
+        pchanges[j] = event = qtest_add_event(event_list, WEED_EVENT_TYPE_PARAM_CHANGE, tc);
+        weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+        weed_set_int_value(event, WEED_LEAF_INDEX, j);
+        weed_set_double_value(event, WEED_LEAF_VALUE, 0.);
+      }
+      weed_set_voidptr_array(init_event, WEED_LEAF_IN_PARAMETERS, nparams, pchanges);
+      lives_free(pchanges);
+      ievs[0] = init_event;
+      event = qtest_add_event(event_list, WEED_EVENT_TYPE_FILTER_MAP, tc);
+      weed_set_voidptr_array(event, WEED_LEAF_INIT_EVENTS, 1, ievs);
+    } else {
+      event = qtest_add_event(event_list, WEED_EVENT_TYPE_PARAM_CHANGE, tc);
+      weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+      weed_set_int_value(event, WEED_LEAF_INDEX, (int)(i % nparams));
+      weed_set_double_value(event, WEED_LEAF_VALUE, (double)(i % 100) / 100.);
+    }
+    frames[0] = i + 1;
+    event_list = append_frame_event(event_list, tc, 1, clips, frames);
+  }
+  event = qtest_add_event(event_list, WEED_EVENT_TYPE_FILTER_DEINIT, tc);
+  weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+  weed_set_voidptr_value(init_event, WEED_LEAF_DEINIT_EVENT, event);
+  lives_free(hashname);
+
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) nevents++;
+
+  t0 = lives_get_current_ticks();
+  qevent_list = quantise_events(event_list, 25., FALSE);
+  t_quant = lives_get_current_ticks() - t0;
+
+  if (!qevent_list) {
+    d_print("quantise test: FAILED to quantise\n");
+    event_list_free(event_list);
+    return;
+  }
+
+  errs = qtest_check(qevent_list, &npchanges);
+
+  // shrink the first filter instance to half its length, rescaling its param changes, then restore it
+  for (event = get_first_event(qevent_list); event && !WEED_EVENT_IS_FILTER_INIT(event);
+       event = get_next_event(event));
+  init_event = event;
+  deinit_event = init_event ? weed_get_plantptr_value(init_event, WEED_LEAF_DEINIT_EVENT, NULL) : NULL;
+
+  t0 = lives_get_current_ticks();
+  if (deinit_event) {
+    init_tc = get_event_timecode(init_event);
+    deinit_tc = get_event_timecode(deinit_event);
+    move_filter_deinit_event(qevent_list, q_gint64(init_tc + (deinit_tc - init_tc) / 2, 25.), deinit_event, 25., TRUE);
+    move_filter_deinit_event(qevent_list, deinit_tc, deinit_event, 25., TRUE);
+  } else errs++;
+  t_rescale = lives_get_current_ticks() - t0;
+
+  errs += qtest_check(qevent_list, &i);
+  if (i != npchanges) errs++;
+
+  d_print("quantise test: %"PRId64" events, %"PRId64" param changes after quantising, %s\n", nevents, npchanges,
+          errs ? "FAILED" : "passed");
+  d_print("quantise to 25 fps %.2f ms, shrink and restore filter %.2f ms\n",
+          (double)t_quant / TICKS_PER_SECOND_DBL * 1000., (double)t_rescale / TICKS_PER_SECOND_DBL * 1000.);
+
+  event_list_free(qevent_list);
+  event_list_free(event_list);
+}
+
+
+#define EITEST_NFRAMES 4000
+#define EITEST_REPS 3 // lookups per query; the first ones may walk a stale index, the last will use the rebuilt one
+
+static weed_event_t *eitest_lin_frame_at(weed_event_list_t *event_list, weed_timecode_t tc, boolean exact_tc) {
+  // what get_frame_event_at(..., TRUE) (or with exact_tc, has_frame_event_at()) should find, by walking the whole list
+  weed_event_t *event;
+  for (event = get_first_frame_event(event_list); event; event = get_next_event(event)) {
+    weed_timecode_t xtc = get_event_timecode(event);
+    if (WEED_EVENT_IS_FRAME(event) && (exact_tc ? xtc == tc : labs(tc - xtc) <= 10)) return event;
+    if (xtc > tc) return NULL;
+  }
+  return NULL;
+}
+
+
+static boolean eitest_relevant(weed_event_t *fmap, int ctrack) {
+  void **init_events;
+  int ninits;
+  boolean relevant = FALSE;
+  if (ctrack == LIVES_TRACK_ANY) return TRUE;
+  init_events = weed_get_voidptr_array_counted(fmap, WEED_LEAF_INIT_EVENTS, &ninits);
+  for (int i = 0; i < ninits && !relevant; i++)
+    if (init_events[i]) relevant = init_event_is_relevant((weed_event_t *)init_events[i], ctrack);
+  lives_freep((void **)&init_events);
+  return relevant;
+}
+
+
+static int eitest_check(weed_event_list_t *event_list, int64_t nframes, int *nchecks) {
+  // compare the indexed lookups with linear walks
+  weed_event_t *event, *lin, *xevent;
+  int64_t i = 0;
+  int errs = 0;
+
+  // frame lookups at, near and between frame timecodes
+  for (int64_t k = 0; k < nframes * 2; k += 37) {
+    weed_timecode_t tc = k * TICKS_PER_SECOND / 50 + (k % 3) * 5;
+    for (int rep = 0; rep < EITEST_REPS; rep++) {
+      if (get_frame_event_at(event_list, tc, NULL, TRUE) != eitest_lin_frame_at(event_list, tc, FALSE)) errs++;
+      xevent = NULL;
+      if (has_frame_event_at(event_list, tc, &xevent) != (eitest_lin_frame_at(event_list, tc, TRUE) != NULL)) errs++;
+      (*nchecks) += 2;
+    }
+  }
+
+  // filter map lookups from every 11th frame, for any track and for each track
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) {
+    if (!WEED_EVENT_IS_FRAME(event) || ++i % 11) continue;
+    for (int track = -1; track < 3; track++) {
+      int ctrack = track < 0 ? LIVES_TRACK_ANY : track;
+      for (int rep = 0; rep < EITEST_REPS; rep++) {
+        for (lin = event; lin && !(WEED_EVENT_IS_FILTER_MAP(lin) && eitest_relevant(lin, ctrack));
+             lin = get_next_event(lin));
+        if (get_filter_map_after(event, ctrack) != lin) errs++;
+        for (lin = event; lin && !(WEED_EVENT_IS_FILTER_MAP(lin) && eitest_relevant(lin, ctrack));
+             lin = get_prev_event(lin));
+        if (get_filter_map_before(event, ctrack, NULL) != lin) errs++;
+        (*nchecks) += 2;
+      }
+    }
+  }
+  return errs;
+}
+
+
+void test_event_index(void) {
+  // edit an event list in the ways the editors do - via the list helpers, and by relinking directly followed by
+  // event_list_index_invalidate() - and check after each edit that the index lookups agree with linear walks
+  weed_event_list_t *event_list = NULL;
+  weed_event_t *event, *init_event = NULL, *next;
+  weed_timecode_t tc = 0;
+  int clips[1] = {1};
+  frames64_t frames[1];
+  int64_t i;
+  int nchecks = 0, errs = 0, step = 0;
+  int fail_step = -1;
+
+  for (i = 0; i < EITEST_NFRAMES; i++) {
+    tc = i * TICKS_PER_SECOND / 25;
+    frames[0] = i + 1;
+    event_list = append_frame_event(event_list, tc, 1, clips, frames);
+    if (i % 50 == 25) {
+      int in_tracks[1];
+      weed_event_t *ievs[2] = {NULL, NULL};
+      in_tracks[0] = (i / 50) % 3;
+      init_event = weed_plant_new(WEED_PLANT_EVENT);
+      weed_set_int_value(init_event, WEED_LEAF_EVENT_TYPE, WEED_EVENT_TYPE_FILTER_INIT);
+      weed_event_set_timecode(init_event, tc);
+      weed_set_int_array(init_event, WEED_LEAF_IN_TRACKS, 1, in_tracks);
+      if (!insert_event_after(get_last_event(event_list), init_event))
+        weed_set_voidptr_value(event_list, WEED_LEAF_LAST, init_event);
+      ievs[0] = init_event;
+      event_list = append_filter_map_event(event_list, tc, ievs);
+    }
+  }
+
+  // build the index, then check it untouched
+  get_frame_event_at(event_list, tc / 2, NULL, TRUE);
+  if ((errs = eitest_check(event_list, EITEST_NFRAMES, &nchecks))) fail_step = step;
+  step++;
+
+  // remove every 13th frame via the helpers
+  for (event = get_first_event(event_list), i = 0; event; event = next) {
+    next = get_next_event(event);
+    if (WEED_EVENT_IS_FRAME(event) && !(++i % 13)) {
+      unlink_event(event_list, event);
+      weed_plant_free(event);
+    }
+  }
+  if (!errs && (errs = eitest_check(event_list, EITEST_NFRAMES, &nchecks))) fail_step = step;
+  step++;
+
+  // insert an empty filter map after every 17th frame via the helpers
+  for (event = get_first_event(event_list), i = 0; event; event = get_next_event(event)) {
+    if (WEED_EVENT_IS_FRAME(event) && !(++i % 17)) {
+      weed_event_t *fmap = weed_plant_new(WEED_PLANT_EVENT);
+      weed_set_int_value(fmap, WEED_LEAF_EVENT_TYPE, WEED_EVENT_TYPE_FILTER_MAP);
+      weed_event_set_timecode(fmap, get_event_timecode(event));
+      weed_set_voidptr_value(fmap, WEED_LEAF_INIT_EVENTS, NULL);
+      if (!insert_event_after(event, fmap)) weed_set_voidptr_value(event_list, WEED_LEAF_LAST, fmap);
+      event = fmap;
+    }
+  }
+  if (!errs && (errs = eitest_check(event_list, EITEST_NFRAMES, &nchecks))) fail_step = step;
+  step++;
+
+  // move each filter map to just before the next frame by relinking directly, as the journal replay does
+  // and retime it to that frame
+  for (event = get_first_event(event_list); event; event = next) {
+    weed_event_t *prev, *frame;
+    next = get_next_event(event);
+    if (!WEED_EVENT_IS_FILTER_MAP(event)) continue;
+    for (frame = next; frame && !WEED_EVENT_IS_FRAME(frame); frame = get_next_event(frame));
+    if (!frame || (prev = get_prev_event(frame)) == event) continue;
+    next = frame;
+    // unlink
+    weed_set_voidptr_value(get_prev_event(event), WEED_LEAF_NEXT, get_next_event(event));
+    weed_set_voidptr_value(get_next_event(event), WEED_LEAF_PREVIOUS, get_prev_event(event));
+    // relink before frame
+    weed_event_set_timecode(event, get_event_timecode(frame));
+    weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, prev);
+    weed_set_voidptr_value(event, WEED_LEAF_NEXT, frame);
+    weed_set_voidptr_value(prev, WEED_LEAF_NEXT, event);
+    weed_set_voidptr_value(frame, WEED_LEAF_PREVIOUS, event);
+  }
+  event_list_index_invalidate();
+  if (!errs && (errs = eitest_check(event_list, EITEST_NFRAMES, &nchecks))) fail_step = step;
+  step++;
+
+  if (errs) d_print("event index test: FAILED at step %d of %d, %d of %d lookups differ from the linear walk\n",
+                      fail_step, step, errs, nchecks);
+  else d_print("event index test: %d lookups checked against the linear walk, passed\n", nchecks);
+
+  event_list_free(event_list);
+}
+
+
 /// any diagnostic tests can be placed in this section - the functional will be called early in
 // startup. If abort_after is TRUE, then the function will abort() after completing all designatedd testing
 //////////////
@@ -2485,6 +3136,12 @@ lives_result_t do_startup_diagnostics(uint64_t tests_to_run) {
 
     if (tests_to_run & TEST_WEED_UTILS)
       weed_utils_test();
+
+    if (tests_to_run & TEST_LAYOUT_BIN)
+      test_layout_binary();
+
+    if (tests_to_run & TEST_EVENT_INDEX)
+      test_event_index();
   }
 
   if (testpoint == 2) {
@@ -2492,6 +3149,8 @@ lives_result_t do_startup_diagnostics(uint64_t tests_to_run) {
       run_weed_startup_tests();
     if (tests_to_run & TEST_PROCTHRDS)
       test_procthreads();
+    if (tests_to_run & TEST_EVENT_QUANT)
+      test_quantise_events();
   }
 
   if (tests_to_run & ABORT_AFTER
@@ -18,9 +18,12 @@
 #define TEST_PAL_CONV		(1ull << 3)
 #define TEST_BUNDLES		(1ull << 4)
 #define TEST_WEED_UTILS		(1ull << 6)
+#define TEST_LAYOUT_BIN		(1ull << 7)
+#define TEST_EVENT_INDEX	(1ull << 8)
 
 #define TEST_POINT_2		(1ull << 16)
 #define TEST_PROCTHRDS		(1ull << 17)
+#define TEST_EVENT_QUANT	(1ull << 18)
 
 #ifdef TEST_RTM_CODE
 #define TEST_RTM		(1ull << 32)
@@ -40,6 +43,9 @@ void print_diagnostics(uint64_t types);
 //
 
 void test_procthreads(void);
+void test_layout_binary(void);
+void test_event_index(void);
+void test_quantise_events(void);
 
 boolean debug_callback(LiVESAccelGroup *, LiVESWidgetObject *, uint32_t keyval, LiVESXModifierType mod,
                        livespointer statep);
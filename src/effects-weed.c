@@ -32,6 +32,8 @@ using namespace cv;
 #include "ce_thumbs.h"
 #include "paramwindow.h"
 #include "diagnostics.h"
+#include "fmapplan.h"
+#include "genqueue.h"
 
 ////////////////////////////////////////////////////////////////////////
 
@@ -239,7 +241,16 @@ LIVES_GLOBAL_INLINE int filter_mutex_lock(int key) {
 
 LIVES_GLOBAL_INLINE int filter_mutex_trylock(int key) {
   if (key >= 0 && key < FX_KEYS_MAX_VIRTUAL) {
-    return pthread_mutex_trylock(&mainw->fx_key_mutex[key]);
+    int ret = pthread_mutex_trylock(&mainw->fx_key_mutex[key]);
+    // record the owner as filter_mutex_lock() does, else filter_mutex_unlock() will not release it
+    if (!ret) {
+      if (mainw->fx_mutex_tuid[key] == 0) {
+        mainw->fx_mutex_tuid[key] = THREADVAR(uid);
+        mainw->fx_mutex_nlocks[key] = 0;
+      }
+      mainw->fx_mutex_nlocks[key]++;
+    }
+    return ret;
   } else {
     char *msg = lives_strdup_printf("attempted lock of bad fx key %d", key);
     LIVES_ERROR(msg);
@@ -2618,6 +2629,20 @@ static lives_filter_error_t weed_apply_audio_instance_inner(weed_plant_t *inst,
     /* g_print("setting ad for channel %d from layer %d. val %p, eg %f \n", i, in_tracks[i] + nbtracks, weed_get_voidptr_value(layer,
        "audio_data", NULL), ((float *)(weed_get_voidptr_value(layer, "audio_data", NULL)))[0]); */
     lives_leaf_dup(channel, layer, WEED_LEAF_AUDIO_DATA);
+
+    if (weed_get_boolean_value(weed_channel_get_template(channel), WEED_LEAF_HOST_SPECTRUM_REQ, NULL) == WEED_TRUE) {
+      // give the channel the spectrum with the window it asked for
+      const char *keys[] = {WEED_LEAF_HOST_SPECTRUM, WEED_LEAF_HOST_SPECTRUM_SIZE, WEED_LEAF_HOST_BAND_ENERGIES,
+                            WEED_LEAF_HOST_BAND_FREQS, NULL
+                           };
+      char lkey[64];
+      int window = weed_get_int_value(weed_channel_get_template(channel), WEED_LEAF_HOST_SPECTRUM_WINDOW, NULL);
+      for (int k = 0; keys[k]; k++) {
+        if (weed_leaf_copy(channel, keys[k], layer, host_spectrum_layer_key(lkey, 64, keys[k], window)) != WEED_SUCCESS)
+          weed_leaf_delete(channel, keys[k]);
+      }
+      weed_set_int_value(channel, WEED_LEAF_HOST_SPECTRUM_WINDOW, window);
+    }
     /* g_print("setting afterval %p, eg %f \n", weed_get_voidptr_value(channel, "audio_data", NULL),
        ((float *)(weed_get_voidptr_value(channel, "audio_data", NULL)))[0]); */
   }
@@ -3060,26 +3085,26 @@ static void weed_apply_filter_map(weed_plant_t **layers, weed_plant_t *filter_ma
                                   weed_timecode_t tc, void ***pchains) {
   weed_plant_t *instance, *orig_inst = NULL, *xinstance;
   weed_plant_t *init_event;
+  lives_fmap_plan_t *plan;
   lives_filter_error_t retval;
 
   char *keystr;
 
-  void **init_events;
-
   weed_error_t filter_error;
-  int key, num_inst;
+  int key;
 
   boolean needs_reinit;
 
   if (!filter_map || !weed_plant_has_leaf(filter_map, WEED_LEAF_INIT_EVENTS) ||
       !weed_get_voidptr_value(filter_map, WEED_LEAF_INIT_EVENTS, NULL)) return;
 
-  init_events = weed_get_voidptr_array_counted(filter_map, WEED_LEAF_INIT_EVENTS, &num_inst);
+  if (!(plan = fmap_plan_get(filter_map))) return;
 
-  for (int i = 0; i < num_inst; i++) {
+  for (int i = 0; i < plan->nsteps; i++) {
+    lives_fmap_step_t *step = &plan->steps[i];
     if (orig_inst) weed_instance_unref(orig_inst);
     orig_inst = NULL;
-    init_event = (weed_plant_t *)init_events[i];
+    init_event = step->init_event;
 
     if (weed_plant_has_leaf(init_event, WEED_LEAF_HOST_TAG)) {
       keystr = weed_get_string_value(init_event, WEED_LEAF_HOST_TAG, NULL);
@@ -3104,34 +3129,21 @@ static void weed_apply_filter_map(weed_plant_t **layers, weed_plant_t *filter_ma
             if (mainw->multitrack->solo_inst) continue;
           }
         } else {
-          int idx;
-          char *filter_hash;
           boolean is_valid = FALSE;
-          if (!weed_plant_has_leaf(init_events[i], WEED_LEAF_OUT_TRACKS)
-              || !weed_plant_has_leaf(init_events[i], WEED_LEAF_IN_TRACKS)) {
-            continue;
-          }
+          if (!step->has_tracks) continue;
           if (mainw->multitrack && mainw->multitrack->solo_inst && mainw->multitrack->init_event
-              && !LIVES_IS_PLAYING && mainw->multitrack->init_event != init_events[i]) {
+              && !LIVES_IS_PLAYING && mainw->multitrack->init_event != init_event) {
             continue;
           }
-          filter_hash = weed_get_string_value(init_events[i], WEED_LEAF_FILTER, NULL);
-          if ((idx = weed_get_idx_for_hashname(filter_hash, TRUE)) != -1) {
-            weed_plant_t *filter = get_weed_filter(idx);
-            if (has_video_chans_in(filter, FALSE) && has_video_chans_out(filter, FALSE)) {
-              int nintracks, *in_tracks = weed_get_int_array_counted(init_events[i],
-                                          WEED_LEAF_IN_TRACKS, &nintracks);
-              for (int j = 0; j < nintracks; j++) {
-                if (j >= mainw->num_tracks) break;
-                if (mainw->active_track_list[in_tracks[j]] > 0) {
-                  is_valid = TRUE;
-                  break;
-                }
+          if (step->is_video) {
+            for (int j = 0; j < step->nin_tracks; j++) {
+              if (j >= mainw->num_tracks) break;
+              if (mainw->active_track_list[step->in_tracks[j]] > 0) {
+                is_valid = TRUE;
+                break;
               }
-              lives_free(in_tracks);
             }
           }
-          lives_free(filter_hash);
           /// avoid applying to non-active tracks
           if (!is_valid) {
             continue;
@@ -3198,7 +3210,7 @@ apply_inst2:
   // *INDENT-ON*
 
   if (orig_inst) weed_instance_unref(orig_inst);
-  lives_freep((void **)&init_events);
+  fmap_plan_unref(plan);
 }
 
 
@@ -3552,7 +3564,7 @@ boolean has_audio_filters(lives_af_t af_type) {
   weed_plant_t *filter;
   int idx;
 
-  if (af_type == AF_TYPE_A && mainw->afbuffer) return TRUE;
+  if (af_type == AF_TYPE_A && mainw->aarena) return TRUE;
 
   for (int i = 0; i < FX_KEYS_MAX_VIRTUAL; i++) {
     if (rte_key_valid(i + 1, TRUE)) {
@@ -3572,6 +3584,40 @@ boolean has_audio_filters(lives_af_t af_type) {
 }
 
 
+const char *host_spectrum_layer_key(char *buf, size_t buflen, const char *key, int window) {
+  lives_snprintf(buf, buflen, "%s_w%d", key, window);
+  return buf;
+}
+
+
+int has_spectrum_analysers(void) {
+  // do we have any active audio analysers which want the host spectral data ?
+  // returns a bitmap of the windows they want
+  // called from audio thread during playback
+  weed_plant_t *filter, **ctmpls;
+  int idx, window, windows = 0;
+
+  for (int i = 0; i < FX_KEYS_MAX_VIRTUAL; i++) {
+    if (rte_key_valid(i + 1, TRUE)) {
+      if (rte_key_is_enabled(i, TRUE)) {
+        idx = key_to_fx[i][key_modes[i]];
+        filter = weed_filters[idx];
+        if (!is_pure_audio(filter, FALSE) || has_audio_chans_out(filter, FALSE)) continue;
+        ctmpls = weed_filter_get_in_chantmpls(filter, NULL);
+        if (!ctmpls) continue;
+        if (weed_get_boolean_value(ctmpls[0], WEED_LEAF_HOST_SPECTRUM_REQ, NULL) == WEED_TRUE) {
+          window = weed_get_int_value(ctmpls[0], WEED_LEAF_HOST_SPECTRUM_WINDOW, NULL);
+          if (window >= 0 && window < N_HOST_SPECTRUM_WINDOWS) windows |= (1 << window);
+        }
+        lives_free(ctmpls);
+	// *INDENT-OFF*
+      }}}
+  // *INDENT-ON*
+
+  return windows;
+}
+
+
 boolean has_video_filters(boolean analysers_only) {
   // do we have any active video filters (excluding generators) ?
   weed_plant_t *filter;
@@ -5827,6 +5873,7 @@ void weed_unload_all(void) {
 
   mainw->num_tr_applied = 0;
   weed_deinit_all(TRUE);
+  fmap_plans_clear(); // plans refer to filters by index
 
   for (i = 0; i < FX_KEYS_MAX_VIRTUAL; i++) {
     for (j = 0; j < FX_MODES_MAX; j++) {
@@ -7033,6 +7080,14 @@ weed_error_t weed_call_deinit_func(weed_plant_t *instance) {
     }
   }
 
+  if (mainw->aarena) {
+    // readers claimed by fill_audio_channel() are otherwise only reclaimed once stale
+    int nchans;
+    weed_plant_t **in_channels = weed_instance_get_in_channels(instance, &nchans);
+    for (int i = 0; i < nchans; i++) release_audio_reader(in_channels[i]);
+    lives_freep((void **)&in_channels);
+  }
+
   return error;
 }
 
@@ -7405,83 +7460,141 @@ void weed_deinit_all(boolean shutdown) {
 }
 
 
+static int get_areader(weed_plant_t *achan, lives_aarena_t *aar) {
+  // get the arena reader for achan, claiming a new one if it has none yet, or its reader belongs to an old arena,
+  // or the slot was reclaimed meanwhile (then its generation will have changed)
+  uint64_t gen;
+  int reader;
+  if (weed_get_int64_value(achan, WEED_LEAF_HOST_AARENA, NULL) == (int64_t)aar->id) {
+    reader = weed_get_int_value(achan, WEED_LEAF_HOST_AREADER, NULL);
+    gen = (uint64_t)weed_get_int64_value(achan, WEED_LEAF_HOST_AREADER_GEN, NULL);
+    if (aarena_reader_valid(aar, reader, gen)) return reader;
+  }
+  reader = aarena_add_reader(aar, &gen);
+  if (reader < 0) return -1;
+  weed_set_int64_value(achan, WEED_LEAF_HOST_AARENA, (int64_t)aar->id);
+  weed_set_int_value(achan, WEED_LEAF_HOST_AREADER, reader);
+  weed_set_int64_value(achan, WEED_LEAF_HOST_AREADER_GEN, (int64_t)gen);
+  return reader;
+}
+
+
+static void channel_arena_unref(weed_plant_t *achan) {
+  // drop the reference taken by fill_audio_channel(), once the audio it pointed to is no longer used
+  if (weed_get_boolean_value(achan, WEED_LEAF_HOST_AARENA_REF, NULL) == WEED_TRUE) {
+    weed_leaf_delete(achan, WEED_LEAF_HOST_AARENA_REF);
+    audio_arena_unref();
+  }
+}
+
+
+void release_audio_reader(weed_plant_t *achan) {
+  // give up the arena reader held by achan, if any; called when a client unregisters, or the instance is deinited
+  lives_aarena_t *aar;
+  if (!achan || !weed_plant_has_leaf(achan, WEED_LEAF_HOST_AARENA)) return;
+  if ((aar = audio_arena_ref())) {
+    if (weed_get_int64_value(achan, WEED_LEAF_HOST_AARENA, NULL) == (int64_t)aar->id)
+      aarena_remove_reader(aar, weed_get_int_value(achan, WEED_LEAF_HOST_AREADER, NULL),
+                           (uint64_t)weed_get_int64_value(achan, WEED_LEAF_HOST_AREADER_GEN, NULL));
+    audio_arena_unref();
+  }
+  weed_leaf_delete(achan, WEED_LEAF_HOST_AARENA);
+  weed_leaf_delete(achan, WEED_LEAF_HOST_AREADER);
+  weed_leaf_delete(achan, WEED_LEAF_HOST_AREADER_GEN);
+  channel_arena_unref(achan);
+}
+
+
 /**
    @brief registration fn. for video effects with audio input channels
    during playback there is the option of buffering audio sent to the soundcard
-   if a video effect requires audio it can register itself here, and the audio buffer will be filled and
-   only refreshed after all clients have read from it. Once this has happened, the read / write buffers are swapped for the
-   following cycle. This ensures that no client will miss audio samples, at the cost of some minor latency.
+   if a video effect requires audio it can register itself here, and the audio arena will be created and
+   filled by the audio thread for as long as any clients remain registered.
+   Each client reads via its own reader in the arena, so no client will miss audio samples unless it falls behind
+   by more than the arena size, and no client holds up any other.
+   The reader is claimed now if achan is supplied, otherwise on the first fill_audio_channel().
    Purely audio filters are run directly during the audio cycle or by the audio caching thread.
 */
-int register_audio_client(boolean is_vid) {
+int register_audio_client(weed_plant_t *achan) {
   if (!is_realtime_aplayer(prefs->audio_player)) {
     return -1;
   }
 
-  if (!mainw->afbuffer) {
-    init_audio_frame_buffers(prefs->audio_player);
-    mainw->afbuffer->aclients = mainw->afbuffer->vclients = 0;
-    mainw->afbuffer->aclients_read = mainw->afbuffer->vclients_read = 0;
-  }
-
-  if (is_vid) mainw->afbuffer->vclients++;
-  else mainw->afbuffer->aclients++;
+  if (!mainw->aarena) init_audio_arena(prefs->audio_player);
+  if (!mainw->aarena) return -1;
 
-  if (is_vid) return mainw->afbuffer->vclients;
-  return mainw->afbuffer->aclients;
+  if (achan) get_areader(achan, mainw->aarena);
+  return ++mainw->aarena->nclients;
 }
 
-int unregister_audio_client(boolean is_vid) {
-  if (!mainw->afbuffer) return -1;
 
-  if (is_vid) mainw->afbuffer->vclients--;
-  else mainw->afbuffer->aclients--;
-  if (mainw->afbuffer->aclients <= 0 && mainw->afbuffer->vclients <= 0) {
-    // lock out the audio thread
-    free_audio_frame_buffer(mainw->afbuffer);
-    mainw->afbuffer = NULL;
+int unregister_audio_client(weed_plant_t *achan) {
+  lives_aarena_t *aar = mainw->aarena;
+  if (!aar) return -1;
+
+  if (achan) release_audio_reader(achan);
+
+  if (--aar->nclients <= 0) {
+    // the audio thread may still be writing, so the arena is retired rather than freed
+    retire_audio_arena();
     return 0;
   }
-
-  if (is_vid) return mainw->afbuffer->vclients;
-  return mainw->afbuffer->aclients;
+  return aar->nclients;
 }
 
 
-boolean fill_audio_channel(weed_plant_t *filter, weed_plant_t *achan, boolean is_vid) {
+boolean fill_audio_channel(weed_plant_t *filter, weed_plant_t *achan) {
   // this is for filter instances with mixed audio / video inputs/outputs
-  // uneffected audio is buffered by the audio thread; here we copy / convert it to a video effect's audio channel
+  // uneffected audio is buffered in the arena by the audio thread; here we pass it to a video effect's audio channel
   // purely audio filters run in the audio thread
   // now used also to pass loopback audio from reader to writer
-  lives_audio_buf_t *audbuf;
+  // when done with the audio, the caller should call release_audio_channel()
+  // the channel keeps a reference to the arena until then, since it may point into the arena data
+  lives_aarena_t *aar;
+  int reader;
+
   if (!achan) return TRUE;
 
   weed_set_int_value(achan, WEED_LEAF_AUDIO_DATA_LENGTH, 0);
   weed_set_voidptr_value(achan, WEED_LEAF_AUDIO_DATA, NULL);
+  channel_arena_unref(achan);
 
-  audbuf = mainw->afbuffer;
-  if (!achan || !audbuf || audbuf->write_pos < 0) return FALSE;
-  if (is_vid) {
-    if (!audbuf->vclients) return FALSE;
-    push_audio_to_channel(filter, achan, audbuf, TRUE);
-    if (++audbuf->vclients_read >= audbuf->vclients) audbuf->vclients_read = 0;
-    if (!audbuf->vclients_read) {
-      audbuf->vclient_readpos = audbuf->vclient_readlevel;
-      audbuf->vclient_readlevel = audbuf->write_pos;
-    }
-  } else {
-    if (!audbuf->aclients) return FALSE;
-    push_audio_to_channel(filter, achan, audbuf, FALSE);
-    if (++audbuf->aclients_read >= audbuf->aclients) audbuf->aclients_read = 0;
-    if (!audbuf->aclients_read) {
-      audbuf->aclient_readpos = audbuf->aclient_readlevel;
-      audbuf->aclient_readlevel = audbuf->write_pos;
-    }
+  if (!(aar = audio_arena_ref())) return FALSE;
+
+  if (aar->nclients <= 0 || (reader = get_areader(achan, aar)) < 0
+      || !push_arena_to_channel(filter, achan, aar, reader)) {
+    audio_arena_unref();
+    return FALSE;
   }
+  weed_set_boolean_value(achan, WEED_LEAF_HOST_AARENA_REF, WEED_TRUE);
   return TRUE;
 }
 
 
+void release_audio_channel(weed_plant_t *achan) {
+  // the audio_data points into the arena (or a reader's scratch buffer) so only the array is freed here,
+  // then the reader is advanced past it
+  lives_aarena_t *aar;
+  float **abuf;
+
+  if (!achan) return;
+
+  abuf = (float **)weed_get_voidptr_array(achan, WEED_LEAF_AUDIO_DATA, NULL);
+  lives_freep((void **)&abuf);
+  weed_channel_set_audio_data(achan, NULL, 0, 0, 0);
+
+  if ((aar = audio_arena_ref())) {
+    if (weed_get_int64_value(achan, WEED_LEAF_HOST_AARENA, NULL) == (int64_t)aar->id) {
+      int reader = weed_get_int_value(achan, WEED_LEAF_HOST_AREADER, NULL);
+      if (aarena_reader_valid(aar, reader, (uint64_t)weed_get_int64_value(achan, WEED_LEAF_HOST_AREADER_GEN, NULL)))
+        aarena_release(aar, reader);
+    }
+    audio_arena_unref();
+  }
+  channel_arena_unref(achan);
+}
+
+
 int register_aux_audio_channels(int nchannels) {
   if (!is_realtime_aplayer(prefs->audio_player)) {
     mainw->afbuffer_aux_clients = 0;
@@ -7553,7 +7666,7 @@ boolean fill_audio_channel_aux(weed_plant_t *achan) {
   // push read buffer to channel
   if (achan && audbuf) {
     // convert audio to format requested, and copy it to the audio channel data
-    push_audio_to_channel(NULL, achan, audbuf, FALSE);
+    push_audio_to_channel(NULL, achan, audbuf);
   }
 
   if (++mainw->afbuffer_aux_clients_read >= mainw->afbuffer_aux_clients) {
@@ -7569,7 +7682,8 @@ boolean fill_audio_channel_aux(weed_plant_t *achan) {
 /////////////////////
 // special handling for generators (sources)
 
-lives_filter_error_t lives_layer_fill_from_generator(weed_layer_t *layer, weed_instance_t *inst, weed_timecode_t tc) {
+static lives_filter_error_t _fill_from_generator(weed_layer_t *layer, weed_instance_t *inst, weed_timecode_t tc,
+    boolean fixed_tc) {
   weed_filter_t *filter;
   weed_channel_t *channel, *achan;
   weed_layer_t *inter;
@@ -7678,7 +7792,7 @@ matchvals:
 
   // if we have an optional audio channel, we can push audio to it
   if ((achan = get_enabled_audio_channel(inst, 0, LIVES_INPUT)) != NULL) {
-    fill_audio_channel(filter, achan, TRUE);
+    fill_audio_channel(filter, achan);
   }
 
   cwd = cd_to_plugin_dir(filter);
@@ -7686,8 +7800,9 @@ matchvals:
 procfunc1:
 
   // the timecode we get in the parameter will be the queued or "reference" time for the layer
-  // for realtime playback, better to use current tc
-  if (!mainw->preview && (!mainw->event_list || mainw->record || mainw->record_paused)) {
+  // for realtime playback, better to use current tc - unless we are rendering ahead
+  if (fixed_tc) weed_set_int64_value(layer, WEED_LEAF_HOST_TC, tc);
+  else if (!mainw->preview && (!mainw->event_list || mainw->record || mainw->record_paused)) {
     tc = mainw->currticks;
     weed_set_int64_value(layer, WEED_LEAF_HOST_TC, tc);
   }
@@ -7695,13 +7810,7 @@ procfunc1:
   // get the current video data, then we will push an audio packet for the following frame
   retval = run_process_func(inst, tc);
 
-  if (achan) {
-    int nachans;
-    float **abuf = weed_channel_get_audio_data(achan, &nachans);
-    for (i = 0; i < nachans; i++) lives_freep((void **)&abuf[i]);
-    lives_freep((void **)&abuf);
-    weed_channel_set_audio_data(achan, NULL, 0, 0, 0);
-  }
+  if (achan) release_audio_channel(achan);
 
   if (retval == WEED_ERROR_REINIT_NEEDED) {
     if (reinited) {
@@ -7736,6 +7845,14 @@ procfunc1:
 }
 
 
+lives_filter_error_t lives_layer_fill_from_generator(weed_layer_t *layer, weed_instance_t *inst, weed_timecode_t tc)
+{return _fill_from_generator(layer, inst, tc, FALSE);}
+
+
+lives_filter_error_t lives_layer_fill_from_generator_at(weed_layer_t *layer, weed_instance_t *inst, weed_timecode_t tc)
+{return _fill_from_generator(layer, inst, tc, TRUE);}
+
+
 int weed_generator_start(weed_plant_t *inst, int key) {
   // key here is zero based
   // make an "ephemeral clip"
@@ -7860,7 +7977,7 @@ int weed_generator_start(weed_plant_t *inst, int key) {
   if (prefs->push_audio_to_gens) {
     if ((achan = get_audio_channel_in(inst, 0)) != NULL) {
       if (weed_plant_has_leaf(achan, WEED_LEAF_DISABLED)) weed_leaf_delete(achan, WEED_LEAF_DISABLED);
-      register_audio_client(TRUE);
+      register_audio_client(achan);
     }
   }
 
@@ -7961,6 +8078,9 @@ void wge_inner(weed_plant_t *inst) {
     filter_mutex_unlock(key);
   }
 
+  // the run ahead thread must finish before we deinit
+  genq_stop(inst);
+
   while (inst) {
     next_inst = get_next_compound_inst(inst);
     weed_call_deinit_func(inst);
@@ -7996,8 +8116,9 @@ void weed_generator_end(weed_plant_t *inst) {
   }
 
   if (prefs->push_audio_to_gens) {
-    if (inst && get_audio_channel_in(inst, 0)) {
-      unregister_audio_client(TRUE);
+    weed_plant_t *achan;
+    if (inst && (achan = get_audio_channel_in(inst, 0)) != NULL) {
+      unregister_audio_client(achan);
     }
   }
 
@@ -9913,6 +10034,42 @@ static char *get_default_element_string(weed_plant_t *param, int idx) {
 }
 
 
+static weed_event_t *find_last_pchange(weed_plant_t *param, weed_event_t *pchain, weed_timecode_t tc) {
+  // return the last param change in pchain with timecode <= tc, or NULL if there is none
+  // the result is cached in param, and the next search starts from there, forwards or backwards according to the
+  // direction of playback; the cache is discarded if pchain changes, or after any edit to param changes
+  weed_event_t *pchange, *last_pchange = NULL;
+  uint64_t gen = event_pchange_gen();
+
+  if (weed_get_voidptr_value(param, LIVES_LEAF_PCHAIN_HEAD, NULL) == pchain
+      && (uint64_t)weed_get_int64_value(param, LIVES_LEAF_PCHAIN_GEN, NULL) == gen) {
+    last_pchange = (weed_event_t *)weed_get_voidptr_value(param, LIVES_LEAF_PCHAIN_CURSOR, NULL);
+    while (last_pchange && get_event_timecode(last_pchange) > tc) {
+      pchange = (weed_event_t *)weed_get_voidptr_value(last_pchange, WEED_LEAF_PREV_CHANGE, NULL);
+      if (!pchange && last_pchange != pchain) {
+        // chain is not linked backwards, start again from the head
+        last_pchange = NULL;
+        break;
+      }
+      last_pchange = pchange;
+    }
+  }
+
+  if (last_pchange) pchange = (weed_event_t *)weed_get_voidptr_value(last_pchange, WEED_LEAF_NEXT_CHANGE, NULL);
+  else pchange = pchain;
+
+  while (pchange && get_event_timecode(pchange) <= tc) {
+    last_pchange = pchange;
+    pchange = (weed_event_t *)weed_get_voidptr_value(pchange, WEED_LEAF_NEXT_CHANGE, NULL);
+  }
+
+  weed_set_voidptr_value(param, LIVES_LEAF_PCHAIN_HEAD, pchain);
+  weed_set_voidptr_value(param, LIVES_LEAF_PCHAIN_CURSOR, last_pchange);
+  weed_set_int64_value(param, LIVES_LEAF_PCHAIN_GEN, (int64_t)gen);
+  return last_pchange;
+}
+
+
 boolean interpolate_param(weed_plant_t *param, void *pchain, weed_timecode_t tc) {
   // return FALSE if param has no "value"
   // - this can happen during realtime audio processing, if the effect is inited, but no "value" has been set yet
@@ -9936,10 +10093,8 @@ boolean interpolate_param(weed_plant_t *param, void *pchain, weed_timecode_t tc)
   if ((num_values = weed_leaf_num_elements(param, WEED_LEAF_VALUE)) == 0) return FALSE;
   if (weed_param_value_irrelevant(param)) return TRUE;
 
-  while (pchange && get_event_timecode(pchange) <= tc) {
-    last_pchange = pchange;
-    pchange = (weed_plant_t *)weed_get_voidptr_value(pchange, WEED_LEAF_NEXT_CHANGE, NULL);
-  }
+  last_pchange = find_last_pchange(param, pchange, tc);
+  if (last_pchange) pchange = (weed_plant_t *)weed_get_voidptr_value(last_pchange, WEED_LEAF_NEXT_CHANGE, NULL);
 
   wtmpl = weed_param_get_template(param);
 
@@ -9953,7 +10108,29 @@ boolean interpolate_param(weed_plant_t *param, void *pchain, weed_timecode_t tc)
     lpc[0] = last_pchange;
     npc[0] = pchange;
   } else {
-    pchange = (weed_plant_t *)pchain;
+    // elements may be ignored in some changes, so for each one we look back from last_pchange
+    // for the last change which sets it; if the chain is not linked backwards we search from the head
+    int got_lpc = 0;
+    for (pchange = last_pchange; pchange && got_lpc < num_values;
+         pchange = (weed_plant_t *)weed_get_voidptr_value(pchange, WEED_LEAF_PREV_CHANGE, NULL)) {
+      num_pvals = weed_leaf_num_elements(pchange, WEED_LEAF_VALUE);
+      if (num_pvals > num_values) num_pvals = num_values;
+      ign = weed_get_boolean_array_counted(pchange, WEED_LEAF_IGNORE, &num_ign);
+      for (j = 0; j < num_pvals; j++) {
+        if (!lpc[j] && (!ign || j >= num_ign || ign[j] == WEED_FALSE)) {
+          lpc[j] = pchange;
+          got_lpc++;
+        }
+      }
+      lives_freep((void **)&ign);
+      if (pchange == (weed_plant_t *)pchain) break;
+    }
+
+    if (got_lpc < num_values && pchange != (weed_plant_t *)pchain) {
+      for (j = 0; j < num_values; j++) lpc[j] = NULL;
+      pchange = (weed_plant_t *)pchain;
+    } else if (last_pchange) pchange = (weed_plant_t *)weed_get_voidptr_value(last_pchange, WEED_LEAF_NEXT_CHANGE, NULL);
+    else pchange = (weed_plant_t *)pchain;
 
     while (pchange) {
       num_pvals = weed_leaf_num_elements(pchange, WEED_LEAF_VALUE);
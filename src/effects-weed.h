@@ -76,6 +76,28 @@ void weed_plant_sanitize(weed_plant_t *, boolean sterilize);
 
 // internal values
 #define WEED_LEAF_HOST_AUDIO_PLAYER "host_audio_player" // exported to plugins
+#define WEED_LEAF_HOST_AARENA "host_aarena" // int64, id of the audio arena which the channel's reader belongs to
+#define WEED_LEAF_HOST_AREADER "host_areader" // int, reader index in the audio arena
+#define WEED_LEAF_HOST_AREADER_GEN "host_areader_gen" // int64, generation of the reader slot when it was claimed
+#define WEED_LEAF_HOST_AARENA_REF "host_aarena_ref" // boolean, channel holds an arena reference until its audio is released
+
+// host spectral analysis, exported to plugins: an audio in chantmpl with host_spectrum_req set to WEED_TRUE
+// will have the remaining leaves set in the channel, computed once per audio packet (see audio.c)
+// the window applied is the one requested by host_spectrum_window in the chantmpl (default none)
+#define WEED_LEAF_HOST_SPECTRUM_REQ "host_spectrum_req" // boolean, set in chantmpl by plugin
+#define WEED_LEAF_HOST_SPECTRUM_WINDOW "host_spectrum_window" // int, set in chantmpl by plugin, and in channel by host
+#define WEED_LEAF_HOST_SPECTRUM "host_spectrum" // double array, magnitudes for bins 0 -> size / 2, averaged over chans
+#define WEED_LEAF_HOST_SPECTRUM_SIZE "host_spectrum_size" // int, FFT size
+#define WEED_LEAF_HOST_BAND_ENERGIES "host_band_energies" // double array, mean power per log spaced band
+#define WEED_LEAF_HOST_BAND_FREQS "host_band_freqs" // double array, upper frequency (Hz) of each band
+
+// values for WEED_LEAF_HOST_SPECTRUM_WINDOW
+#define HOST_SPECTRUM_WINDOW_NONE 0
+#define HOST_SPECTRUM_WINDOW_HAMMING 1
+#define N_HOST_SPECTRUM_WINDOWS 2
+
+/// the layer holds one spectrum per requested window, under keys made by this
+const char *host_spectrum_layer_key(char *buf, size_t buflen, const char *key, int window);
 
 #define WEED_LEAF_HOST_ORIG_PDATA "host_orig_pdata" // set if we "steal" an alpha channel to chain
 #define WEED_LEAF_HOST_MENU_HIDE "host_menu_hide" // hide from menus
@@ -120,6 +142,11 @@ void weed_plant_sanitize(weed_plant_t *, boolean sterilize);
 
 #define LIVES_LEAF_NOQUANT "host_noquant"
 
+// cached position in the param change chain of an in param, see interpolate_param()
+#define LIVES_LEAF_PCHAIN_HEAD "host_pchain_head"
+#define LIVES_LEAF_PCHAIN_CURSOR "host_pchain_cursor"
+#define LIVES_LEAF_PCHAIN_GEN "host_pchain_gen"
+
 // compound plugins
 #define WEED_LEAF_HOST_INTERNAL_CONNECTION "host_internal_connection" // for chain plugins
 #define WEED_LEAF_HOST_INTERNAL_CONNECTION_AUTOSCALE "host_internal_connection_autoscale" // for chain plugins
@@ -174,6 +201,7 @@ boolean has_audio_chans_out(weed_filter_t *, boolean count_opt);
 boolean is_pure_audio(weed_plant_t *filter_or_instance, boolean count_opt); ///< TRUE if audio in or out and no vid in/out
 
 boolean has_video_filters(boolean analysers_only);
+int has_spectrum_analysers(void); ///< returns a bitmap of (1 << window) for the windows requested
 
 #ifdef HAS_LIVES_EFFECTS_H
 lives_fx_cat_t weed_filter_categorise(weed_plant_t *, int in_channels, int out_channels);
@@ -272,9 +300,11 @@ void weed_apply_audio_effects(weed_plant_t *filter_map, weed_layer_t **, int nbt
 
 void weed_apply_audio_effects_rt(weed_layer_t *alayer, ticks_t tc, boolean analysers_only, boolean is_audio_thread);
 
-boolean fill_audio_channel(weed_filter_t *filter, weed_plant_t *achan, boolean is_vid);
-int register_audio_client(boolean is_vid);
-int unregister_audio_client(boolean is_vid);
+boolean fill_audio_channel(weed_filter_t *filter, weed_plant_t *achan);
+void release_audio_channel(weed_plant_t *achan);
+void release_audio_reader(weed_plant_t *achan);
+int register_audio_client(weed_plant_t *achan);
+int unregister_audio_client(weed_plant_t *achan);
 
 int register_aux_audio_channels(int nchannels);
 int unregister_aux_audio_channels(int nchannels);
@@ -293,6 +323,9 @@ void wge_inner(weed_instance_t *inst); ///< deinit and instance(s) for generator
 // layers
 lives_filter_error_t lives_layer_fill_from_generator(weed_layer_t *, weed_instance_t *, weed_timecode_t tc);
 
+/// as above, but always renders for tc, rather than the player clock; used for rendering ahead, see genqueue.h
+lives_filter_error_t lives_layer_fill_from_generator_at(weed_layer_t *, weed_instance_t *, weed_timecode_t tc);
+
 /// for multitrack
 void backup_weed_instances(void);
 void restore_weed_instances(void);
@@ -16,6 +16,8 @@
 #include "cvirtual.h"
 #include "startup.h"
 #include "rfx-builder.h"
+#include "segrender.h"
+#include "fmapplan.h"
 #ifdef LIBAV_TRANSCODE
 #include "transcode.h"
 #endif
@@ -88,7 +90,14 @@ LIVES_GLOBAL_INLINE int weed_frame_event_get_audio_tracks(weed_event_t *event,
   return xntracks;
 }
 
+static void evindex_invalidate(void);
+
 LIVES_GLOBAL_INLINE weed_error_t weed_event_set_timecode(weed_event_t *event, weed_timecode_t tc) {
+  // moving a linked event invalidates the timecode index
+  if (get_prev_event(event) || get_next_event(event)) {
+    evindex_invalidate();
+    event_changed(event);
+  }
   return weed_set_int64_value(event, WEED_LEAF_TIMECODE, tc);
 }
 
@@ -99,6 +108,385 @@ LIVES_GLOBAL_INLINE weed_timecode_t weed_event_get_timecode(weed_event_t *event)
 
 LIVES_PURE void ** *get_event_pchains(void) {return pchains;}
 
+/////////////// timecode index ////////////////
+//
+// frame events and filter maps are kept in skip lists ordered as in the event_list (and therefore by timecode),
+// so that the get_*_at / before / after lookups can jump straight to the right place instead of walking the list
+// the index is maintained by the insert / unlink functions; code which relinks events or changes the timecode of
+// a linked event directly must call event_list_index_invalidate(), and the index will then be rebuilt lazily
+// if the list is found not to be in timecode order, the index is marked unusable and lookups fall back to the walk
+
+#define EVINDEX_MAX_LEVEL 24
+#define EVINDEX_MAX_WALK 256 // max events to walk when locating the index for an event
+#define EVINDEX_STALE_HITS 2 // lookups on a stale index before we rebuild it
+
+#define EVINDEX_CLASS_FRAME 0
+#define EVINDEX_CLASS_FMAP 1
+#define EVINDEX_NCLASSES 2
+
+typedef struct _evindex_node lives_evindex_node_t;
+
+struct _evindex_node {
+  weed_event_t *event;
+  weed_timecode_t tc;
+  lives_evindex_node_t *prev; // level 0 only
+  int level;
+  lives_evindex_node_t *next[];
+};
+
+typedef struct {
+  lives_evindex_node_t *head;
+  int level;
+} lives_evindex_list_t;
+
+typedef struct {
+  weed_event_list_t *event_list;
+  uint64_t gen;
+  int stale_hits;
+  boolean usable;
+  lives_evindex_list_t lists[EVINDEX_NCLASSES];
+} lives_event_index_t;
+
+static LiVESList *evindexes = NULL;
+static uint64_t evindex_gen = 1;
+static pthread_mutex_t evindex_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// bumped whenever a param change may have been added, removed or moved, (or an event list freed)
+// so that any cached positions in param change chains can be discarded, see interpolate_param()
+static volatile uint64_t pchange_gen = 1;
+
+// likewise for filter maps and filter inits, see fmapplan.c
+static volatile uint64_t fmap_gen = 1;
+
+static lives_event_watch_f evwatch_func = NULL;
+static void *evwatch_data = NULL;
+static pthread_mutex_t evwatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+void event_list_watch(lives_event_watch_f func, void *data) {
+  // once this returns, the previous watcher will not be called again
+  pthread_mutex_lock(&evwatch_mutex);
+  evwatch_func = func;
+  evwatch_data = data;
+  pthread_mutex_unlock(&evwatch_mutex);
+}
+
+
+static void evwatch_notify(weed_event_list_t *event_list, weed_event_t *event, int what) {
+  if (!evwatch_func) return;
+  pthread_mutex_lock(&evwatch_mutex);
+  if (evwatch_func) (*evwatch_func)(evwatch_data, event_list, event, what);
+  pthread_mutex_unlock(&evwatch_mutex);
+}
+
+
+LIVES_GLOBAL_INLINE void event_changed(weed_event_t *event) {
+  if (event) evwatch_notify(NULL, event, EVENT_WATCH_CHANGED);
+}
+
+
+LIVES_LOCAL_INLINE int evindex_class(weed_event_t *event) {
+  if (WEED_EVENT_IS_FRAME(event)) return EVINDEX_CLASS_FRAME;
+  if (WEED_EVENT_IS_FILTER_MAP(event)) return EVINDEX_CLASS_FMAP;
+  return -1;
+}
+
+
+static lives_evindex_node_t *evnode_new(weed_event_t *event, weed_timecode_t tc, int level) {
+  lives_evindex_node_t *node = lives_calloc(1, sizeof(lives_evindex_node_t) + level * sizeof(lives_evindex_node_t *));
+  node->event = event;
+  node->tc = tc;
+  node->level = level;
+  return node;
+}
+
+
+static void evlist_clear(lives_evindex_list_t *sl) {
+  lives_evindex_node_t *node, *next;
+  if (!sl->head) {
+    sl->head = evnode_new(NULL, 0, EVINDEX_MAX_LEVEL);
+    sl->level = 1;
+    return;
+  }
+  for (node = sl->head->next[0]; node; node = next) {
+    next = node->next[0];
+    lives_free(node);
+  }
+  lives_memset(sl->head->next, 0, EVINDEX_MAX_LEVEL * sizeof(lives_evindex_node_t *));
+  sl->level = 1;
+}
+
+
+LIVES_LOCAL_INLINE int evlist_random_level(void) {
+  // p = 1/4
+  uint64_t r = fastrand();
+  int level = 1;
+  while (level < EVINDEX_MAX_LEVEL && !(r & 3)) {
+    level++;
+    r >>= 2;
+  }
+  return level;
+}
+
+
+static lives_evindex_node_t *evlist_find_lt(lives_evindex_list_t *sl, weed_timecode_t tc,
+    lives_evindex_node_t **update) {
+  // return the last node with timecode < tc, or head if there is none
+  // if update is non-NULL, it is filled with the predecessor at each level
+  lives_evindex_node_t *node = sl->head;
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (node->next[i] && node->next[i]->tc < tc) node = node->next[i];
+    if (update) update[i] = node;
+  }
+  return node;
+}
+
+
+static lives_evindex_node_t *evlist_find_node(lives_evindex_list_t *sl, weed_event_t *event, weed_timecode_t tc,
+    lives_evindex_node_t **update) {
+  // locate the node for event, which must have timecode tc; update receives its predecessors
+  lives_evindex_node_t *node = evlist_find_lt(sl, tc, update);
+  for (node = node->next[0]; node && node->tc == tc; node = node->next[0]) {
+    if (node->event == event) return node;
+    for (int i = 0; i < node->level; i++) update[i] = node;
+  }
+  return NULL;
+}
+
+
+static void evlist_insert(lives_evindex_list_t *sl, lives_evindex_node_t **update, weed_event_t *event,
+                          weed_timecode_t tc) {
+  // insert a node for event after the predecessors in update
+  int level = evlist_random_level();
+  lives_evindex_node_t *node = evnode_new(event, tc, level);
+  if (level > sl->level) {
+    for (int i = sl->level; i < level; i++) update[i] = sl->head;
+    sl->level = level;
+  }
+  for (int i = 0; i < level; i++) {
+    node->next[i] = update[i]->next[i];
+    update[i]->next[i] = node;
+  }
+  if (update[0] != sl->head) node->prev = update[0];
+  if (node->next[0]) node->next[0]->prev = node;
+}
+
+
+static void evlist_remove(lives_evindex_list_t *sl, lives_evindex_node_t *node, lives_evindex_node_t **update) {
+  for (int i = 0; i < node->level; i++) update[i]->next[i] = node->next[i];
+  if (node->next[0]) node->next[0]->prev = node->prev;
+  while (sl->level > 1 && !sl->head->next[sl->level - 1]) sl->level--;
+  lives_free(node);
+}
+
+
+static void evindex_build(lives_event_index_t *idx) {
+  lives_evindex_node_t *tails[EVINDEX_NCLASSES][EVINDEX_MAX_LEVEL];
+  weed_timecode_t tc, last_tc = 0;
+  int cls;
+
+  for (cls = 0; cls < EVINDEX_NCLASSES; cls++) {
+    evlist_clear(&idx->lists[cls]);
+    for (int i = 0; i < EVINDEX_MAX_LEVEL; i++) tails[cls][i] = idx->lists[cls].head;
+  }
+  idx->usable = TRUE;
+  idx->stale_hits = 0;
+  idx->gen = evindex_gen;
+
+  for (weed_event_t *event = get_first_event(idx->event_list); event; event = get_next_event(event)) {
+    tc = get_event_timecode(event);
+    if (tc < last_tc) {
+      // out of order list, we cannot use the index
+      idx->usable = FALSE;
+      for (cls = 0; cls < EVINDEX_NCLASSES; cls++) evlist_clear(&idx->lists[cls]);
+      return;
+    }
+    last_tc = tc;
+    if ((cls = evindex_class(event)) < 0) continue;
+    evlist_insert(&idx->lists[cls], tails[cls], event, tc);
+    // we are appending, so the new node becomes the tail at each of its levels
+    for (int i = 0; i < EVINDEX_MAX_LEVEL && tails[cls][i]->next[i]; i++) tails[cls][i] = tails[cls][i]->next[i];
+  }
+}
+
+
+static void evindex_free(lives_event_index_t *idx) {
+  for (int cls = 0; cls < EVINDEX_NCLASSES; cls++) {
+    evlist_clear(&idx->lists[cls]);
+    lives_free(idx->lists[cls].head);
+  }
+  lives_free(idx);
+}
+
+
+static lives_event_index_t *evindex_find(weed_event_list_t *event_list) {
+  for (LiVESList *list = evindexes; list; list = list->next) {
+    lives_event_index_t *idx = (lives_event_index_t *)list->data;
+    if (idx->event_list == event_list) return idx;
+  }
+  return NULL;
+}
+
+
+static lives_event_index_t *get_event_index(weed_event_list_t *event_list) {
+  // return a current, usable index for event_list, or NULL if the caller should walk the list
+  // must be called with evindex_mutex locked
+  lives_event_index_t *idx = evindex_find(event_list);
+  if (!idx) {
+    idx = (lives_event_index_t *)lives_calloc(1, sizeof(lives_event_index_t));
+    idx->event_list = event_list;
+    evindexes = lives_list_prepend(evindexes, idx);
+  }
+  if (idx->gen != evindex_gen) {
+    // if the list is being edited directly, rebuilding on every lookup would be slower than just walking it
+    if (++idx->stale_hits < EVINDEX_STALE_HITS) return NULL;
+    evindex_build(idx);
+  } else if (idx->usable) {
+    // guard against an event_list being freed elsewhere and its address reused
+    lives_evindex_node_t *first = idx->lists[EVINDEX_CLASS_FRAME].head->next[0];
+    if ((first ? first->event : NULL) != get_first_frame_event(event_list)) evindex_build(idx);
+  }
+  return idx->usable ? idx : NULL;
+}
+
+
+static lives_event_index_t *evindex_for_event(weed_event_t *event, boolean *known) {
+  // find the current index (if any) for the event_list containing event
+  // we locate a nearby frame event then check if any index holds it
+  // if *known is set FALSE, we could not tell
+  weed_event_t *frame = event;
+  int count = 0;
+  *known = TRUE;
+  if (!evindexes) return NULL;
+  while (frame && !WEED_EVENT_IS_FRAME(frame) && ++count < EVINDEX_MAX_WALK) frame = get_prev_event(frame);
+  if (!frame || !WEED_EVENT_IS_FRAME(frame)) {
+    for (frame = event, count = 0; frame && !WEED_EVENT_IS_FRAME(frame) && ++count < EVINDEX_MAX_WALK;
+         frame = get_next_event(frame));
+    if (!frame || !WEED_EVENT_IS_FRAME(frame)) {
+      *known = FALSE;
+      return NULL;
+    }
+  }
+  for (LiVESList *list = evindexes; list; list = list->next) {
+    lives_event_index_t *idx = (lives_event_index_t *)list->data;
+    lives_evindex_node_t *update[EVINDEX_MAX_LEVEL];
+    if (idx->gen != evindex_gen || !idx->usable) continue;
+    if (evlist_find_node(&idx->lists[EVINDEX_CLASS_FRAME], frame, get_event_timecode(frame), update)) return idx;
+  }
+  return NULL;
+}
+
+
+static boolean evindex_add(lives_event_index_t *idx, weed_event_t *event) {
+  // event has just been linked into the list covered by idx; returns FALSE if the index can no longer be used
+  lives_evindex_node_t *update[EVINDEX_MAX_LEVEL], *pnode;
+  lives_evindex_list_t *sl;
+  weed_event_t *prev = get_prev_event(event), *next = get_next_event(event);
+  weed_timecode_t tc = get_event_timecode(event);
+  int cls;
+
+  if ((prev && get_event_timecode(prev) > tc) || (next && get_event_timecode(next) < tc)) return FALSE;
+  if ((cls = evindex_class(event)) < 0) return TRUE;
+  sl = &idx->lists[cls];
+
+  // the nearest preceding event of the same class at the same timecode, if any, will be the node before ours
+  for (; prev && get_event_timecode(prev) == tc; prev = get_prev_event(prev)) if (evindex_class(prev) == cls) break;
+  if (prev && get_event_timecode(prev) == tc) {
+    if (!(pnode = evlist_find_node(sl, prev, tc, update))) return FALSE;
+    for (int i = 0; i < pnode->level; i++) update[i] = pnode;
+  } else evlist_find_lt(sl, tc, update);
+
+  evlist_insert(sl, update, event, tc);
+  return TRUE;
+}
+
+
+static boolean evindex_remove(lives_event_index_t *idx, weed_event_t *event) {
+  lives_evindex_node_t *update[EVINDEX_MAX_LEVEL], *node;
+  lives_evindex_list_t *sl;
+  int cls = evindex_class(event);
+  if (cls < 0) return TRUE;
+  sl = &idx->lists[cls];
+  if (!(node = evlist_find_node(sl, event, get_event_timecode(event), update))) return FALSE;
+  evlist_remove(sl, node, update);
+  return TRUE;
+}
+
+
+static void evindex_linked(weed_event_list_t *event_list, weed_event_t *event) {
+  // event was just linked into event_list (which may be NULL if unknown)
+  lives_event_index_t *idx;
+  boolean known = TRUE;
+  pthread_mutex_lock(&evindex_mutex);
+  if (event_list) idx = evindex_find(event_list);
+  else {
+    // event itself is not in the index yet, so we have to search from a neighbour
+    weed_event_t *nevent = get_prev_event(event);
+    idx = evindex_for_event(nevent ? nevent : get_next_event(event), &known);
+  }
+  if (!known) evindex_gen++;
+  else if (idx && idx->gen == evindex_gen && idx->usable && !evindex_add(idx, event)) idx->gen = 0;
+  if (WEED_EVENT_IS_PARAM_CHANGE(event)) pchange_gen++;
+  else if (WEED_EVENT_IS_FILTER_MAP(event) || WEED_EVENT_IS_FILTER_INIT(event)) fmap_gen++;
+  pthread_mutex_unlock(&evindex_mutex);
+  evwatch_notify(event_list, event, EVENT_WATCH_CHANGED);
+}
+
+
+static void evindex_unlinked(weed_event_list_t *event_list, weed_event_t *event) {
+  lives_event_index_t *idx;
+  pthread_mutex_lock(&evindex_mutex);
+  idx = evindex_find(event_list);
+  if (idx && idx->gen == evindex_gen && idx->usable && !evindex_remove(idx, event)) idx->gen = 0;
+  if (WEED_EVENT_IS_PARAM_CHANGE(event)) pchange_gen++;
+  else if (WEED_EVENT_IS_FILTER_MAP(event) || WEED_EVENT_IS_FILTER_INIT(event)) fmap_gen++;
+  pthread_mutex_unlock(&evindex_mutex);
+  evwatch_notify(event_list, event, EVENT_WATCH_UNLINKED);
+}
+
+
+static void evindex_invalidate(void) {
+  pthread_mutex_lock(&evindex_mutex);
+  evindex_gen++;
+  pchange_gen++;
+  pthread_mutex_unlock(&evindex_mutex);
+}
+
+
+void event_list_index_invalidate(void) {
+  evindex_invalidate();
+  // we cannot tell which events were relinked
+  evwatch_notify(NULL, NULL, EVENT_WATCH_UNKNOWN);
+}
+
+
+void event_list_fmaps_changed(void) {
+  // must be called after changing the init_events of a linked filter map, or the tracks of a linked filter init
+  pthread_mutex_lock(&evindex_mutex);
+  fmap_gen++;
+  pthread_mutex_unlock(&evindex_mutex);
+}
+
+
+void event_list_index_drop(weed_event_list_t *event_list) {
+  lives_event_index_t *idx;
+  pthread_mutex_lock(&evindex_mutex);
+  if ((idx = evindex_find(event_list)) != NULL) {
+    evindexes = lives_list_remove(evindexes, idx);
+    evindex_free(idx);
+  }
+  pchange_gen++;
+  fmap_gen++;
+  pthread_mutex_unlock(&evindex_mutex);
+  evwatch_notify(event_list, NULL, EVENT_WATCH_UNKNOWN);
+}
+
+
+uint64_t event_pchange_gen(void) {return pchange_gen;}
+
+uint64_t event_fmap_gen(void) {return fmap_gen;}
+
+
 #define _get_or_zero(a, b, c) (a ? weed_get_##b##_value(a, c, NULL) : 0)
 
 LIVES_GLOBAL_INLINE weed_timecode_t get_event_timecode(weed_plant_t *plant) {
@@ -136,6 +524,19 @@ boolean has_frame_event_at(weed_event_list_t *event_list, weed_timecode_t tc, we
   weed_plant_t *event;
   weed_timecode_t ev_tc;
 
+  if (!shortcut || !*shortcut || get_event_timecode(*shortcut) < tc) {
+    lives_event_index_t *idx;
+    pthread_mutex_lock(&evindex_mutex);
+    if ((idx = get_event_index(event_list)) != NULL) {
+      lives_evindex_node_t *node = evlist_find_lt(&idx->lists[EVINDEX_CLASS_FRAME], tc, NULL)->next[0];
+      event = (node && node->tc == tc) ? node->event : NULL;
+      pthread_mutex_unlock(&evindex_mutex);
+      if (event && shortcut) *shortcut = event;
+      return event != NULL;
+    }
+    pthread_mutex_unlock(&evindex_mutex);
+  }
+
   if (!shortcut || !*shortcut) event = get_first_frame_event(event_list);
   else event = *shortcut;
 
@@ -303,6 +704,8 @@ void unlink_event(weed_event_list_t *event_list, weed_plant_t *event) {
   weed_plant_t *prev_event = get_prev_event(event);
   weed_plant_t *next_event = get_next_event(event);
 
+  evindex_unlinked(event_list, event);
+
   if (prev_event) weed_set_voidptr_value(prev_event, WEED_LEAF_NEXT, next_event);
   if (next_event) weed_set_voidptr_value(next_event, WEED_LEAF_PREVIOUS, prev_event);
 
@@ -328,6 +731,7 @@ boolean insert_event_before(weed_plant_t *at_event, weed_plant_t *event) {
   weed_set_voidptr_value(event, WEED_LEAF_NEXT, at_event);
   weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, xevent);
   weed_set_voidptr_value(at_event, WEED_LEAF_PREVIOUS, event);
+  evindex_linked(NULL, event);
   if (get_event_timecode(event) > get_event_timecode(at_event))
     lives_printerr("Warning ! Inserted out of order event type %d before %d\n", get_event_type(event), get_event_type(at_event));
   return (xevent != NULL);
@@ -341,6 +745,7 @@ boolean insert_event_after(weed_plant_t *at_event, weed_plant_t *event) {
   weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, at_event);
   weed_set_voidptr_value(event, WEED_LEAF_NEXT, xevent);
   weed_set_voidptr_value(at_event, WEED_LEAF_NEXT, event);
+  evindex_linked(NULL, event);
   if (get_event_timecode(event) < get_event_timecode(at_event))
     lives_printerr("Warning ! Inserted out of order event type %d after %d\n", get_event_type(event), get_event_type(at_event));
   return (xevent != NULL);
@@ -666,7 +1071,8 @@ weed_event_list_t *event_copy_and_insert(weed_event_t *in_event, weed_timecode_t
   }
 
   event = weed_plant_copy(in_event);
-  weed_event_set_timecode(event, out_tc);
+  // the copy is not linked yet, so we set the leaf directly rather than invalidating the index
+  weed_set_int64_value(event, WEED_LEAF_TIMECODE, out_tc);
 
   // need to repoint our avol_init_event
   if (mainw->multitrack) mt_fixup_events(mainw->multitrack, in_event, event);
@@ -693,6 +1099,8 @@ weed_event_list_t *event_copy_and_insert(weed_event_t *in_event, weed_timecode_t
   else error = weed_set_voidptr_value(event_after, WEED_LEAF_PREVIOUS, event);
   if (error == WEED_ERROR_MEMORY_ALLOCATION) return NULL;
 
+  evindex_linked(event_list, event);
+
   etype = get_event_type(in_event);
   switch (etype) {
   case WEED_EVENT_TYPE_FILTER_INIT:
@@ -730,6 +1138,7 @@ weed_event_list_t *event_copy_and_insert(weed_event_t *in_event, weed_timecode_t
     weed_leaf_delete((weed_plant_t *)new_init_event,
                      WEED_LEAF_DEINIT_EVENT); // delete since we assign a placeholder with int64 type
     weed_set_plantptr_value((weed_plant_t *)new_init_event, WEED_LEAF_DEINIT_EVENT, event);
+    event_changed((weed_event_t *)new_init_event);
     if (error == WEED_ERROR_MEMORY_ALLOCATION) return NULL;
     break;
   case WEED_EVENT_TYPE_FILTER_MAP:
@@ -793,8 +1202,25 @@ weed_event_t *get_frame_event_at(weed_event_list_t *event_list, weed_timecode_t
   // if exact is FALSE, we can get a frame event just after tc
   weed_event_t *event, *next_event;
   weed_timecode_t xtc, next_tc = 0;
+  lives_event_index_t *idx;
 
   if (!event_list) return NULL;
+
+  pthread_mutex_lock(&evindex_mutex);
+  if ((idx = get_event_index(event_list)) != NULL) {
+    // no event before the last frame more than 10 ticks before tc can match, so start from there
+    // (or from the first frame if there is none)
+    lives_evindex_list_t *sl = &idx->lists[EVINDEX_CLASS_FRAME];
+    lives_evindex_node_t *node = evlist_find_lt(sl, tc - 10, NULL);
+    if (node == sl->head) node = node->next[0];
+    if (!node) {
+      pthread_mutex_unlock(&evindex_mutex);
+      return NULL;
+    }
+    if (!shortcut || get_event_timecode(shortcut) < node->tc) shortcut = node->event;
+  }
+  pthread_mutex_unlock(&evindex_mutex);
+
   if (shortcut) event = shortcut;
   else event = get_first_frame_event(event_list);
   while (event) {
@@ -830,38 +1256,61 @@ weed_event_t *get_frame_event_at_or_before(weed_event_list_t *event_list, weed_t
 }
 
 
-weed_event_t *get_filter_map_after(weed_event_t *event, int ctrack) {
-  // get filter_map following event; if ctrack!=LIVES_TRACK_ANY then we ignore filter maps with no in_track/out_track == ctrack
+static boolean filter_map_is_relevant(weed_event_t *fmap, int ctrack) {
+  // TRUE if fmap has an init_event with in_track / out_track ctrack, or ctrack is LIVES_TRACK_ANY
   void **init_events;
-  weed_event_t *init_event;
   int num_init_events;
 
-  while (event) {
-    if (WEED_EVENT_IS_FILTER_MAP(event)) {
-      if (ctrack == LIVES_TRACK_ANY) return event;
-      if (!weed_plant_has_leaf(event, WEED_LEAF_INIT_EVENTS)) {
-        event = get_next_event(event);
-        continue;
-      }
-      init_events = weed_get_voidptr_array_counted(event, WEED_LEAF_INIT_EVENTS, &num_init_events);
-      if (!init_events[0]) {
-        lives_free(init_events);
-        event = get_next_event(event);
-        continue;
-      }
-      for (int i = 0; i < num_init_events; i++) {
-        init_event = (weed_event_t *)init_events[i];
+  if (ctrack == LIVES_TRACK_ANY) return TRUE;
+  if (!weed_plant_has_leaf(fmap, WEED_LEAF_INIT_EVENTS)) return FALSE;
+  init_events = weed_get_voidptr_array_counted(fmap, WEED_LEAF_INIT_EVENTS, &num_init_events);
+  if (!num_init_events || !init_events[0]) {
+    lives_freep((void **)&init_events);
+    return FALSE;
+  }
+  for (int i = 0; i < num_init_events; i++) {
+    if (init_event_is_relevant((weed_event_t *)init_events[i], ctrack)) {
+      lives_free(init_events);
+      return TRUE;
+    }
+  }
+  lives_free(init_events);
+  return FALSE;
+}
 
-        if (init_event_is_relevant(init_event, ctrack)) {
-          lives_free(init_events);
-          return event;
-        }
 
+weed_event_t *get_filter_map_after(weed_event_t *event, int ctrack) {
+  // get filter_map following event; if ctrack!=LIVES_TRACK_ANY then we ignore filter maps with no in_track/out_track == ctrack
+  lives_event_index_t *idx;
+  lives_evindex_node_t *node = NULL;
+  weed_timecode_t tc;
+  boolean known;
+
+  if (!event) return NULL;
+  tc = get_event_timecode(event);
+
+  // events at the same timecode are checked in place, after that we can jump from one filter map to the next
+  for (; event && get_event_timecode(event) == tc; event = get_next_event(event))
+    if (WEED_EVENT_IS_FILTER_MAP(event) && filter_map_is_relevant(event, ctrack)) return event;
+  if (!event) return NULL;
+
+  pthread_mutex_lock(&evindex_mutex);
+  if ((idx = evindex_for_event(event, &known)) != NULL) {
+    // the nodes are freed if another thread rebuilds the index, so we keep the mutex until we are done with them
+    weed_event_t *fmap = NULL;
+    for (node = evlist_find_lt(&idx->lists[EVINDEX_CLASS_FMAP], tc + 1, NULL)->next[0]; node; node = node->next[0]) {
+      if (filter_map_is_relevant(node->event, ctrack)) {
+        fmap = node->event;
+        break;
       }
-      lives_freep((void **)&init_events);
     }
-    event = get_next_event(event);
+    pthread_mutex_unlock(&evindex_mutex);
+    return fmap;
   }
+  pthread_mutex_unlock(&evindex_mutex);
+
+  for (; event; event = get_next_event(event))
+    if (WEED_EVENT_IS_FILTER_MAP(event) && filter_map_is_relevant(event, ctrack)) return event;
   return NULL;
 }
 
@@ -907,32 +1356,56 @@ weed_event_t *get_filter_map_before(weed_event_t *event, int ctrack, weed_event_
 
   // we will stop searching when we reach stop_event; if it is NULL we will search back to
   // start of event list
+  lives_event_index_t *idx;
+  lives_evindex_node_t *node = NULL;
+  weed_timecode_t tc, stc = 0;
+  boolean known;
 
-  void **init_events;
-  weed_event_t *init_event;
-  int num_init_events;
-
-  for (; event != stop_event && event; event = get_prev_event(event)) {
-    if (WEED_EVENT_IS_FILTER_MAP(event)) {
-      if (ctrack == LIVES_TRACK_ANY) return event;
-      if (!weed_plant_has_leaf(event, WEED_LEAF_INIT_EVENTS)) {
-        continue;
-      }
-      init_events = weed_get_voidptr_array_counted(event, WEED_LEAF_INIT_EVENTS, &num_init_events);
-      if (!num_init_events || !init_events[0]) {
-        lives_freep((void **)&init_events);
-        continue;
-      }
-      for (int i = 0; i < num_init_events; i++) {
-        init_event = (weed_event_t *)init_events[i];
-        if (init_event_is_relevant(init_event, ctrack)) {
-          lives_free(init_events);
-          return event;
+  if (!event || event == stop_event) return event;
+  tc = get_event_timecode(event);
+  if (stop_event) stc = get_event_timecode(stop_event);
+
+  for (; event != stop_event && event && get_event_timecode(event) == tc; event = get_prev_event(event))
+    if (WEED_EVENT_IS_FILTER_MAP(event) && filter_map_is_relevant(event, ctrack)) return event;
+  if (event == stop_event || !event) return event;
+
+  pthread_mutex_lock(&evindex_mutex);
+  if ((idx = evindex_for_event(event, &known)) != NULL) {
+    // as in get_filter_map_after(), the mutex is held for as long as we use the nodes
+    lives_evindex_list_t *sl = &idx->lists[EVINDEX_CLASS_FMAP];
+    weed_event_t *found = NULL;
+    node = evlist_find_lt(sl, tc, NULL);
+    if (node == sl->head) node = NULL;
+
+    // event is the last event before tc; everything after it has been checked
+    // jump back through the filter maps, checking if stop_event lies in each gap
+    for (; node; node = node->prev) {
+      if (stop_event) {
+        if (stop_event == node->event) {
+          found = stop_event;
+          break;
         }
+        // with equal timecodes we cannot tell which comes first, so walk from here
+        if (stc == node->tc) break;
+        if (stc > node->tc && stc < tc) {
+          found = stop_event;
+          break;
+        }
+      }
+      if (filter_map_is_relevant(node->event, ctrack)) {
+        found = node->event;
+        break;
       }
-      lives_freep((void **)&init_events);
+      tc = node->tc;
+      event = get_prev_event(node->event);
     }
-  }
+    pthread_mutex_unlock(&evindex_mutex);
+    if (found) return found;
+    if (!node) return (stop_event && stc < tc) ? stop_event : NULL;
+  } else pthread_mutex_unlock(&evindex_mutex);
+
+  for (; event != stop_event && event; event = get_prev_event(event))
+    if (WEED_EVENT_IS_FILTER_MAP(event) && filter_map_is_relevant(event, ctrack)) return event;
   return event;
 }
 
@@ -943,7 +1416,8 @@ weed_event_t **get_init_events_before(weed_event_t *event, weed_event_t *init_ev
   int error, num_init_events = 0;
   int i, j = 0;
 
-  while (event) {
+  for (event = get_filter_map_before(event, LIVES_TRACK_ANY, NULL); event;
+       event = get_filter_map_before(get_prev_event(event), LIVES_TRACK_ANY, NULL)) {
     if (WEED_EVENT_IS_FILTER_MAP(event)) {
       if ((init_events =
              (weed_event_t **)weed_get_voidptr_array_counted(event, WEED_LEAF_INIT_EVENTS, &num_init_events)) != NULL) {
@@ -996,7 +1470,6 @@ weed_event_t **get_init_events_before(weed_event_t *event, weed_event_t *init_ev
       }
       if (init_events) lives_free(init_events);
     }
-    event = get_prev_event(event);
   }
   // no previous init_events found
   if (add) {
@@ -1190,6 +1663,7 @@ weed_event_list_t *insert_frame_event_at(weed_event_list_t *event_list, weed_tim
     while (event && (((xtc = get_event_timecode(event)) < tc) || (xtc == tc && (!WEED_EVENT_IS_FILTER_DEINIT(event))))) {
       if (shortcut) *shortcut = event;
       if (xtc == tc && WEED_EVENT_IS_FRAME(event)) {
+        event_changed(event);
         error = weed_set_int_array(event, WEED_LEAF_CLIPS, numframes, clips);
         if (error == WEED_ERROR_MEMORY_ALLOCATION) return NULL;
         error = weed_set_int64_array(event, WEED_LEAF_FRAMES, numframes, frames);
@@ -1241,6 +1715,8 @@ weed_event_list_t *insert_frame_event_at(weed_event_list_t *event_list, weed_tim
     if (error == WEED_ERROR_MEMORY_ALLOCATION) return NULL;
   }
 
+  evindex_linked(event_list, new_event);
+
   weed_plant_free(new_event_list);
 
   if (shortcut) *shortcut = new_event;
@@ -1256,6 +1732,8 @@ void insert_audio_event_at(weed_event_t *event, int track, int clipnum, double s
 
   arv = (double)(myround(vel * 10000.)) / 10000.;
 
+  event_changed(event);
+
   if (WEED_EVENT_IS_AUDIO_FRAME(event)) {
     int *aclips = NULL, i;
     double *aseeks = NULL;
@@ -1363,6 +1841,8 @@ void remove_audio_for_track(weed_event_t *event, int track) {
 
   int j = 0;
 
+  event_changed(event);
+
   for (int i = 0; i < num_atracks; i += 2) {
     if (aclip_index[i] == track) continue;
     new_aclip_index[j] = aclip_index[i];
@@ -1405,6 +1885,7 @@ static weed_error_t set_event_ptrs(weed_event_list_t *event_list, weed_event_t *
     if (error != WEED_SUCCESS) return error;
   }
   error = weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+  if (error == WEED_SUCCESS) evindex_linked(event_list, event);
   return error;
 }
 
@@ -1469,6 +1950,7 @@ weed_plant_t *insert_marker_event_at(weed_event_list_t *event_list, weed_plant_t
         }
         new_tracks[i] = LIVES_POINTER_TO_INT(data); // add new track
         weed_set_int_array(at_event, WEED_LEAF_TRACKS, num_tracks + 1, new_tracks);
+        event_changed(at_event);
         lives_free(new_tracks);
         lives_free(tracks);
         weed_plant_free(event); // new event not used
@@ -1520,6 +2002,8 @@ void remove_filter_from_event_list(weed_event_list_t *event_list, weed_event_t *
       for (i = 0; new_init_events[i]; i++);
       if (i == 0) weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENTS, NULL);
       else weed_set_voidptr_array(event, WEED_LEAF_INIT_EVENTS, i, (void **)new_init_events);
+      event_list_fmaps_changed();
+      event_changed(event);
       lives_free(new_init_events);
 
       if ((!filter_map && i == 0) || (filter_map && compare_filter_maps(filter_map, event, LIVES_TRACK_ANY)))
@@ -1564,6 +2048,8 @@ static boolean remove_event_from_filter_map(weed_plant_t *fmap, weed_event_t *ev
 
   if (j == 0 || (j == 1 && (!event || !init_events[0]))) weed_set_voidptr_value(fmap, WEED_LEAF_INIT_EVENTS, NULL);
   else weed_set_voidptr_array(fmap, WEED_LEAF_INIT_EVENTS, j, new_init_events);
+  event_list_fmaps_changed();
+  event_changed(fmap);
   if (init_events) lives_free(init_events);
   if (new_init_events) lives_free(new_init_events);
 
@@ -1669,6 +2155,40 @@ void delete_param_changes_after_deinit(weed_event_list_t *event_list, weed_event
 }
 
 
+typedef struct {
+  weed_event_t *pchange;
+  weed_timecode_t tc, new_tc;
+} pchange_move_t;
+
+static weed_event_t *find_pchange_slot(weed_event_t *pchange, weed_timecode_t new_tc, boolean back,
+                                       weed_event_t *cursor) {
+  // find the event at which pchange is to be re-inserted: moving back, the last event before it with timecode <= new_tc,
+  // moving forward, the first event after it with timecode >= new_tc
+  // cursor, if non-NULL, lies beyond the slot, (a param change in the same chain which was already moved there);
+  // we walk inwards from both ends in step, so the cost is the shorter of the two distances
+  weed_event_t *event = pchange, *xevent;
+  while (1) {
+    if (back) {
+      event = get_prev_event(event);
+      if (!event || get_event_timecode(event) <= new_tc) return event;
+      if (cursor) {
+        xevent = get_next_event(cursor);
+        if (xevent == pchange || get_event_timecode(xevent) > new_tc) return cursor;
+        cursor = xevent;
+      }
+    } else {
+      event = get_next_event(event);
+      if (!event || get_event_timecode(event) >= new_tc) return event;
+      if (cursor) {
+        xevent = get_prev_event(cursor);
+        if (xevent == pchange || get_event_timecode(xevent) < new_tc) return cursor;
+        cursor = xevent;
+      }
+    }
+  }
+}
+
+
 void rescale_param_changes(weed_event_list_t *event_list, weed_event_t *init_event,
                            weed_timecode_t new_init_tc,
                            weed_event_t *deinit_event, weed_timecode_t new_deinit_tc, double fps) {
@@ -1676,16 +2196,20 @@ void rescale_param_changes(weed_event_list_t *event_list, weed_event_t *init_eve
   // this can be called when a FILTER_INIT or FILTER_DEINIT is moved
   // fps is used for quantisation; may be 0. for no quant.
 
+  // the new timecodes are in the same order as the old ones, so each change which moves back is searched for
+  // from the previous change in its chain, and each which moves forward from the next one; thus the cost
+  // is linear in the length of the chain plus the distance moved, rather than their product
+  pchange_move_t *moves;
   void **init_events;
 
   weed_timecode_t old_init_tc = get_event_timecode(init_event);
   weed_timecode_t old_deinit_tc = get_event_timecode(deinit_event);
-  weed_timecode_t pchain_tc, new_tc;
+  weed_timecode_t new_tc;
 
   void *pchain;
-  weed_event_t *event;
+  weed_event_t *event, *cursor;
 
-  int num_inits, i;
+  int num_inits, nmoves, i, j;
 
   if (!weed_plant_has_leaf(init_event, WEED_LEAF_IN_PARAMETERS)) return;
 
@@ -1694,33 +2218,51 @@ void rescale_param_changes(weed_event_list_t *event_list, weed_event_t *init_eve
   if (!init_events) num_inits = 0;
 
   for (i = 0; i < num_inits; i++) {
-    pchain = init_events[i];
-    while (pchain) {
-      pchain_tc = get_event_timecode((weed_event_t *)pchain);
+    nmoves = 0;
+    for (pchain = init_events[i]; pchain; pchain = weed_get_voidptr_value((weed_plant_t *)pchain,
+         WEED_LEAF_NEXT_CHANGE, NULL)) nmoves++;
+    if (!nmoves) continue;
+
+    moves = (pchange_move_t *)lives_calloc(nmoves, sizeof(pchange_move_t));
+    nmoves = 0;
+    for (pchain = init_events[i]; pchain; pchain = weed_get_voidptr_value((weed_plant_t *)pchain,
+         WEED_LEAF_NEXT_CHANGE, NULL)) {
+      weed_timecode_t pchain_tc = get_event_timecode((weed_event_t *)pchain);
       new_tc = (weed_timecode_t)((double)(pchain_tc - old_init_tc) / (double)(old_deinit_tc - old_init_tc) *
                                  (double)(new_deinit_tc - new_init_tc)) + new_init_tc;
       if (new_tc < 0) break;
       if (fps > 0.) new_tc = q_gint64(new_tc, fps);
-      if (new_tc == pchain_tc) {
-        if (!weed_plant_has_leaf((weed_plant_t *)pchain, WEED_LEAF_NEXT_CHANGE)) pchain = NULL;
-        else pchain = weed_get_voidptr_value((weed_plant_t *)pchain, WEED_LEAF_NEXT_CHANGE, NULL);
-        continue;
-      }
-      event = (weed_event_t *)pchain;
-      if (new_tc < pchain_tc) {
-        while (event && get_event_timecode(event) > new_tc) event = get_prev_event(event);
-      } else {
-        while (event && get_event_timecode(event) < new_tc) event = get_next_event(event);
+      moves[nmoves].pchange = (weed_event_t *)pchain;
+      moves[nmoves].tc = pchain_tc;
+      moves[nmoves++].new_tc = new_tc;
+    }
+
+    // changes moving back, first to last
+    for (j = 0; j < nmoves; j++) {
+      new_tc = moves[j].new_tc;
+      if (new_tc >= moves[j].tc) continue;
+      cursor = j > 0 ? moves[j - 1].pchange : NULL;
+      if (cursor && get_event_timecode(cursor) > new_tc) cursor = NULL;
+      event = find_pchange_slot(moves[j].pchange, new_tc, TRUE, cursor);
+      if (event) {
+        unlink_event(event_list, moves[j].pchange);
+        insert_param_change_event_at(event_list, event, moves[j].pchange);
       }
+    }
 
+    // changes moving forward, last to first
+    for (j = nmoves - 1; j >= 0; j--) {
+      new_tc = moves[j].new_tc;
+      if (new_tc <= moves[j].tc) continue;
+      cursor = j < nmoves - 1 ? moves[j + 1].pchange : NULL;
+      if (cursor && get_event_timecode(cursor) < new_tc) cursor = NULL;
+      event = find_pchange_slot(moves[j].pchange, new_tc, FALSE, cursor);
       if (event) {
-        unlink_event(event_list, (weed_event_t *)pchain);
-        insert_param_change_event_at(event_list, event, (weed_event_t *)pchain);
+        unlink_event(event_list, moves[j].pchange);
+        insert_param_change_event_at(event_list, event, moves[j].pchange);
       }
-
-      if (!weed_plant_has_leaf((weed_plant_t *)pchain, WEED_LEAF_NEXT_CHANGE)) pchain = NULL;
-      else pchain = weed_get_voidptr_value((weed_plant_t *)pchain, WEED_LEAF_NEXT_CHANGE, NULL);
     }
+    lives_free(moves);
   }
 
   if (init_events) lives_free(init_events);
@@ -1799,6 +2341,7 @@ void add_init_event_to_filter_map(weed_plant_t *fmap, weed_event_t *event, void
   }
 
   weed_set_voidptr_array(fmap, WEED_LEAF_INIT_EVENTS, j, new_init_events);
+  event_list_fmaps_changed();
   lives_freep((void **)&init_events);
   lives_free(new_init_events);
 }
@@ -2332,6 +2875,7 @@ static void event_list_free_events(weed_event_list_t *event_list) {
 
 void event_list_free(weed_event_list_t *event_list) {
   if (!event_list) return;
+  event_list_index_drop(event_list);
   event_list_free_events(event_list);
   weed_plant_free(event_list);
 }
@@ -2341,6 +2885,8 @@ void event_list_replace_events(weed_event_list_t *event_list,
                                weed_event_list_t *new_event_list) {
   if (!event_list || !new_event_list) return;
   if (event_list == new_event_list) return;
+  event_list_index_drop(event_list);
+  event_list_index_drop(new_event_list);
   event_list_free_events(event_list);
   weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, get_first_event(new_event_list));
   weed_set_voidptr_value(event_list, WEED_LEAF_LAST, get_last_event(new_event_list));
@@ -2456,7 +3002,10 @@ static void event_list_reorder_noquant(weed_event_list_t *event_list) {
   // here we put them in correct chronological order
   // having done thie, we can now merge the filter maps for audio and video effects
   // which were added separately during recording
-  weed_event_t *event, *prev_event = NULL, *next_event, *filter_map = NULL;
+  // run_end is the first quantised event after the current run of noquant events; events moved forward are
+  // inserted after it, and those moved back before the run, so it can be reused until we reach it
+  weed_event_t *event, *prev_event = NULL, *next_event, *filter_map = NULL, *run_end = NULL;
+  boolean have_run_end = FALSE;
   if (!event_list) return;
 
   event = get_first_event(event_list);
@@ -2514,8 +3063,14 @@ static void event_list_reorder_noquant(weed_event_list_t *event_list) {
           continue;
         }
       }
-      while (xnext_event && weed_get_boolean_value(xnext_event, LIVES_LEAF_NOQUANT, NULL) == WEED_TRUE) {
-        xnext_event = get_next_event(xnext_event);
+      if (xnext_event && weed_get_boolean_value(xnext_event, LIVES_LEAF_NOQUANT, NULL) == WEED_TRUE) {
+        if (!have_run_end) {
+          run_end = xnext_event;
+          while (run_end && weed_get_boolean_value(run_end, LIVES_LEAF_NOQUANT, NULL) == WEED_TRUE)
+            run_end = get_next_event(run_end);
+          have_run_end = TRUE;
+        }
+        xnext_event = run_end;
       }
       next_tc = get_event_timecode(xnext_event);
       if (next_tc < tc) {
@@ -2548,7 +3103,10 @@ static void event_list_reorder_noquant(weed_event_list_t *event_list) {
       // if it's a filter map, note it, when we get a deinit, another map, or reach the end, add its events to all
       // subsequent maps, then add events from prior map to it
       filter_map = check_noq_filter_maps(event, filter_map);
-    } else prev_event = event;
+    } else {
+      prev_event = event;
+      have_run_end = FALSE;
+    }
     event = next_event;
   }
   if (filter_map) {
@@ -2653,6 +3211,8 @@ void add_track_to_avol_init(weed_plant_t *filter, weed_event_t *event, int nbtra
     new_in_tracks[i] = i - nbtracks;
   }
   weed_set_int_array(event, WEED_LEAF_IN_TRACKS, num_in_tracks, new_in_tracks);
+  event_list_fmaps_changed();
+  event_changed(event);
   lives_free(new_in_tracks);
 
   weed_set_int_value(event, WEED_LEAF_IN_COUNT, weed_get_int_value(event, WEED_LEAF_IN_COUNT, NULL) + 1);
@@ -2667,6 +3227,7 @@ void add_track_to_avol_init(weed_plant_t *filter, weed_event_t *event, int nbtra
     pchange = (weed_plant_t *)pchainx[i];
     bval = WEED_FALSE;
     while (pchange) {
+      event_changed((weed_event_t *)pchange);
       fill_param_vals_to((weed_plant_t *)pchange, in_ptmpls[i], behind ? num_in_tracks - 1 : 1);
       if (weed_plant_has_leaf((weed_plant_t *)pchange, WEED_LEAF_IGNORE)) {
         igns = weed_get_boolean_array_counted((weed_plant_t *)pchange, WEED_LEAF_IGNORE, &numigns);
@@ -2722,6 +3283,7 @@ void event_list_add_track(weed_event_list_t *event_list, int layer) {
         break;
       }
 
+      event_changed(event);
       newclips = (int *)lives_malloc((numframes + 1) * sizint);
       newframes = (int64_t *)lives_malloc((numframes + 1) * 8);
 
@@ -2758,12 +3320,14 @@ void event_list_add_track(weed_event_list_t *event_list, int layer) {
       break;
 
     case WEED_EVENT_TYPE_FILTER_INIT:
+      event_changed(event);
       in_tracks = weed_get_int_array_counted(event, WEED_LEAF_IN_TRACKS, &num_in_tracks);
       if (num_in_tracks) {
         for (i = 0; i < num_in_tracks; i++) {
           if (in_tracks[i] >= layer) in_tracks[i]++;
         }
         weed_set_int_array(event, WEED_LEAF_IN_TRACKS, num_in_tracks, in_tracks);
+        event_list_fmaps_changed();
         lives_free(in_tracks);
       }
       out_tracks = weed_get_int_array_counted(event, WEED_LEAF_OUT_TRACKS, &num_out_tracks);
@@ -2924,6 +3488,7 @@ void **filter_init_add_pchanges(weed_event_list_t *event_list, weed_plant_t *pla
   lives_free(in_ptmpls);
 
   weed_set_voidptr_array(init_event, WEED_LEAF_IN_PARAMETERS, num_params, pchain);
+  event_changed(init_event);
 
   return pchain;
 }
@@ -3082,6 +3647,7 @@ weed_event_list_t *append_filter_deinit_event(weed_event_list_t *event_list,
   weed_leaf_delete((weed_plant_t *)init_event, WEED_LEAF_DEINIT_EVENT); // delete since we assign a placeholder with int64 type
 
   weed_set_plantptr_value(init_event, WEED_LEAF_DEINIT_EVENT, (void *)event);
+  event_changed((weed_event_t *)init_event);
   if (pchain) {
     int num_params = 0;
     while (pchain[num_params]) num_params++;
@@ -3123,6 +3689,7 @@ weed_event_list_t *append_param_change_event(weed_event_list_t *event_list,
     }
 
     weed_set_voidptr_value(last_pchange_event, WEED_LEAF_NEXT_CHANGE, event);
+    event_changed(last_pchange_event);
     weed_set_voidptr_value(event, WEED_LEAF_PREV_CHANGE, last_pchange_event);
     weed_set_voidptr_value(event, WEED_LEAF_NEXT_CHANGE, NULL);
   }
@@ -3748,6 +4315,35 @@ static char *set_proc_label(xprocess * proc, const char *label, boolean copy_old
 }
 
 
+static void render_segs_show_timings(boolean finish) {
+  // show the time per frame for each stage of the segment renderer under the progress label,
+  // refreshing at most twice a second; on finish, the original label is restored
+  static char *orig_label = NULL;
+  static ticks_t last_ticks = 0;
+  double decode, fx, encode;
+  ticks_t now;
+  char *label;
+
+  if (finish) {
+    if (orig_label && mainw->proc_ptr) set_proc_label(mainw->proc_ptr, orig_label, FALSE);
+    lives_freep((void **)&orig_label);
+    last_ticks = 0;
+    return;
+  }
+  if (!mainw->proc_ptr) return;
+  now = lives_get_current_ticks();
+  if (last_ticks && now - last_ticks < TICKS_PER_SECOND / 2) return;
+  if (!render_segs_get_timings(&decode, &fx, &encode)) return;
+  last_ticks = now;
+
+  if (!orig_label) orig_label = lives_strdup(lives_label_get_text(LIVES_LABEL(mainw->proc_ptr->label)));
+  label = lives_strdup_printf(_("%s\nDecode %.1f ms, effects %.1f ms, encode %.1f ms per frame"),
+                              orig_label, decode, fx, encode);
+  set_proc_label(mainw->proc_ptr, label, FALSE);
+  lives_free(label);
+}
+
+
 /**
    @brief render mainw->event_list to a clip
 
@@ -3811,7 +4407,7 @@ lives_render_error_t render_events(boolean reset, boolean rend_video, boolean re
 #endif
   static weed_timecode_t rec_delta_tc, atc;
   static weed_event_t *event, *eventnext;
-  static boolean r_audio, r_video;
+  static boolean r_audio, r_video, r_segs;
 
   weed_timecode_t tc, next_out_tc = 0l, out_tc, dtc = atc, ztc;
   void *init_event, **eevents;
@@ -3970,11 +4566,26 @@ lives_render_error_t render_events(boolean reset, boolean rend_video, boolean re
       read_write_error = LIVES_RENDER_ERROR_NONE;
       audio_free_fnames();
     }
+
+    /// if the video can be rendered in parallel segments, we only render audio here
+    r_segs = FALSE;
+    if (r_video && render_segs_start(mainw->event_list, event, out_frame)) {
+      r_segs = TRUE;
+      r_video = FALSE;
+      read_write_error = LIVES_RENDER_ERROR_NONE;
+    }
     return LIVES_RENDER_READY;
   } // end reset
 
   if (mainw->effects_paused) return LIVES_RENDER_EFFECTS_PAUSED;
 
+  if (r_segs && event) {
+    frames_t ndone;
+    render_segs_running(&ndone);
+    lives_snprintf(mainw->msg, MAINW_MSG_SIZE, "%d", ndone);
+    render_segs_show_timings(FALSE);
+  }
+
   if (r_video)
     // use internal image saver if we can
     if (cfile->img_type == IMG_TYPE_PNG) intimg = TRUE;
@@ -3998,6 +4609,7 @@ lives_render_error_t render_events(boolean reset, boolean rend_video, boolean re
         etype = WEED_EVENT_TYPE_FRAME;
     }
 
+    // this also keeps video filter inits / deinits away from the segment threads when r_segs is set
     if (!r_video && etype != WEED_EVENT_TYPE_FRAME && etype != WEED_EVENT_TYPE_MARKER) etype = WEED_EVENT_TYPE_UNDEFINED;
 
     switch (etype) {
@@ -4518,6 +5130,9 @@ lives_render_error_t render_events(boolean reset, boolean rend_video, boolean re
         //if (weed_plant_has_leaf(event, WEED_LEAF_HOST_TAG)) weed_leaf_delete(event, WEED_LEAF_HOST_TAG);
         break; // audio effects are processed in the audio renderer
       }
+      // the segment threads init their own instances, changing the channel templates under rseg_fx_mutex
+      // (see segrender.c), so we must not touch them here
+      if (r_segs) break;
 
       key = get_next_free_key();
       weed_add_effectkey_by_idx(key + 1, idx);
@@ -4648,6 +5263,7 @@ filterinit2:
 
       filter = get_weed_filter(idx);
       if (is_pure_audio(filter, FALSE)) break; // audio effects are processed in the audio renderer
+      if (r_segs) break;
 
       key_string = weed_get_string_value((weed_plant_t *)init_event, WEED_LEAF_HOST_TAG, &weed_error);
       key = atoi(key_string);
@@ -4696,6 +5312,27 @@ filterinit2:
     event = eventnext;
   } else {
     /// no more events or audio to flush, rendering complete
+    if (r_segs) {
+      frames_t ndone;
+      lives_render_error_t seg_error;
+      if (render_segs_running(&ndone)) {
+        lives_snprintf(mainw->msg, MAINW_MSG_SIZE, "%d", ndone);
+        render_segs_show_timings(FALSE);
+        lives_nanosleep(LIVES_FORTY_WINKS);
+        return LIVES_RENDER_PROCESSING;
+      }
+      render_segs_show_timings(TRUE);
+      r_segs = FALSE;
+      r_video = TRUE;
+      seg_error = render_segs_finish(&out_frame);
+      if (seg_error) read_write_error = seg_error;
+      if (out_frame > cfile->undo_start) {
+        cfile->undo_end = out_frame - 1;
+        if (cfile->undo_end > cfile->frames) cfile->frames = cfile->undo_end;
+        if (cfile->undo_end > cfile->end) cfile->end = cfile->undo_end;
+        if (cfile->start == 0) cfile->start = 1;
+      }
+    }
 #ifdef SAVE_THREAD
     if (saver_lpt) {
       lives_proc_thread_join(saver_lpt);
@@ -4816,6 +5453,7 @@ boolean start_render_effect_events(weed_event_list_t *event_list, boolean render
 
   mainw->is_rendering = mainw->internal_messaging = TRUE;
   cfile->next_event = get_first_event(event_list);
+  fmap_plans_compile(event_list);
 
   mainw->effort = -EFFORT_RANGE_MAX;
 
@@ -4854,6 +5492,8 @@ boolean start_render_effect_events(weed_event_list_t *event_list, boolean render
                               ? _("Rendering") : _("Transcoding")) : _("Pre-rendering audio"))
        && mainw->cancelled != CANCEL_KEEP) || mainw->error
       || mainw->render_error >= LIVES_RENDER_ERROR) {
+    render_segs_abort();
+    render_segs_show_timings(TRUE);
     mainw->disk_mon = 0;
     mainw->cancel_type = CANCEL_KILL;
     mainw->cancelled = CANCEL_NONE;
@@ -4875,6 +5515,10 @@ boolean start_render_effect_events(weed_event_list_t *event_list, boolean render
     return FALSE;
   }
 
+  // in case rendering was stopped early and the segments were not finished
+  render_segs_abort();
+  render_segs_show_timings(TRUE);
+
   cfile->nopreview = FALSE;
   mainw->disk_mon = 0;
   mainw->cancel_type = CANCEL_KILL;
@@ -330,6 +330,24 @@ void replace_event(weed_event_list_t *, weed_event_t *at_event, weed_event_t *ev
 boolean insert_event_before(weed_event_t *at_event, weed_event_t *event);
 boolean insert_event_after(weed_event_t *at_event, weed_event_t *event);
 
+// timecode index; call invalidate after relinking events or changing the timecode of a linked event directly
+void event_list_index_invalidate(void);
+void event_list_index_drop(weed_event_list_t *);
+uint64_t event_pchange_gen(void);
+uint64_t event_fmap_gen(void);
+void event_list_fmaps_changed(void);
+
+// change watch, for one watcher at a time (the layout journal). Linking and unlinking is reported by the functions
+// above; code which changes the leaves of a linked event in place must call event_changed() for it
+#define EVENT_WATCH_CHANGED 0 ///< event was linked, or its leaves changed
+#define EVENT_WATCH_UNLINKED 1
+#define EVENT_WATCH_UNKNOWN 2 ///< events were relinked directly, or event_list was freed; the watcher should rescan
+
+typedef void (*lives_event_watch_f)(void *data, weed_event_list_t *, weed_event_t *, int what);
+
+void event_list_watch(lives_event_watch_f func, void *data); ///< func NULL to stop watching
+void event_changed(weed_event_t *);
+
 // param changes
 void ** *get_event_pchains(void);
 ticks_t get_next_paramchange(void **pchange_next, ticks_t end_tc);
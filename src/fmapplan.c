@@ -0,0 +1,203 @@
+// fmapplan.c
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// precompiled plans for applying filter maps
+// see fmapplan.h for an overview
+
+#include "main.h"
+#include "effects.h"
+#include "fmapplan.h"
+
+#define FMAP_TABLE_MIN 64 ///< initial size of the hash tables, must be a power of 2
+
+typedef struct {
+  weed_event_t *filter_map;
+  lives_fmap_plan_t *plan;
+} fmap_slot_t;
+
+// both tables are open addressed, with nslots entries; fmap_slots maps filter map events to plans,
+// plan_slots holds each distinct plan, by the hash of its init events
+static fmap_slot_t *fmap_slots = NULL;
+static lives_fmap_plan_t **plan_slots = NULL;
+static size_t nslots = 0, nmaps = 0;
+
+static uint64_t plans_gen = 0, next_plan_id = 1;
+
+static pthread_mutex_t fmap_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+LIVES_LOCAL_INLINE size_t fmap_slot_for(weed_event_t *filter_map, size_t mask) {
+  uint64_t val = (uint64_t)(uintptr_t)filter_map;
+  val ^= val >> 33;
+  val *= 0xff51afd7ed558ccdull;
+  val ^= val >> 33;
+  return (size_t)val & mask;
+}
+
+
+static uint64_t init_events_hash(void **init_events, int ninits) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (int i = 0; i < ninits; i++) {
+    hash ^= (uint64_t)(uintptr_t)init_events[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+
+static void plan_free(lives_fmap_plan_t *plan) {
+  for (int i = 0; i < plan->nsteps; i++) lives_freep((void **)&plan->steps[i].in_tracks);
+  lives_free(plan);
+}
+
+
+static void fmap_tables_clear(void) {
+  // drop the references held by the tables; plans still in use are freed when their last user unrefs them
+  for (size_t i = 0; i < nslots; i++) {
+    if (plan_slots[i] && --plan_slots[i]->refs == 0) plan_free(plan_slots[i]);
+  }
+  lives_freep((void **)&fmap_slots);
+  lives_freep((void **)&plan_slots);
+  nslots = nmaps = 0;
+}
+
+
+static void fmap_tables_grow(void) {
+  fmap_slot_t *ofmap_slots = fmap_slots;
+  lives_fmap_plan_t **oplan_slots = plan_slots;
+  size_t onslots = nslots, mask, j;
+
+  nslots = nslots ? nslots << 1 : FMAP_TABLE_MIN;
+  mask = nslots - 1;
+  fmap_slots = (fmap_slot_t *)lives_calloc(nslots, sizeof(fmap_slot_t));
+  plan_slots = (lives_fmap_plan_t **)lives_calloc(nslots, sizeof(lives_fmap_plan_t *));
+
+  for (size_t i = 0; i < onslots; i++) {
+    if (ofmap_slots[i].filter_map) {
+      for (j = fmap_slot_for(ofmap_slots[i].filter_map, mask); fmap_slots[j].filter_map; j = (j + 1) & mask);
+      fmap_slots[j] = ofmap_slots[i];
+    }
+    if (oplan_slots[i]) {
+      for (j = oplan_slots[i]->hash & mask; plan_slots[j]; j = (j + 1) & mask);
+      plan_slots[j] = oplan_slots[i];
+    }
+  }
+  lives_free(ofmap_slots);
+  lives_free(oplan_slots);
+}
+
+
+static lives_fmap_plan_t *plan_compile(void **init_events, int ninits, uint64_t hash) {
+  lives_fmap_plan_t *plan = (lives_fmap_plan_t *)lives_calloc(1, sizeof(lives_fmap_plan_t)
+                            + ninits * sizeof(lives_fmap_step_t));
+  for (int i = 0; i < ninits; i++) {
+    lives_fmap_step_t *step = &plan->steps[i];
+    weed_event_t *init_event = (weed_event_t *)init_events[i];
+    char *filter_hash = weed_get_string_value(init_event, WEED_LEAF_FILTER, NULL);
+
+    step->init_event = init_event;
+    step->filter_idx = weed_get_idx_for_hashname(filter_hash, TRUE);
+    lives_free(filter_hash);
+
+    if (step->filter_idx != -1) {
+      weed_filter_t *filter = get_weed_filter(step->filter_idx);
+      step->is_video = has_video_chans_in(filter, FALSE) && has_video_chans_out(filter, FALSE);
+    }
+    step->has_tracks = weed_plant_has_leaf(init_event, WEED_LEAF_IN_TRACKS)
+                       && weed_plant_has_leaf(init_event, WEED_LEAF_OUT_TRACKS);
+    if (step->is_video && step->has_tracks)
+      step->in_tracks = weed_get_int_array_counted(init_event, WEED_LEAF_IN_TRACKS, &step->nin_tracks);
+  }
+  plan->nsteps = ninits;
+  plan->hash = hash;
+  plan->id = next_plan_id++;
+  plan->refs = 1;
+  return plan;
+}
+
+
+lives_fmap_plan_t *fmap_plan_get(weed_event_t *filter_map) {
+  lives_fmap_plan_t *plan = NULL;
+  void **init_events;
+  uint64_t gen = event_fmap_gen(), hash;
+  size_t mask, i;
+  int ninits, j, k;
+
+  if (!filter_map) return NULL;
+
+  pthread_mutex_lock(&fmap_plan_mutex);
+  if (plans_gen != gen) {
+    fmap_tables_clear();
+    plans_gen = gen;
+  }
+
+  if (nslots) {
+    mask = nslots - 1;
+    for (i = fmap_slot_for(filter_map, mask); fmap_slots[i].filter_map; i = (i + 1) & mask) {
+      if (fmap_slots[i].filter_map == filter_map) {
+        plan = fmap_slots[i].plan;
+        plan->refs++;
+        pthread_mutex_unlock(&fmap_plan_mutex);
+        return plan;
+      }
+    }
+  }
+
+  init_events = weed_get_voidptr_array_counted(filter_map, WEED_LEAF_INIT_EVENTS, &ninits);
+  for (j = k = 0; j < ninits; j++) if (init_events[j]) init_events[k++] = init_events[j];
+  if (!(ninits = k)) {
+    pthread_mutex_unlock(&fmap_plan_mutex);
+    lives_freep((void **)&init_events);
+    return NULL;
+  }
+
+  if ((nmaps + 1) << 1 > nslots) fmap_tables_grow();
+  mask = nslots - 1;
+
+  // look for an identical plan, else make a new one
+  hash = init_events_hash(init_events, ninits);
+  for (i = hash & mask; plan_slots[i]; i = (i + 1) & mask) {
+    plan = plan_slots[i];
+    if (plan->hash == hash && plan->nsteps == ninits) {
+      for (j = 0; j < ninits; j++) if (plan->steps[j].init_event != init_events[j]) break;
+      if (j == ninits) break;
+    }
+  }
+  if (!plan_slots[i]) plan_slots[i] = plan = plan_compile(init_events, ninits, hash);
+
+  for (i = fmap_slot_for(filter_map, mask); fmap_slots[i].filter_map; i = (i + 1) & mask);
+  fmap_slots[i].filter_map = filter_map;
+  fmap_slots[i].plan = plan;
+  nmaps++;
+
+  plan->refs++;
+  pthread_mutex_unlock(&fmap_plan_mutex);
+  lives_free(init_events);
+  return plan;
+}
+
+
+void fmap_plan_unref(lives_fmap_plan_t *plan) {
+  if (!plan) return;
+  pthread_mutex_lock(&fmap_plan_mutex);
+  if (--plan->refs == 0) plan_free(plan);
+  pthread_mutex_unlock(&fmap_plan_mutex);
+}
+
+
+void fmap_plans_compile(weed_event_list_t *event_list) {
+  // compile all plans before playback or rendering starts, rather than on first use
+  for (weed_event_t *event = get_first_event(event_list); event; event = get_next_event(event)) {
+    if (WEED_EVENT_IS_FILTER_MAP(event)) fmap_plan_unref(fmap_plan_get(event));
+  }
+}
+
+
+void fmap_plans_clear(void) {
+  pthread_mutex_lock(&fmap_plan_mutex);
+  fmap_tables_clear();
+  pthread_mutex_unlock(&fmap_plan_mutex);
+}
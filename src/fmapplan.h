@@ -0,0 +1,46 @@
+// fmapplan.h
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// precompiled plans for applying filter maps
+
+#ifndef HAS_LIVES_FMAPPLAN_H
+#define HAS_LIVES_FMAPPLAN_H
+
+// a plan holds everything weed_apply_filter_map() needs to know about a filter map which does not change
+// during playback: the init events in order, with the filter and in tracks for each. Plans are compiled
+// once per filter map and looked up by the filter map event, so the per frame cost no longer includes
+// fetching the init events and looking up each filter by its hashname.
+//
+// filter maps with the same init events share a single plan, and plans with equal ids have identical steps,
+// so identical segments of a layout can be recognised without comparing the maps.
+//
+// all plans are discarded when a filter map or filter init is added, removed or changed (see event_fmap_gen()),
+// and are recompiled on demand
+
+typedef struct {
+  weed_event_t *init_event;
+  int filter_idx; ///< -1 if the filter is not loaded
+  boolean is_video; ///< filter has video channels in and out
+  boolean has_tracks; ///< init_event has in and out tracks
+  int nin_tracks;
+  int *in_tracks;
+} lives_fmap_step_t;
+
+typedef struct {
+  uint64_t id;
+  uint64_t hash;
+  int refs;
+  int nsteps;
+  lives_fmap_step_t steps[];
+} lives_fmap_plan_t;
+
+lives_fmap_plan_t *fmap_plan_get(weed_event_t *filter_map); ///< adds a ref, NULL if the map has no init events
+void fmap_plan_unref(lives_fmap_plan_t *);
+
+void fmap_plans_compile(weed_event_list_t *); ///< compile plans for all filter maps in advance
+void fmap_plans_clear(void);
+
+#endif
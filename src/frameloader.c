@@ -14,6 +14,7 @@
 #include "callbacks.h"
 #include "startup.h"
 #include "ce_thumbs.h"
+#include "genqueue.h"
 #ifdef HAVE_YUV4MPEG
 #include "lives-yuv4mpeg.h"
 #endif
@@ -2623,13 +2624,17 @@ retry:
     }
     weed_instance_ref(inst);
 
-    int key = weed_get_int_value(inst, WEED_LEAF_HOST_KEY, NULL);
-    filter_mutex_lock(key);
+    // a frame rendered ahead does not need the filter mutex, so try that first
+    if (IS_VALID_CLIP(clip) && genq_fetch(layer, inst)) res = FILTER_SUCCESS;
+    else {
+      int key = weed_get_int_value(inst, WEED_LEAF_HOST_KEY, NULL);
+      filter_mutex_lock(key);
 
-    if (IS_VALID_CLIP(clip))
-      res = lives_layer_fill_from_generator(layer, inst, tc);
+      if (IS_VALID_CLIP(clip))
+        res = lives_layer_fill_from_generator(layer, inst, tc);
 
-    filter_mutex_unlock(key);
+      filter_mutex_unlock(key);
+    }
     weed_instance_unref(inst);
 
     if (res != FILTER_SUCCESS) {
@@ -2752,6 +2757,7 @@ static void pft_thread(weed_layer_t *layer, const char *img_ext) {
   weed_timecode_t tc = weed_get_int64_value(layer, WEED_LEAF_TIMECODE, NULL);
   int width = weed_layer_get_width(layer);
   int height = weed_layer_get_height(layer);
+  sched_policy_apply(SCHED_CLASS_DECODER);
   pull_frame_at_size(layer, img_ext, tc, width, height, WEED_PALETTE_ANY);
 }
 
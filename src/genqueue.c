@@ -0,0 +1,307 @@
+// genqueue.c
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// run ahead frame queues for generators
+// see genqueue.h for an overview
+
+#include "main.h"
+#include "effects.h"
+#include "genqueue.h"
+
+typedef struct {
+  weed_layer_t *layer;
+  weed_timecode_t tc;
+  uint64_t phash; ///< hash of the in param values the frame was rendered with
+  int width, height, palette; ///< requested size and palette
+} genq_frame_t;
+
+typedef struct {
+  weed_instance_t *inst;
+  int clipno, key;
+  lives_proc_thread_t lpt;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  genq_frame_t frames[GENQ_DEPTH];
+  int head, nframes;
+  // set by the consumer, read by the producer
+  int width, height, palette;
+  double period; ///< estimated ticks between pulls
+  weed_timecode_t last_pull, next_tc;
+  volatile boolean die;
+  int nhits, nmisses;
+} genq_t;
+
+static LiVESList *genqs = NULL;
+static pthread_mutex_t genqs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static uint64_t params_hash(weed_instance_t *inst) {
+  // the producer renders with whatever param values are current, so a frame is only valid
+  // while the values are unchanged
+  uint64_t hash = 0xcbf29ce484222325ull, val;
+  weed_param_t **params;
+  char *str;
+  int nparams, ne, st;
+
+  params = weed_instance_get_in_params(inst, &nparams);
+  for (int i = 0; i < nparams; i++) {
+    ne = weed_leaf_num_elements(params[i], WEED_LEAF_VALUE);
+    st = weed_leaf_seed_type(params[i], WEED_LEAF_VALUE);
+    for (int j = 0; j < ne; j++) {
+      if (st == WEED_SEED_STRING) {
+        str = NULL;
+        weed_leaf_get(params[i], WEED_LEAF_VALUE, j, &str);
+        val = str ? fast_hash64(str) : 0;
+      } else {
+        val = 0;
+        weed_leaf_get(params[i], WEED_LEAF_VALUE, j, &val);
+      }
+      hash ^= val;
+      hash *= 0x100000001b3ull;
+    }
+  }
+  lives_freep((void **)&params);
+  return hash;
+}
+
+
+static boolean genq_eligible(weed_instance_t *inst) {
+  weed_filter_t *filter = weed_instance_get_filter(inst, FALSE);
+  weed_instance_t *kinst;
+  int key;
+  if (!filter || (weed_filter_get_flags(filter) & WEED_FILTER_HINT_STATEFUL)) return FALSE;
+  if (get_enabled_channel(inst, 0, LIVES_INPUT) || get_enabled_audio_channel(inst, 0, LIVES_INPUT)) return FALSE;
+  // an instance which is no longer bound to its key is being ended, and genq_stop() may already have been called
+  key = weed_get_int_value(inst, WEED_LEAF_HOST_KEY, NULL) + 1;
+  kinst = rte_keymode_get_instance(key, rte_key_getmode(key));
+  if (kinst) weed_instance_unref(kinst);
+  return kinst == inst;
+}
+
+
+LIVES_LOCAL_INLINE boolean genq_realtime(void) {
+  // same condition as lives_layer_fill_from_generator() uses for timing frames by the player clock
+  return LIVES_IS_PLAYING && !mainw->is_rendering && !mainw->preview
+         && (!mainw->event_list || mainw->record || mainw->record_paused);
+}
+
+
+static void genq_flush(genq_t *q) {
+  // must be called with q->mutex locked
+  for (; q->nframes; q->nframes--) {
+    weed_layer_free(q->frames[q->head].layer);
+    q->frames[q->head].layer = NULL;
+    q->head = (q->head + 1) % GENQ_DEPTH;
+  }
+  q->head = 0;
+}
+
+
+static void genq_producer(genq_t *q) {
+  weed_layer_t *layer;
+  genq_frame_t *frame;
+  weed_timecode_t tc;
+  lives_filter_error_t res;
+  uint64_t phash;
+  boolean locked;
+  int width, height, palette;
+
+  sched_policy_apply(SCHED_CLASS_DECODER);
+
+  while (1) {
+    pthread_mutex_lock(&q->mutex);
+    while (q->nframes == GENQ_DEPTH && !q->die) pthread_cond_wait(&q->cond, &q->mutex);
+    if (q->die) {
+      pthread_mutex_unlock(&q->mutex);
+      break;
+    }
+    // if we fell behind the player, start again one period ahead of it
+    if (q->next_tc < mainw->currticks + q->period * .5) q->next_tc = mainw->currticks + q->period;
+    tc = q->next_tc;
+    width = q->width;
+    height = q->height;
+    palette = q->palette;
+    pthread_mutex_unlock(&q->mutex);
+
+    // the caller of genq_stop() may hold the filter mutex, so we cannot block on it
+    for (locked = FALSE; !q->die; lives_nanosleep(GENQ_LOCK_WAIT)) {
+      if (!filter_mutex_trylock(q->key)) {
+        locked = TRUE;
+        break;
+      }
+    }
+    if (!locked) break;
+
+    phash = params_hash(q->inst);
+    layer = lives_layer_new_for_frame(q->clipno, 0);
+    weed_layer_set_size(layer, width, height);
+    if (palette != WEED_PALETTE_NONE) weed_layer_set_palette(layer, palette);
+    res = lives_layer_fill_from_generator_at(layer, q->inst, tc);
+    filter_mutex_unlock(q->key);
+
+    if (res != FILTER_SUCCESS) {
+      // the consumer will carry on synchronously, and report any error
+      weed_layer_free(layer);
+      break;
+    }
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->die) {
+      pthread_mutex_unlock(&q->mutex);
+      weed_layer_free(layer);
+      break;
+    }
+    frame = &q->frames[(q->head + q->nframes++) % GENQ_DEPTH];
+    frame->layer = layer;
+    frame->tc = tc;
+    frame->phash = phash;
+    frame->width = width;
+    frame->height = height;
+    frame->palette = palette;
+    q->next_tc = tc + q->period;
+    pthread_mutex_unlock(&q->mutex);
+  }
+}
+
+
+static genq_t *genq_find(weed_instance_t *inst) {
+  // must be called with genqs_mutex locked
+  for (LiVESList *list = genqs; list; list = list->next) {
+    genq_t *q = (genq_t *)list->data;
+    if (q->inst == inst) return q;
+  }
+  return NULL;
+}
+
+
+static genq_t *genq_start(weed_layer_t *layer, weed_instance_t *inst) {
+  // must be called with genqs_mutex locked
+  genq_t *q = (genq_t *)lives_calloc(1, sizeof(genq_t));
+  lives_clip_t *sfile;
+  q->inst = inst;
+  q->clipno = lives_layer_get_clip(layer);
+  q->key = weed_get_int_value(inst, WEED_LEAF_HOST_KEY, NULL);
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->cond, NULL);
+  q->width = weed_layer_get_width(layer);
+  q->height = weed_layer_get_height(layer);
+  q->palette = weed_layer_get_palette(layer);
+  sfile = RETURN_VALID_CLIP(q->clipno);
+  if (sfile && sfile->pb_fps != 0.) q->period = TICKS_PER_SECOND_DBL / fabs(sfile->pb_fps);
+  else if (mainw->inst_fps > 0.) q->period = TICKS_PER_SECOND_DBL / mainw->inst_fps;
+  else q->period = TICKS_PER_SECOND_DBL / prefs->default_fps;
+  q->last_pull = q->next_tc = mainw->currticks;
+  weed_instance_ref(inst);
+  genqs = lives_list_prepend(genqs, q);
+  q->lpt = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, (lives_funcptr_t)genq_producer, 0, "v", q);
+  d_print_debug("GEN QUEUE: started for clip %d, period %.2f msec\n", q->clipno,
+                q->period * 1000. / TICKS_PER_SECOND_DBL);
+  return q;
+}
+
+
+boolean genq_fetch(weed_layer_t *layer, weed_instance_t *inst) {
+  weed_layer_t *qlayer = NULL;
+  genq_frame_t *frame;
+  weed_timecode_t tc = mainw->currticks, qtc = 0;
+  uint64_t phash;
+  genq_t *q;
+  int clipno;
+
+  if (!prefs->gen_runahead || !genq_realtime()) return FALSE;
+
+  pthread_mutex_lock(&genqs_mutex);
+  if (!(q = genq_find(inst))) {
+    if (genq_eligible(inst)) genq_start(layer, inst);
+    pthread_mutex_unlock(&genqs_mutex);
+    return FALSE;
+  }
+
+  // genqs_mutex is held until we are done with q, so genq_stop() cannot free it meanwhile
+  phash = params_hash(inst);
+
+  pthread_mutex_lock(&q->mutex);
+  if (tc > q->last_pull) q->period = q->period * (1. - GENQ_PERIOD_SMOOTHING)
+                                       + (double)(tc - q->last_pull) * GENQ_PERIOD_SMOOTHING;
+  q->last_pull = tc;
+  q->width = weed_layer_get_width(layer);
+  q->height = weed_layer_get_height(layer);
+  q->palette = weed_layer_get_palette(layer);
+
+  // drop anything already shown, or rendered with different params or size
+  while (q->nframes) {
+    frame = &q->frames[q->head];
+    if (frame->tc >= tc - q->period * .5 && frame->phash == phash && frame->width == q->width
+        && frame->height == q->height && frame->palette == q->palette) break;
+    weed_layer_free(frame->layer);
+    frame->layer = NULL;
+    q->head = (q->head + 1) % GENQ_DEPTH;
+    q->nframes--;
+  }
+  if (!q->nframes) q->next_tc = tc;
+  else if (q->frames[q->head].tc <= tc + q->period * .5) {
+    frame = &q->frames[q->head];
+    qlayer = frame->layer;
+    qtc = frame->tc;
+    frame->layer = NULL;
+    q->head = (q->head + 1) % GENQ_DEPTH;
+    q->nframes--;
+  }
+  if (qlayer) q->nhits++;
+  else q->nmisses++;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+  pthread_mutex_unlock(&genqs_mutex);
+
+  if (!qlayer) return FALSE;
+
+  // same hand over as lives_layer_fill_from_generator() uses for the out channel
+  clipno = lives_layer_get_clip(layer);
+  weed_pixel_data_share(layer, qlayer);
+  weed_layer_free(qlayer);
+  lives_layer_set_clip(layer, clipno);
+  weed_set_int64_value(layer, WEED_LEAF_HOST_TC, qtc);
+  return TRUE;
+}
+
+
+static void genq_free(genq_t *q) {
+  pthread_mutex_lock(&q->mutex);
+  q->die = TRUE;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+  lives_proc_thread_join(q->lpt);
+
+  d_print_debug("GEN QUEUE: stopped for clip %d, %d frames from queue, %d generated synchronously\n",
+                q->clipno, q->nhits, q->nmisses);
+
+  genq_flush(q);
+  weed_instance_unref(q->inst);
+  pthread_cond_destroy(&q->cond);
+  pthread_mutex_destroy(&q->mutex);
+  lives_free(q);
+}
+
+
+void genq_stop(weed_instance_t *inst) {
+  genq_t *q;
+  if (!inst) return;
+  pthread_mutex_lock(&genqs_mutex);
+  if ((q = genq_find(inst))) genqs = lives_list_remove(genqs, q);
+  pthread_mutex_unlock(&genqs_mutex);
+  if (q) genq_free(q);
+}
+
+
+void genq_stop_all(void) {
+  LiVESList *list;
+  pthread_mutex_lock(&genqs_mutex);
+  list = genqs;
+  genqs = NULL;
+  pthread_mutex_unlock(&genqs_mutex);
+  for (LiVESList *xlist = list; xlist; xlist = xlist->next) genq_free((genq_t *)xlist->data);
+  lives_list_free(list);
+}
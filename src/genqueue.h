@@ -0,0 +1,37 @@
+// genqueue.h
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// run ahead frame queues for generators
+
+#ifndef HAS_LIVES_GENQUEUE_H
+#define HAS_LIVES_GENQUEUE_H
+
+// a generator whose filter does not set WEED_FILTER_HINT_STATEFUL produces the same output for a given
+// timecode regardless of what it rendered before, so its frames can be rendered ahead of the playhead.
+// With prefs->gen_runahead, the first time such a generator is pulled during realtime playback it is given
+// a producer thread, which renders into a bounded queue at timecodes one frame period apart, staying ahead of
+// the player clock. The period follows the interval between pulls.
+//
+// the clip loader takes the queued frame for the current timecode (within half a period) without waiting
+// for the filter mutex; older frames are dropped. If the queue has no suitable frame (underflow), or the
+// params or requested size changed since the frames were rendered, the frame is generated synchronously
+// as before.
+//
+// generators with in channels (alpha or audio) are not queued, since their inputs are only valid for
+// the current cycle
+
+#define GENQ_DEPTH 3 ///< maximum number of frames rendered ahead
+#define GENQ_PERIOD_SMOOTHING .1 ///< weight of each new pull interval in the period estimate
+#define GENQ_LOCK_WAIT 100000 ///< nsec to wait before retrying the filter mutex in the producer
+
+/// if inst has a queue with a frame for the current time, moves the frame into layer and returns TRUE
+/// else returns FALSE, and the caller should generate the frame synchronously
+boolean genq_fetch(weed_layer_t *layer, weed_instance_t *inst);
+
+void genq_stop(weed_instance_t *inst); ///< must be called before inst is deinited
+void genq_stop_all(void);
+
+#endif
@@ -181,6 +181,10 @@ boolean update_timer_bars(int clipno, int posx, int posy, int width, int height,
     }
 
     if (sfile->audio_waveform[0]) {
+      // use the peak cache where possible, and only read the audio for anything it cannot supply yet
+      if (start != offset_end)
+        start = clip_peaks_get_waveform(clipno, 0, sfile->audio_waveform[0], start, offset_end,
+                                        1. / scalex, sfile->vol * 2.);
       if (start != offset_end) {
         filename = lives_get_audio_file_name(clipno);
         afd = lives_open_buffered_rdonly(filename);
@@ -312,6 +316,9 @@ boolean update_timer_bars(int clipno, int posx, int posy, int width, int height,
     }
 
     if (sfile->audio_waveform[1]) {
+      if (start != offset_end)
+        start = clip_peaks_get_waveform(clipno, 1, sfile->audio_waveform[1], start, offset_end,
+                                        1. / scalex, sfile->vol * 2.);
       if (start != offset_end) {
         if (afd < 0) {
           filename = lives_get_audio_file_name(clipno);
@@ -2304,18 +2304,20 @@ LIVES_INLINE lives_audio_buf_t *pop_cache_buffer(void) {
 
 static void output_silence(size_t offset, jack_nframes_t nframes, jack_driver_t *jackd, float **out_buffer) {
   // write nframes silence to all output streams
+  lives_aarena_t *aar = prefs->audio_src != AUDIO_SRC_EXT ? audio_arena_ref() : NULL;
   int nch = jackd->num_output_channels;
   for (int i = 0; i < nch; i++) {
     if (out_buffer[i]) {
       if (!jackd->is_silent) {
         sample_silence_dS(out_buffer[i] + offset, nframes);
       }
-      if (mainw->afbuffer && prefs->audio_src != AUDIO_SRC_EXT) {
+      if (aar) {
         // audio to be sent to video generator plugins
-        append_to_audio_bufferf(out_buffer[i] + offset, nframes, i == nch - 1 ? -i - 1 : i + 1);
+        append_to_audio_bufferf(aar, out_buffer[i] + offset, nframes, i == nch - 1 ? -i - 1 : i + 1);
       }
     }
   }
+  if (aar) audio_arena_unref();
   if (mainw->ext_audio && mainw->vpp && mainw->vpp->render_audio_frame_float) {
     // audio to be sent to video playback plugin
     sample_silence_stream(nch, nframes);
@@ -2472,6 +2474,7 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
   jack_driver_t *jackd = (jack_driver_t *)arg;
   jack_position_t pos;
   aserver_message_t *msg;
+  lives_aarena_t *aar;
   int64_t xseek;
   int new_file;
   int nch;
@@ -2515,6 +2518,12 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
 
   //jackd->is_silent = FALSE;
 
+  if (LIVES_IS_PLAYING) {
+    alat_callback(&jackd->alat, nframes, jackd->sample_out_rate);
+    // the jack period belongs to the server, so here the target is only reported
+    alat_adapt(&jackd->alat, jackd->sample_out_rate, nframes, XSAMPLES);
+  } else jackd->alat.last_cb = 0;
+
   /* retrieve the buffers for the output ports */
   for (i = 0; i < nch; i++)
     out_buffer[i] = (float *)jack_port_get_buffer(jackd->output_port[i], nframes);
@@ -2529,9 +2538,10 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
     size_t acsize, remsiz, xlbufsiz;
     int k;
 
-    // get audio from abuffs
-    // create a fake audio chan
-    weed_plant_t *achan = weed_plant_new(WEED_PLANT_CHANNEL);
+    // get audio from the arena via a fake audio chan, which keeps our arena reader from cycle to cycle
+    weed_plant_t *achan;
+    if (!jackd->lb_achan) jackd->lb_achan = weed_plant_new(WEED_PLANT_CHANNEL);
+    achan = jackd->lb_achan;
 
     if (reset_buffers && lb_buff) {
       for (i = 0; i < nch; i++) if (lb_buff[i]) lives_free(lb_buff[i]);
@@ -2558,7 +2568,9 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
     else vol = lives_vol_from_linear(future_prefs->volume);
 
     weed_channel_set_audio_data(achan, NULL, jackd->sample_out_rate, nch, 0);
-    fill_audio_channel(NULL, achan, FALSE);
+    // once jack_pb_end() has unregistered us, the reader is given up here, in the only thread which uses it
+    if (jackd->lb_registered) fill_audio_channel(NULL, achan);
+    else release_audio_reader(achan);
 
     acsize = weed_channel_get_audio_length(achan);
 
@@ -2620,7 +2632,7 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
           }}}}
     // *INDENT-ON*
 
-    weed_plant_free(achan);
+    release_audio_channel(achan);
     if (ac_buff) lives_free(ac_buff);
     lbufsiz = lbufsiz - xlbufsiz + acsize - remsiz;
 
@@ -2763,6 +2775,9 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
         return 0;
       }
       if (cache_buffer->fileno == -1) jackd->playing_file = -1;
+      if (cache_buffer->is_ready)
+        alat_cache_lead(&jackd->alat, lives_get_current_ticks() - cache_buffer->ready_ticks);
+      else alat_cache_lead(&jackd->alat, -jackd->alat.period);
     }
     if (cache_buffer && cache_buffer->in_achans > 0 && !cache_buffer->is_ready) {
       wait_cache_buffer = TRUE;
@@ -3080,14 +3095,12 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
               if (pl_error) {
                 // error in plugin, put silence
                 output_silence(0, numFramesToWrite, jackd, out_buffer);
-              } else {
+              } else if (prefs->audio_src != AUDIO_SRC_EXT && (aar = audio_arena_ref())) {
                 for (i = 0; i < nch; i++) {
-                  // push non-interleaved audio in fbuffer to jack
-                  if (mainw->afbuffer && prefs->audio_src != AUDIO_SRC_EXT) {
-                    // we will push the pre-effected audio to any audio reactive generators
-                    append_to_audio_bufferf(out_buffer[i], numFramesToWrite, i == nch - 1 ? -i - 1 : i + 1);
-                  }
+                  // we will push the pre-effected audio to any audio reactive generators
+                  append_to_audio_bufferf(aar, out_buffer[i], numFramesToWrite, i == nch - 1 ? -i - 1 : i + 1);
                 }
+                audio_arena_unref();
               }
               //}
               if (!pl_error && has_audio_filters(AF_TYPE_ANY)) {
@@ -3162,6 +3175,7 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
                 numFramesToWrite = jackFramesAvailable;
 
                 // push audio from cache_buffer to jack
+                aar = prefs->audio_src != AUDIO_SRC_EXT ? audio_arena_ref() : NULL;
                 for (i = 0; i < nch; i++) {
                   /* if (afile->asampsize == 32) */
                   /*   sample_move_float_float(out_buffer[i], cache_buffer->bufferf[i], numFramesToWrite, 1., 1, 1.); */
@@ -3170,11 +3184,12 @@ static int audio_process(jack_nframes_t nframes, void *arg) {
                   jackd->abs_maxvol_heard = sample_move_d16_float(out_buffer[i], cache_buffer->buffer16[0] + i, numFramesToWrite,
                                             jackd->num_output_channels, afile->signed_endian
                                             & AFORM_UNSIGNED, FALSE, vol);
-                  if (mainw->afbuffer && prefs->audio_src != AUDIO_SRC_EXT) {
+                  if (aar) {
                     // we will push the pre-effected audio to any audio reactive generators
-                    append_to_audio_bufferf(out_buffer[i], numFramesToWrite, i == nch - 1 ? -i - 1 : i + 1);
+                    append_to_audio_bufferf(aar, out_buffer[i], numFramesToWrite, i == nch - 1 ? -i - 1 : i + 1);
                   }
                 }
+                if (aar) audio_arena_unref();
                 pthread_mutex_unlock(&mainw->cache_buffer_mutex);
 
                 jackFramesAvailable = 0;
@@ -3405,6 +3420,7 @@ static int xrun_callback(void *arg) {
     //g_print("\n\nXRUN: %f\n", delay);
   }
   mainw->xrun_active = TRUE;
+  alat_underrun(&jackd->alat);
   if (delay >= 0.)
     if (IS_VALID_CLIP(jackd->playing_file))
       jackd->seek_pos += (off_t)((double)jackd->sample_in_rate * ((double)delay / (double)MILLIONS(1))
@@ -3684,6 +3700,14 @@ void jack_close_client(jack_driver_t *jackd) {
     jack_client_close(jackd->client);
   }
 
+  if (jackd->lb_achan) {
+    // the process callback has stopped, so the loopback reader can be released here
+    release_audio_reader(jackd->lb_achan);
+    weed_plant_free(jackd->lb_achan);
+    jackd->lb_achan = NULL;
+  }
+  jackd->lb_registered = FALSE;
+
   jack_reset_driver(jackd);
   jackd->client = NULL;
 
@@ -3908,6 +3932,7 @@ boolean jack_write_client_activate(jack_driver_t *jackd) {
 
   if (jackd->is_active) return TRUE; // already running
 
+  alat_reset(&jackd->alat, 0);
   jack_set_process_callback(jackd->client, audio_process, jackd);
   jack_set_xrun_callback(jackd->client, xrun_callback, jackd);
 
@@ -4353,8 +4378,10 @@ void jack_pb_end(void) {
   cache_buffer = NULL;
   if (prefs->audio_opts & AUDIO_OPTS_AUX_PLAY)
     unregister_aux_audio_channels(1);
-  if (AUD_SRC_EXTERNAL && (prefs->audio_opts & AUDIO_OPTS_EXT_FX))
-    unregister_audio_client(FALSE);
+  if (AUD_SRC_EXTERNAL && (prefs->audio_opts & AUDIO_OPTS_EXT_FX)) {
+    if (mainw->jackd) mainw->jackd->lb_registered = FALSE;
+    unregister_audio_client(NULL);
+  }
 }
 
 
@@ -4412,7 +4439,8 @@ void jack_aud_pb_ready(jack_driver_t *jackd, int fileno) {
     if ((mainw->agen_key != 0 || mainw->agen_needs_reinit)
         && !mainw->multitrack && !mainw->preview) jackd->in_use = TRUE; // audio generator is active
 
-    if (AUD_SRC_EXTERNAL && (prefs->audio_opts & AUDIO_OPTS_EXT_FX)) register_audio_client(FALSE);
+    if (AUD_SRC_EXTERNAL && (prefs->audio_opts & AUDIO_OPTS_EXT_FX))
+      jackd->lb_registered = register_audio_client(NULL) > 0;
     if (prefs->audio_opts & AUDIO_OPTS_AUX_PLAY) register_aux_audio_channels(1);
 
     mainw->rec_aclip = jackd->playing_file;
@@ -217,6 +217,11 @@ typedef struct _lives_jack_driver_t {
 
   volatile float abs_maxvol_heard;
 
+  lives_alatency_t alat; ///< callback jitter / cache lead stats
+
+  weed_plant_t *lb_achan; ///< channel for the external audio loopback, holds its arena reader between cycles
+  volatile boolean lb_registered; ///< loopback is registered as an audio arena client
+
   char status_msg[STMSGLEN];
 } jack_driver_t;
 
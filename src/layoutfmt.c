@@ -0,0 +1,1293 @@
+// layoutfmt.c
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// compact binary format for event_lists (layouts)
+// see layoutfmt.h for a description of the format
+
+#include <sys/mman.h>
+
+#include "main.h"
+#include "layoutfmt.h"
+
+#define LB_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+LIVES_LOCAL_INLINE size_t lb_seed_size(int st) {
+  // size of each stored value, or 0 if the type cannot be stored
+  switch (st) {
+  case WEED_SEED_INT: case WEED_SEED_BOOLEAN: case WEED_SEED_UINT: case WEED_SEED_STRING: return 4;
+  case WEED_SEED_INT64: case WEED_SEED_UINT64: case WEED_SEED_DOUBLE:
+  case WEED_SEED_VOIDPTR: case WEED_SEED_PLANTPTR: return 8;
+  default: return 0;
+  }
+}
+
+/////////////// saving ///////////////
+
+typedef struct {
+  uint8_t *buf;
+  size_t len, size;
+} lb_buf_t;
+
+typedef struct {
+  weed_event_t *event;
+  int64_t idx; ///< index in the list, or the event id when journalling
+  int64_t after; ///< journal only: id of the preceding event
+  uint64_t hash; ///< journal only: hash of the encoded event
+  uint32_t flags; ///< journal only
+} lb_evmap_t;
+
+typedef struct {
+  lb_evmap_t *slots; ///< open addressing by event, NULL event for empty slots
+  int64_t size, count;
+} lb_idmap_t;
+
+typedef struct {
+  lb_buf_t leaves, strtab, data;
+  uint32_t *strhash; ///< open addressing, strtab offset + 1, 0 for empty slots
+  uint32_t hsize, nstrings;
+  lb_evmap_t *evmap;
+  int64_t nevents;
+  lb_idmap_t *idmap; ///< if set, used instead of evmap
+} lb_builder_t;
+
+
+static size_t lb_append(lb_buf_t *b, const void *data, size_t len) {
+  size_t offs = b->len;
+  if (b->len + len > b->size) {
+    size_t nsize = b->size ? b->size : 4096;
+    while (nsize < b->len + len) nsize <<= 1;
+    b->buf = lives_realloc(b->buf, nsize);
+    b->size = nsize;
+  }
+  if (data) lives_memcpy(b->buf + b->len, data, len);
+  else lives_memset(b->buf + b->len, 0, len);
+  b->len += len;
+  return offs;
+}
+
+
+LIVES_LOCAL_INLINE void lb_align(lb_buf_t *b) {
+  size_t pad = LB_ALIGN(b->len) - b->len;
+  if (pad) lb_append(b, NULL, pad);
+}
+
+
+static uint32_t lb_intern(lb_builder_t *lbb, const char *str) {
+  // return the string table offset for str, adding it if necessary
+  uint32_t h, mask;
+  if (!str) return LAYOUT_STR_NULL;
+
+  if (lbb->nstrings * 2 >= lbb->hsize) {
+    // grow and rehash
+    uint32_t *ohash = lbb->strhash, osize = lbb->hsize;
+    lbb->hsize = osize ? osize << 1 : 256;
+    lbb->strhash = (uint32_t *)lives_calloc(lbb->hsize, sizeof(uint32_t));
+    mask = lbb->hsize - 1;
+    for (uint32_t i = 0; i < osize; i++) {
+      if (!ohash[i]) continue;
+      h = lives_string_hash((const char *)lbb->strtab.buf + ohash[i] - 1) & mask;
+      while (lbb->strhash[h]) h = (h + 1) & mask;
+      lbb->strhash[h] = ohash[i];
+    }
+    lives_free(ohash);
+  }
+
+  mask = lbb->hsize - 1;
+  for (h = lives_string_hash(str) & mask; lbb->strhash[h]; h = (h + 1) & mask) {
+    if (!lives_strcmp((const char *)lbb->strtab.buf + lbb->strhash[h] - 1, str)) return lbb->strhash[h] - 1;
+  }
+  lbb->strhash[h] = lb_append(&lbb->strtab, str, lives_strlen(str) + 1) + 1;
+  lbb->nstrings++;
+  return lbb->strhash[h] - 1;
+}
+
+
+static int lb_evmap_cmp(const void *a, const void *b) {
+  const lb_evmap_t *ea = (const lb_evmap_t *)a, *eb = (const lb_evmap_t *)b;
+  return ea->event < eb->event ? -1 : ea->event > eb->event ? 1 : 0;
+}
+
+
+LIVES_LOCAL_INLINE uint64_t lb_idmap_slot(lb_idmap_t *map, weed_event_t *event) {
+  return (((uint64_t)event * 0x9E3779B97F4A7C15ull) >> 24) & (map->size - 1);
+}
+
+
+static lb_evmap_t *lb_idmap_find(lb_idmap_t *map, weed_event_t *event) {
+  if (!map->size || !event) return NULL;
+  for (uint64_t h = lb_idmap_slot(map, event);; h = (h + 1) & (map->size - 1)) {
+    if (!map->slots[h].event) return NULL;
+    if (map->slots[h].event == event) return &map->slots[h];
+  }
+}
+
+
+static lb_evmap_t *lb_idmap_add(lb_idmap_t *map, weed_event_t *event) {
+  // event must not be in map yet; the new entry is zeroed apart from the event
+  // any entries returned previously may be moved by this
+  uint64_t h;
+  if ((map->count + 1) * 2 > map->size) {
+    lb_idmap_t nmap;
+    nmap.size = map->size ? map->size << 1 : 1024;
+    nmap.count = 0;
+    nmap.slots = (lb_evmap_t *)lives_calloc(nmap.size, sizeof(lb_evmap_t));
+    for (int64_t i = 0; i < map->size; i++) {
+      if (map->slots[i].event) *lb_idmap_add(&nmap, map->slots[i].event) = map->slots[i];
+    }
+    lives_free(map->slots);
+    *map = nmap;
+  }
+  for (h = lb_idmap_slot(map, event); map->slots[h].event; h = (h + 1) & (map->size - 1));
+  lives_memset(&map->slots[h], 0, sizeof(lb_evmap_t));
+  map->slots[h].event = event;
+  map->count++;
+  return &map->slots[h];
+}
+
+
+static void lb_idmap_remove(lb_idmap_t *map, lb_evmap_t *ent) {
+  // entries after ent are shifted back to fill the gap, so that we do not need tombstones
+  uint64_t mask = map->size - 1, i = ent - map->slots, j = i, k;
+  while (1) {
+    j = (j + 1) & mask;
+    if (!map->slots[j].event) break;
+    k = lb_idmap_slot(map, map->slots[j].event);
+    // the entry at j can fill i unless its home slot lies cyclically in (i, j]
+    if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+      map->slots[i] = map->slots[j];
+      i = j;
+    }
+  }
+  map->slots[i].event = NULL;
+  map->count--;
+}
+
+
+static int64_t lb_event_index(lb_builder_t *lbb, void *ptr) {
+  lb_evmap_t key, *found;
+  if (!ptr) return -1;
+  if (lbb->idmap) {
+    found = lb_idmap_find(lbb->idmap, (weed_event_t *)ptr);
+    return found ? found->idx : -1;
+  }
+  key.event = (weed_event_t *)ptr;
+  found = (lb_evmap_t *)bsearch(&key, lbb->evmap, lbb->nevents, sizeof(lb_evmap_t), lb_evmap_cmp);
+  return found ? found->idx : -1;
+}
+
+
+LIVES_LOCAL_INLINE uint64_t lb_encode_ptr(lb_builder_t *lbb, void *ptr, int64_t idx, boolean *is_ref) {
+  // references to events become (relative index << 1) | 1
+  // other pointers are kept as they are (as the existing format does); since these are aligned the low bit is free
+  int64_t tidx = lb_event_index(lbb, ptr);
+  if (tidx >= 0) {
+    *is_ref = TRUE;
+    return ((uint64_t)(tidx - idx) << 1) | 1;
+  }
+  if ((uint64_t)ptr & 1) return 0;
+  return (uint64_t)ptr;
+}
+
+
+static void lb_add_leaf(lb_builder_t *lbb, weed_plant_t *plant, const char *key, int64_t idx, uint32_t flags) {
+  lives_layout_bin_leaf_t leaf;
+  int st = weed_leaf_seed_type(plant, key);
+  int ne = weed_leaf_num_elements(plant, key);
+  int i;
+
+  leaf.key = lb_intern(lbb, key);
+  leaf.seed_type = st;
+  leaf.nvals = ne;
+  leaf.flags = 0;
+
+  lb_align(&lbb->data);
+  leaf.offset = lbb->data.len;
+
+  if (ne > 0) {
+    switch (st) {
+    case WEED_SEED_INT: case WEED_SEED_BOOLEAN: case WEED_SEED_UINT:
+    case WEED_SEED_INT64: case WEED_SEED_UINT64: case WEED_SEED_DOUBLE: {
+      size_t elsize = lb_seed_size(st);
+      for (i = 0; i < ne; i++) {
+        uint64_t val = 0;
+        weed_leaf_get(plant, key, i, &val);
+        lb_append(&lbb->data, &val, elsize);
+      }
+    }
+    break;
+    case WEED_SEED_STRING: {
+      char **vals = weed_get_string_array(plant, key, NULL);
+      for (i = 0; i < ne; i++) {
+        uint32_t soffs = lb_intern(lbb, vals[i]);
+        lb_append(&lbb->data, &soffs, 4);
+        lives_freep((void **)&vals[i]);
+      }
+      lives_free(vals);
+    }
+    break;
+    case WEED_SEED_VOIDPTR: case WEED_SEED_PLANTPTR: {
+      boolean is_ref = FALSE;
+      for (i = 0; i < ne; i++) {
+        void *ptr = NULL;
+        uint64_t enc;
+        weed_leaf_get(plant, key, i, &ptr);
+        enc = lb_encode_ptr(lbb, ptr, idx, &is_ref);
+        lb_append(&lbb->data, &enc, 8);
+      }
+      if (is_ref) leaf.flags |= LAYOUT_LEAF_EVREF;
+      if (flags & LAYOUT_LEAF_IDREF) {
+        leaf.flags |= LAYOUT_LEAF_EVREF | LAYOUT_LEAF_IDREF;
+        leaf.seed_type = WEED_SEED_INT64;
+      }
+    }
+    break;
+    default:
+      // funcptrs and unknown types cannot be saved
+      lbb->data.len = leaf.offset;
+      return;
+    }
+  } else if (flags & LAYOUT_LEAF_IDREF) leaf.seed_type = WEED_SEED_INT64;
+
+  lb_append(&lbb->leaves, &leaf, sizeof(leaf));
+}
+
+
+static void lb_add_plant_leaves(lb_builder_t *lbb, weed_plant_t *plant, int64_t idx) {
+  char **leaves = weed_plant_list_leaves(plant, NULL);
+  boolean is_event = WEED_PLANT_IS_EVENT(plant);
+  uint32_t flags;
+
+  if (is_event && WEED_EVENT_IS_FILTER_INIT(plant)) {
+    // the id is just a reference to the event itself
+    uint64_t enc = 1;
+    lives_layout_bin_leaf_t leaf;
+    leaf.key = lb_intern(lbb, WEED_LEAF_EVENT_ID);
+    leaf.seed_type = WEED_SEED_INT64;
+    leaf.nvals = 1;
+    leaf.flags = LAYOUT_LEAF_EVREF | LAYOUT_LEAF_IDREF;
+    lb_align(&lbb->data);
+    leaf.offset = lb_append(&lbb->data, &enc, 8);
+    lb_append(&lbb->leaves, &leaf, sizeof(leaf));
+  }
+
+  for (int i = 0; leaves[i]; i++) {
+    const char *key = leaves[i];
+    flags = 0;
+    if (!lives_strcmp(key, WEED_LEAF_TYPE) || !lives_strcmp(key, WEED_LEAF_HINT)) goto skip;
+    if (is_event) {
+      if (!lives_strcmp(key, WEED_LEAF_NEXT) || !lives_strcmp(key, WEED_LEAF_PREVIOUS)
+          || !lives_strcmp(key, WEED_LEAF_TIMECODE) || !lives_strcmp(key, WEED_LEAF_EVENT_TYPE)) goto skip;
+      if (WEED_EVENT_IS_FILTER_INIT(plant) && !lives_strcmp(key, WEED_LEAF_EVENT_ID)) goto skip;
+      // these are converted to ids, as when saving in the serialised format
+      if (((WEED_EVENT_IS_FILTER_DEINIT(plant) || WEED_EVENT_IS_PARAM_CHANGE(plant))
+           && !lives_strcmp(key, WEED_LEAF_INIT_EVENT))
+          || (WEED_EVENT_IS_FILTER_MAP(plant) && !lives_strcmp(key, WEED_LEAF_INIT_EVENTS)))
+        flags = LAYOUT_LEAF_IDREF;
+    } else {
+      if (!lives_strcmp(key, WEED_LEAF_FIRST) || !lives_strcmp(key, WEED_LEAF_LAST)) goto skip;
+    }
+    if (flags && weed_leaf_seed_type(plant, key) == WEED_SEED_INT64) flags = 0;
+    lb_add_leaf(lbb, plant, key, idx, flags);
+skip:
+    _ext_free(leaves[i]);
+  }
+  _ext_free(leaves);
+}
+
+
+size_t layout_bin_serialise(weed_event_list_t *event_list, uint8_t **pbuf) {
+  // serialise event_list in binary layout format. The buffer is allocated and should be freed by the caller
+  // returns the size in bytes, or 0 on error
+  lives_layout_bin_hdr_t hdr;
+  lb_builder_t lbb;
+  lb_buf_t out;
+  weed_event_t *event;
+  uint32_t *leafidx;
+  int32_t *etypes;
+  int64_t *tcs;
+  int64_t i, nevents = 0;
+
+  *pbuf = NULL;
+  if (!event_list) return 0;
+
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) nevents++;
+
+  lives_memset(&lbb, 0, sizeof(lbb));
+  lbb.nevents = nevents;
+  lbb.evmap = (lb_evmap_t *)lives_calloc(nevents + 1, sizeof(lb_evmap_t));
+  etypes = (int32_t *)lives_calloc(nevents + 1, 4);
+  tcs = (int64_t *)lives_calloc(nevents + 1, 8);
+  leafidx = (uint32_t *)lives_calloc(nevents + 1, 4);
+
+  for (event = get_first_event(event_list), i = 0; event; event = get_next_event(event), i++) {
+    lbb.evmap[i].event = event;
+    lbb.evmap[i].idx = i;
+    etypes[i] = get_event_type(event);
+    tcs[i] = get_event_timecode(event);
+  }
+  qsort(lbb.evmap, nevents, sizeof(lb_evmap_t), lb_evmap_cmp);
+
+  for (event = get_first_event(event_list), i = 0; event; event = get_next_event(event), i++) {
+    leafidx[i] = lbb.leaves.len / sizeof(lives_layout_bin_leaf_t);
+    lb_add_plant_leaves(&lbb, event, i);
+  }
+  leafidx[nevents] = lbb.leaves.len / sizeof(lives_layout_bin_leaf_t);
+  lb_add_plant_leaves(&lbb, event_list, -1);
+
+  lives_memset(&hdr, 0, sizeof(hdr));
+  lives_memcpy(hdr.magic, LAYOUT_BIN_MAGIC, LAYOUT_BIN_MAGIC_LEN);
+  hdr.version = LAYOUT_BIN_VERSION;
+  hdr.endian = LAYOUT_BIN_ENDIAN;
+  hdr.nevents = nevents;
+  hdr.nleaves = lbb.leaves.len / sizeof(lives_layout_bin_leaf_t);
+  hdr.list_leaf_start = leafidx[nevents];
+  hdr.off_types = LB_ALIGN(sizeof(hdr));
+  hdr.off_tcs = LB_ALIGN(hdr.off_types + nevents * 4);
+  hdr.off_leafidx = hdr.off_tcs + nevents * 8;
+  hdr.off_leaves = LB_ALIGN(hdr.off_leafidx + (nevents + 1) * 4);
+  hdr.off_strtab = hdr.off_leaves + lbb.leaves.len;
+  hdr.strtab_size = lbb.strtab.len;
+  hdr.off_data = LB_ALIGN(hdr.off_strtab + hdr.strtab_size);
+  hdr.data_size = lbb.data.len;
+  hdr.total_size = hdr.off_data + hdr.data_size;
+
+  lives_memset(&out, 0, sizeof(out));
+  lb_append(&out, NULL, hdr.total_size);
+  lives_memcpy(out.buf, &hdr, sizeof(hdr));
+  lives_memcpy(out.buf + hdr.off_types, etypes, nevents * 4);
+  lives_memcpy(out.buf + hdr.off_tcs, tcs, nevents * 8);
+  lives_memcpy(out.buf + hdr.off_leafidx, leafidx, (nevents + 1) * 4);
+  if (lbb.leaves.len) lives_memcpy(out.buf + hdr.off_leaves, lbb.leaves.buf, lbb.leaves.len);
+  if (lbb.strtab.len) lives_memcpy(out.buf + hdr.off_strtab, lbb.strtab.buf, lbb.strtab.len);
+  if (lbb.data.len) lives_memcpy(out.buf + hdr.off_data, lbb.data.buf, lbb.data.len);
+
+  lives_free(etypes);
+  lives_free(tcs);
+  lives_free(leafidx);
+  lives_free(lbb.evmap);
+  lives_freep((void **)&lbb.strhash);
+  lives_freep((void **)&lbb.leaves.buf);
+  lives_freep((void **)&lbb.strtab.buf);
+  lives_freep((void **)&lbb.data.buf);
+
+  *pbuf = out.buf;
+  return hdr.total_size;
+}
+
+
+boolean layout_bin_save(int fd, weed_event_list_t *event_list) {
+  // write event_list to fd (opened with lives_create_buffered) in binary layout format
+  uint8_t *buf;
+  size_t size = layout_bin_serialise(event_list, &buf);
+  if (!size) return FALSE;
+  THREADVAR(write_failed) = FALSE;
+  lives_write_buffered(fd, (const char *)buf, size, TRUE);
+  lives_free(buf);
+  return !THREADVAR(write_failed);
+}
+
+
+/////////////// loading ///////////////
+
+boolean layout_bin_is_layout(const void *buf, size_t size) {
+  return buf && size >= sizeof(lives_layout_bin_hdr_t) && !lives_memcmp(buf, LAYOUT_BIN_MAGIC, LAYOUT_BIN_MAGIC_LEN);
+}
+
+
+boolean layout_bin_file_is_layout(const char *fname) {
+  char magic[LAYOUT_BIN_MAGIC_LEN];
+  ssize_t bytes;
+  int fd = lives_open2(fname, O_RDONLY);
+  if (fd < 0) return FALSE;
+  bytes = read(fd, magic, LAYOUT_BIN_MAGIC_LEN);
+  close(fd);
+  return bytes == LAYOUT_BIN_MAGIC_LEN && !lives_memcmp(magic, LAYOUT_BIN_MAGIC, LAYOUT_BIN_MAGIC_LEN);
+}
+
+
+static boolean lb_section_ok(const lives_layout_bin_hdr_t *hdr, uint64_t offs, uint64_t count, uint64_t elsize) {
+  if (offs & 7 || offs > hdr->total_size) return FALSE;
+  if (count > (hdr->total_size - offs) / elsize) return FALSE;
+  return TRUE;
+}
+
+
+static boolean lb_leaves_ok(const lives_layout_bin_leaf_t *leaves, uint64_t nleaves, uint64_t strtab_size,
+                            uint64_t data_size) {
+  for (uint64_t i = 0; i < nleaves; i++) {
+    const lives_layout_bin_leaf_t *leaf = &leaves[i];
+    uint64_t elsize = lb_seed_size(leaf->seed_type);
+    if (leaf->key >= strtab_size || !elsize) return FALSE;
+    if (leaf->offset > data_size || leaf->nvals > (data_size - leaf->offset) / elsize) return FALSE;
+  }
+  return TRUE;
+}
+
+
+static boolean lb_validate(lives_layout_bin_t *lb) {
+  const lives_layout_bin_hdr_t *hdr = lb->hdr;
+  uint64_t i;
+
+  if (hdr->version != LAYOUT_BIN_VERSION || hdr->endian != LAYOUT_BIN_ENDIAN) return FALSE;
+  if (hdr->total_size > lb->size) return FALSE;
+  if (hdr->nevents >= 0xFFFFFFFF || hdr->nleaves >= 0xFFFFFFFF) return FALSE;
+  if (!lb_section_ok(hdr, hdr->off_types, hdr->nevents, 4)
+      || !lb_section_ok(hdr, hdr->off_tcs, hdr->nevents, 8)
+      || !lb_section_ok(hdr, hdr->off_leafidx, hdr->nevents + 1, 4)
+      || !lb_section_ok(hdr, hdr->off_leaves, hdr->nleaves, sizeof(lives_layout_bin_leaf_t))
+      || !lb_section_ok(hdr, hdr->off_strtab, hdr->strtab_size, 1)
+      || !lb_section_ok(hdr, hdr->off_data, hdr->data_size, 1)) return FALSE;
+  if (hdr->strtab_size && lb->base[hdr->off_strtab + hdr->strtab_size - 1]) return FALSE;
+
+  lb->etypes = (const int32_t *)(lb->base + hdr->off_types);
+  lb->tcs = (const int64_t *)(lb->base + hdr->off_tcs);
+  lb->leafidx = (const uint32_t *)(lb->base + hdr->off_leafidx);
+  lb->leaves = (const lives_layout_bin_leaf_t *)(lb->base + hdr->off_leaves);
+  lb->strtab = (const char *)(lb->base + hdr->off_strtab);
+  lb->data = lb->base + hdr->off_data;
+
+  for (i = 0; i < hdr->nevents; i++) if (lb->leafidx[i] > lb->leafidx[i + 1]) return FALSE;
+  if (lb->leafidx[hdr->nevents] != hdr->list_leaf_start || hdr->list_leaf_start > hdr->nleaves) return FALSE;
+
+  return lb_leaves_ok(lb->leaves, hdr->nleaves, hdr->strtab_size, hdr->data_size);
+}
+
+
+lives_layout_bin_t *layout_bin_map_mem(const uint8_t *buf, size_t size) {
+  // the buffer must remain valid and unchanged until layout_bin_unmap() is called
+  lives_layout_bin_t *lb;
+  if (!layout_bin_is_layout(buf, size) || ((uint64_t)buf & 7)) return NULL;
+  lb = (lives_layout_bin_t *)lives_calloc(1, sizeof(lives_layout_bin_t));
+  lb->base = buf;
+  lb->size = size;
+  lb->hdr = (const lives_layout_bin_hdr_t *)buf;
+  if (!lb_validate(lb)) {
+    lives_free(lb);
+    return NULL;
+  }
+  lb->plants = (weed_event_t **)lives_calloc(lb->hdr->nevents + 1, sizeof(weed_event_t *));
+  lb->filled = (uint8_t *)lives_calloc(lb->hdr->nevents + 1, 1);
+  return lb;
+}
+
+
+lives_layout_bin_t *layout_bin_map_file(const char *fname) {
+  lives_layout_bin_t *lb;
+  struct stat st;
+  void *base;
+  int fd = lives_open2(fname, O_RDONLY);
+
+  if (fd < 0) return NULL;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(lives_layout_bin_hdr_t)) {
+    close(fd);
+    return NULL;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  if (!(lb = layout_bin_map_mem((const uint8_t *)base, st.st_size))) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+  lb->mapped = TRUE;
+  // we will mostly read the columns and leaves in order
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  return lb;
+}
+
+
+void layout_bin_unmap(lives_layout_bin_t *lb) {
+  // free the map, along with any events materialised but not handed over
+  if (!lb) return;
+  if (lb->plants) {
+    for (uint64_t i = 0; i < lb->hdr->nevents; i++) if (lb->plants[i]) weed_plant_free(lb->plants[i]);
+    lives_free(lb->plants);
+  }
+  lives_freep((void **)&lb->filled);
+  if (lb->mapped) munmap((void *)lb->base, lb->size);
+  lives_free(lb);
+}
+
+
+typedef weed_event_t *(*lb_resolve_f)(void *rdata, int64_t idx);
+
+static weed_event_t *lb_get_shell(void *rdata, int64_t i) {
+  // return the plant for event i, creating an empty one if it does not exist yet
+  lives_layout_bin_t *lb = (lives_layout_bin_t *)rdata;
+  if (i < 0 || i >= (int64_t)lb->hdr->nevents) return NULL;
+  if (!lb->plants[i]) lb->plants[i] = weed_plant_new(WEED_PLANT_EVENT);
+  return lb->plants[i];
+}
+
+
+static void lb_set_leaves(lives_layout_bin_t *lb, weed_plant_t *plant, int64_t idx, uint64_t start, uint64_t end,
+                          lb_resolve_f resolve, void *rdata) {
+  for (uint64_t l = start; l < end; l++) {
+    const lives_layout_bin_leaf_t *leaf = &lb->leaves[l];
+    const char *key = lb->strtab + leaf->key;
+    const uint8_t *vals = lb->data + leaf->offset;
+    int ne = leaf->nvals;
+
+    if (!ne) {
+      weed_leaf_set(plant, key, leaf->seed_type, 0, NULL);
+      continue;
+    }
+
+    switch (leaf->seed_type) {
+    case WEED_SEED_STRING: {
+      char **strs = (char **)lives_malloc(ne * sizeof(char *));
+      const uint32_t *soffs = (const uint32_t *)vals;
+      for (int i = 0; i < ne; i++)
+        strs[i] = soffs[i] < lb->hdr->strtab_size ? (char *)lb->strtab + soffs[i] : NULL;
+      weed_leaf_set(plant, key, WEED_SEED_STRING, ne, strs);
+      lives_free(strs);
+    }
+    break;
+    case WEED_SEED_VOIDPTR: case WEED_SEED_PLANTPTR: case WEED_SEED_INT64:
+      if (leaf->flags & LAYOUT_LEAF_EVREF) {
+        const uint64_t *encs = (const uint64_t *)vals;
+        void **ptrs = (void **)lives_malloc(ne * sizeof(void *));
+        for (int i = 0; i < ne; i++) {
+          if (encs[i] & 1) ptrs[i] = (*resolve)(rdata, idx + ((int64_t)encs[i] >> 1));
+          else ptrs[i] = (void *)encs[i];
+        }
+        if (leaf->flags & LAYOUT_LEAF_IDREF) {
+          int64_t *ids = (int64_t *)lives_malloc(ne * 8);
+          for (int i = 0; i < ne; i++) ids[i] = (int64_t)(uint64_t)ptrs[i];
+          weed_leaf_set(plant, key, WEED_SEED_INT64, ne, ids);
+          lives_free(ids);
+        } else weed_leaf_set(plant, key, leaf->seed_type, ne, ptrs);
+        lives_free(ptrs);
+        break;
+      }
+    // fall through
+    default:
+      weed_leaf_set(plant, key, leaf->seed_type, ne, (void *)vals);
+      break;
+    }
+  }
+}
+
+
+weed_event_t *layout_bin_get_event(lives_layout_bin_t *lb, int64_t i) {
+  // materialise event i; events it refers to are created as shells, and filled when they are asked for
+  weed_event_t *event = lb_get_shell(lb, i);
+  if (!event || lb->filled[i]) return event;
+  lb->filled[i] = 1;
+  weed_set_int_value(event, WEED_LEAF_EVENT_TYPE, lb->etypes[i]);
+  weed_event_set_timecode(event, lb->tcs[i]);
+  lb_set_leaves(lb, event, i, lb->leafidx[i], lb->leafidx[i + 1], lb_get_shell, lb);
+  weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, NULL);
+  weed_set_voidptr_value(event, WEED_LEAF_NEXT, NULL);
+  return event;
+}
+
+
+weed_event_list_t *layout_bin_get_list_plant(lives_layout_bin_t *lb) {
+  // create the event_list plant, without any events
+  weed_event_list_t *event_list = weed_plant_new(WEED_PLANT_EVENT_LIST);
+  lb_set_leaves(lb, event_list, -1, lb->hdr->list_leaf_start, lb->hdr->nleaves, lb_get_shell, lb);
+  weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, NULL);
+  weed_set_voidptr_value(event_list, WEED_LEAF_LAST, NULL);
+  return event_list;
+}
+
+
+int64_t layout_bin_append_events(lives_layout_bin_t *lb, weed_event_list_t *event_list) {
+  // materialise all remaining events and append them to event_list, which takes ownership of them
+  // returns the number of events appended
+  weed_event_t *event, *prev = get_last_event(event_list);
+  int64_t nevents = lb->hdr->nevents;
+
+  // fill everything first, since events may refer forwards or backwards
+  for (int64_t i = 0; i < nevents; i++) layout_bin_get_event(lb, i);
+
+  for (int64_t i = 0; i < nevents; i++) {
+    event = lb->plants[i];
+    weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, prev);
+    if (prev) weed_set_voidptr_value(prev, WEED_LEAF_NEXT, event);
+    else weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, event);
+    prev = event;
+    lb->plants[i] = NULL;
+  }
+  if (prev) weed_set_voidptr_value(event_list, WEED_LEAF_LAST, prev);
+  return nevents;
+}
+
+
+weed_event_list_t *layout_bin_materialise(lives_layout_bin_t *lb) {
+  weed_event_list_t *event_list = layout_bin_get_list_plant(lb);
+  layout_bin_append_events(lb, event_list);
+  return event_list;
+}
+
+
+/////////////// journal ///////////////
+
+#define LB_HASH_INIT 0xcbf29ce484222325ull
+
+LIVES_LOCAL_INLINE uint64_t lb_hash(uint64_t h, const void *data, size_t len) {
+  // FNV-1a
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 0x100000001b3ull;
+  return h;
+}
+
+
+// entry flags
+#define LB_JNL_DIRTY	(1 << 0) ///< linked or changed since the last record
+#define LB_JNL_NEW	(1 << 1) ///< not recorded yet
+
+// between records, the changes reported by events.c (see event_list_watch()) are collected, so that a record
+// only needs to encode the events which were changed. If events are relinked without being reported, or the
+// list is replaced, the whole list is compared with the last recorded state instead
+struct _lives_layout_jnl {
+  char *base_file, *jnl_file;
+  lb_idmap_t map; ///< state of the list when last recorded, plus events linked since
+  weed_event_list_t *event_list; ///< the list the state refers to
+  lb_buf_t dirty; ///< events marked LB_JNL_DIRTY, in the order reported; some may have been removed since
+  lb_buf_t dels; ///< ids of recorded events unlinked since the last record
+  boolean rescan;
+  pthread_mutex_t mutex; ///< protects the above, since changes can be reported from any thread
+  int64_t next_id;
+  uint64_t list_hash;
+  uint64_t base_size, base_hash;
+  uint64_t jnl_size;
+  int nblocks;
+  uint8_t *base_buf; ///< new base, waiting to be written
+  lives_proc_thread_t compactor;
+  volatile boolean failed;
+};
+
+
+lives_layout_jnl_t *layout_jnl_new(const char *base_file, const char *jnl_file) {
+  // nothing is written until layout_jnl_compact() is called
+  lives_layout_jnl_t *jnl = (lives_layout_jnl_t *)lives_calloc(1, sizeof(lives_layout_jnl_t));
+  jnl->base_file = lives_strdup(base_file);
+  jnl->jnl_file = lives_strdup(jnl_file);
+  jnl->next_id = 1;
+  jnl->failed = TRUE;
+  pthread_mutex_init(&jnl->mutex, NULL);
+  return jnl;
+}
+
+
+boolean layout_jnl_sync(lives_layout_jnl_t *jnl) {
+  // wait for any background compaction; returns FALSE if the journal is not usable
+  if (jnl->compactor) {
+    lives_proc_thread_join(jnl->compactor);
+    jnl->compactor = NULL;
+  }
+  return !jnl->failed;
+}
+
+
+static lives_layout_jnl_t *lb_jnl_watching = NULL;
+
+void layout_jnl_free(lives_layout_jnl_t *jnl) {
+  // files are left in place
+  if (!jnl) return;
+  if (lb_jnl_watching == jnl) {
+    event_list_watch(NULL, NULL);
+    lb_jnl_watching = NULL;
+  }
+  layout_jnl_sync(jnl);
+  lives_freep((void **)&jnl->base_buf);
+  lives_freep((void **)&jnl->map.slots);
+  lives_freep((void **)&jnl->dirty.buf);
+  lives_freep((void **)&jnl->dels.buf);
+  pthread_mutex_destroy(&jnl->mutex);
+  lives_free(jnl->base_file);
+  lives_free(jnl->jnl_file);
+  lives_free(jnl);
+}
+
+
+static lb_evmap_t *lb_jnl_find(lives_layout_jnl_t *jnl, weed_event_t *event) {
+  // returns the recorded state of event, if any
+  lb_evmap_t *ent = lb_idmap_find(&jnl->map, event);
+  return ent && !(ent->flags & LB_JNL_NEW) ? ent : NULL;
+}
+
+
+static void lb_jnl_watch(void *data, weed_event_list_t *event_list, weed_event_t *event, int what) {
+  // called from events.c as lists are edited
+  lives_layout_jnl_t *jnl = (lives_layout_jnl_t *)data;
+  lb_evmap_t *ent;
+
+  pthread_mutex_lock(&jnl->mutex);
+  if (jnl->rescan || (event_list && event_list != jnl->event_list)) goto done;
+
+  switch (what) {
+  case EVENT_WATCH_UNKNOWN:
+    jnl->rescan = TRUE;
+    break;
+  case EVENT_WATCH_UNLINKED:
+    if ((ent = lb_idmap_find(&jnl->map, event))) {
+      if (!(ent->flags & LB_JNL_NEW)) lb_append(&jnl->dels, &ent->idx, 8);
+      lb_idmap_remove(&jnl->map, ent);
+    }
+    break;
+  default:
+    if (!(ent = lb_idmap_find(&jnl->map, event))) {
+      // a new event is ours if it was linked into our list, or next to one of our events
+      if (!event_list && !lb_idmap_find(&jnl->map, get_prev_event(event))
+          && !lb_idmap_find(&jnl->map, get_next_event(event))) break;
+      ent = lb_idmap_add(&jnl->map, event);
+      ent->idx = jnl->next_id++;
+      ent->flags = LB_JNL_NEW;
+    }
+    if (!(ent->flags & LB_JNL_DIRTY)) {
+      ent->flags |= LB_JNL_DIRTY;
+      lb_append(&jnl->dirty, &event, sizeof(weed_event_t *));
+    }
+    break;
+  }
+done:
+  pthread_mutex_unlock(&jnl->mutex);
+}
+
+
+static uint64_t lb_jnl_encode(lb_builder_t *lbb, weed_plant_t *plant, int64_t id) {
+  // encode the leaves of a single plant into lbb, replacing anything already there
+  // returns a hash of the encoding
+  uint64_t h = LB_HASH_INIT;
+
+  lbb->leaves.len = lbb->strtab.len = lbb->data.len = 0;
+  if (lbb->nstrings) {
+    lives_memset(lbb->strhash, 0, lbb->hsize * sizeof(uint32_t));
+    lbb->nstrings = 0;
+  }
+  lb_add_plant_leaves(lbb, plant, id);
+
+  if (WEED_PLANT_IS_EVENT(plant)) {
+    int32_t etype = get_event_type(plant);
+    int64_t tc = get_event_timecode(plant);
+    h = lb_hash(h, &etype, 4);
+    h = lb_hash(h, &tc, 8);
+  }
+  h = lb_hash(h, lbb->leaves.buf, lbb->leaves.len);
+  h = lb_hash(h, lbb->strtab.buf, lbb->strtab.len);
+  return lb_hash(h, lbb->data.buf, lbb->data.len);
+}
+
+
+static void lb_jnl_add_rec(lb_buf_t *out, lb_builder_t *lbb, uint32_t op, uint32_t flags, int64_t id, int64_t after,
+                           weed_plant_t *plant) {
+  // append a record to out; if flags has LAYOUT_JNL_CONTENT, the leaves are taken from lbb
+  lives_layout_jnl_rec_t rec;
+
+  lives_memset(&rec, 0, sizeof(rec));
+  rec.op = op;
+  rec.flags = flags;
+  rec.id = id;
+  rec.after = after;
+  if (plant && WEED_PLANT_IS_EVENT(plant)) {
+    rec.etype = get_event_type(plant);
+    rec.tc = get_event_timecode(plant);
+  }
+  if (flags & LAYOUT_JNL_CONTENT) {
+    rec.nleaves = lbb->leaves.len / sizeof(lives_layout_bin_leaf_t);
+    rec.strtab_size = lbb->strtab.len;
+    rec.data_size = lbb->data.len;
+  }
+  lb_append(out, &rec, sizeof(rec));
+  if (flags & LAYOUT_JNL_CONTENT) {
+    lb_append(out, lbb->leaves.buf, lbb->leaves.len);
+    lb_append(out, lbb->strtab.buf, lbb->strtab.len);
+    lb_align(out);
+    lb_append(out, lbb->data.buf, lbb->data.len);
+    lb_align(out);
+  }
+}
+
+
+static void lb_builder_free(lb_builder_t *lbb) {
+  lives_freep((void **)&lbb->strhash);
+  lives_freep((void **)&lbb->leaves.buf);
+  lives_freep((void **)&lbb->strtab.buf);
+  lives_freep((void **)&lbb->data.buf);
+}
+
+
+static int lb_jnl_add_dels(lives_layout_jnl_t *jnl, lb_buf_t *out) {
+  // records for the events reported as unlinked
+  int64_t *dels = (int64_t *)jnl->dels.buf, ndels = jnl->dels.len / 8;
+  for (int64_t i = 0; i < ndels; i++) lb_jnl_add_rec(out, NULL, LAYOUT_JNL_OP_DEL, 0, dels[i], 0, NULL);
+  jnl->dels.len = 0;
+  return (int)ndels;
+}
+
+
+static int lb_jnl_add_list(lives_layout_jnl_t *jnl, lb_builder_t *lbb, weed_event_list_t *event_list, lb_buf_t *out) {
+  uint64_t list_hash = lb_jnl_encode(lbb, event_list, 0);
+  int nrecs = 0;
+  if (out && list_hash != jnl->list_hash) {
+    lb_jnl_add_rec(out, lbb, LAYOUT_JNL_OP_LIST, LAYOUT_JNL_CONTENT, 0, 0, event_list);
+    nrecs++;
+  }
+  jnl->list_hash = list_hash;
+  return nrecs;
+}
+
+
+static int lb_jnl_scan(lives_layout_jnl_t *jnl, weed_event_list_t *event_list, lb_buf_t *out) {
+  // compare the whole of event_list with the state when it was last recorded, adding records for the differences
+  // to out; if out is NULL, the state is simply rebuilt, with new ids
+  // returns the number of records added. Must be called with jnl->mutex locked
+  weed_event_t *event;
+  lb_evmap_t *ent, *old;
+  lb_idmap_t map;
+  lb_builder_t lbb;
+  int64_t prev_id = 0;
+  int nrecs = 0;
+
+  lives_memset(&map, 0, sizeof(map));
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) {
+    old = out ? lb_jnl_find(jnl, event) : NULL;
+    ent = lb_idmap_add(&map, event);
+    ent->idx = old ? old->idx : jnl->next_id++;
+    ent->after = prev_id;
+    prev_id = ent->idx;
+  }
+
+  // encoding needs to look up the ids of referenced events
+  lives_memset(&lbb, 0, sizeof(lbb));
+  lbb.idmap = &map;
+
+  if (out) {
+    // events which were removed
+    nrecs += lb_jnl_add_dels(jnl, out);
+    for (int64_t i = 0; i < jnl->map.size; i++) {
+      old = &jnl->map.slots[i];
+      if (!old->event || (old->flags & LB_JNL_NEW) || lb_idmap_find(&map, old->event)) continue;
+      lb_jnl_add_rec(out, NULL, LAYOUT_JNL_OP_DEL, 0, old->idx, 0, NULL);
+      nrecs++;
+    }
+  }
+
+  // then, in list order, events which are new, changed or moved, so that the preceding event
+  // is always in place by the time an event is inserted after it
+  for (event = get_first_event(event_list); event; event = get_next_event(event)) {
+    uint32_t flags = 0;
+    ent = lb_idmap_find(&map, event);
+    ent->hash = lb_jnl_encode(&lbb, event, ent->idx);
+    if (!out) continue;
+    old = lb_jnl_find(jnl, event);
+    if (!old || old->hash != ent->hash) flags = LAYOUT_JNL_CONTENT;
+    else if (old->after == ent->after) continue;
+    lb_jnl_add_rec(out, &lbb, LAYOUT_JNL_OP_PUT, flags, ent->idx, ent->after, event);
+    nrecs++;
+  }
+
+  nrecs += lb_jnl_add_list(jnl, &lbb, event_list, out);
+
+  // the current state, with hashes, becomes the reference for next time
+  lives_free(jnl->map.slots);
+  jnl->map = map;
+  jnl->event_list = event_list;
+  jnl->dirty.len = jnl->dels.len = 0;
+  jnl->rescan = FALSE;
+
+  lb_builder_free(&lbb);
+  return nrecs;
+}
+
+
+static int lb_jnl_changes(lives_layout_jnl_t *jnl, weed_event_list_t *event_list, lb_buf_t *out) {
+  // add records for the events reported since the last record
+  // returns the number of records added, or -1 if the list does not match what was reported, in which case
+  // the state is no longer usable. Must be called with jnl->mutex locked
+  weed_event_t **dirty = (weed_event_t **)jnl->dirty.buf, *event, *prev;
+  int64_t ndirty = jnl->dirty.len / sizeof(weed_event_t *);
+  lb_evmap_t *ent, *pent;
+  lb_builder_t lbb;
+  int nrecs = lb_jnl_add_dels(jnl, out);
+
+  lives_memset(&lbb, 0, sizeof(lbb));
+  lbb.idmap = &jnl->map;
+
+  for (int64_t i = 0; i < ndirty; i++) {
+    ent = lb_idmap_find(&jnl->map, dirty[i]);
+    if (!ent || !(ent->flags & LB_JNL_DIRTY)) continue;
+
+    // an event is put after the one preceding it, so any dirty events before this one must go first
+    for (event = dirty[i]; (pent = lb_idmap_find(&jnl->map, get_prev_event(event)))
+         && (pent->flags & LB_JNL_DIRTY); event = pent->event);
+
+    for (;; event = get_next_event(event)) {
+      uint32_t flags = 0;
+      uint64_t hash;
+      int64_t after = 0;
+
+      ent = lb_idmap_find(&jnl->map, event);
+      if ((prev = get_prev_event(event))) {
+        if (!(pent = lb_idmap_find(&jnl->map, prev))) nrecs = -1;
+        else after = pent->idx;
+      } else if (event != get_first_event(event_list)) nrecs = -1;
+      if (nrecs < 0) goto done;
+
+      hash = lb_jnl_encode(&lbb, event, ent->idx);
+      if ((ent->flags & LB_JNL_NEW) || hash != ent->hash) flags = LAYOUT_JNL_CONTENT;
+      if (flags || after != ent->after) {
+        lb_jnl_add_rec(out, &lbb, LAYOUT_JNL_OP_PUT, flags, ent->idx, after, event);
+        nrecs++;
+      }
+      ent->hash = hash;
+      ent->after = after;
+      ent->flags = 0;
+      if (event == dirty[i]) break;
+    }
+  }
+
+  nrecs += lb_jnl_add_list(jnl, &lbb, event_list, out);
+
+done:
+  jnl->dirty.len = 0;
+  lb_builder_free(&lbb);
+  return nrecs;
+}
+
+
+static boolean lb_write_file(const char *fname, const void *data1, size_t size1, const void *data2, size_t size2) {
+  // write to a temporary file, then rename it, so fname is always either complete or unchanged
+  char *tmpfile = lives_strdup_printf("%s.tmp", fname);
+  boolean ok = FALSE;
+  int fd = lives_open3(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, DEF_FILE_PERMS);
+  if (fd >= 0) {
+    ok = lives_write(fd, data1, size1, TRUE) == (ssize_t)size1;
+    if (ok && size2) ok = lives_write(fd, data2, size2, TRUE) == (ssize_t)size2;
+    if (ok) ok = lives_fsync(fd);
+    close(fd);
+    if (ok) ok = !rename(tmpfile, fname);
+    if (!ok) lives_rm(tmpfile);
+  }
+  lives_free(tmpfile);
+  return ok;
+}
+
+
+static boolean lb_jnl_write_base(lives_layout_jnl_t *jnl) {
+  // the base must be in place before the new journal replaces the old one;
+  // if we stop in between, the old journal will not match the new base and will be ignored
+  lives_layout_jnl_hdr_t hdr;
+  boolean ok = lb_write_file(jnl->base_file, jnl->base_buf, jnl->base_size, NULL, 0);
+
+  lives_freep((void **)&jnl->base_buf);
+
+  if (ok) {
+    lives_memset(&hdr, 0, sizeof(hdr));
+    lives_memcpy(hdr.magic, LAYOUT_JNL_MAGIC, LAYOUT_BIN_MAGIC_LEN);
+    hdr.version = LAYOUT_JNL_VERSION;
+    hdr.endian = LAYOUT_BIN_ENDIAN;
+    hdr.base_size = jnl->base_size;
+    hdr.base_hash = jnl->base_hash;
+    ok = lb_write_file(jnl->jnl_file, &hdr, sizeof(hdr), NULL, 0);
+  }
+  jnl->failed = !ok;
+  return ok;
+}
+
+
+boolean layout_jnl_compact(lives_layout_jnl_t *jnl, weed_event_list_t *event_list, boolean background) {
+  // write event_list as a new base, and start an empty journal
+  // the list is serialised immediately, so it may be changed as soon as this returns,
+  // but if background is TRUE the files are written by another thread; layout_jnl_sync() waits for this
+  layout_jnl_sync(jnl);
+
+  pthread_mutex_lock(&jnl->mutex);
+  lives_freep((void **)&jnl->map.slots);
+  jnl->map.size = jnl->map.count = 0;
+  jnl->next_id = 1;
+  lb_jnl_scan(jnl, event_list, NULL);
+  pthread_mutex_unlock(&jnl->mutex);
+
+  // from now on, changes to the list are reported to us
+  if (lb_jnl_watching != jnl) {
+    lb_jnl_watching = jnl;
+    event_list_watch(lb_jnl_watch, jnl);
+  }
+
+  jnl->base_size = layout_bin_serialise(event_list, &jnl->base_buf);
+  if (!jnl->base_size) {
+    jnl->failed = TRUE;
+    return FALSE;
+  }
+  jnl->base_hash = lb_hash(LB_HASH_INIT, jnl->base_buf, jnl->base_size);
+  jnl->jnl_size = sizeof(lives_layout_jnl_hdr_t);
+  jnl->nblocks = 0;
+  jnl->failed = FALSE;
+
+  if (!background) return lb_jnl_write_base(jnl);
+
+  jnl->compactor = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, (lives_funcptr_t)lb_jnl_write_base,
+                   WEED_SEED_BOOLEAN, "v", jnl);
+  return TRUE;
+}
+
+
+void layout_jnl_rescan(lives_layout_jnl_t *jnl) {
+  // the next record will compare the whole list, picking up any changes which were not reported
+  pthread_mutex_lock(&jnl->mutex);
+  jnl->rescan = TRUE;
+  pthread_mutex_unlock(&jnl->mutex);
+}
+
+
+boolean layout_jnl_needs_compact(lives_layout_jnl_t *jnl) {
+  if (jnl->failed) return TRUE;
+  return jnl->nblocks >= LAYOUT_JNL_MAX_BLOCKS || jnl->jnl_size > (jnl->base_size >> 1);
+}
+
+
+int layout_jnl_record(lives_layout_jnl_t *jnl, weed_event_list_t *event_list, boolean do_sync) {
+  // append a block with the changes to event_list since it was last recorded or compacted
+  // returns the number of records written, or -1 on error, in which case the journal should be compacted
+  lives_layout_jnl_blk_t blk;
+  lb_buf_t out;
+  int nrecs, fd;
+
+  if (!layout_jnl_sync(jnl)) return -1;
+
+  lives_memset(&out, 0, sizeof(out));
+  lb_append(&out, NULL, sizeof(blk));
+
+  pthread_mutex_lock(&jnl->mutex);
+  if (jnl->rescan || event_list != jnl->event_list || lb_jnl_watching != jnl)
+    nrecs = lb_jnl_scan(jnl, event_list, &out);
+  else nrecs = lb_jnl_changes(jnl, event_list, &out);
+  pthread_mutex_unlock(&jnl->mutex);
+
+  if (nrecs < 0) jnl->failed = TRUE;
+  else if (nrecs > 0) {
+    blk.magic = LAYOUT_JNL_BLOCK_MAGIC;
+    blk.nrecs = nrecs;
+    blk.size = out.len - sizeof(blk);
+    blk.hash = lb_hash(LB_HASH_INIT, out.buf + sizeof(blk), blk.size);
+    lives_memcpy(out.buf, &blk, sizeof(blk));
+
+    // a single write, so a crash leaves at most one partial block
+    fd = lives_open2(jnl->jnl_file, O_WRONLY | O_APPEND);
+    if (fd < 0 || lives_write(fd, out.buf, out.len, TRUE) != (ssize_t)out.len
+        || (do_sync && !lives_fsync(fd))) {
+      // the state has moved on without the block being saved, so the journal is no longer usable
+      jnl->failed = TRUE;
+      nrecs = -1;
+    } else {
+      jnl->jnl_size += out.len;
+      jnl->nblocks++;
+    }
+    if (fd >= 0) close(fd);
+  }
+  lives_free(out.buf);
+  return nrecs;
+}
+
+
+/////////////// replay ///////////////
+
+typedef struct {
+  weed_event_t **byid;
+  uint8_t *linked;
+  int64_t nids;
+} lb_jnl_ctx_t;
+
+#define LB_JNL_MAX_ID 0x7FFFFFFF
+
+
+static weed_event_t *lb_jnl_resolve(void *rdata, int64_t id) {
+  // return the event with id, creating an unlinked shell if it is not known yet
+  lb_jnl_ctx_t *ctx = (lb_jnl_ctx_t *)rdata;
+  if (id <= 0 || id > LB_JNL_MAX_ID) return NULL;
+  if (id >= ctx->nids) {
+    int64_t nids = ctx->nids;
+    while (nids <= id) nids <<= 1;
+    ctx->byid = (weed_event_t **)lives_realloc(ctx->byid, nids * sizeof(weed_event_t *));
+    ctx->linked = (uint8_t *)lives_realloc(ctx->linked, nids);
+    lives_memset(ctx->byid + ctx->nids, 0, (nids - ctx->nids) * sizeof(weed_event_t *));
+    lives_memset(ctx->linked + ctx->nids, 0, nids - ctx->nids);
+    ctx->nids = nids;
+  }
+  if (!ctx->byid[id]) ctx->byid[id] = weed_plant_new(WEED_PLANT_EVENT);
+  return ctx->byid[id];
+}
+
+
+static void lb_jnl_clear_leaves(weed_plant_t *plant) {
+  // remove everything except the type and the list links
+  char **leaves = weed_plant_list_leaves(plant, NULL);
+  for (int i = 0; leaves[i]; i++) {
+    if (lives_strcmp(leaves[i], WEED_LEAF_TYPE) && lives_strcmp(leaves[i], WEED_LEAF_NEXT)
+        && lives_strcmp(leaves[i], WEED_LEAF_PREVIOUS) && lives_strcmp(leaves[i], WEED_LEAF_FIRST)
+        && lives_strcmp(leaves[i], WEED_LEAF_LAST)) weed_leaf_delete(plant, leaves[i]);
+    _ext_free(leaves[i]);
+  }
+  _ext_free(leaves);
+}
+
+
+static void lb_jnl_unlink(weed_event_list_t *event_list, weed_event_t *event) {
+  weed_event_t *prev = get_prev_event(event), *next = get_next_event(event);
+  if (prev) weed_set_voidptr_value(prev, WEED_LEAF_NEXT, next);
+  else weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, next);
+  if (next) weed_set_voidptr_value(next, WEED_LEAF_PREVIOUS, prev);
+  else weed_set_voidptr_value(event_list, WEED_LEAF_LAST, prev);
+  event_list_index_invalidate();
+}
+
+
+static void lb_jnl_link_after(weed_event_list_t *event_list, weed_event_t *prev, weed_event_t *event) {
+  // we link directly rather than via insert_event_after(), since the list may be briefly out of order
+  weed_event_t *next = prev ? get_next_event(prev) : get_first_event(event_list);
+  weed_set_voidptr_value(event, WEED_LEAF_PREVIOUS, prev);
+  weed_set_voidptr_value(event, WEED_LEAF_NEXT, next);
+  if (prev) weed_set_voidptr_value(prev, WEED_LEAF_NEXT, event);
+  else weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, event);
+  if (next) weed_set_voidptr_value(next, WEED_LEAF_PREVIOUS, event);
+  else weed_set_voidptr_value(event_list, WEED_LEAF_LAST, event);
+  event_list_index_invalidate();
+}
+
+
+static uint64_t lb_jnl_rec_size(const lives_layout_jnl_rec_t *rec, uint64_t avail) {
+  // returns the total size of rec including its leaves and data, or 0 if it does not fit in avail
+  uint64_t size = sizeof(lives_layout_jnl_rec_t), lsize;
+  if (avail < size) return 0;
+  if (!(rec->flags & LAYOUT_JNL_CONTENT)) return size;
+  if (rec->strtab_size > avail || rec->data_size > avail) return 0;
+  lsize = (uint64_t)rec->nleaves * sizeof(lives_layout_bin_leaf_t);
+  if (lsize > avail) return 0;
+  size += LB_ALIGN(lsize + rec->strtab_size) + LB_ALIGN(rec->data_size);
+  return size <= avail ? size : 0;
+}
+
+
+static boolean lb_jnl_apply(lb_jnl_ctx_t *ctx, weed_event_list_t *event_list, const lives_layout_jnl_rec_t *rec) {
+  const uint8_t *payload = (const uint8_t *)(rec + 1);
+  weed_plant_t *plant, *prev = NULL;
+
+  if (rec->op == LAYOUT_JNL_OP_DEL) {
+    if (rec->id <= 0 || rec->id >= ctx->nids || !ctx->byid[rec->id]) return FALSE;
+    if (ctx->linked[rec->id]) lb_jnl_unlink(event_list, ctx->byid[rec->id]);
+    weed_plant_free(ctx->byid[rec->id]);
+    ctx->byid[rec->id] = NULL;
+    ctx->linked[rec->id] = 0;
+    return TRUE;
+  }
+
+  if (rec->op == LAYOUT_JNL_OP_LIST) plant = event_list;
+  else if (rec->op == LAYOUT_JNL_OP_PUT) {
+    if (rec->after == rec->id) return FALSE;
+    if (rec->after) {
+      if (rec->after < 0 || rec->after >= ctx->nids || !ctx->linked[rec->after]) return FALSE;
+      prev = ctx->byid[rec->after];
+    }
+    if (!(plant = lb_jnl_resolve(ctx, rec->id))) return FALSE;
+  } else return FALSE;
+
+  if (rec->flags & LAYOUT_JNL_CONTENT) {
+    lives_layout_bin_hdr_t vhdr;
+    lives_layout_bin_t view;
+    size_t lsize = rec->nleaves * sizeof(lives_layout_bin_leaf_t);
+
+    lives_memset(&vhdr, 0, sizeof(vhdr));
+    lives_memset(&view, 0, sizeof(view));
+    vhdr.strtab_size = rec->strtab_size;
+    view.hdr = &vhdr;
+    view.leaves = (const lives_layout_bin_leaf_t *)payload;
+    view.strtab = (const char *)payload + lsize;
+    view.data = payload + LB_ALIGN(lsize + rec->strtab_size);
+
+    if (rec->strtab_size && view.strtab[rec->strtab_size - 1]) return FALSE;
+    if (!lb_leaves_ok(view.leaves, rec->nleaves, rec->strtab_size, rec->data_size)) return FALSE;
+
+    lb_jnl_clear_leaves(plant);
+    if (plant != event_list) {
+      weed_set_int_value(plant, WEED_LEAF_EVENT_TYPE, rec->etype);
+      weed_event_set_timecode(plant, rec->tc);
+    }
+    lb_set_leaves(&view, plant, rec->id, 0, rec->nleaves, lb_jnl_resolve, ctx);
+  }
+
+  if (plant != event_list) {
+    if (ctx->linked[rec->id]) lb_jnl_unlink(event_list, plant);
+    lb_jnl_link_after(event_list, prev, plant);
+    ctx->linked[rec->id] = 1;
+  }
+  return TRUE;
+}
+
+
+int64_t layout_jnl_replay(lives_layout_bin_t *lb, weed_event_list_t *event_list, const char *jnl_file) {
+  // apply the journal to event_list, which should hold the events from lb, in order (see layout_bin_materialise())
+  // returns the number of blocks applied, or -1 if the journal cannot be read or belongs to a different base
+  const lives_layout_jnl_hdr_t *hdr;
+  const uint8_t *base;
+  lb_jnl_ctx_t ctx;
+  weed_event_t *event;
+  struct stat st;
+  uint64_t offs;
+  int64_t i, nblocks = 0;
+  boolean ok = TRUE;
+  int fd = lives_open2(jnl_file, O_RDONLY);
+
+  if (fd < 0) return -1;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(lives_layout_jnl_hdr_t)) {
+    close(fd);
+    return -1;
+  }
+  base = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return -1;
+
+  hdr = (const lives_layout_jnl_hdr_t *)base;
+  if (lives_memcmp(hdr->magic, LAYOUT_JNL_MAGIC, LAYOUT_BIN_MAGIC_LEN) || hdr->version != LAYOUT_JNL_VERSION
+      || hdr->endian != LAYOUT_BIN_ENDIAN || hdr->base_size != lb->hdr->total_size
+      || hdr->base_hash != lb_hash(LB_HASH_INIT, lb->base, lb->hdr->total_size)) {
+    munmap((void *)base, st.st_size);
+    return -1;
+  }
+
+  ctx.nids = lb->hdr->nevents + 2;
+  ctx.byid = (weed_event_t **)lives_calloc(ctx.nids, sizeof(weed_event_t *));
+  ctx.linked = (uint8_t *)lives_calloc(ctx.nids, 1);
+  for (event = get_first_event(event_list), i = 1; event && i < ctx.nids; event = get_next_event(event), i++) {
+    ctx.byid[i] = event;
+    ctx.linked[i] = 1;
+  }
+
+  for (offs = sizeof(lives_layout_jnl_hdr_t); ok && offs + sizeof(lives_layout_jnl_blk_t) <= (uint64_t)st.st_size;) {
+    const lives_layout_jnl_blk_t *blk = (const lives_layout_jnl_blk_t *)(base + offs);
+    const uint8_t *recs = (const uint8_t *)(blk + 1);
+    uint64_t roffs = 0, rsize;
+
+    offs += sizeof(lives_layout_jnl_blk_t);
+    // an incomplete final block is expected after a crash
+    if (blk->magic != LAYOUT_JNL_BLOCK_MAGIC || blk->size > st.st_size - offs || (blk->size & 7)
+        || blk->hash != lb_hash(LB_HASH_INIT, recs, blk->size)) break;
+
+    for (uint32_t r = 0; r < blk->nrecs; r++) {
+      const lives_layout_jnl_rec_t *rec = (const lives_layout_jnl_rec_t *)(recs + roffs);
+      if (!(rsize = lb_jnl_rec_size(rec, blk->size - roffs)) || !lb_jnl_apply(&ctx, event_list, rec)) {
+        ok = FALSE;
+        break;
+      }
+      roffs += rsize;
+    }
+    if (ok) nblocks++;
+    offs += blk->size;
+  }
+
+  // drop anything referred to but never placed in the list
+  for (i = 1; i < ctx.nids; i++) if (ctx.byid[i] && !ctx.linked[i]) weed_plant_free(ctx.byid[i]);
+  lives_free(ctx.byid);
+  lives_free(ctx.linked);
+  munmap((void *)base, st.st_size);
+
+  event_list_index_drop(event_list);
+  return nblocks;
+}
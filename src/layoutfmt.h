@@ -0,0 +1,166 @@
+// layoutfmt.h
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// compact binary format for event_lists (layouts)
+
+#ifndef HAS_LIVES_LAYOUTFMT_H
+#define HAS_LIVES_LAYOUTFMT_H
+
+// the file is laid out as a header followed by 8 byte aligned sections:
+// - event types (int32) and timecodes (int64), one of each per event, in list order
+// - leaf index (uint32 per event + 1), giving the range of leaves belonging to each event
+//   leaves after the last event's range belong to the event_list plant
+// - leaf records, fixed size
+// - string table: all keys and string values, interned and NUL terminated
+// - data: the leaf values, 8 byte aligned per leaf
+//
+// pointers to other events are stored relative to the index of the owning event, so the file
+// can be mmapped and events materialised into plants only as they are needed.
+// "next" and "previous" are implicit in the ordering, and timecode and event_type are held in the columns
+
+#define LAYOUT_BIN_MAGIC "LiVESLB" // including the terminating NUL this is 8 bytes
+#define LAYOUT_BIN_MAGIC_LEN 8
+#define LAYOUT_BIN_VERSION 1
+#define LAYOUT_BIN_ENDIAN 0x01020304
+
+// leaf flags
+#define LAYOUT_LEAF_EVREF	(1 << 0) ///< pointer values may be references to other events
+#define LAYOUT_LEAF_IDREF	(1 << 1) ///< event references to be materialised as int64 ids (see event_list_rectify)
+
+#define LAYOUT_STR_NULL 0xFFFFFFFF
+
+typedef struct {
+  char magic[LAYOUT_BIN_MAGIC_LEN];
+  uint32_t version;
+  uint32_t endian;
+  uint64_t nevents;
+  uint64_t nleaves;
+  uint64_t list_leaf_start; ///< leaves from here to nleaves belong to the event_list
+  uint64_t off_types;
+  uint64_t off_tcs;
+  uint64_t off_leafidx;
+  uint64_t off_leaves;
+  uint64_t off_strtab;
+  uint64_t strtab_size;
+  uint64_t off_data;
+  uint64_t data_size;
+  uint64_t total_size;
+} lives_layout_bin_hdr_t;
+
+typedef struct {
+  uint32_t key; ///< offset in string table
+  int32_t seed_type;
+  uint32_t nvals;
+  uint32_t flags;
+  uint64_t offset; ///< offset in data section
+} lives_layout_bin_leaf_t;
+
+typedef struct {
+  const uint8_t *base;
+  size_t size;
+  boolean mapped; ///< base is a mmapped file
+  const lives_layout_bin_hdr_t *hdr;
+  const int32_t *etypes;
+  const int64_t *tcs;
+  const uint32_t *leafidx;
+  const lives_layout_bin_leaf_t *leaves;
+  const char *strtab;
+  const uint8_t *data;
+  weed_event_t **plants; ///< events materialised so far; may be empty shells if not yet filled
+  uint8_t *filled;
+} lives_layout_bin_t;
+
+// saving
+size_t layout_bin_serialise(weed_event_list_t *, uint8_t **pbuf);
+boolean layout_bin_save(int fd, weed_event_list_t *);
+
+// loading
+boolean layout_bin_is_layout(const void *buf, size_t size);
+boolean layout_bin_file_is_layout(const char *fname);
+
+lives_layout_bin_t *layout_bin_map_mem(const uint8_t *buf, size_t size);
+lives_layout_bin_t *layout_bin_map_file(const char *fname);
+void layout_bin_unmap(lives_layout_bin_t *);
+
+// column access, does not create any plants
+LIVES_INLINE int64_t layout_bin_get_nevents(lives_layout_bin_t *lb) {return lb->hdr->nevents;}
+LIVES_INLINE int layout_bin_get_event_type(lives_layout_bin_t *lb, int64_t i) {return lb->etypes[i];}
+LIVES_INLINE weed_timecode_t layout_bin_get_timecode(lives_layout_bin_t *lb, int64_t i) {return lb->tcs[i];}
+
+// materialisation; plants returned here are owned by the map until layout_bin_append_events() is called
+weed_event_t *layout_bin_get_event(lives_layout_bin_t *, int64_t i);
+weed_event_list_t *layout_bin_get_list_plant(lives_layout_bin_t *);
+int64_t layout_bin_append_events(lives_layout_bin_t *, weed_event_list_t *);
+weed_event_list_t *layout_bin_materialise(lives_layout_bin_t *);
+
+// journal of changes to an event_list, relative to a base layout saved in the binary format.
+// the file is a header followed by blocks, each holding the records needed to bring the list up to date
+// with its state when the block was written. Events are identified by ids: in the base, event n has id n + 1,
+// events added later are given new ids. A block is only applied if it is complete and its checksum matches,
+// so a write cut short by a crash loses only the final block.
+//
+// compacting writes the current list as a new base, then starts a new, empty journal
+//
+// only the events reported as changed by events.c since the last block are encoded when recording;
+// layout_jnl_rescan() makes the next record compare the whole list instead
+
+#define LAYOUT_JNL_MAGIC "LiVESLJ"
+#define LAYOUT_JNL_VERSION 1
+#define LAYOUT_JNL_BLOCK_MAGIC 0x4B4C424A
+
+#define LAYOUT_JNL_MAX_BLOCKS 256 ///< compact after this many blocks, even if the journal is still small
+
+// record ops
+#define LAYOUT_JNL_OP_PUT	1 ///< insert, move or update an event
+#define LAYOUT_JNL_OP_DEL	2 ///< remove an event
+#define LAYOUT_JNL_OP_LIST	3 ///< update the leaves of the event_list plant
+
+// record flags
+#define LAYOUT_JNL_CONTENT	(1 << 0) ///< record carries leaves; for PUT without this, the event is only moved
+
+typedef struct {
+  char magic[LAYOUT_BIN_MAGIC_LEN];
+  uint32_t version;
+  uint32_t endian;
+  uint64_t base_size;
+  uint64_t base_hash; ///< checksum of the base file this journal applies to
+} lives_layout_jnl_hdr_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t nrecs;
+  uint64_t size; ///< size of the records following
+  uint64_t hash; ///< checksum of the records
+} lives_layout_jnl_blk_t;
+
+// each record is followed by its leaves, string table and data, as for the base format;
+// event references are relative to the event's id rather than to an index
+typedef struct {
+  uint32_t op;
+  uint32_t flags;
+  int64_t id;
+  int64_t after; ///< id of the preceding event, or 0 if the event is first in the list
+  int32_t etype;
+  uint32_t nleaves;
+  int64_t tc;
+  uint64_t strtab_size;
+  uint64_t data_size;
+} lives_layout_jnl_rec_t;
+
+typedef struct _lives_layout_jnl lives_layout_jnl_t;
+
+lives_layout_jnl_t *layout_jnl_new(const char *base_file, const char *jnl_file);
+void layout_jnl_free(lives_layout_jnl_t *);
+
+int layout_jnl_record(lives_layout_jnl_t *, weed_event_list_t *, boolean do_sync);
+boolean layout_jnl_compact(lives_layout_jnl_t *, weed_event_list_t *, boolean background);
+boolean layout_jnl_needs_compact(lives_layout_jnl_t *);
+void layout_jnl_rescan(lives_layout_jnl_t *);
+boolean layout_jnl_sync(lives_layout_jnl_t *);
+
+int64_t layout_jnl_replay(lives_layout_bin_t *, weed_event_list_t *, const char *jnl_file);
+
+#endif
@@ -1227,7 +1227,7 @@ void reset_effort(void) {
     free_tabdata(force);
     force = NULL;
   }
-  prefs->pb_quality = future_prefs->pb_quality;
+  prefs->pb_quality = qctl_pb_quality(future_prefs->pb_quality);
   inited = TRUE;
   struggling = 0;
   if ((mainw->is_rendering || (mainw->multitrack
@@ -1257,6 +1257,9 @@ void update_effort(float impulse) {
   if (mainw->effort > EFFORT_RANGE_MAX) mainw->effort = EFFORT_RANGE_MAX;
   if (mainw->effort < -EFFORT_RANGE_MAX) mainw->effort = -EFFORT_RANGE_MAX;
 
+  // the plan cycle quality controller, if active, decides playback quality from the same load
+  if (qctl_active()) return;
+
   if (mainw->effort <= 0) struggling--;
   else struggling++;
 
@@ -2832,6 +2835,205 @@ int set_thread_cpuid(pthread_t pth) {
 }
 
 
+#define MAX_NUMA_NODES 16
+#define SYS_NODE_CPULIST "/sys/devices/system/node/node%d/cpulist"
+
+#ifdef CPU_ZERO
+static cpu_set_t rt_cpus, other_cpus;
+static cpu_set_t node_cpus[MAX_NUMA_NODES];
+#endif
+static int n_nodes = 0;
+static boolean sched_ready = FALSE, have_rt_cpus = FALSE;
+static volatile boolean rt_denied = FALSE;
+
+static const char *sched_class_names[] = {"none", "worker", "player", "audio", "decoder"};
+
+const char *sched_class_name(int sclass) {
+  if (sclass < SCHED_CLASS_NONE || sclass > SCHED_CLASS_DECODER) return "unknown";
+  return sched_class_names[sclass];
+}
+
+
+#ifdef CPU_ZERO
+static int parse_cpulist(const char *list, cpu_set_t *cpuset) {
+  // parses a cpu list in the format used by the kernel, e.g. "0-3,8,10-11"
+  // returns the number of cpus in cpuset
+  const char *p = list;
+  char *end;
+  long first, last;
+  CPU_ZERO(cpuset);
+  while (*p) {
+    while (*p == ',' || *p == ' ' || *p == '\n') p++;
+    if (!*p) break;
+    first = strtol(p, &end, 10);
+    if (end == p) break;
+    last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(++p, &end, 10);
+      if (end == p) break;
+      p = end;
+    }
+    for (long i = first; i >= 0 && i <= last && i < CPU_SETSIZE; i++) CPU_SET(i, cpuset);
+  }
+  return CPU_COUNT(cpuset);
+}
+#endif
+
+
+void sched_policy_init(void) {
+  // must be called after prefs are loaded, and before the threadpool is started
+#ifdef CPU_ZERO
+  char buff[1024];
+  cpu_set_t cpuset;
+  FILE *file;
+  char *fname;
+  int i;
+
+  CPU_ZERO(&other_cpus);
+  for (i = 0; i < capable->hw.ncpus && i < CPU_SETSIZE; i++) CPU_SET(i, &other_cpus);
+
+  if (*prefs->rt_cores && parse_cpulist(prefs->rt_cores, &cpuset)) {
+    CPU_AND(&rt_cpus, &cpuset, &other_cpus);
+    if (CPU_COUNT(&rt_cpus)) {
+      // everything else is kept off the reserved cpus, unless that would leave nowhere to run
+      CPU_XOR(&cpuset, &other_cpus, &rt_cpus);
+      if (CPU_COUNT(&cpuset)) other_cpus = cpuset;
+      have_rt_cpus = TRUE;
+    }
+  }
+
+  if (prefs->numa_workers) {
+    for (i = 0; n_nodes < MAX_NUMA_NODES; i++) {
+      fname = lives_strdup_printf(SYS_NODE_CPULIST, i);
+      file = fopen(fname, "r");
+      lives_free(fname);
+      if (!file) break;
+      if (!fgets(buff, 1024, file)) *buff = 0;
+      fclose(file);
+      if (!parse_cpulist(buff, &cpuset)) continue;
+      CPU_AND(&node_cpus[n_nodes], &cpuset, &other_cpus);
+      // skip nodes which have only reserved cpus
+      if (CPU_COUNT(&node_cpus[n_nodes])) n_nodes++;
+    }
+    // with a single node there is nothing to choose
+    if (n_nodes < 2) n_nodes = 0;
+  }
+
+  if (prefs->rt_sched_policy != RT_SCHED_NONE && !have_rt_cpus)
+    LIVES_WARN("realtime scheduling needs reserved cpus (rt_cores), player and audio threads will use the normal scheduler");
+
+  if (have_rt_cpus || n_nodes) sched_ready = TRUE;
+  if (sched_ready)
+    d_print_debug("SCHED POLICY: %d reserved cpus, %d numa nodes for workers, realtime policy %d\n",
+                  have_rt_cpus ? CPU_COUNT(&rt_cpus) : 0, n_nodes, prefs->rt_sched_policy);
+#endif
+}
+
+
+boolean sched_policy_active(void) {return sched_ready;}
+
+
+LIVES_LOCAL_INLINE boolean is_rt_class(int sclass) {
+  return sclass == SCHED_CLASS_PLAYER || sclass == SCHED_CLASS_AUDIO;
+}
+
+
+int sched_policy_apply(int sclass) {
+  // pool threads run all kinds of tasks, so this is called when a task starts, rather than when the thread
+  // is created; the pool restores the worker class when the task returns
+  int oclass = THREADVAR(sched_class);
+  THREADVAR(sched_class) = sclass;
+  if (!sched_ready || sclass == oclass) return oclass;
+#ifdef CPU_ZERO
+  else {
+    pthread_t self = pthread_self();
+    cpu_set_t *cpuset = &other_cpus;
+    struct sched_param sparam;
+    int policy = SCHED_OTHER, err;
+
+    if (is_rt_class(sclass)) {
+      // the player spins with sched_yield() when it does not pace, which would starve SCHED_OTHER threads
+      // sharing its cpu, so the realtime policy is only used on reserved cpus
+      if (have_rt_cpus) {
+        cpuset = &rt_cpus;
+        if (prefs->rt_sched_policy != RT_SCHED_NONE)
+          policy = prefs->rt_sched_policy == RT_SCHED_RR ? SCHED_RR : SCHED_FIFO;
+      }
+    } else if (sclass == SCHED_CLASS_WORKER && n_nodes) {
+      int slot_id = THREADVAR(slot_id);
+      if (slot_id >= 0) cpuset = &node_cpus[slot_id % n_nodes];
+    }
+
+    if (have_rt_cpus || n_nodes) {
+      err = pthread_setaffinity_np(self, sizeof(cpu_set_t), cpuset);
+      if (err) {LIVES_ERROR("pthread aff error");}
+    }
+
+    if (rt_denied || (policy == SCHED_OTHER && !is_rt_class(oclass))) return oclass;
+
+    if (policy == SCHED_OTHER) sparam.sched_priority = 0;
+    else {
+      sparam.sched_priority = sched_get_priority_min(policy)
+                              + (sclass == SCHED_CLASS_AUDIO ? RT_PRIO_AUDIO : RT_PRIO_PLAYER);
+      if (sparam.sched_priority > sched_get_priority_max(policy))
+        sparam.sched_priority = sched_get_priority_max(policy);
+    }
+    err = pthread_setschedparam(self, policy, &sparam);
+    if (err == EPERM) {
+      // not permitted (no CAP_SYS_NICE or RLIMIT_RTPRIO too low); carry on with the normal scheduler
+      if (!rt_denied) {
+        rt_denied = TRUE;
+        LIVES_WARN("realtime scheduling is not permitted, player and audio threads will use the normal scheduler");
+      }
+    } else if (err) {LIVES_ERROR("pthread sched error");}
+  }
+#endif
+  return oclass;
+}
+
+
+boolean get_thread_sched_stats(int tid, int *cpu, int64_t *nvol, int64_t *ninvol) {
+#if IS_LINUX_GNU
+  char buff[1024], *fname, *p, *tok, *sptr;
+  FILE *file;
+  int i;
+
+  *cpu = -1;
+  *nvol = *ninvol = -1;
+
+  fname = lives_strdup_printf("%s/%d/status", LIVES_PROC_DIR, tid);
+  file = fopen(fname, "r");
+  lives_free(fname);
+  if (!file) return FALSE;
+  while (fgets(buff, 1024, file)) {
+    if (sscanf(buff, "voluntary_ctxt_switches: %"SCNd64, nvol) == 1) continue;
+    sscanf(buff, "nonvoluntary_ctxt_switches: %"SCNd64, ninvol);
+  }
+  fclose(file);
+
+  // the cpu last run on is field 39 of stat; the fields start after the command name, which is in brackets
+  fname = lives_strdup_printf("%s/%d/stat", LIVES_PROC_DIR, tid);
+  file = fopen(fname, "r");
+  lives_free(fname);
+  if (file) {
+    if (fgets(buff, 1024, file) && (p = strrchr(buff, ')'))) {
+      for (i = 3, tok = strtok_r(p + 1, " ", &sptr); tok; i++, tok = strtok_r(NULL, " ", &sptr)) {
+        if (i == 39) {
+          *cpu = atoi(tok);
+          break;
+        }
+      }
+    }
+    fclose(file);
+  }
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
 typedef struct {
   uint64_t tot, idlet;
   int64_t ret;
@@ -280,6 +280,34 @@ double check_disk_pressure(double current);
 
 int set_thread_cpuid(pthread_t pth);
 
+// thread scheduling policy
+// each thread is given a class when it starts a task; the class decides which cpus it may run on
+// and, for the player and audio, whether it runs with a realtime scheduler (prefs->rt_sched_policy)
+// player and audio threads run on the cpus in prefs->rt_cores, and all other threads avoid them.
+// The realtime scheduler is only used when prefs->rt_cores is set.
+// With prefs->numa_workers, each pool thread stays on one NUMA node, assigned by slot number
+#define RT_SCHED_NONE 0
+#define RT_SCHED_FIFO 1
+#define RT_SCHED_RR 2
+
+// realtime priorities, relative to the minimum for the policy. Audio is highest since an underrun is audible
+#define RT_PRIO_PLAYER 10
+#define RT_PRIO_AUDIO 20
+
+#define SCHED_CLASS_NONE 0
+#define SCHED_CLASS_WORKER 1
+#define SCHED_CLASS_PLAYER 2
+#define SCHED_CLASS_AUDIO 3
+#define SCHED_CLASS_DECODER 4
+
+void sched_policy_init(void);
+int sched_policy_apply(int sclass); ///< applies to the calling thread, returns the previous class
+boolean sched_policy_active(void);
+const char *sched_class_name(int sclass);
+
+/// reads the current cpu and the voluntary / involuntary context switches for thread tid
+boolean get_thread_sched_stats(int tid, int *cpu, int64_t *nvol, int64_t *ninvol);
+
 typedef struct {
   uint64_t boottime;
   float *loads;
@@ -568,6 +568,7 @@ enum {
 #define LIVES_FILE_EXT_WAV "wav"
 
 #define LIVES_FILE_EXT_LAYOUT "lay"
+#define LIVES_FILE_EXT_LAYOUT_JOURNAL "jnl"
 
 #define LIVES_FILE_EXT_RFX_SCRIPT "script"
 
@@ -593,6 +594,7 @@ enum {
 #define CLIP_BINFMT_CHECK "LiVESXXX"
 #define CLIP_AUDIO_FILENAME "audio"
 #define CLIP_TEMP_AUDIO_FILENAME "audiodump." LIVES_FILE_EXT_PCM
+#define PEAK_CACHE_FILENAME CLIP_AUDIO_FILENAME ".peaks"
 
 #define WORKDIR_LITERAL "workdir"
 #define WORKDIR_LITERAL_LEN 7
@@ -1856,7 +1858,7 @@ typedef struct {
 
   boolean gen_started_play;
 
-  lives_audio_buf_t *afbuffer; ///< used for buffering / feeding audio to video generators
+  lives_aarena_t *aarena; ///< used for buffering / feeding audio to video generators
 
   volatile lives_audio_buf_t *audio_frame_buffer_aux; ///< used for buffering / feeding to loopback
   lives_audio_buf_t *afb_aux[2]; ///< used for buffering / feeding audio to loopback
@@ -43,6 +43,51 @@ LIVES_GLOBAL_INLINE double gaussian(double x, double a, double m, double s1, dou
   return a * exp(-(t * t) / 2.);
 }
 
+
+void lives_fft(float *re, float *im, int log2n) {
+  // in place iterative radix-2 complex FFT, size 1 << log2n; output is unnormalised
+  // (same scaling as fftw), so for real input, bins 0 to n / 2 hold the spectrum
+  int n = 1 << log2n, half, a, b;
+
+  for (int i = 1, j = 0; i < n; i++) {
+    // bit reversal permutation
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float t = re[i];
+      re[i] = re[j];
+      re[j] = t;
+      t = im[i];
+      im[i] = im[j];
+      im[j] = t;
+    }
+  }
+
+  for (int len = 2; len <= n; len <<= 1) {
+    double ang = -2. * M_PI / (double)len;
+    double wr = cos(ang), wi = sin(ang);
+    half = len >> 1;
+    for (int i = 0; i < n; i += len) {
+      double cr = 1., ci = 0., t;
+      for (int k = 0; k < half; k++) {
+        float xr, xi;
+        a = i + k;
+        b = a + half;
+        xr = re[b] * cr - im[b] * ci;
+        xi = re[b] * ci + im[b] * cr;
+        re[b] = re[a] - xr;
+        im[b] = im[a] - xi;
+        re[a] += xr;
+        im[a] += xi;
+        t = cr * wr - ci * wi;
+        ci = cr * wi + ci * wr;
+        cr = t;
+	// *INDENT-OFF*
+      }}}
+  // *INDENT-ON*
+}
+
 LIVES_GLOBAL_INLINE uint32_t get_2pow(uint32_t x) {
   // return largest 2 ** n <= x
   x |= (x >> 1); x |= (x >> 2); x |= (x >> 4); x |= (x >> 8); x |= (x >> 16);
@@ -155,6 +155,8 @@ uint64_t get_satisfactory_value(uint64_t val, uint64_t lim, boolean less);
 
 double gaussian(double x, double a, double m, double s1, double s2);
 
+void lives_fft(float *re, float *im, int log2n);
+
 int hextodec(const char *string);
 
 uint32_t make_bitmask32(int hi, int lo);
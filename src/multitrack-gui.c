@@ -63,6 +63,7 @@
 #include "paramwindow.h"
 #include "callbacks.h"
 #include "multitrack-gui.h"
+#include "thumbcache.h"
 
 static int aofile;
 static int afd;
@@ -151,6 +152,30 @@ static void draw_soundwave(LiVESWidget *ebox, lives_painter_surface_t *surf, int
 
     lives_painter_set_source_rgb(cr, 0.5, 0.5, 0.5);
 
+    if (vel > 0. && offset_end >= offset_start) {
+      // draw min / max for each pixel from the peak cache, falling back to reading the audio
+      // for anything not yet cached
+      int npix = offset_end - offset_start + 1, done;
+      float *mins = (float *)lives_malloc(npix * sizeof(float));
+      float *maxs = (float *)lives_malloc(npix * sizeof(float));
+      double height = (double)lives_widget_get_allocation_height(ebox);
+      double atime = chnum == 0 ? mainw->files[fnum]->laudio_time : mainw->files[fnum]->raudio_time;
+      secs = ((double)offset_start / (double)width * tl_span + mt->tl_min - offset_startd) * vel + seek;
+      done = clip_peaks_query(fnum, chnum, secs, tl_span / (double)width * vel, npix, mins, maxs, NULL);
+      for (int i = 0; i < done; i++) {
+        if (secs + (double)i * tl_span / (double)width * vel >= atime) break;
+        lives_painter_move_to(cr, offset_start + i, (.5 - maxs[i] * .5) * height);
+        lives_painter_line_to(cr, offset_start + i, (.5 - mins[i] * .5) * height);
+        lives_painter_stroke(cr);
+      }
+      lives_free(mins); lives_free(maxs);
+      if (done == npix) {
+        block = block->next;
+        continue;
+      }
+      offset_start += done;
+    }
+
     // open audio file here
 
     if (fnum != aofile) {
@@ -355,6 +380,23 @@ void free_thumb_cache(int fnum, frames_t fromframe) {
 }
 
 
+static void mt_thumb_ready(int clipno, frames_t frame, int width, int height, LiVESPixbuf *thumbnail,
+                           livespointer data) {
+  // a thumbnail requested by mt_draw_block() is ready; cache it and redraw the track
+  lives_mt *mt = mainw->multitrack;
+  LiVESWidget *eventbox;
+  int track = LIVES_POINTER_TO_INT(data);
+
+  if (!mt || (mainw->files[clipno]->tcache && height != mainw->files[clipno]->tcache_height)
+      || !add_to_thumb_cache(clipno, frame, 0, height, thumbnail)) {
+    lives_widget_object_unref(thumbnail);
+    return;
+  }
+  eventbox = (LiVESWidget *)lives_list_nth_data(mt->video_draws, track);
+  if (eventbox) mt_redraw_eventbox(mt, eventbox);
+}
+
+
 LiVESPixbuf *mt_make_thumb(lives_mt *mt, int clipno, int width, int height, frames_t frame, LiVESInterpType interp,
                            boolean noblanks) {
   LiVESPixbuf *thumbnail = NULL, *pixbuf;
@@ -691,6 +733,8 @@ void mt_draw_block(lives_mt * mt, lives_painter_t *cairo,
       if (!is_audio && track > -1) {
         boolean in_cache = FALSE;
         int height = lives_widget_get_allocation_height(eventbox);
+        // thumbnails for the visible part of the timeline are made before any still pending from earlier views
+        thumb_request_view(((uint64_t)(mt->tl_min * 1000.) << 32) ^ (uint64_t)(mt->tl_max * 1000.) ^ height);
         for (i = offset_start; i < offset_end; i += BLOCK_THUMB_WIDTH) {
           if (i > x2 - x1) break;
           tc += tl_span / lives_widget_get_allocation_width(eventbox) * width * TICKS_PER_SECOND_DBL;
@@ -734,20 +778,24 @@ void mt_draw_block(lives_mt * mt, lives_painter_t *cairo,
                 free_thumb_cache(filenum, 0);
               }
               if (!(thumbnail = get_from_thumb_cache(filenum, framenum, range))) {
-                if (mainw->files[filenum]->frames > 0 && mainw->files[filenum]->clip_type == CLIP_TYPE_FILE) {
-                  lives_clip_data_t *cdata = get_clip_cdata(filenum);
-                  if (cdata && !((cdata->seek_flag & LIVES_SEEK_FAST) &&
-                                 is_virtual_frame(filenum, framenum))) {
-                    thumbnail = make_thumb_fast_between(mt, filenum, width, height,
-                                                        framenum, last_framenum == -1 ? 0
-                                                        : framenum - last_framenum);
+                // thumbnails are made in the background if possible, leaving a placeholder until they are ready
+                if (!thumb_request(filenum, framenum, width, height, FALSE, i - x1, mt_thumb_ready,
+                                   LIVES_INT_TO_POINTER(track))) {
+                  if (mainw->files[filenum]->frames > 0 && mainw->files[filenum]->clip_type == CLIP_TYPE_FILE) {
+                    lives_clip_data_t *cdata = get_clip_cdata(filenum);
+                    if (cdata && !((cdata->seek_flag & LIVES_SEEK_FAST) &&
+                                   is_virtual_frame(filenum, framenum))) {
+                      thumbnail = make_thumb_fast_between(mt, filenum, width, height,
+                                                          framenum, last_framenum == -1 ? 0
+                                                          : framenum - last_framenum);
+                    } else {
+                      thumbnail = mt_make_thumb(mt, filenum, width, height, framenum, LIVES_INTERP_FAST, FALSE);
+                    }
                   } else {
                     thumbnail = mt_make_thumb(mt, filenum, width, height, framenum, LIVES_INTERP_FAST, FALSE);
                   }
-                } else {
-                  thumbnail = mt_make_thumb(mt, filenum, width, height, framenum, LIVES_INTERP_FAST, FALSE);
+                  in_cache = add_to_thumb_cache(filenum, framenum, range, height, thumbnail);
                 }
-                in_cache = add_to_thumb_cache(filenum, framenum, range, height, thumbnail);
               } else {
                 in_cache = TRUE;
               }
@@ -10,6 +10,8 @@
 
 #include "main.h"
 #include "events.h"
+#include "layoutfmt.h"
+#include "fmapplan.h"
 #include "callbacks.h"
 #include "effects.h"
 #include "resample.h"
@@ -221,17 +223,26 @@ void mt_memory_free(void) {
 }
 
 
+static int64_t save_init_event_id(weed_event_t *init_event, boolean stable) {
+  if (stable && init_event && weed_plant_has_leaf(init_event, WEED_LEAF_EVENT_ID))
+    return weed_get_int64_value(init_event, WEED_LEAF_EVENT_ID, NULL);
+  return (int64_t)(uint64_t)((void *)init_event);
+}
+
+
 boolean save_event_list_inner(lives_mt *mt, int fd, weed_plant_t *event_list, unsigned char **mem) {
-  weed_plant_t *event;
+  // if mem is set, the list is being saved for undo; see below
+  weed_plant_t *event, *deinit_event = NULL;
 
-  void **ievs = NULL;
-  void *next, *prev;
+  void **ievs = NULL, **pchanges = NULL, **nopchanges = NULL;
+  void *next, *prev, *first = NULL, *last = NULL;
+  void *init_event = NULL, *next_change = NULL, *prev_change = NULL;
 
   int64_t *uievs;
-  int64_t iev = 0l;
+  int64_t iev = 0l, ninits = 0;
 
   int count = 0;
-  int nivs = 0;
+  int nivs = 0, npchanges = 0;
 
   int i;
 
@@ -310,9 +321,30 @@ boolean save_event_list_inner(lives_mt *mt, int fd, weed_plant_t *event_list, un
 
   threaded_dialog_spin(0.);
 
+  if (mem) {
+    // undo entries are stored as the difference between consecutive saves (see make_undo_record()), and event
+    // addresses change every time the list is reloaded, so filter inits are identified by their position instead.
+    // The loader rebuilds the other links between events, so those are written as NULL
+    for (weed_event_t *xevent = event; xevent; xevent = get_next_event(xevent)) {
+      if (WEED_EVENT_IS_FILTER_INIT(xevent)) {
+        weed_leaf_delete(xevent, WEED_LEAF_EVENT_ID);
+        weed_set_int64_value(xevent, WEED_LEAF_EVENT_ID, ++ninits);
+      }
+    }
+    first = get_first_event(event_list);
+    last = get_last_event(event_list);
+    weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, NULL);
+    weed_set_voidptr_value(event_list, WEED_LEAF_LAST, NULL);
+  }
+
   THREADVAR(write_failed) = FALSE;
   weed_plant_serialise(fd, event_list, mem);
 
+  if (mem) {
+    weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, first);
+    weed_set_voidptr_value(event_list, WEED_LEAF_LAST, last);
+  }
+
   while (!THREADVAR(write_failed) && event) {
     next = weed_get_voidptr_value(event, WEED_LEAF_NEXT, NULL);
     weed_leaf_delete(event, WEED_LEAF_NEXT);
@@ -321,23 +353,45 @@ boolean save_event_list_inner(lives_mt *mt, int fd, weed_plant_t *event_list, un
     weed_leaf_delete(event, WEED_LEAF_PREVIOUS);
 
     if (WEED_EVENT_IS_FILTER_INIT(event)) {
-      weed_leaf_delete(event, WEED_LEAF_EVENT_ID);
-      weed_set_int64_value(event, WEED_LEAF_EVENT_ID, (int64_t)(uint64_t)((void *)event));
+      if (!mem) {
+        weed_leaf_delete(event, WEED_LEAF_EVENT_ID);
+        weed_set_int64_value(event, WEED_LEAF_EVENT_ID, (int64_t)(uint64_t)((void *)event));
+      } else if (weed_plant_has_leaf(event, WEED_LEAF_DEINIT_EVENT)) {
+        deinit_event = weed_get_plantptr_value(event, WEED_LEAF_DEINIT_EVENT, NULL);
+        weed_set_plantptr_value(event, WEED_LEAF_DEINIT_EVENT, NULL);
+      }
     } else if (WEED_EVENT_IS_FILTER_DEINIT(event) || WEED_EVENT_IS_PARAM_CHANGE(event)) {
-      iev = (int64_t)(uint64_t)weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL);
+      init_event = weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL);
+      iev = save_init_event_id(init_event, mem != NULL);
       weed_leaf_delete(event, WEED_LEAF_INIT_EVENT);
       weed_set_int64_value(event, WEED_LEAF_INIT_EVENT, iev);
+      if (mem && WEED_EVENT_IS_PARAM_CHANGE(event)) {
+        next_change = weed_get_voidptr_value(event, WEED_LEAF_NEXT_CHANGE, NULL);
+        prev_change = weed_get_voidptr_value(event, WEED_LEAF_PREV_CHANGE, NULL);
+        if (next_change) weed_set_voidptr_value(event, WEED_LEAF_NEXT_CHANGE, NULL);
+        if (prev_change) weed_set_voidptr_value(event, WEED_LEAF_PREV_CHANGE, NULL);
+      }
     } else if (WEED_EVENT_IS_FILTER_MAP(event)) {
       ievs = weed_get_voidptr_array_counted(event, WEED_LEAF_INIT_EVENTS, &nivs);
       uievs = (int64_t *)lives_malloc(nivs * 8);
       for (i = 0; i < nivs; i++) {
-        uievs[i] = (int64_t)(uint64_t)ievs[i];
+        uievs[i] = save_init_event_id(ievs[i], mem != NULL);
       }
       weed_leaf_delete(event, WEED_LEAF_INIT_EVENTS);
       weed_set_int64_array(event, WEED_LEAF_INIT_EVENTS, nivs, uievs);
       lives_free(uievs);
     }
 
+    if (mem && (WEED_EVENT_IS_FILTER_INIT(event) || WEED_EVENT_IS_FILTER_DEINIT(event))) {
+      // only the number of elements is used when loading
+      pchanges = weed_get_voidptr_array_counted(event, WEED_LEAF_IN_PARAMETERS, &npchanges);
+      if (npchanges) {
+        nopchanges = (void **)lives_calloc(npchanges, sizeof(void *));
+        weed_set_voidptr_array(event, WEED_LEAF_IN_PARAMETERS, npchanges, nopchanges);
+        lives_free(nopchanges);
+      }
+    }
+
     if (!mem && prefs->back_compat) {
       // create a "hint" leaf as a service to older versions of LiVES
       // TODO: prompt user if they need backwards compat or not
@@ -348,12 +402,24 @@ boolean save_event_list_inner(lives_mt *mt, int fd, weed_plant_t *event_list, un
 
     weed_leaf_delete(event, WEED_LEAF_HINT);
 
+    if (pchanges) {
+      weed_set_voidptr_array(event, WEED_LEAF_IN_PARAMETERS, npchanges, pchanges);
+      lives_freep((void **)&pchanges);
+    }
+
     if (WEED_EVENT_IS_FILTER_INIT(event)) {
-      weed_leaf_delete(event, WEED_LEAF_EVENT_ID);
+      if (!mem) weed_leaf_delete(event, WEED_LEAF_EVENT_ID);
+      else if (deinit_event) {
+        weed_set_plantptr_value(event, WEED_LEAF_DEINIT_EVENT, deinit_event);
+        deinit_event = NULL;
+      }
     }
     if (WEED_EVENT_IS_FILTER_DEINIT(event) || WEED_EVENT_IS_PARAM_CHANGE(event)) {
       weed_leaf_delete(event, WEED_LEAF_INIT_EVENT);
-      weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, (void *)iev);
+      weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENT, init_event);
+      if (next_change) weed_set_voidptr_value(event, WEED_LEAF_NEXT_CHANGE, next_change);
+      if (prev_change) weed_set_voidptr_value(event, WEED_LEAF_PREV_CHANGE, prev_change);
+      next_change = prev_change = NULL;
     } else if (WEED_EVENT_IS_FILTER_MAP(event)) {
       weed_leaf_delete(event, WEED_LEAF_INIT_EVENTS);
       weed_set_voidptr_array(event, WEED_LEAF_INIT_EVENTS, nivs, ievs);
@@ -369,6 +435,10 @@ boolean save_event_list_inner(lives_mt *mt, int fd, weed_plant_t *event_list, un
       threaded_dialog_spin(0.);
     }
   }
+  if (mem) {
+    for (event = get_first_event(event_list); event; event = get_next_event(event))
+      if (WEED_EVENT_IS_FILTER_INIT(event)) weed_leaf_delete(event, WEED_LEAF_EVENT_ID);
+  }
   if (THREADVAR(write_failed)) return FALSE;
   return TRUE;
 }
@@ -487,22 +557,37 @@ static void renumber_from_backup_layout_numbering(lives_mt *mt) {
 }
 
 
+// journal for the auto backup. Changes are appended to this as they are made, and the full layout is
+// only rewritten when the journal grows too large
+static lives_layout_jnl_t *mt_jnl = NULL;
+
+static void mt_autoback_reset(void) {
+  // the next auto backup will write the full layout
+  layout_jnl_free(mt_jnl);
+  mt_jnl = NULL;
+}
+
+
+static char *get_autoback_filename(const char *ext) {
+  char *fname = lives_strdup_printf("%s.%d.%d.%d.%s", LAYOUT_FILENAME, lives_getuid(), lives_getgid(),
+                                    capable->mainpid, ext);
+  char *file = lives_build_filename(prefs->workdir, fname, NULL);
+  lives_free(fname);
+  return file;
+}
+
+
 static void save_mt_autoback(lives_mt *mt) {
   // auto backup of the current layout
 
   // this is called from an idle function - if the specified amount of time has passed and
   // the clip has been altered
 
-  char *fname = lives_strdup_printf("%s.%d.%d.%d.%s", LAYOUT_FILENAME, lives_getuid(), lives_getgid(),
-                                    capable->mainpid, LIVES_FILE_EXT_LAYOUT);
-  char *asave_file = lives_build_filename(prefs->workdir, fname, NULL);
+  char *asave_file = get_autoback_filename(LIVES_FILE_EXT_LAYOUT);
   char *tmp;
 
   boolean retval = TRUE;
   LiVESResponseType retval2;
-  int fd;
-
-  lives_free(fname);
 
   mt->auto_changed = FALSE;
   lives_widget_set_sensitive(mt->backup, FALSE);
@@ -515,26 +600,39 @@ static void save_mt_autoback(lives_mt *mt) {
     retval2 = LIVES_RESPONSE_NONE;
     THREADVAR(write_failed) = FALSE;
 
-    fd = lives_create_buffered(asave_file, DEF_FILE_PERMS);
-    if (fd >= 0) {
-      add_markers(mt, mt->event_list, FALSE);
-      do_threaded_dialog(_("Auto backup"), FALSE);
+    add_markers(mt, mt->event_list, FALSE);
+    do_threaded_dialog(_("Auto backup"), FALSE);
+
+    set_signal_handlers((lives_sigfunc_t)defer_sigint);
 
-      set_signal_handlers((lives_sigfunc_t)defer_sigint);
+    // the auto backup uses the binary format, which is much quicker to write and to reload
+    save_event_list_inner(mt, -1, mt->event_list, NULL);
 
-      retval = save_event_list_inner(mt, fd, mt->event_list, NULL);
-      if (retval) retval = write_backup_layout_numbering(mt);
+    if (!mt_jnl) {
+      char *jsave_file = get_autoback_filename(LIVES_FILE_EXT_LAYOUT_JOURNAL);
+      mt_jnl = layout_jnl_new(asave_file, jsave_file);
+      lives_free(jsave_file);
+    }
 
-      if (mainw->signal_caught) catch_sigint(mainw->signal_caught, NULL, NULL);
+    // usually we only need to append the latest changes to the journal
+    // here we compare the whole list, in case some edit did not report its changes
+    layout_jnl_rescan(mt_jnl);
+    if (layout_jnl_record(mt_jnl, mt->event_list, TRUE) < 0) {
+      // no usable journal (or the last background write failed), so write everything now
+      THREADVAR(write_failed) = FALSE;
+      retval = layout_jnl_compact(mt_jnl, mt->event_list, FALSE);
+    } else if (layout_jnl_needs_compact(mt_jnl)) layout_jnl_compact(mt_jnl, mt->event_list, TRUE);
 
-      set_signal_handlers((lives_sigfunc_t)catch_sigint);
+    if (retval) retval = write_backup_layout_numbering(mt);
 
-      end_threaded_dialog();
-      mt_paint_lines(mt, mt->ptr_time, FALSE, NULL);
+    if (mainw->signal_caught) catch_sigint(mainw->signal_caught, NULL, NULL);
 
-      remove_markers(mt->event_list);
-      lives_close_buffered(fd);
-    } else THREADVAR(write_failed) = TRUE;
+    set_signal_handlers((lives_sigfunc_t)catch_sigint);
+
+    end_threaded_dialog();
+    mt_paint_lines(mt, mt->ptr_time, FALSE, NULL);
+
+    remove_markers(mt->event_list);
 
     mt_sensitise(mt);
 
@@ -627,15 +725,17 @@ uint32_t mt_idle_add(lives_mt *mt) {
 
 
 void recover_layout_cancelled(boolean is_startup) {
-  char *fname = lives_strdup_printf("%s.%d.%d.%d.%s", LAYOUT_FILENAME,
-                                    lives_getuid(), lives_getgid(),
-                                    capable->mainpid, LIVES_FILE_EXT_LAYOUT);
-
-  char *eload_file = lives_build_filename(prefs->workdir, fname, NULL);
-  lives_free(fname);
+  char *eload_file = get_autoback_filename(LIVES_FILE_EXT_LAYOUT);
+  char *fname;
 
   if (is_startup) mainw->recoverable_layout = FALSE;
 
+  mt_autoback_reset();
+
+  lives_rm(eload_file);
+  lives_free(eload_file);
+
+  eload_file = get_autoback_filename(LIVES_FILE_EXT_LAYOUT_JOURNAL);
   lives_rm(eload_file);
   lives_free(eload_file);
 
@@ -662,17 +762,19 @@ boolean mt_load_recovery_layout(lives_mt *mt) {
                                 capable->mainpid);
     aload_file = lives_build_filename(prefs->workdir, fname, NULL);
     lives_free(fname);
-    fname = lives_strdup_printf("%s.%d.%d.%d.%s", LAYOUT_FILENAME, lives_getuid(), lives_getgid(),
-                                capable->mainpid, LIVES_FILE_EXT_LAYOUT);
-    eload_file = lives_build_filename(prefs->workdir, fname, NULL);
-    lives_free(fname);
+    eload_file = get_autoback_filename(LIVES_FILE_EXT_LAYOUT);
     mt->auto_reloading = TRUE;
+    // load_event_list() will replay the journal, if there is one
     mt->event_list = mainw->event_list = load_event_list(mt, eload_file);
     mt->auto_reloading = FALSE;
     if (mt->event_list) {
       weed_plant_t *avol_init_event = mt->avol_init_event;
+      char *jload_file = get_autoback_filename(LIVES_FILE_EXT_LAYOUT_JOURNAL);
+      mt_autoback_reset();
       lives_rm(eload_file);
+      lives_rm(jload_file);
       lives_rm(aload_file);
+      lives_free(jload_file);
       mt->avol_init_event = NULL;
       mt_init_tracks(mt, TRUE);
       mt->avol_init_event = avol_init_event;
@@ -2744,6 +2846,206 @@ static size_t estimate_space(lives_mt * mt, int undo_type) {
 }
 
 
+// the undo buffer holds a header (mt_undo) followed by data for each entry in mt->undos, oldest first.
+// The newest entry holds a full copy of its saved event list, and each older entry holds only the difference
+// between its event list and that of the entry after it: the number of bytes the two have in common at the start
+// and at the end, then the bytes in between from each side. A difference can be applied in either direction,
+// so undo and redo rebuild an entry by walking from the last one rebuilt, and both the space used and the cost of
+// each step depend on the size of the change rather than the size of the layout.
+// Where the difference would be no smaller than a full copy, the full copy is kept instead.
+// save_event_list_inner() refers to filter inits by position rather than address when saving for undo, so
+// the parts of the layout which did not change are saved identically, even after the list has been reloaded.
+
+#define UNDO_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+typedef struct {
+  size_t prefix, suffix; ///< bytes in common at the start and end
+  size_t len, next_len; ///< bytes in between for this entry, followed by those for the next entry
+} mt_undo_diff_t;
+
+// the event list rebuilt last, and the uid of its entry
+static uint8_t *undo_snap = NULL;
+static size_t undo_snap_len = 0;
+static uint64_t undo_snap_uid = 0;
+
+static uint64_t next_undo_uid = 1;
+
+
+static void undo_snap_set(const uint8_t *data, size_t len, uint64_t uid) {
+  undo_snap = (uint8_t *)lives_realloc(undo_snap, len + 1);
+  lives_memcpy(undo_snap, data, len);
+  undo_snap_len = len;
+  undo_snap_uid = uid;
+}
+
+
+static void undo_snap_patch(const mt_undo_diff_t *diff, const uint8_t *mid, size_t mid_len) {
+  // replace the bytes between the common prefix and suffix
+  size_t new_len = diff->prefix + mid_len + diff->suffix;
+  if (new_len > undo_snap_len) undo_snap = (uint8_t *)lives_realloc(undo_snap, new_len + 1);
+  lives_memmove(undo_snap + diff->prefix + mid_len, undo_snap + undo_snap_len - diff->suffix, diff->suffix);
+  lives_memcpy(undo_snap + diff->prefix, mid, mid_len);
+  undo_snap_len = new_len;
+}
+
+
+static uint8_t *undo_get_snapshot(lives_mt * mt, int idx, size_t *len) {
+  // rebuild the serialised event list for entry idx in mt->undos; the result is valid until the next call
+  LiVESList *list = lives_list_nth(mt->undos, idx), *xlist;
+  mt_undo_diff_t *diff;
+  mt_undo *undo;
+  int cidx = -1, i;
+
+  if (!list) return NULL;
+
+  for (xlist = mt->undos, i = 0; xlist; xlist = xlist->next, i++) {
+    if (((mt_undo *)xlist->data)->uid == undo_snap_uid) {
+      cidx = i;
+      break;
+    }
+  }
+
+  if (cidx < idx) {
+    // walk forwards, as far as there are diffs to apply
+    for (; cidx != -1 && cidx < idx; xlist = xlist->next, cidx++) {
+      undo = (mt_undo *)xlist->data;
+      if (!undo->is_diff) break;
+      diff = (mt_undo_diff_t *)((uint8_t *)undo + sizeof(mt_undo));
+      undo_snap_patch(diff, (uint8_t *)diff + sizeof(mt_undo_diff_t) + diff->len, diff->next_len);
+      undo_snap_uid = ((mt_undo *)xlist->next->data)->uid;
+    }
+    if (cidx != idx) {
+      // otherwise start again from the nearest full copy after idx, and walk back
+      for (xlist = list, cidx = idx; xlist && ((mt_undo *)xlist->data)->is_diff; xlist = xlist->next, cidx++);
+      if (!xlist) return NULL;
+      undo = (mt_undo *)xlist->data;
+      undo_snap_set((uint8_t *)undo + sizeof(mt_undo), undo->snap_len, undo->uid);
+    }
+  }
+
+  for (; cidx > idx; cidx--) {
+    xlist = xlist->prev;
+    undo = (mt_undo *)xlist->data;
+    if (undo->is_diff) {
+      diff = (mt_undo_diff_t *)((uint8_t *)undo + sizeof(mt_undo));
+      undo_snap_patch(diff, (uint8_t *)diff + sizeof(mt_undo_diff_t), diff->len);
+      undo_snap_uid = undo->uid;
+    } else undo_snap_set((uint8_t *)undo + sizeof(mt_undo), undo->snap_len, undo->uid);
+  }
+
+  if (len) *len = undo_snap_len;
+  return undo_snap;
+}
+
+
+static uint8_t *make_undo_record(mt_undo * undo, const uint8_t *data, size_t len, const uint8_t *next,
+                                 size_t next_len) {
+  // make a copy of undo with its data, as a diff against next if that is smaller than a full copy
+  size_t minlen = len < next_len ? len : next_len, rec_len;
+  mt_undo_diff_t diff;
+  uint8_t *rec;
+
+  for (diff.prefix = 0; diff.prefix < minlen && data[diff.prefix] == next[diff.prefix]; diff.prefix++);
+  for (diff.suffix = 0; diff.suffix < minlen - diff.prefix
+       && data[len - diff.suffix - 1] == next[next_len - diff.suffix - 1]; diff.suffix++);
+  diff.len = len - diff.prefix - diff.suffix;
+  diff.next_len = next_len - diff.prefix - diff.suffix;
+
+  undo->snap_len = len;
+  undo->is_diff = sizeof(mt_undo_diff_t) + diff.len + diff.next_len < len;
+  if (undo->is_diff) rec_len = sizeof(mt_undo) + sizeof(mt_undo_diff_t) + diff.len + diff.next_len;
+  else rec_len = sizeof(mt_undo) + len;
+  undo->data_len = UNDO_ALIGN(rec_len);
+
+  rec = (uint8_t *)lives_calloc(1, undo->data_len);
+  lives_memcpy(rec, undo, sizeof(mt_undo));
+  if (undo->is_diff) {
+    lives_memcpy(rec + sizeof(mt_undo), &diff, sizeof(mt_undo_diff_t));
+    lives_memcpy(rec + sizeof(mt_undo) + sizeof(mt_undo_diff_t), data + diff.prefix, diff.len);
+    lives_memcpy(rec + sizeof(mt_undo) + sizeof(mt_undo_diff_t) + diff.len, next + diff.prefix, diff.next_len);
+  } else lives_memcpy(rec + sizeof(mt_undo), data, len);
+  return rec;
+}
+
+
+static boolean mt_undo_push(lives_mt * mt, mt_undo * undo, const uint8_t *snap, size_t snap_len) {
+  // append an entry holding a full copy of snap, re-encoding the previous newest entry as a diff against it
+  // returns FALSE if even the new entry alone does not fit in the buffer
+  size_t bufsize = (size_t)(prefs->mt_undo_buf * 1024 * 1024);
+  LiVESList *last = lives_list_last(mt->undos);
+  uint8_t *prec = NULL;
+  size_t prec_len = 0;
+
+  undo->uid = next_undo_uid++;
+  undo->snap_len = snap_len;
+  undo->is_diff = FALSE;
+  undo->data_len = UNDO_ALIGN(sizeof(mt_undo) + snap_len);
+
+  if (last) {
+    mt_undo pundo = *(mt_undo *)last->data;
+    size_t plen;
+    uint8_t *pdata = undo_get_snapshot(mt, lives_list_length(mt->undos) - 1, &plen);
+    if (pdata) {
+      prec = make_undo_record(&pundo, pdata, plen, snap, snap_len);
+      prec_len = pundo.data_len;
+    }
+    // take it out of the buffer before making space, so it cannot be moved or dropped
+    mt->undo_buffer_used = (uint8_t *)last->data - mt->undo_mem;
+    mt->undos = lives_list_delete_link(mt->undos, last);
+  }
+
+  if (undo->data_len + prec_len > bufsize - mt->undo_buffer_used) {
+    if (!make_backup_space(mt, undo->data_len + prec_len)) {
+      // the buffer is now empty, keep just the new entry if it fits
+      lives_freep((void **)&prec);
+      if (undo->data_len > bufsize) return FALSE;
+    }
+  }
+
+  if (prec) {
+    lives_memcpy(mt->undo_mem + mt->undo_buffer_used, prec, prec_len);
+    mt->undos = lives_list_append(mt->undos, mt->undo_mem + mt->undo_buffer_used);
+    mt->undo_buffer_used += prec_len;
+    lives_free(prec);
+  }
+
+  lives_memcpy(mt->undo_mem + mt->undo_buffer_used, undo, sizeof(mt_undo));
+  lives_memcpy(mt->undo_mem + mt->undo_buffer_used + sizeof(mt_undo), snap, snap_len);
+  mt->undos = lives_list_append(mt->undos, mt->undo_mem + mt->undo_buffer_used);
+  mt->undo_buffer_used += undo->data_len;
+  undo_snap_set(snap, snap_len, undo->uid);
+  return TRUE;
+}
+
+
+void mt_undo_mem_usage(lives_mt * mt, size_t *used, size_t *full_size, int *nentries) {
+  // report the space used in the undo buffer, and the space the same entries would need as full copies
+  size_t fsize = 0;
+  int count = 0;
+  for (LiVESList *list = mt->undos; list; list = list->next, count++)
+    fsize += sizeof(mt_undo) + ((mt_undo *)list->data)->snap_len;
+  if (used) *used = mt->undo_buffer_used;
+  if (full_size) *full_size = fsize;
+  if (nentries) *nentries = count;
+}
+
+
+static void show_undo_mem_usage(lives_mt * mt) {
+  char *text;
+  size_t used, fsize;
+  int nentries;
+
+  if (!mt->undo_mem) return;
+  mt_undo_mem_usage(mt, &used, &fsize, &nentries);
+  text = lives_strdup_printf(_("Undo buffer: %.2f of %d MB used for %d steps (%.2f MB as full copies)"),
+                             (double)used / (1024. * 1024.), prefs->mt_undo_buf, nentries,
+                             (double)fsize / (1024. * 1024.));
+  lives_widget_set_tooltip_text(mt->undo, text);
+  lives_widget_set_tooltip_text(mt->redo, text);
+  lives_free(text);
+}
+
+
 static char *get_undo_text(int action, void *extra) {
   char *filtname, *ret;
 
@@ -2802,6 +3104,7 @@ static void mt_set_undoable(lives_mt * mt, int what, void *extra, boolean sensit
   lives_menu_item_set_text(mt->undo, mt->undo_text, TRUE);
 
   lives_widget_set_sensitive(mt->undo, sensitive);
+  show_undo_mem_usage(mt);
 }
 
 
@@ -2821,6 +3124,7 @@ static void mt_set_redoable(lives_mt * mt, int what, void *extra, boolean sensit
   lives_menu_item_set_text(mt->redo, mt->redo_text, TRUE);
 
   lives_widget_set_sensitive(mt->redo, sensitive);
+  show_undo_mem_usage(mt);
 }
 
 
@@ -2885,6 +3189,15 @@ void mt_backup(lives_mt * mt, int undo_type, weed_timecode_t tc) {
   // ask caller to add the idle func
   if (prefs->mt_auto_back > 0) mt->auto_changed = TRUE;
 
+  if (mt_jnl && mt->event_list && prefs->mt_auto_back >= 0) {
+    // journal the result of the previous operation, so a recovered layout is at most one operation behind
+    // only the events changed by the operation are encoded (see layoutfmt.h)
+    // the markers are added, as they would be for a full save
+    add_markers(mt, mt->event_list, FALSE);
+    layout_jnl_record(mt_jnl, mt->event_list, FALSE);
+    remove_markers(mt->event_list);
+  }
+
   if (!mt->undo_mem) return;
 
   if (mt->undos && mt->undo_offset != 0) {
@@ -2900,6 +3213,9 @@ void mt_backup(lives_mt * mt, int undo_type, weed_timecode_t tc) {
       if (ulist) {
         memblock = (unsigned char *)ulist->data;
         last_valid_undo = (mt_undo *)memblock;
+        // it may hold a diff against the first entry we drop, so rebuild it while we still can
+        if (last_valid_undo->is_diff)
+          undo_get_snapshot(mt, (int)lives_list_length(mt->undos) - mt->undo_offset - 1, NULL);
         memblock += last_valid_undo->data_len;
         mt->undo_buffer_used = memblock - mt->undo_mem;
         if (ulist->next) {
@@ -2932,25 +3248,19 @@ void mt_backup(lives_mt * mt, int undo_type, weed_timecode_t tc) {
   }
 
   add_markers(mt, mt->event_list, TRUE);
-  if ((space_needed = estimate_space(mt, undo_type) + sizeof(mt_undo)) >
-      ((size_t)(prefs->mt_undo_buf * 1024 * 1024) - mt->undo_buffer_used)) {
-    if (!make_backup_space(mt, space_needed)) {
-      remove_markers(mt->event_list);
-      do_mt_backup_space_error(mt, (int)((space_needed * 3) >> 20));
-      return;
-    }
-  }
-
-  omemblock = memblock = (unsigned char *)(mt->undo_mem + mt->undo_buffer_used + sizeof(mt_undo));
+  space_needed = estimate_space(mt, undo_type);
+  omemblock = memblock = (unsigned char *)lives_malloc(space_needed);
   save_event_list_inner(NULL, 0, mt->event_list, &memblock);
-  undo->data_len = memblock - omemblock;
-  space_needed = undo->data_len + sizeof(mt_undo);
-
   remove_markers(mt->event_list);
 
-  lives_memcpy(mt->undo_mem + mt->undo_buffer_used, undo, sizeof(mt_undo));
-  mt->undos = lives_list_append(mt->undos, mt->undo_mem + mt->undo_buffer_used);
-  mt->undo_buffer_used += space_needed;
+  if (!mt_undo_push(mt, undo, omemblock, memblock - omemblock)) {
+    lives_free(omemblock);
+    lives_free(undo);
+    do_mt_backup_space_error(mt, (int)((space_needed * 3) >> 20));
+    return;
+  }
+  lives_free(omemblock);
+
   mt_set_undoable(mt, undo->action, undo->extra, TRUE);
   lives_free(undo);
 }
@@ -3217,6 +3527,11 @@ void set_mt_play_sizes_cfg(lives_mt * mt) {
 }
 
 
+// if set, load_event_list_inner() reads from this binary layout rather than fd
+static lives_layout_bin_t *bin_layout = NULL;
+// and, if this is also set, replays the journal from this file
+static char *bin_journal = NULL;
+
 static weed_plant_t *load_event_list_inner(lives_mt * mt, int fd, boolean show_errors, int *num_events,
     unsigned char **mem, unsigned char *mem_end) {
   weed_plant_t *event, *eventprev = NULL;
@@ -3226,7 +3541,10 @@ static weed_plant_t *load_event_list_inner(lives_mt * mt, int fd, boolean show_e
 
   char *msg, *err;
 
-  if (fd >= 0 || mem) event_list = weed_plant_deserialise(fd, mem, NULL);
+  if (bin_layout) {
+    event_list = layout_bin_materialise(bin_layout);
+    if (bin_journal) layout_jnl_replay(bin_layout, event_list, bin_journal);
+  } else if (fd >= 0 || mem) event_list = weed_plant_deserialise(fd, mem, NULL);
   else event_list = mainw->stored_event_list;
 
   if (mt) mt->layout_set_properties = FALSE;
@@ -3385,13 +3703,19 @@ static weed_plant_t *load_event_list_inner(lives_mt * mt, int fd, boolean show_e
     }
   }
 
-  if (weed_plant_has_leaf(event_list, WEED_LEAF_FIRST)) weed_leaf_delete(event_list, WEED_LEAF_FIRST);
-  if (weed_plant_has_leaf(event_list, WEED_LEAF_LAST)) weed_leaf_delete(event_list, WEED_LEAF_LAST);
+  if (bin_layout) {
+    // the events were added along with the list plant, so they are available to the journal
+    // ids are already in the form event_list_rectify() expects
+    if (num_events)(*num_events) += count_events(event_list, TRUE, 0, 0);
+  } else {
+    if (weed_plant_has_leaf(event_list, WEED_LEAF_FIRST)) weed_leaf_delete(event_list, WEED_LEAF_FIRST);
+    if (weed_plant_has_leaf(event_list, WEED_LEAF_LAST)) weed_leaf_delete(event_list, WEED_LEAF_LAST);
 
-  weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, NULL);
-  weed_set_voidptr_value(event_list, WEED_LEAF_LAST, NULL);
+    weed_set_voidptr_value(event_list, WEED_LEAF_FIRST, NULL);
+    weed_set_voidptr_value(event_list, WEED_LEAF_LAST, NULL);
+  }
 
-  do {
+  if (!bin_layout) do {
     if (mem && *mem >= mem_end) break;
     event = weed_plant_deserialise(fd, mem, NULL);
     if (event) {
@@ -7026,6 +7350,8 @@ boolean multitrack_delete(lives_mt * mt, boolean save_layout) {
   if (mt->poly_state == POLY_PARAMS) polymorph(mt, POLY_CLIPS);
 
   lives_freep((void **)&mt->undo_mem);
+  lives_freep((void **)&undo_snap);
+  undo_snap_len = 0;
 
   if (mt->undos) lives_list_free(mt->undos);
 
@@ -7246,6 +7572,8 @@ boolean multitrack_delete(lives_mt * mt, boolean save_layout) {
 
   pref_factory_int(PREF_SEPWIN_TYPE, (int *)&prefs->sepwin_type, future_prefs->sepwin_type, FALSE);
 
+  mt_autoback_reset();
+
   lives_free(mt);
 
   if (prefs->sepwin_type == SEPWIN_TYPE_STICKY && mainw->sep_win) {
@@ -7713,6 +8041,7 @@ void mt_init_tracks(lives_mt * mt, boolean set_min_max) {
 
         weed_set_int_array(event, WEED_LEAF_CLIPS, num_tracks, new_clip_index);
         weed_set_int64_array(event, WEED_LEAF_FRAMES, num_tracks, new_frame_index);
+        event_changed(event);
 
         lives_free(clip_index);
         lives_free(frame_index);
@@ -7759,6 +8088,7 @@ void mt_init_tracks(lives_mt * mt, boolean set_min_max) {
             if (aclips[i + 1] > 0) aclips[i + 1] = renumbered_clips[aclips[i + 1]];
           }
           weed_set_int_array(event, WEED_LEAF_AUDIO_CLIPS, num_aclips, aclips);
+          event_changed(event);
           lives_free(aseeks);
           lives_free(aclips);
         }
@@ -12470,6 +12800,7 @@ static void insgap_inner(lives_mt * mt, int tnum, boolean is_sel, int passnm) {
 
           weed_set_int_array(new_event, WEED_LEAF_CLIPS, xnumclips, new_clips);
           weed_set_int64_array(new_event, WEED_LEAF_FRAMES, xnumclips, new_frames);
+          event_changed(new_event);
 
           lives_free(clips);
           lives_free(frames);
@@ -12735,8 +13066,7 @@ void multitrack_undo(LiVESMenuItem * menuitem, livespointer user_data) {
 
   unsigned char *memblock, *omemblock, *mem_end;
 
-  size_t space_avail = (size_t)(prefs->mt_undo_buf * 1024 * 1024) - mt->undo_buffer_used;
-  size_t space_needed;
+  size_t space_needed, snap_len = 0;
 
   double end_secs;
   double ptr_time;
@@ -12768,26 +13098,25 @@ void multitrack_undo(LiVESMenuItem * menuitem, livespointer user_data) {
 
   if (last_undo->action != MT_UNDO_NONE) {
     if (mt->undo_offset == 0) {
-      add_markers(mt, mt->event_list, TRUE);
-      if ((space_needed = estimate_space(mt, last_undo->action) + sizeof(mt_undo)) > space_avail) {
-        if (!make_backup_space(mt, space_needed) || !mt->undos) {
-          remove_markers(mt->event_list);
-          mt->idlefunc = mt_idle_add(mt);
-          do_mt_undo_buf_error();
-          mt_sensitise(mt);
-          return;
-        }
-      }
-
-      new_redo = (mt_undo *)(mt->undo_mem + mt->undo_buffer_used);
+      new_redo = (mt_undo *)lives_calloc(1, sizeof(mt_undo));
       new_redo->action = last_undo->action;
 
-      omemblock = memblock = (unsigned char *)new_redo + sizeof(mt_undo);
+      add_markers(mt, mt->event_list, TRUE);
+      space_needed = estimate_space(mt, last_undo->action);
+      omemblock = memblock = (unsigned char *)lives_malloc(space_needed);
       save_event_list_inner(NULL, 0, mt->event_list, &memblock);
-      new_redo->data_len = memblock - omemblock;
-      space_needed = new_redo->data_len + sizeof(mt_undo);
-      mt->undo_buffer_used += space_needed;
-      mt->undos = lives_list_append(mt->undos, new_redo);
+      remove_markers(mt->event_list);
+
+      if (!mt_undo_push(mt, new_redo, omemblock, memblock - omemblock) || lives_list_length(mt->undos) < 2) {
+        lives_free(omemblock);
+        lives_free(new_redo);
+        mt->idlefunc = mt_idle_add(mt);
+        do_mt_undo_buf_error();
+        mt_sensitise(mt);
+        return;
+      }
+      lives_free(omemblock);
+      lives_free(new_redo);
       mt->undo_offset++;
     }
 
@@ -12815,9 +13144,9 @@ void multitrack_undo(LiVESMenuItem * menuitem, livespointer user_data) {
 
     event_list_free(mt->event_list);
     last_undo = (mt_undo *)lives_list_nth_data(mt->undos, lives_list_length(mt->undos) - 1 - mt->undo_offset);
-    memblock = (unsigned char *)(last_undo) + sizeof(mt_undo);
-    mem_end = memblock + last_undo->data_len - sizeof(mt_undo);
-    mt->event_list = load_event_list_inner(mt, -1, FALSE, NULL, &memblock, mem_end);
+    memblock = undo_get_snapshot(mt, lives_list_length(mt->undos) - 1 - mt->undo_offset, &snap_len);
+    mem_end = memblock + snap_len;
+    mt->event_list = memblock ? load_event_list_inner(mt, -1, FALSE, NULL, &memblock, mem_end) : NULL;
 
     if (!event_list_rectify(mt, mt->event_list)) {
       event_list_free(mt->event_list);
@@ -12953,6 +13282,8 @@ void multitrack_redo(LiVESMenuItem * menuitem, livespointer user_data) {
 
   unsigned char *memblock, *mem_end;
 
+  size_t snap_len = 0;
+
   char *txt;
   char *utxt, *tmp;
 
@@ -13003,9 +13334,9 @@ void multitrack_redo(LiVESMenuItem * menuitem, livespointer user_data) {
 
     event_list_free(mt->event_list);
 
-    memblock = (unsigned char *)(last_redo) + sizeof(mt_undo);
-    mem_end = memblock + last_redo->data_len - sizeof(mt_undo);
-    mt->event_list = load_event_list_inner(mt, -1, FALSE, NULL, &memblock, mem_end);
+    memblock = undo_get_snapshot(mt, lives_list_length(mt->undos) + 1 - mt->undo_offset, &snap_len);
+    mem_end = memblock + snap_len;
+    mt->event_list = memblock ? load_event_list_inner(mt, -1, FALSE, NULL, &memblock, mem_end) : NULL;
     if (!event_list_rectify(mt, mt->event_list)) {
       event_list_free(mt->event_list);
       mt->event_list = NULL;
@@ -14119,6 +14450,8 @@ void update_filter_events(lives_mt * mt, weed_plant_t *first_event, weed_timecod
             if (lives_list_index(moved_events, event) == -1) {
               // update owners,in_tracks and out_tracks
               weed_set_int_value(event, WEED_LEAF_IN_TRACKS, new_track); // update the in_track to the new one
+              event_list_fmaps_changed();
+              event_changed(event);
 
               if (weed_plant_has_leaf(event, WEED_LEAF_OUT_TRACKS)) {
                 int num_tracks;
@@ -14731,6 +15064,7 @@ void multitrack_playall(lives_mt * mt) {
   } else {
     if (mt->event_list) {
       mainw->is_rendering = TRUE; // NOTE : mainw->is_rendering is not the same as mt->is_rendering !
+      fmap_plans_compile(mt->event_list);
       mt_set_play_position(mt);
       if (mainw->cancelled != CANCEL_VID_END) {
         // otherwise jack transport set us out of range
@@ -16565,6 +16899,8 @@ void on_del_node_clicked(LiVESWidget * button, livespointer user_data) {
         delete_event(mt->event_list, event);
         if (prev_pchange) weed_set_voidptr_value(prev_pchange, WEED_LEAF_NEXT_CHANGE, next_pchange);
         if (next_pchange) weed_set_voidptr_value(next_pchange, WEED_LEAF_PREV_CHANGE, prev_pchange);
+        event_changed(prev_pchange);
+        event_changed(next_pchange);
       } else {
         // is initial pchange, reset to defaults, c.f. paramspecial.c
         weed_plant_t *param = in_params[i];
@@ -16577,6 +16913,7 @@ void on_del_node_clicked(LiVESWidget * button, livespointer user_data) {
           fill_param_vals_to(event, paramtmpl, num_in_tracks - 1);
         }
         weed_set_boolean_value(event, WEED_LEAF_IS_DEF_VALUE, WEED_TRUE);
+        event_changed(event);
       }
     }
   }
@@ -16677,6 +17014,7 @@ static void add_to_pchain(weed_plant_t *event_list, weed_plant_t *init_event, we
     // replace an existing change
     weed_plant_t *next_event = (weed_plant_t *)weed_get_voidptr_value(event, WEED_LEAF_NEXT_CHANGE, &error);
     if (next_event) weed_set_voidptr_value(next_event, WEED_LEAF_PREV_CHANGE, pchange);
+    event_changed(next_event);
     weed_set_voidptr_value(pchange, WEED_LEAF_NEXT_CHANGE, next_event);
     if (event == pchain[index]) weed_leaf_delete(pchange, WEED_LEAF_IGNORE); // never ignore our init pchanges
     if (weed_plant_has_leaf(pchange, WEED_LEAF_IGNORE)) combine_ign(pchange, event);
@@ -16684,15 +17022,19 @@ static void add_to_pchain(weed_plant_t *event_list, weed_plant_t *init_event, we
   } else {
     weed_set_voidptr_value(pchange, WEED_LEAF_NEXT_CHANGE, event);
     if (event) weed_set_voidptr_value(event, WEED_LEAF_PREV_CHANGE, pchange);
+    event_changed(event);
   }
 
-  if (last_event) weed_set_voidptr_value(last_event, WEED_LEAF_NEXT_CHANGE, pchange);
-  else {
+  if (last_event) {
+    weed_set_voidptr_value(last_event, WEED_LEAF_NEXT_CHANGE, pchange);
+    event_changed(last_event);
+  } else {
     // update "in_params" for init_event
     int numin;
     void **in_params = weed_get_voidptr_array_counted(init_event, WEED_LEAF_IN_PARAMETERS, &numin);
     in_params[index] = pchain[index] = (void *)pchange;
     weed_set_voidptr_array(init_event, WEED_LEAF_IN_PARAMETERS, numin, in_params);
+    event_changed(init_event);
     lives_free(in_params);
   }
   weed_set_voidptr_value(pchange, WEED_LEAF_PREV_CHANGE, last_event);
@@ -17681,6 +18023,8 @@ void move_init_in_filter_map(lives_mt * mt, weed_plant_t *event_list, weed_plant
     }
     if (j < num_inits) new_init_events[j] = ifrom;
     weed_set_voidptr_array(event, WEED_LEAF_INIT_EVENTS, num_inits, new_init_events);
+    event_list_fmaps_changed();
+    event_changed(event);
     lives_free(new_init_events);
     lives_free(init_events);
     event = get_next_event(event);
@@ -18122,7 +18466,7 @@ boolean event_list_rectify(lives_mt * mt, weed_plant_t *event_list) {
     tc = get_event_timecode(event);
     if (fps != 0.) {
       tc = q_gint64(tc + TICKS_PER_SECOND_DBL / (2. * fps) - 1, fps);
-      weed_set_int64_value(event, WEED_LEAF_TIMECODE, tc);
+      weed_event_set_timecode(event, tc);
     }
     ev_count++;
     lives_snprintf(mainw->msg, MAINW_MSG_SIZE, "%d|", ev_count);
@@ -18445,6 +18789,7 @@ boolean event_list_rectify(lives_mt * mt, weed_plant_t *event_list) {
         if (!new_init_events) weed_set_voidptr_value(event, WEED_LEAF_INIT_EVENTS, NULL);
         else {
           weed_set_voidptr_array(event, WEED_LEAF_INIT_EVENTS, num_init_events, new_init_events);
+          event_list_fmaps_changed();
 
           for (i = 0; i < num_init_events; i++) {
             if (init_event_is_process_last((weed_plant_t *)new_init_events[i])) {
@@ -19114,7 +19459,11 @@ weed_plant_t *load_event_list(lives_mt * mt, char *eload_file) {
     return NULL;
   }
 
-  lives_buffered_rdonly_slurp(fd, 0);
+  if (layout_bin_file_is_layout(eload_file)) {
+    // binary layouts are mapped rather than read
+    bin_layout = layout_bin_map_file(eload_file);
+    if (mt && mt->auto_reloading) bin_journal = get_autoback_filename(LIVES_FILE_EXT_LAYOUT_JOURNAL);
+  } else lives_buffered_rdonly_slurp(fd, 0);
 
   if (mt) {
     event_list_free_undos(mt);
@@ -19134,7 +19483,13 @@ weed_plant_t *load_event_list(lives_mt * mt, char *eload_file) {
 
   do {
     retval = LIVES_RESPONSE_NONE;
-    if ((event_list = load_event_list_inner(mt, fd, mt != NULL, &num_events, NULL, NULL)) == NULL) {
+    event_list = load_event_list_inner(mt, fd, mt != NULL, &num_events, NULL, NULL);
+    if (bin_layout) {
+      layout_bin_unmap(bin_layout);
+      bin_layout = NULL;
+      lives_freep((void **)&bin_journal);
+    }
+    if (!event_list) {
       lives_close_buffered(fd);
 
       if (THREADVAR(read_failed) == fd + 1) {
@@ -20156,6 +20511,7 @@ void mt_do_autotransition(lives_mt * mt, track_rect * block) {
     //weed_add_plant_flags(enevent, WEED_LEAF_READONLY_PLUGIN);
 
     weed_set_voidptr_value(stevent, WEED_LEAF_NEXT_CHANGE, enevent);
+    event_changed(stevent);
 
     if (param_type == WEED_PARAM_INTEGER) {
       int min = weed_get_int_value(ptm, WEED_LEAF_MIN, NULL);
@@ -20224,6 +20580,7 @@ void mt_do_autotransition(lives_mt * mt, track_rect * block) {
     //weed_add_plant_flags(enevent, WEED_LEAF_READONLY_PLUGIN);
 
     weed_set_voidptr_value(stevent, WEED_LEAF_NEXT_CHANGE, enevent);
+    event_changed(stevent);
 
     if (param_type == WEED_PARAM_INTEGER) {
       int min = weed_get_int_value(ptm, WEED_LEAF_MIN, NULL);
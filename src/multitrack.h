@@ -730,6 +730,9 @@ typedef struct {
   ticks_t tc;
   void *extra;
   size_t data_len; ///< including this mt_undo
+  uint64_t uid; ///< identifies the saved event list, unchanged when the entry is re-encoded
+  size_t snap_len; ///< size of the saved event list
+  boolean is_diff; ///< data holds the difference from the next entry, rather than a full copy
 } mt_undo;
 
 struct _lives_amixer_t {
@@ -974,6 +977,7 @@ boolean event_list_rectify(lives_mt *, weed_plant_t *event_listy);
 void *find_init_event_in_ttable(ttable *trans_table, uint64_t in, boolean normal);
 void reset_renumbering(void);
 boolean make_backup_space(lives_mt *, size_t space_needed);
+void mt_undo_mem_usage(lives_mt *, size_t *used, size_t *full_size, int *nentries);
 void activate_mt_preview(lives_mt *); ///< sensitize Show Preview and Apply buttons
 void **mt_get_pchain(void);
 void event_list_free_undos(lives_mt *);
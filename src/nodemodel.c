@@ -14,6 +14,7 @@
 
 #include "main.h"
 #include "nodemodel.h"
+#include "costmodel.h"
 #include "effects-weed.h"
 #include "effects.h"
 #include "cvirtual.h"
@@ -22,10 +23,28 @@
 static volatile int nplans = 0;
 pthread_mutex_t nplans_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// prefetch runners, the plan runner and their cancel hooks all update nplans
+static int nplans_add(int n) {
+  int val;
+  pthread_mutex_lock(&nplans_mutex);
+  val = nplans += n;
+  pthread_mutex_unlock(&nplans_mutex);
+  return val;
+}
+
+// the most recent prefetch cycle, and the one before it, which may still be finishing
+static exec_plan_t *prefetch_cycle = NULL, *retiring_cycle = NULL;
+static boolean prefetch_adopted = FALSE, retiring_adopted = FALSE;
+static uint64_t prefetch_hits = 0, prefetch_misses = 0;
+
+// protects prev_step in prefetch cycles, which is cleared when the previous cycle is freed
+static pthread_mutex_t cycles_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static int allpals[] = {_ALL_24BIT_PALETTES, _ALL_32BIT_PALETTES, WEED_PALETTE_END};
 static int n_allpals = 0;
 
 #define ANN_ERR_THRESH 0.05
+#define FALLBACK_BYTES_PER_SEC 1000000000. ///< assumed rate for a pass over pixel data, until gamma has been timed
 #define ANN_GEN_LIMIT 50
 
 glob_timedata_t *glob_timing = NULL;
@@ -59,6 +78,7 @@ LIVES_GLOBAL_INLINE double get_cycle_avg_time(double *dets) {
 static inst_node_t *desc_and_add_steps(inst_node_t *, exec_plan_t *);
 static inst_node_t *desc_and_align(inst_node_t *, lives_nodemodel_t *);
 static inst_node_t *desc_and_reinit(inst_node_t *n);
+static void discard_prefetch_cycles(void);
 
 static lives_result_t get_op_order(int out_width, int out_height, int in_width, int in_height,
                                    int flags, int outpl, int inpl,
@@ -443,6 +463,16 @@ static lives_result_t get_op_order(int out_width, int out_height, int in_width,
 // and discount some time cost
 // this can affect resize, palcovn, gamma conv and proc tcosts (and dinterlace)
 
+static double get_fallback_tcost(int width, int height, int pal) {
+  // time for an operation which the cost model cannot predict yet. This must be in seconds, like the fitted costs,
+  // otherwise palettes with samples would always look cheaper (or dearer) than those without.
+  // We assume one pass over the pixel data at the rate measured for gamma conversion
+  size_t bytes = lives_frame_calc_bytesize(width, height, pal, FALSE, NULL);
+  double bps = glob_timing && glob_timing->gbytes_per_sec ? glob_timing->gbytes_per_sec : FALLBACK_BYTES_PER_SEC;
+  return (double)bytes / bps;
+}
+
+
 // here we calulculate tcost, qloss_sG, qloss_sR
 static double get_resize_cost(int cost_type, int out_width, int out_height, int in_width, int in_height,
                               int outpl, int inpl) {
@@ -462,7 +492,10 @@ static double get_resize_cost(int cost_type, int out_width, int out_height, int
     return in_size / out_size;
 
   case COST_TYPE_TIME: {
-    double tcost = 1.;
+    double tcost = cost_model_predict(COST_OP_RESIZE, 0, outpl, inpl,
+                                      (double)(out_width * out_height + in_width * in_height));
+    if (tcost < 0.) tcost = get_fallback_tcost(out_width, out_height, outpl)
+                              + get_fallback_tcost(in_width, in_height, inpl);
     /* if (glob_timing) { */
     /*   volatile float *cpuload; */
     /*   ann_testdata_t realdata; */
@@ -529,6 +562,8 @@ static double get_gamma_cost(int cost_type, int width, int height, int pal, int
     return (1. - q);
   }
   if (cost_type == COST_TYPE_TIME) {
+    double tcost = cost_model_predict(COST_OP_GAMMA, 0, pal, pal, (double)(width * height));
+    if (tcost >= 0.) return tcost;
     if (glob_timing->gbytes_per_sec) {
       size_t bytes = lives_frame_calc_bytesize(width, height, pal, FALSE, NULL);
       return bytes / glob_timing->gbytes_per_sec;
@@ -764,7 +799,8 @@ double get_pconv_cost(int cost_type, int width, int height, int outpl, int inpl,
   if (cost_type == COST_TYPE_QLOSS_P)
     return get_qloss_p(outpl, inpl, inpals);
   if (cost_type == COST_TYPE_TIME) {
-    double tcost = 0.01;
+    double tcost = cost_model_predict(COST_OP_PCONV, 0, outpl, inpl, (double)(width * height));
+    if (tcost < 0.) tcost = get_fallback_tcost(width, height, outpl) + get_fallback_tcost(width, height, inpl);
     /* if (glob_timing) { */
     /*   volatile float *cpuload; */
     /*   ann_testdata_t realdata; */
@@ -796,8 +832,9 @@ static double get_proc_cost(int cost_type, weed_filter_t *filter, int width, int
   // get processing cost for applying an instance. The only cost with non-zero valueis tcost
   double est = 0.;
   if (cost_type == COST_TYPE_TIME) {
-
-    // return estimate which will be fn(size, pal)
+    // estimate is fn(size, pal), learned from previous runs of the filter
+    est = cost_model_predict(COST_OP_PROC, cost_model_filter_key(filter), pal, pal, (double)(width * height));
+    if (est < 0.) est = 2. * get_fallback_tcost(width, height, pal);
   }
   return est;
 }
@@ -1107,6 +1144,10 @@ static lives_filter_error_t pconv_substep(plan_step_t *step) {
 
     sub->end = xtime;
 
+    if (retval == FILTER_SUCCESS && inpalette != opalette)
+      cost_model_add_sample(COST_OP_PCONV, 0, inpalette, opalette,
+                            (double)(sub->width * sub->height), sub->end - sub->start);
+
     lives_layer_set_status(layer, LAYER_STATUS_PROCESSED);
     weed_layer_unref(layer);
   }
@@ -1134,8 +1175,14 @@ static lives_filter_error_t gamma_substep(plan_step_t *step) {
 
     lives_layer_set_status(layer, LAYER_STATUS_CONVERTING);
 
-    if (l_gamma != tgt_gamma && tgt_gamma != WEED_GAMMA_UNKNOWN)
+    if (l_gamma != tgt_gamma && tgt_gamma != WEED_GAMMA_UNKNOWN) {
+      double gstart = xtime;
+      int pal = weed_layer_get_palette(layer);
       gamma_convert_layer(tgt_gamma, layer);
+      xtime = lives_get_session_time();
+      cost_model_add_sample(COST_OP_GAMMA, 0, pal, pal,
+                            (double)(weed_layer_get_width(layer) * weed_layer_get_height(layer)), xtime - gstart);
+    }
 
     xtime = lives_get_session_time();
     SET_SELF_VALUE(double, "gconv_end", xtime);
@@ -1207,6 +1254,10 @@ static lives_filter_error_t res_substep(plan_step_t *step) {
 
     if (sub->start > sub->end) sub->end = sub->start;
 
+    if (resized)
+      cost_model_add_sample(COST_OP_RESIZE, 0, sub->pal, opalette,
+                            (double)(sub->width * sub->height + xwidth * xheight), sub->end - sub->start);
+
     lives_layer_set_status(layer, LAYER_STATUS_PROCESSED);
     weed_layer_unref(layer);
   }
@@ -1303,8 +1354,12 @@ static lives_filter_error_t run_apply_inst_step(plan_step_t *step, weed_instance
   }
 
   filter_mutex_lock(step->target_idx);
+  xtime = lives_get_session_time();
   filter_error = act_on_instance(inst, step->target_idx, plan->layers,
                                  plan->model->opwidth, plan->model->opheight);
+  if (filter_error == FILTER_SUCCESS && step->target)
+    cost_model_add_sample(COST_OP_PROC, cost_model_filter_key(step->target), step->fin_pal, step->fin_pal,
+                          (double)(step->fin_width * step->fin_height), lives_get_session_time() - xtime);
   filter_mutex_unlock(step->target_idx);
 
   if (filter_error == FILTER_ERROR_NEEDS_REINIT) {
@@ -1612,6 +1667,20 @@ static double dec_running_steps(plan_step_t *step) {
   return xtime;
 }
 
+static boolean prev_cycle_step_done(plan_step_t *step) {
+  // in a prefetch cycle, a step cannot start until the same step in the previous cycle is done
+  boolean done = TRUE;
+  pthread_mutex_lock(&cycles_mutex);
+  if (step->prev_step) {
+    int state = step->prev_step->state;
+    done = (state == STEP_STATE_FINISHED || state == STEP_STATE_SKIPPED || state == STEP_STATE_IGNORE
+            || state == STEP_STATE_ERROR || state == STEP_STATE_CANCELLED);
+    if (done) step->prev_step = NULL;
+  }
+  pthread_mutex_unlock(&cycles_mutex);
+  return done;
+}
+
 static pthread_mutex_t planrunner_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static int planrunner_trylock(void) {
@@ -1627,7 +1696,10 @@ static int planrunner_unlock(void) {
 }
 
 void postpone_planning(void) {
-  if (LIVES_IS_PLAYING) planrunner_lock();
+  if (LIVES_IS_PLAYING) {
+    discard_prefetch_cycles();
+    planrunner_lock();
+  }
 }
 
 void continue_planning(void) {
@@ -1638,6 +1710,121 @@ void continue_planning(void) {
 }
 
 
+// quality controller - if plan cycles keep overrunning the frame period, we step down the quality, and step back up
+// once there is enough headroom. Levels are taken in this order, and given back in reverse order:
+// - playback quality is lowered, one step at a time to PB_QUALITY_LOW. When the model is rebuilt, this selects
+//   cheaper palettes and interpolation, and allows smaller processing sizes
+// - the most expensive filter with a single in and single out channel is bypassed, up to QCTL_MAX_SKIPS filters
+// this only runs if adaptive quality is enabled in preferences
+static double qctl_avg = 0.;
+static int qctl_over = 0, qctl_under = 0, qctl_settle = 0;
+static int qctl_qdrop = 0, qctl_nskips = 0;
+static int qctl_skips[QCTL_MAX_SKIPS];
+static uint64_t qctl_skip_keys = 0;
+
+void qctl_reset(void) {
+  qctl_avg = 0.;
+  qctl_over = qctl_under = qctl_settle = 0;
+  qctl_qdrop = qctl_nskips = 0;
+  qctl_skip_keys = 0;
+}
+
+
+boolean qctl_active(void) {
+  // playback is run by plan cycles, so quality is controlled from their timings
+  return prefs->pbq_adaptive && LIVES_IS_PLAYING && mainw->exec_plan;
+}
+
+
+int qctl_pb_quality(int pb_quality) {
+  pb_quality -= qctl_qdrop;
+  return pb_quality < PB_QUALITY_LOW ? PB_QUALITY_LOW : pb_quality;
+}
+
+
+LIVES_LOCAL_INLINE boolean qctl_key_skipped(int key) {
+  return key >= 0 && key < 64 && (qctl_skip_keys & (1ull << key));
+}
+
+
+static int qctl_pick_skip(exec_plan_t *plan) {
+  // find the filter which took longest in the last cycle, from those which can simply be bypassed
+  plan_step_t *step;
+  double maxtime = 0.;
+  int key = -1;
+  for (LiVESList *list = plan->steps; list; list = list->next) {
+    step = (plan_step_t *)list->data;
+    if (step->st_type != STEP_TYPE_APPLY_INST || !step->target || step->state != STEP_STATE_FINISHED) continue;
+    if (step->target_idx < 0 || step->target_idx >= 64 || qctl_key_skipped(step->target_idx)) continue;
+    if (count_ctmpls(step->target, LIVES_INPUT) != 1 || count_ctmpls(step->target, LIVES_OUTPUT) != 1) continue;
+    if (step->tdata->real_duration > maxtime) {
+      maxtime = step->tdata->real_duration;
+      key = step->target_idx;
+    }
+  }
+  return key;
+}
+
+
+static void qctl_update(exec_plan_t *plan) {
+  double ratio;
+  int key;
+
+  if (!prefs->pbq_adaptive) {
+    // adaptive quality was switched off, give back anything we took
+    if (qctl_qdrop || qctl_nskips) {
+      if (qctl_qdrop) mainw->refresh_model = TRUE;
+      qctl_reset();
+      d_print_debug("QUALITY CONTROL: disabled, restoring playback quality and filters\n");
+    }
+    return;
+  }
+  if (plan->tdata->tgt_time <= 0. || plan->tdata->real_duration <= 0.) return;
+  ratio = plan->tdata->real_duration / plan->tdata->tgt_time;
+  qctl_avg = qctl_avg ? qctl_avg * (1. - QCTL_SMOOTHING) + ratio * QCTL_SMOOTHING : ratio;
+
+  if (qctl_avg > QCTL_DEGRADE_RATIO) qctl_over++;
+  else qctl_over = 0;
+  if (qctl_avg < QCTL_RESTORE_RATIO) qctl_under++;
+  else qctl_under = 0;
+
+  if (qctl_settle > 0) {
+    // give the last change time to take effect
+    qctl_settle--;
+    return;
+  }
+
+  if (qctl_over >= QCTL_DEGRADE_CYCLES) {
+    if (qctl_pb_quality(future_prefs->pb_quality) > PB_QUALITY_LOW) {
+      qctl_qdrop++;
+      mainw->refresh_model = TRUE;
+      d_print_debug("QUALITY CONTROL: cycles average %.2f %% of frame period, lowering playback quality to %d\n",
+                    qctl_avg * 100., qctl_pb_quality(future_prefs->pb_quality));
+    } else if (qctl_nskips < QCTL_MAX_SKIPS && (key = qctl_pick_skip(plan)) != -1) {
+      qctl_skips[qctl_nskips++] = key;
+      qctl_skip_keys |= 1ull << key;
+      d_print_debug("QUALITY CONTROL: cycles average %.2f %% of frame period, bypassing filter on key %d\n",
+                    qctl_avg * 100., key + 1);
+    } else return;
+  } else if (qctl_under >= QCTL_RESTORE_CYCLES) {
+    if (qctl_nskips) {
+      key = qctl_skips[--qctl_nskips];
+      qctl_skip_keys &= ~(1ull << key);
+      d_print_debug("QUALITY CONTROL: cycles average %.2f %% of frame period, restoring filter on key %d\n",
+                    qctl_avg * 100., key + 1);
+    } else if (qctl_qdrop) {
+      qctl_qdrop--;
+      mainw->refresh_model = TRUE;
+      d_print_debug("QUALITY CONTROL: cycles average %.2f %% of frame period, raising playback quality to %d\n",
+                    qctl_avg * 100., qctl_pb_quality(future_prefs->pb_quality));
+    } else return;
+  } else return;
+
+  qctl_over = qctl_under = 0;
+  qctl_settle = QCTL_SETTLE_CYCLES;
+}
+
+
 #define SET_PLAN_STATE(xstate) _DW0(plan->state = PLAN_STATE_##xstate;)
 
 static void run_plan(exec_plan_t *plan) {
@@ -1649,7 +1836,7 @@ static void run_plan(exec_plan_t *plan) {
   lives_layer_t *layer;
   lives_proc_thread_t lpt;
   double xtime;
-  double errval;
+  double errval, est_time, real_time;
   boolean complete = FALSE;
   boolean cancelled = FALSE;
   boolean paused = FALSE;
@@ -1660,7 +1847,7 @@ static void run_plan(exec_plan_t *plan) {
 
   if (!plan) return;
 
-  if (nplans > 1) lives_abort("multiple plans cannot be active simultaneously");
+  if (nplans_add(0) > MAX_PLAN_CYCLES) lives_abort("too many plan cycles active simultaneously");
 
   ____FUNC_ENTRY____(run_plan, NULL, "v");
 
@@ -1668,7 +1855,8 @@ static void run_plan(exec_plan_t *plan) {
 
   //MSGMODE_ON(DEBUG);
 
-  planrunner_lock();
+  // prefetch cycles run alongside the current cycle, which holds the lock until it completes
+  if (!(plan->flags & PLAN_FLAG_PREFETCH)) planrunner_lock();
 
   if (mainw->refresh_model ||
       lives_proc_thread_get_cancel_requested(self)) {
@@ -1676,7 +1864,7 @@ static void run_plan(exec_plan_t *plan) {
   }
 
   //if (!ann_proc) ann_roll_launch();
-  if (plan->iteration == 1) {
+  if (plan->iteration == 1 && !(plan->flags & PLAN_FLAG_PREFETCH)) {
     glob_timing->tot_duration = glob_timing->avg_duration = 0.;
     if (ann_proc && (plan->model->flags & NODEMODEL_NEW))
       lives_proc_thread_set_loveliness(ann_proc, DEF_LOVELINESS);
@@ -1826,6 +2014,8 @@ static void run_plan(exec_plan_t *plan) {
 
         complete = FALSE;
 
+        if (!prev_cycle_step_done(step)) continue;
+
         // ensure dependencie are fullfilled
         if (step->st_type == STEP_TYPE_LOAD) {
           frames64_t frame;
@@ -1849,7 +2039,7 @@ static void run_plan(exec_plan_t *plan) {
             frame = plan->frame_idx[step->track];
             if (!frame) continue;
 
-            plan->template->frame_idx[step->track] = frame;
+            if (!(plan->flags & PLAN_FLAG_PREFETCH)) plan->template->frame_idx[step->track] = frame;
 
             layer = lives_layer_new_for_frame(plan->model->clip_index[step->track], frame);
 
@@ -1893,8 +2083,9 @@ static void run_plan(exec_plan_t *plan) {
           if (lstatus == LAYER_STATUS_PREPARED) {
             int clip = lives_layer_get_clip(layer);
             lives_clip_t *sfile = RETURN_VALID_CLIP(clip);
-            plan->template->frame_idx[step->track] = plan->frame_idx[step->track]
-            = lives_layer_get_frame(layer);
+            plan->frame_idx[step->track] = lives_layer_get_frame(layer);
+            if (!(plan->flags & PLAN_FLAG_PREFETCH))
+              plan->template->frame_idx[step->track] = plan->frame_idx[step->track];
             xtime = inc_running_steps(step);
             d_print_debug("\nstep %d; RUN LOAD - track %d, clip %d, frame %ld, @ %.2f msec\n", step_count,
                           step->track, step->target_idx, plan->frame_idx[step->track], xtime * 1000.);
@@ -1942,6 +2133,23 @@ static void run_plan(exec_plan_t *plan) {
             step->state = STEP_STATE_ERROR;
             break;
           }
+
+          // an adopted layer is in both the prefetch cycle and the cycle which took it over, so the layer is
+          // claimed under the status lock; the other cycle waits until the conversion is done
+          lock_layer_status(layer);
+          if ((plan->flags & PLAN_FLAG_PREFETCH)
+              && weed_get_boolean_value(layer, LIVES_LEAF_PREFETCH_ADOPTED, NULL) == WEED_TRUE) {
+            unlock_layer_status(layer);
+            step->state = STEP_STATE_IGNORE;
+            continue;
+          }
+          if (_lives_layer_get_status(layer) == LAYER_STATUS_CONVERTING) {
+            unlock_layer_status(layer);
+            continue;
+          }
+          _lives_layer_set_status(layer, LAYER_STATUS_CONVERTING);
+          unlock_layer_status(layer);
+
           step->ini_pal = weed_layer_get_palette(layer);
           step->ini_width = weed_layer_get_width(layer);
           step->ini_height = weed_layer_get_height(layer);
@@ -2096,6 +2304,7 @@ static void run_plan(exec_plan_t *plan) {
           step->state = STEP_STATE_RUNNING;
 
           lives_proc_thread_set_cancellable(lpt);
+          if (step->flags & STEP_FLAG_CRITICAL) lives_proc_thread_set_loveliness(lpt, MAX_LOVELINESS);
 
           // queue lpt and have it remove proc_thread from layer after
           lives_layer_async_auto(layer, lpt);
@@ -2136,13 +2345,26 @@ static void run_plan(exec_plan_t *plan) {
               break;
             }
 
+            if (qctl_key_skipped(step->target_idx)) {
+              d_print_debug("\nstep %d APPLY INST  skipped, bypassed by quality control\n", step->count);
+              step->state = STEP_STATE_SKIPPED;
+              weed_instance_unref(inst);
+              break;
+            }
+
             step->state = STEP_STATE_RUNNING;
             inc_running_steps(step);
             complete = FALSE;
 
-            step->proc_thread =
-              lives_proc_thread_create(LIVES_THRDATTR_NONE,
-                                       run_apply_inst_step, WEED_SEED_INT, "vv", step, inst);
+            if (step->flags & STEP_FLAG_CRITICAL) {
+              step->proc_thread =
+                lives_proc_thread_create(LIVES_THRDATTR_PRIORITY,
+                                         run_apply_inst_step, WEED_SEED_INT, "vv", step, inst);
+              lives_proc_thread_set_loveliness(step->proc_thread, MAX_LOVELINESS);
+            } else
+              step->proc_thread =
+                lives_proc_thread_create(LIVES_THRDATTR_NONE,
+                                         run_apply_inst_step, WEED_SEED_INT, "vv", step, inst);
             weed_instance_unref(inst);
             //
           } else {
@@ -2445,7 +2667,10 @@ static void run_plan(exec_plan_t *plan) {
       layer = plan->layers[i];
       //weed_layer_ref(layer);
       if (layer) {
-        if (plan->state == PLAN_STATE_CANCELLED || plan->state == PLAN_STATE_ERROR)
+        // layers from a prefetch cycle may be left LOADED, for the next cycle to take over
+        if (plan->flags & PLAN_FLAG_PREFETCH) {
+          if (plan->state == PLAN_STATE_ERROR) weed_layer_set_invalid(layer, TRUE);
+        } else if (plan->state == PLAN_STATE_CANCELLED || plan->state == PLAN_STATE_ERROR)
           weed_layer_set_invalid(layer, TRUE);
         else {
           lock_layer_status(layer);
@@ -2473,7 +2698,10 @@ static void run_plan(exec_plan_t *plan) {
     }
   }
 
-  if (plan->state == PLAN_STATE_RUNNING) {
+  if (plan->state == PLAN_STATE_RUNNING && (plan->flags & PLAN_FLAG_PREFETCH)) {
+    d_print_debug("PREFETCH DONE, in %.4f msec\n", 1000. * (plan->tdata->real_end - plan->tdata->real_start));
+    SET_PLAN_STATE(COMPLETE);
+  } else if (plan->state == PLAN_STATE_RUNNING) {
     int gtorun = 0;
     //extract_timedata(plan);
     /* d_print_debug("train nnet\n"); */
@@ -2541,6 +2769,24 @@ static void run_plan(exec_plan_t *plan) {
     glob_timing->active = FALSE;
     pthread_mutex_unlock(&glob_timing->upd_mutex);
 
+    // compare estimated and measured times for the steps which the cost model estimates
+    est_time = real_time = 0.;
+    for (LiVESList *list = plan->steps; list; list = list->next) {
+      step = (plan_step_t *)list->data;
+      if (step->state != STEP_STATE_FINISHED || step->tdata->est_duration <= 0.) continue;
+      if (step->st_type != STEP_TYPE_CONVERT && step->st_type != STEP_TYPE_APPLY_INST) continue;
+      est_time += step->tdata->est_duration;
+      real_time += step->tdata->real_duration / 1000.;
+    }
+    cost_model_report_plan(est_time, real_time);
+
+    qctl_update(plan);
+
+    // parallelism is the total time of all steps over the time the cycle took
+    if (plan->tdata->real_duration > 0.)
+      d_print_debug("PARALLELISM: %.2f steps active on average, critical path estimated at %.4f msec\n",
+                    plan->tdata->sequential_time / 1000. / plan->tdata->real_duration, plan->crit_path * 1000.);
+
     d_print_debug("PLAN DONE, finished cycle in %.4f msec, target was < %.4f (%+.4f), average is %.4f\n"
                   "sequential time %.4f (%.2f %%), concurrent time = %.4f (%.2f %%)\n"
                   "preload time = %.4f, preload active time = %.4f (%.2f %%)\n"
@@ -2590,8 +2836,8 @@ static void run_plan(exec_plan_t *plan) {
   //MSGMODE_OFF(DEBUG);
 
   if (plan->state == PLAN_STATE_CANCELLED) lives_proc_thread_cancel(self);
-  nplans--;
-  planrunner_unlock();
+  nplans_add(-1);
+  if (!(plan->flags & PLAN_FLAG_PREFETCH)) planrunner_unlock();
 
   ____FUNC_EXIT____;
 }
@@ -2680,7 +2926,7 @@ static boolean runner_cancelled_cb(void *lptp, void *planp) {
     d_print_debug("plan cancelled @ %.2f msec\n", xtime * 1000.);
     if (plan->state == PLAN_STATE_WAITING || plan->state == PLAN_STATE_QUEUED)
       d_print_debug("(plan cancelled before running)\n");
-    nplans--;
+    nplans_add(-1);
     SET_PLAN_STATE(CANCELLED);
   }
   planrunner_unlock();
@@ -2688,11 +2934,35 @@ static boolean runner_cancelled_cb(void *lptp, void *planp) {
 }
 
 
+static boolean prefetch_cancelled_cb(void *lptp, void *planp) {
+  // as runner_cancelled_cb, but prefetch cycles do not hold the planrunner lock
+  exec_plan_t *plan = (exec_plan_t *)planp;
+  if (plan) {
+    d_print_debug("prefetch cycle cancelled @ %.2f msec\n", lives_get_session_time() * 1000.);
+    nplans_add(-1);
+    SET_PLAN_STATE(CANCELLED);
+  }
+  return FALSE;
+}
+
+
 lives_proc_thread_t execute_plan(exec_plan_t *plan, boolean async) {
   // execute steps in plan. If asynch is TRUE, then this is done in a proc_thread whichis returned
   // otherwise it runs synch and NULL is returned
   lives_proc_thread_t lpt = NULL;
   if (async) {
+    if (plan->flags & PLAN_FLAG_PREFETCH) {
+      if (plan->state != PLAN_STATE_INERT) return plan->runner;
+      SET_PLAN_STATE(QUEUED);
+      plan->runner = lpt = lives_proc_thread_create(LIVES_THRDATTR_START_UNQUEUED, run_plan, -1, "v", plan);
+      lives_proc_thread_add_hook(lpt, CANCELLED_HOOK, 0, prefetch_cancelled_cb, (void *)plan);
+      lives_proc_thread_set_cancellable(lpt);
+      plan->tdata->exec_time = lives_get_session_time();
+      nplans_add(1);
+      lives_proc_thread_queue(lpt, LIVES_THRDATTR_NONE);
+      return lpt;
+    }
+
     if (plan->state != PLAN_STATE_INERT) return mainw->plan_runner_proc;
 
     planrunner_lock();
@@ -2708,7 +2978,7 @@ lives_proc_thread_t execute_plan(exec_plan_t *plan, boolean async) {
 
     if (plan->tdata)
       plan->tdata->exec_time = lives_get_session_time();
-    nplans++;
+    nplans_add(1);
     lives_proc_thread_queue(lpt, LIVES_THRDATTR_PRIORITY);
     planrunner_unlock();
   } else run_plan(plan);
@@ -2746,14 +3016,14 @@ static plan_step_t *plan_step_copy(exec_plan_t *dplan, exec_plan_t *splan, plan_
 }
 
 
-exec_plan_t *create_plan_cycle(exec_plan_t *template, lives_layer_t **layers) {
+static exec_plan_t *copy_plan_cycle(exec_plan_t *template, lives_layer_t **layers) {
+  // the caller sets the iteration
   exec_plan_t *cycle = NULL;
   if (template && layers) {
     cycle = (exec_plan_t *)lives_calloc(1, sizeof(exec_plan_t));
     lives_memcpy(cycle, template, sizeof(exec_plan_t));
     cycle->state = PLAN_STATE_INERT;
     cycle->template = template;
-    cycle->iteration = ++template->iteration;
     cycle->layers = layers;
 
     cycle->frame_idx = (frames64_t *)lives_calloc(cycle->model->ntracks,
@@ -2771,6 +3041,188 @@ exec_plan_t *create_plan_cycle(exec_plan_t *template, lives_layer_t **layers) {
 }
 
 
+exec_plan_t *create_plan_cycle(exec_plan_t *template, lives_layer_t **layers) {
+  exec_plan_t *cycle = copy_plan_cycle(template, layers);
+  if (cycle) cycle->iteration = ++template->iteration;
+  return cycle;
+}
+
+
+static void detach_prefetch_cycles(exec_plan_t *plan) {
+  // called when a cycle is freed; any prefetch cycles must no longer wait for its steps
+  pthread_mutex_lock(&cycles_mutex);
+  for (int i = 0; i < 2; i++) {
+    exec_plan_t *cycle = i ? retiring_cycle : prefetch_cycle;
+    if (cycle && cycle->prev_cycle == plan) {
+      for (LiVESList *list = cycle->steps; list; list = list->next)
+        ((plan_step_t *)list->data)->prev_step = NULL;
+      cycle->prev_cycle = NULL;
+    }
+  }
+  pthread_mutex_unlock(&cycles_mutex);
+}
+
+
+static void reap_prefetch_cycle(exec_plan_t *cycle, boolean adopted) {
+  // wait for a prefetch cycle to finish, then free it along with its layers
+  // if none of its layers were taken over, there is no need to let it finish
+  if (!cycle) return;
+  if (cycle->runner) {
+    if (!adopted && !lives_proc_thread_is_done(cycle->runner, FALSE))
+      lives_proc_thread_request_cancel(cycle->runner, FALSE);
+    lives_proc_thread_join(STEAL_POINTER(cycle->runner));
+  }
+  for (int i = 0; i < cycle->model->ntracks; i++) {
+    weed_layer_t *layer = cycle->layers[i];
+    if (layer) {
+      int lstatus = lives_layer_get_status(layer);
+      lives_nanosleep_while_true(lstatus == LAYER_STATUS_LOADING || lstatus == LAYER_STATUS_BUSY);
+      weed_layer_unref(layer);
+    }
+  }
+  lives_free(cycle->layers);
+  exec_plan_free(cycle);
+}
+
+
+static void retire_prefetch_cycle(void) {
+  pthread_mutex_lock(&cycles_mutex);
+  exec_plan_t *cycle = retiring_cycle;
+  boolean adopted = retiring_adopted;
+  retiring_cycle = STEAL_POINTER(prefetch_cycle);
+  retiring_adopted = prefetch_adopted;
+  prefetch_adopted = FALSE;
+  pthread_mutex_unlock(&cycles_mutex);
+  reap_prefetch_cycle(cycle, adopted);
+}
+
+
+static void discard_prefetch_cycles(void) {
+  retire_prefetch_cycle();
+  retire_prefetch_cycle();
+}
+
+
+void plan_cycle_prefetch(exec_plan_t *cycle) {
+  // start a prefetch cycle for the frames we expect the cycle after this to need, see nodemodel.h
+  // we only predict the next frame in each clip, so this is not done when playing an event list
+  exec_plan_t *pcycle;
+  frames64_t *frame_idx;
+  int ntracks, npred = 0;
+
+  if (!cycle || !cycle->template || cycle->template != mainw->exec_plan || mainw->event_list
+      || mainw->refresh_model || mainw->cancelled != CANCEL_NONE) return;
+
+  ntracks = cycle->model->ntracks;
+  frame_idx = (frames64_t *)lives_calloc(ntracks, sizeof(frames64_t));
+
+  for (int i = 0; i < ntracks; i++) {
+    lives_clip_t *sfile = RETURN_VALID_CLIP(cycle->model->clip_index[i]);
+    frames64_t frame = cycle->frame_idx[i];
+    if (!sfile || !IS_PHYSICAL_CLIP(cycle->model->clip_index[i]) || sfile->pb_fps == 0.) continue;
+    if (!frame && cycle->layers[i]) frame = lives_layer_get_frame(cycle->layers[i]);
+    if (!frame) continue;
+    frame += sfile->pb_fps > 0. ? 1 : -1;
+    if (frame < 1 || frame > sfile->frames) continue;
+    frame_idx[i] = frame;
+    npred++;
+  }
+
+  retire_prefetch_cycle();
+
+  if (!npred) {
+    lives_free(frame_idx);
+    return;
+  }
+
+  // the prefetch cycle is not counted as an iteration of the template
+  pcycle = copy_plan_cycle(cycle->template, LIVES_CALLOC_SIZEOF(weed_layer_t *, ntracks));
+  pcycle->iteration = cycle->iteration;
+  pcycle->flags |= PLAN_FLAG_PREFETCH;
+  pcycle->prev_cycle = cycle;
+  lives_memcpy(pcycle->frame_idx, frame_idx, ntracks * sizeof(frames64_t));
+  lives_free(frame_idx);
+
+  // keep only the loads for predicted frames, and the conversions which follow directly from them
+  // steps were copied from the same template, so the lists match step for step
+  for (LiVESList *list = pcycle->steps, *plist = cycle->steps; list;
+       list = list->next, plist = plist ? plist->next : NULL) {
+    plan_step_t *step = (plan_step_t *)list->data;
+    boolean keep = FALSE;
+    if (plist) step->prev_step = (plan_step_t *)plist->data;
+    if (step->state == STEP_STATE_IGNORE) continue;
+    if (step->st_type == STEP_TYPE_LOAD && !(step->flags & STEP_FLAG_RUN_AS_LOAD))
+      keep = pcycle->frame_idx[step->track] != 0;
+    else if (step->st_type == STEP_TYPE_CONVERT && step->ndeps) {
+      keep = TRUE;
+      for (int i = 0; i < step->ndeps; i++) {
+        if (step->deps[i]->st_type != STEP_TYPE_LOAD || step->deps[i]->state == STEP_STATE_IGNORE) {
+          keep = FALSE;
+          break;
+        }
+      }
+    }
+    if (!keep) {
+      step->state = STEP_STATE_IGNORE;
+      step->prev_step = NULL;
+    }
+  }
+
+  // no need to wait for a trigger, the frame numbers are already set
+  pcycle->tdata->trigger_time = lives_get_session_time();
+
+  pthread_mutex_lock(&cycles_mutex);
+  prefetch_cycle = pcycle;
+  pthread_mutex_unlock(&cycles_mutex);
+
+  execute_plan(pcycle, TRUE);
+}
+
+
+boolean plan_cycle_adopt_prefetch(exec_plan_t *cycle, int track, frames64_t frame) {
+  // if the prefetch cycle has loaded, or is loading, frame for track, make the layer part of cycle
+  // returns FALSE if the caller should set the frame number as normal
+  exec_plan_t *mcycle = NULL;
+  weed_layer_t *layer = NULL;
+  boolean adopted = FALSE, madopted = FALSE, had_prefetch;
+
+  if (!cycle || !cycle->layers || cycle->layers[track]) return FALSE;
+
+  pthread_mutex_lock(&cycles_mutex);
+  had_prefetch = prefetch_cycle != NULL;
+  if (prefetch_cycle && prefetch_cycle->model == cycle->model && prefetch_cycle->frame_idx[track] == frame
+      && prefetch_cycle->state != PLAN_STATE_ERROR && prefetch_cycle->state != PLAN_STATE_CANCELLED)
+    layer = prefetch_cycle->layers[track];
+  // a layer still PREPARED has not been picked up by the prefetch cycle yet, and the two cycles must not both load it
+  if (layer && weed_layer_check_valid(layer) && lives_layer_get_frame(layer) == frame
+      && lives_layer_get_status(layer) != LAYER_STATUS_PREPARED) {
+    // any prefetch conversion which has not claimed the layer yet will now leave it to us
+    lock_layer_status(layer);
+    weed_set_boolean_value(layer, LIVES_LEAF_PREFETCH_ADOPTED, WEED_TRUE);
+    unlock_layer_status(layer);
+    weed_layer_ref(layer);
+    cycle->layers[track] = layer;
+    cycle->frame_idx[track] = frame;
+    prefetch_adopted = adopted = TRUE;
+  } else if (prefetch_cycle && prefetch_cycle->frame_idx[track]) {
+    // mispredicted: the prefetch cycle may still be loading through the clip source for track, which our
+    // LOAD step is about to use, so it has to be cancelled, or finish if we took over any of its layers
+    mcycle = STEAL_POINTER(prefetch_cycle);
+    madopted = prefetch_adopted;
+    prefetch_adopted = FALSE;
+  }
+  pthread_mutex_unlock(&cycles_mutex);
+
+  reap_prefetch_cycle(mcycle, madopted);
+
+  if (adopted) prefetch_hits++;
+  else if (had_prefetch) prefetch_misses++;
+  if (had_prefetch && !((prefetch_hits + prefetch_misses) & 255))
+    d_print_debug("prefetch: %lu hits, %lu misses\n", prefetch_hits, prefetch_misses);
+  return adopted;
+}
+
+
 static plan_step_t *alloc_step(exec_plan_t *plan, int st_type, int ndeps, plan_step_t **deps) {
   LIVES_CALLOC_TYPE(plan_step_t,  step, 1);
   step->st_type = st_type;
@@ -3024,6 +3476,9 @@ static plan_step_t *create_step(exec_plan_t *plan, int st_type, inst_node_t *n,
         size_t memused = 0;
         weed_filter_t *filter = (weed_filter_t *)n->model_for;
         step->target = filter;
+        step->fin_width = n->width;
+        step->fin_height = n->height;
+        step->fin_pal = n->optimal_pal;
         step->tdata->est_duration = get_proc_cost(COST_TYPE_TIME, filter, n->width, n->height, n->optimal_pal);
 
         step->tdata->deadline = -1;
@@ -3068,6 +3523,65 @@ static plan_step_t *create_step(exec_plan_t *plan, int st_type, inst_node_t *n,
 }
 
 
+static int step_rank_cmp(const void *a, const void *b) {
+  // descending crit_rank; ties keep their existing order so the list stays in dependency order
+  plan_step_t *sa = (plan_step_t *)a, *sb = (plan_step_t *)b;
+  if (sa->crit_rank > sb->crit_rank) return -1;
+  if (sa->crit_rank < sb->crit_rank) return 1;
+  return 0;
+}
+
+
+static void schedule_plan_steps(exec_plan_t *plan) {
+  // using the estimated step durations, find for each step the longest chain of steps which depend on it
+  // (its rank), and reorder the steps by decreasing rank. Since run_plan checks steps in list order,
+  // when several are ready at once, those with the most work still to follow them are started first.
+  // Steps on the longest chain (the critical path) are flagged, and are queued ahead of others.
+  // Steps with no dependency on each other, e.g. loading and converting separate tracks before a blend,
+  // were already run concurrently; this only affects which go first when threads are short.
+  //
+  // a step's rank can never be less than that of a step depending on it, so sorting by rank (stably)
+  // keeps every step after its deps, as create_plan_cycle() requires
+  LiVESList *list;
+  plan_step_t *step;
+  double dur, crit_path = 0.;
+
+  for (list = plan->steps; list; list = list->next) {
+    step = (plan_step_t *)list->data;
+    step->crit_rank = step->crit_start = 0.;
+    step->flags &= ~STEP_FLAG_CRITICAL;
+  }
+
+  // forwards, deps first: longest time to reach each step
+  for (list = plan->steps; list; list = list->next) {
+    step = (plan_step_t *)list->data;
+    for (int i = 0; i < step->ndeps; i++) {
+      plan_step_t *dep = step->deps[i];
+      dur = dep->tdata->est_duration > 0. ? dep->tdata->est_duration : 0.;
+      if (dep->crit_start + dur > step->crit_start) step->crit_start = dep->crit_start + dur;
+    }
+  }
+
+  // backwards: at this point crit_rank holds the max rank of the steps depending on it
+  for (list = lives_list_last(plan->steps); list; list = list->prev) {
+    step = (plan_step_t *)list->data;
+    step->crit_rank += step->tdata->est_duration > 0. ? step->tdata->est_duration : 0.;
+    for (int i = 0; i < step->ndeps; i++)
+      if (step->crit_rank > step->deps[i]->crit_rank) step->deps[i]->crit_rank = step->crit_rank;
+    if (step->crit_start + step->crit_rank > crit_path) crit_path = step->crit_start + step->crit_rank;
+  }
+
+  // a step is critical if the longest path through it is the longest path in the plan
+  for (list = plan->steps; list; list = list->next) {
+    step = (plan_step_t *)list->data;
+    if (step->crit_start + step->crit_rank >= crit_path * .999) step->flags |= STEP_FLAG_CRITICAL;
+  }
+
+  plan->crit_path = crit_path;
+  plan->steps = lives_list_sort(plan->steps, step_rank_cmp);
+}
+
+
 exec_plan_t *create_plan_from_model(lives_nodemodel_t *nodemodel) {
   // since a nodemodel can be difficult to parse we will create a plan - a "flattebed version"
   // of it in temploral order
@@ -3132,6 +3646,8 @@ exec_plan_t *create_plan_from_model(lives_nodemodel_t *nodemodel) {
   reset_model(nodemodel);
 
   plan->steps = lives_list_reverse(plan->steps);
+
+  schedule_plan_steps(plan);
   ///  if (prefs->dev_show_timing)
   //display_plan(plan);
 
@@ -3164,6 +3680,7 @@ static void plan_step_free(plan_step_t *step) {
 void exec_plan_free(exec_plan_t *plan) {
   // free: frame_idx, tdata, steps
   if (plan) {
+    detach_prefetch_cycles(plan);
     if (plan->frame_idx) lives_free(plan->frame_idx);
     if (plan->tdata) lives_free(plan->tdata);
     if (plan->steps) {
@@ -3836,9 +4353,9 @@ static void calc_node_sizes(lives_nodemodel_t *nodemodel, inst_node_t *n) {
         }
       }
       if (!can_resize) {
-        // output cannot resize - this is basically the same as having fixed size == ouptut size
-        in->width = opwidth;
-        in->height = opheight;
+        // output cannot resize - this is basically the same as having fixed size == player size, not the proxy size
+        in->width = nodemodel->sink_width;
+        in->height = nodemodel->sink_height;
         if (letterbox) {
           width = out->width;
           height = out->height;
@@ -3860,7 +4377,7 @@ static void calc_node_sizes(lives_nodemodel_t *nodemodel, inst_node_t *n) {
           // can resize, but cannot letterbox, and banindg to get ar of output
           width = in->inner_width = out->width;
           height = in->inner_height = out->height;
-          calc_minspect(opwidth, opheight, &width, &height);
+          calc_minspect(nodemodel->sink_width, nodemodel->sink_height, &width, &height);
           in->width = width;
           in->height = height;
         }
@@ -4576,8 +5093,8 @@ static lives_result_t prepend_node(lives_nodemodel_t *nodemodel, inst_node_t *n,
 
     if (!(vpp->capabilities & VPP_CAN_RESIZE))
       in->flags |= NODEFLAG_IO_FIXED_SIZE;
-    in->inner_width = in->width = nodemodel->opwidth;
-    in->inner_height = in->height = nodemodel->opheight;
+    in->inner_width = in->width = nodemodel->sink_width;
+    in->inner_height = in->height = nodemodel->sink_height;
   }
   break;
   case NODE_MODELS_INTERNAL:
@@ -4591,8 +5108,8 @@ static lives_result_t prepend_node(lives_nodemodel_t *nodemodel, inst_node_t *n,
       target->pals = xplist;
       target->free_pals = TRUE;
       in->flags |= NODEFLAG_IO_FIXED_SIZE;
-      in->inner_width = in->width = nodemodel->opwidth;
-      in->inner_height = in->height = nodemodel->opheight;
+      in->inner_width = in->width = nodemodel->sink_width;
+      in->inner_height = in->height = nodemodel->sink_height;
       d_print_debug("set sink sizes %d X %d\n", in->width, in->height);
     }
     break;
@@ -4920,8 +5437,8 @@ static inst_node_t *create_node(lives_nodemodel_t *nodemodel, int model_type, vo
   case NODE_MODELS_INTERN:
     for (i = 0; i < nins; i++) {
       input_node_t *in = n->inputs[i];
-      in->width = nodemodel->opwidth;
-      in->height = nodemodel->opheight;
+      in->width = nodemodel->sink_width;
+      in->height = nodemodel->sink_height;
       in->flags |= NODEFLAG_IO_FIXED_SIZE;
     }
     break;
@@ -4932,8 +5449,8 @@ static inst_node_t *create_node(lives_nodemodel_t *nodemodel, int model_type, vo
     for (i = 0; i < nins; i++) {
       // node srcs are currently hardcoded, this will change
       input_node_t *in = n->inputs[i];
-      in->width = nodemodel->opwidth;
-      in->height = nodemodel->opheight;
+      in->width = nodemodel->sink_width;
+      in->height = nodemodel->sink_height;
     }
     if (vpp && (vpp->capabilities & VPP_LINEAR_GAMMA)) {
       n->flags |= NODESRC_LINEAR_GAMMA;
@@ -5516,6 +6033,165 @@ static boolean adjust_apparent_pal(inst_node_t *n) {
 }
 
 
+// cost deltas for edges (output -> input connections) from previous models
+// when the model is rebuilt, e.g. after an effect key is toggled, most edges are unchanged, only those
+// downstream of the change have new endpoints, sizes or palette lists. For the others we can copy the cdeltas
+// rather than recomputing them for every palette pairing. Edges are identified by a hash of everything
+// _calc_costs_for_input() depends on, including the cost model generation, so that edges costed before a
+// prediction changed are not reused.
+#define EDGE_COSTS_MAX 256
+
+typedef struct {
+  uint64_t sig;
+  LiVESList *cdeltas;
+} edge_costs_t;
+
+static LiVESList *edge_costs = NULL; // most recently used first
+static int n_edge_costs = 0;
+static pthread_mutex_t edge_costs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double tot_full_build_time = 0., tot_incr_build_time = 0.;
+static int n_full_builds = 0, n_incr_builds = 0;
+
+
+LIVES_LOCAL_INLINE uint64_t sig_mix(uint64_t sig, uint64_t val) {
+  sig ^= val;
+  return sig * 0x100000001b3ull;
+}
+
+
+LIVES_LOCAL_INLINE uint64_t sig_mix_dbl(uint64_t sig, double val) {
+  uint64_t bits;
+  lives_memcpy(&bits, &val, 8);
+  return sig_mix(sig, bits);
+}
+
+
+static uint64_t edge_sig(inst_node_t *n, int ni, int flags, double *glob_costs, boolean *glob_mask,
+                         double *factors) {
+  // returns 0 if the edge cannot be cached
+  input_node_t *in = n->inputs[ni];
+  inst_node_t *p = in->node;
+  output_node_t *out;
+  int npals, *pals, k;
+  uint64_t sig = 0xcbf29ce484222325ull;
+
+  // costing edges from sources also sets the source cdeltas, which depend on the clip
+  if (!p->n_inputs) return 0;
+
+  // and clones of the input get copies of the costs
+  for (k = ni + 1; k < n->n_inputs; k++)
+    if ((n->inputs[k]->flags & NODEFLAG_IO_CLONE) && n->inputs[k]->origin == ni) return 0;
+
+  out = p->outputs[in->oidx];
+
+  sig = sig_mix(sig, flags & _FLG_GHOST_COSTS);
+  sig = sig_mix(sig, prefs->pb_quality);
+  sig = sig_mix(sig, cost_model_generation());
+  for (k = 0; k < N_COST_TYPES; k++) sig = sig_mix_dbl(sig, factors[k]);
+  sig = sig_mix(sig, glob_mask[COST_TYPE_QLOSS_S]);
+  if (glob_mask[COST_TYPE_QLOSS_S]) sig = sig_mix_dbl(sig, glob_costs[COST_TYPE_QLOSS_S]);
+
+  sig = sig_mix(sig, n->model_type);
+  sig = sig_mix(sig, (uint64_t)(uintptr_t)n->model_for);
+  sig = sig_mix(sig, n->gamma_type);
+  sig = sig_mix(sig, n->flags & NODESRC_ANY_SIZE);
+  sig = sig_mix(sig, ((uint64_t)in->width << 32) | in->height);
+  sig = sig_mix(sig, ((uint64_t)in->inner_width << 32) | in->inner_height);
+  sig = sig_mix(sig, in->npals);
+  if (in->npals) {
+    npals = in->npals;
+    pals = in->pals;
+  } else {
+    npals = n->npals;
+    pals = n->pals;
+  }
+  for (k = 0; k < npals; k++)
+    sig = sig_mix(sig, ((uint64_t)input_pal_permitted(n, ni, pals[k]) << 32) | pals[k]);
+
+  sig = sig_mix(sig, p->model_type);
+  sig = sig_mix(sig, (uint64_t)(uintptr_t)p->model_for);
+  sig = sig_mix(sig, p->gamma_type);
+  sig = sig_mix(sig, p->flags & NODESRC_ANY_SIZE);
+  sig = sig_mix(sig, ((uint64_t)out->width << 32) | out->height);
+  sig = sig_mix(sig, out->npals);
+  if (out->npals) {
+    for (k = 0; k < out->npals; k++)
+      sig = sig_mix(sig, ((uint64_t)output_pal_permitted(p, in->oidx, out->pals[k]) << 32) | out->pals[k]);
+  } else {
+    for (k = 0; k < p->npals; k++)
+      sig = sig_mix(sig, ((uint64_t)pal_permitted(p, p->pals[k]) << 32) | p->pals[k]);
+  }
+  return sig ? sig : 1;
+}
+
+
+static LiVESList *prepend_cdelta_copies(LiVESList *cdeltas, LiVESList *from, LiVESList *upto) {
+  // copy the entries from..upto (exclusive) and prepend them to cdeltas, keeping the same order
+  LiVESList *copies = NULL;
+  for (LiVESList *list = from; list && list != upto; list = list->next) {
+    cost_delta_t *cdelta = (cost_delta_t *)lives_malloc(sizeof(cost_delta_t));
+    lives_memcpy(cdelta, list->data, sizeof(cost_delta_t));
+    copies = lives_list_prepend(copies, cdelta);
+  }
+  for (LiVESList *list = copies; list; list = list->next)
+    cdeltas = lives_list_prepend(cdeltas, list->data);
+  lives_list_free(copies);
+  return cdeltas;
+}
+
+
+static boolean edge_costs_fetch(uint64_t sig, LiVESList **cdeltas) {
+  pthread_mutex_lock(&edge_costs_mutex);
+  for (LiVESList *list = edge_costs; list; list = list->next) {
+    edge_costs_t *ecosts = (edge_costs_t *)list->data;
+    if (ecosts->sig != sig) continue;
+    *cdeltas = prepend_cdelta_copies(*cdeltas, ecosts->cdeltas, NULL);
+    if (list != edge_costs) {
+      edge_costs = lives_list_delete_link(edge_costs, list);
+      edge_costs = lives_list_prepend(edge_costs, ecosts);
+    }
+    pthread_mutex_unlock(&edge_costs_mutex);
+    return TRUE;
+  }
+  pthread_mutex_unlock(&edge_costs_mutex);
+  return FALSE;
+}
+
+
+static void edge_costs_free(edge_costs_t *ecosts) {
+  lives_list_free_all(&ecosts->cdeltas);
+  lives_free(ecosts);
+}
+
+
+static void edge_costs_store(uint64_t sig, LiVESList *from, LiVESList *upto) {
+  edge_costs_t *ecosts = (edge_costs_t *)lives_calloc(1, sizeof(edge_costs_t));
+  ecosts->sig = sig;
+  ecosts->cdeltas = prepend_cdelta_copies(NULL, from, upto);
+  pthread_mutex_lock(&edge_costs_mutex);
+  edge_costs = lives_list_prepend(edge_costs, ecosts);
+  if (++n_edge_costs > EDGE_COSTS_MAX) {
+    LiVESList *last = lives_list_last(edge_costs);
+    edge_costs_free((edge_costs_t *)last->data);
+    edge_costs = lives_list_delete_link(edge_costs, last);
+    n_edge_costs--;
+  }
+  pthread_mutex_unlock(&edge_costs_mutex);
+}
+
+
+void flush_edge_costs(void) {
+  pthread_mutex_lock(&edge_costs_mutex);
+  for (LiVESList *list = edge_costs; list; list = list->next)
+    edge_costs_free((edge_costs_t *)list->data);
+  lives_list_free(edge_costs);
+  edge_costs = NULL;
+  n_edge_costs = 0;
+  pthread_mutex_unlock(&edge_costs_mutex);
+}
+
+
 static void compute_all_costs(lives_nodemodel_t *nodemodel, inst_node_t *n, int ord_ctype, double * factors, int flags) {
   // given a node n, we compute costs for all in / out pairs and add these to in->cdeltas for each input
   // the entries will be ordered by ascending cost of the specifies type
@@ -5531,10 +6207,12 @@ static void compute_all_costs(lives_nodemodel_t *nodemodel, inst_node_t *n, int
   // then using a kind of "mask" with just QLOSS_S set, copy the global masked values to each othe cdelta
 
   input_node_t *in;
+  LiVESList **pcdeltas, *ocdeltas;
 
   double glob_costs[N_COST_TYPES];
   boolean glob_mask[N_COST_TYPES];
 
+  uint64_t sig;
   int ni, j, k;
   int npals, *pal_list;
 
@@ -5570,6 +6248,16 @@ static void compute_all_costs(lives_nodemodel_t *nodemodel, inst_node_t *n, int
       glob_mask[COST_TYPE_QLOSS_S] = TRUE;
     }
 
+    if (flags & _FLG_GHOST_COSTS) pcdeltas = &in->cdeltas;
+    else pcdeltas = &in->true_cdeltas;
+
+    sig = edge_sig(n, ni, flags, glob_costs, glob_mask, factors);
+    if (sig && edge_costs_fetch(sig, pcdeltas)) {
+      nodemodel->n_edges_reused++;
+      continue;
+    }
+    ocdeltas = *pcdeltas;
+
     // iterate over all out pals, either for the node or for a specific input
     // cross reference this against the in pals available from the previous node output
     for (j = 0; j < npals; j++) {
@@ -5589,9 +6277,11 @@ static void compute_all_costs(lives_nodemodel_t *nodemodel, inst_node_t *n, int
       // calc for in - with pal pal_list[j] - over all in pals, - if glob_mask[i] is TRUE set val to glob_costs[k]
       // factors are used to compute combined_cost
       _calc_costs_for_input(nodemodel, n, ni, pal_list, j, flags, glob_costs, glob_mask, factors);
-      // *INDENT-OFF*
-    }}
-  // *INDENT-ON*
+    }
+
+    nodemodel->n_edges_costed++;
+    if (sig) edge_costs_store(sig, *pcdeltas, ocdeltas);
+  }
 }
 
 
@@ -7610,6 +8300,20 @@ static void _build_nodemodel(lives_nodemodel_t **pnodemodel, int ntracks, int *c
       get_player_size(&nodemodel->opwidth, &nodemodel->opheight);
     }
 
+    // in proxy mode, all processing is done at a fraction of the player size,
+    // and the final layer is scaled up when it is resized for the sink
+    nodemodel->sink_width = nodemodel->opwidth;
+    nodemodel->sink_height = nodemodel->opheight;
+    nodemodel->proxy_div = get_player_proxy_div();
+    if (nodemodel->proxy_div > 1) {
+      int pwidth = ((nodemodel->opwidth / nodemodel->proxy_div) >> 3) << 3;
+      int pheight = ((nodemodel->opheight / nodemodel->proxy_div) >> 1) << 1;
+      if (pwidth >= PROXY_MIN_WIDTH && pheight >= PROXY_MIN_HEIGHT) {
+        nodemodel->opwidth = pwidth;
+        nodemodel->opheight = pheight;
+      } else nodemodel->proxy_div = 1;
+    } else nodemodel->proxy_div = 1;
+
     // needs adjusting - qloss_p will be around 0.2 bad qloss
     // or 0.5 for catastrrophic
     // qloss_s - downsizing to half size and back up would be catastrophic - qloss_s of 4.
@@ -7672,6 +8376,8 @@ static void _build_nodemodel(lives_nodemodel_t **pnodemodel, int ntracks, int *c
     // instance cycle. In doing so we have the opportunity to reinit the instances asyn.
     nodemodel->flags |= NODEMODEL_NEW;
 
+    nodemodel->build_time = lives_get_session_time() - ztime;
+
     /* do { */
     /*   for (LiVESList *list = nodemodel->node_chains; list; list = list->next) { */
     /* 	node_chain_t *nchain = (node_chain_t *)list->data; */
@@ -7695,7 +8401,124 @@ void build_nodemodel(lives_nodemodel_t **pnodemodel) {
 }
 
 
+// cache of (nodemodel, plan template) pairs, most recently used first
+typedef struct {
+  lives_nodemodel_t *model;
+  exec_plan_t *plan;
+} plan_cache_entry_t;
+
+static LiVESList *plan_cache = NULL;
+static int plan_cache_hits = 0, plan_cache_misses = 0;
+
+
+static uint64_t model_config_sig(void) {
+  // returns 0 if the configuration cannot be cached
+  weed_filter_t *filter;
+  lives_clip_t *sfile;
+  lives_clipsrc_group_t *srcgrp;
+  uint64_t sig = 0xcbf29ce484222325ull;
+  int opwidth, opheight;
+
+  if (mainw->multitrack) return 0;
+
+  // active instances, in running order; connections follow from these and the blend settings
+  for (int i = 0; i < FX_KEYS_MAX_VIRTUAL; i++) {
+    if (!rte_key_valid(i + 1, TRUE) || !rte_key_is_enabled(i, TRUE)) continue;
+    filter = rte_keymode_get_filter(i + 1, rte_key_getmode(i + 1));
+    if (!filter) continue;
+    sig = sig_mix(sig, i);
+    sig = sig_mix(sig, (uint64_t)(uintptr_t)filter);
+  }
+  sig = sig_mix(sig, mainw->blend_file == -1);
+  sig = sig_mix(sig, mainw->blend_file == mainw->playing_file);
+  sig = sig_mix(sig, prefs->tr_self);
+
+  // sources
+  sig = sig_mix(sig, mainw->num_tracks);
+  for (int i = 0; i < mainw->num_tracks; i++) {
+    sig = sig_mix(sig, mainw->clip_index[i]);
+    sfile = RETURN_VALID_CLIP(mainw->clip_index[i]);
+    if (!sfile) continue;
+    sig = sig_mix(sig, (uint64_t)(uintptr_t)sfile);
+    sig = sig_mix(sig, sfile->clip_type);
+    sig = sig_mix(sig, ((uint64_t)sfile->hsize << 32) | sfile->vsize);
+    sig = sig_mix(sig, ((uint64_t)sfile->bpp << 32) | sfile->frames);
+    sig = sig_mix(sig, !!sfile->frame_index);
+    srcgrp = mainw->track_sources[i];
+    if (!srcgrp) srcgrp = get_primary_srcgrp(mainw->clip_index[i]);
+    if (!srcgrp) continue;
+    sig = sig_mix(sig, (uint64_t)(uintptr_t)srcgrp);
+    for (int j = 0; j < srcgrp->n_srcs; j++) {
+      sig = sig_mix(sig, (uint64_t)(uintptr_t)srcgrp->srcs[j]);
+      sig = sig_mix(sig, srcgrp->srcs[j]->class_uid);
+    }
+  }
+
+  // output sink
+  get_player_size(&opwidth, &opheight);
+  if (opwidth < 4) return 0;
+  sig = sig_mix(sig, ((uint64_t)opwidth << 32) | opheight);
+  sig = sig_mix(sig, get_player_proxy_div());
+  sig = sig_mix(sig, mainw->ext_playback);
+  sig = sig_mix(sig, (uint64_t)(uintptr_t)mainw->vpp);
+  if (mainw->vpp) sig = sig_mix(sig, mainw->vpp->palette);
+  sig = sig_mix(sig, prefs->use_screen_gamma);
+  sig = sig_mix(sig, prefs->pb_quality);
+
+  return sig ? sig : 1;
+}
+
+
+static void plan_cache_entry_free(plan_cache_entry_t *entry) {
+  exec_plan_free(entry->plan);
+  free_nodemodel(&entry->model);
+  lives_free(entry);
+}
+
+
+static void plan_cache_store(lives_nodemodel_t *model, exec_plan_t *plan) {
+  plan_cache_entry_t *entry = (plan_cache_entry_t *)lives_calloc(1, sizeof(plan_cache_entry_t));
+  entry->model = model;
+  entry->plan = plan;
+  plan_cache = lives_list_prepend(plan_cache, entry);
+  if (lives_list_length(plan_cache) > PLAN_CACHE_MAX) {
+    LiVESList *last = lives_list_last(plan_cache);
+    plan_cache_entry_free((plan_cache_entry_t *)last->data);
+    plan_cache = lives_list_delete_link(plan_cache, last);
+  }
+}
+
+
+static boolean plan_cache_fetch(uint64_t sig, lives_nodemodel_t **pmodel, exec_plan_t **pplan) {
+  for (LiVESList *list = plan_cache; list; list = list->next) {
+    plan_cache_entry_t *entry = (plan_cache_entry_t *)list->data;
+    if (entry->model->sig != sig) continue;
+    *pmodel = entry->model;
+    *pplan = entry->plan;
+    lives_free(entry);
+    plan_cache = lives_list_delete_link(plan_cache, list);
+    plan_cache_hits++;
+    return TRUE;
+  }
+  plan_cache_misses++;
+  return FALSE;
+}
+
+
+void flush_plan_cache(void) {
+  // models refer to clips and clip sources, so these must be dropped when playback ends
+  for (LiVESList *list = plan_cache; list; list = list->next)
+    plan_cache_entry_free((plan_cache_entry_t *)list->data);
+  lives_list_free(plan_cache);
+  plan_cache = NULL;
+}
+
+
 void cleanup_nodemodel(lives_nodemodel_t **nodemodel) {
+  exec_plan_t *tmpl_plan = NULL;
+
+  discard_prefetch_cycles();
+
   if (mainw->plan_runner_proc && !lives_proc_thread_is_done(mainw->plan_runner_proc, FALSE))
     lives_proc_thread_request_cancel(mainw->plan_runner_proc, FALSE);
 
@@ -7714,7 +8537,11 @@ void cleanup_nodemodel(lives_nodemodel_t **nodemodel) {
   planrunner_lock();
 
   if (mainw->plan_cycle) exec_plan_free(STEAL_POINTER(mainw->plan_cycle));
-  if (mainw->exec_plan) exec_plan_free(STEAL_POINTER(mainw->exec_plan));
+  if (mainw->exec_plan) {
+    if (*nodemodel && (*nodemodel)->sig && mainw->exec_plan->model == *nodemodel)
+      tmpl_plan = STEAL_POINTER(mainw->exec_plan);
+    else exec_plan_free(STEAL_POINTER(mainw->exec_plan));
+  }
 
   if (mainw->layers) {
     int maxl;
@@ -7740,7 +8567,10 @@ void cleanup_nodemodel(lives_nodemodel_t **nodemodel) {
     lives_free(mainw->layers);
     mainw->layers = NULL;
   }
-  if (*nodemodel) free_nodemodel(nodemodel);
+  if (*nodemodel) {
+    if (tmpl_plan) plan_cache_store(STEAL_POINTER(*nodemodel), tmpl_plan);
+    else free_nodemodel(nodemodel);
+  }
   mainw->refresh_model = TRUE;
 
   planrunner_unlock();
@@ -7841,7 +8671,8 @@ lives_result_t run_next_cycle(void) {
   if (mainw->blend_file != -1 && mainw->num_tracks > 1) {
     frames64_t blend_frame = get_blend_frame(mainw->currticks);
     if (blend_frame > 0) {
-      mainw->plan_cycle->frame_idx[1] = blend_frame;
+      if (!plan_cycle_adopt_prefetch(mainw->plan_cycle, 1, blend_frame))
+        mainw->plan_cycle->frame_idx[1] = blend_frame;
       plan_cycle_trigger(mainw->plan_cycle);
     }
   }
@@ -7852,12 +8683,14 @@ lives_result_t run_next_cycle(void) {
 
 void rebuild_nodemodel(void) {
   double xtime;
+  uint64_t sig;
   //g_print("node model needs rebuilding\n");
 
   cleanup_nodemodel(&mainw->nodemodel);
   planrunner_lock();
   d_print_debug("prev plan cancelled, good to create new plan\n");
-  prefs->pb_quality = future_prefs->pb_quality;
+  // the quality controller may be holding playback quality below the user's setting
+  prefs->pb_quality = qctl_pb_quality(future_prefs->pb_quality);
 
   d_print_debug("rebuilding model\n");
 
@@ -7869,14 +8702,41 @@ void rebuild_nodemodel(void) {
 
   xtime = lives_get_session_time();
 
+  sig = model_config_sig();
+  if (sig && plan_cache_fetch(sig, &mainw->nodemodel, &mainw->exec_plan)) {
+    // same configuration as a previous model, we only need to align the instances and sources with it
+    align_with_model(mainw->nodemodel);
+    planrunner_unlock();
+    run_next_cycle();
+    d_print_debug("reused cached model and plan, made new plan-cycle, completed in %.4f millisec "
+                  "(plan cache %d hits, %d misses)\n", 1000. * (lives_get_session_time() - xtime),
+                  plan_cache_hits, plan_cache_misses);
+    return;
+  }
+
   build_nodemodel(&mainw->nodemodel);
+  mainw->nodemodel->sig = sig;
   align_with_model(mainw->nodemodel);
   mainw->exec_plan = create_plan_from_model(mainw->nodemodel);
 
+  // a build which reused no edge costs was a full rebuild, otherwise only the changed edges were costed
+  if (mainw->nodemodel->n_edges_reused) {
+    n_incr_builds++;
+    tot_incr_build_time += mainw->nodemodel->build_time;
+  } else {
+    n_full_builds++;
+    tot_full_build_time += mainw->nodemodel->build_time;
+  }
+
   planrunner_unlock();
   run_next_cycle();
   g_print("rebuilt model (pt 1), created new plan, made new plan-cycle, completed in %.4f millisec\n",
           1000. * (lives_get_session_time() - xtime));
+  d_print_debug("model built in %.4f millisec, %d edges costed, %d reused; average full build %.4f millisec (%d), "
+                "incremental %.4f millisec (%d)\n", 1000. * mainw->nodemodel->build_time,
+                mainw->nodemodel->n_edges_costed, mainw->nodemodel->n_edges_reused,
+                n_full_builds ? 1000. * tot_full_build_time / (double)n_full_builds : 0., n_full_builds,
+                n_incr_builds ? 1000. * tot_incr_build_time / (double)n_incr_builds : 0., n_incr_builds);
 }
 
 
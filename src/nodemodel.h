@@ -14,6 +14,7 @@
 #define HAS_LIVES_NODEMODEL_H
 
 #define LIVES_LEAF_PLAN_CONTROL "plan_control"
+#define LIVES_LEAF_PREFETCH_ADOPTED "prefetch_adopted" ///< layer was taken over from a prefetch cycle
 
 #define NODE_PASSTHRU 0
 #define NODE_INPUT 1
@@ -341,7 +342,9 @@ typedef struct {
   // last node will either be a sink_inst or a sink_node
   int flags;
   double factors[N_COST_TYPES];
-  int opwidth, opheight;
+  int opwidth, opheight; ///< processing size, this is the player size divided by proxy_div
+  int sink_width, sink_height; ///< player size, sink inputs are resized to this
+  int proxy_div; ///< see get_player_proxy_div()
 
   // list of all nodes in any order
   LiVESList *nodes;
@@ -355,6 +358,13 @@ typedef struct {
   // these values are used during construction, and hold placeholder layers
   int ntracks;
   int *clip_index;
+
+  uint64_t sig; ///< hash of the configuration the model was built for, 0 if it cannot be cached
+
+  // timing for the most recent build
+  double build_time; ///< seconds to create and cost the model
+  int n_edges_costed; ///< edges whose cost deltas were computed
+  int n_edges_reused; ///< edges whose cost deltas were copied from a previous model
 } lives_nodemodel_t;
 
 // we may have two values for a single in_pal, out_pal, one including conversion
@@ -674,6 +684,9 @@ typedef struct _inst_node {
 #define STEP_FLAG_NO_READY_STAT		(1ull << 8)
 #define STEP_FLAG_RUN_AS_LOAD		(1ull << 9)
 
+// step is on the critical path (see schedule_plan_steps()), its proc_thread is queued with priority
+#define STEP_FLAG_CRITICAL		(1ull << 10)
+
 #define STEP_FLAG_TAGGED_LAYER		(1ull << 16)
 
 #define STEP_TYPE_LOAD	 		1
@@ -822,6 +835,7 @@ struct _plan_step {
   int count;
   int ndeps;
   plan_step_t **deps;
+  plan_step_t *prev_step; ///< the same step in the plan's prev_cycle, which must be done before this one can start
   size_t start_res[N_RES_TYPES], end_res[N_RES_TYPES];
   double real_st, real_end, paused_time;
   volatile int state;  // same values as PLAN_STATE
@@ -853,6 +867,10 @@ struct _plan_step {
 
   LiVESList *substeps;
 
+  // estimated time (seconds) from the start of this step to the end of the plan, along the longest path
+  // through the steps which depend on it, and the longest estimated time to reach it from the plan start
+  double crit_rank, crit_start;
+
   const char *errmsg;
 
   // eg. apply deinterlace
@@ -945,8 +963,30 @@ struct _exec_plan {
   LiVESList *steps;
 
   volatile uint64_t state;
+
+  uint64_t flags;
+
+  // for prefetch cycles, the cycle which was running when this one was created, and the proc_thread running this one
+  exec_plan_t *prev_cycle;
+  lives_proc_thread_t runner;
+
+  double crit_path; ///< estimated duration (seconds) of the longest chain of dependent steps
 };
 
+// a prefetch cycle runs alongside the current cycle, loading (and converting to the source palette) the frames
+// we expect the next cycle to need. All other steps are ignored. When the next cycle is given its frames,
+// any layer from the prefetch cycle with the same frame number is taken over by the next cycle, and its own steps
+// for that track find the layer already loaded. A prefetch conversion not yet started for an adopted layer is ignored,
+// one already running is waited for, since a CONVERT step never starts on a layer which is CONVERTING.
+// If the frame for a predicted track differs, the prefetch cycle is
+// cancelled (or joined, if any of its layers were taken over) before the next cycle can load from the same source.
+// Each prefetch step waits for the same step in the previous cycle, so the two never pull from a clip source
+// at the same time. Since a prefetch cycle may still be finishing when the next is started, there can be up to
+// MAX_PLAN_CYCLES cycles in flight at once
+#define PLAN_FLAG_PREFETCH	(1ull << 0)
+
+#define MAX_PLAN_CYCLES 3
+
 double get_cycle_avg_time(double *dets);
 
 lives_result_t run_next_cycle(void);
@@ -960,6 +1000,38 @@ void cleanup_nodemodel(lives_nodemodel_t **);
 
 void rebuild_nodemodel(void);
 
+// cost deltas for edges which are unchanged from previous models are reused when rebuilding
+// this discards them, e.g. so that a new playback picks up changes in the measured costs
+void flush_edge_costs(void);
+
+// when the model is rebuilt, the previous model and plan template are kept, keyed by a hash of the configuration
+// (active instances and their connections, sources, output sink). If a later rebuild is for the same
+// configuration, e.g. when cycling through a set of effect keys, the model and plan are reused.
+#define PLAN_CACHE_MAX 8
+
+// smallest processing size in proxy mode; if the divided player size would be smaller, proxy mode is not used
+#define PROXY_MIN_WIDTH 64
+#define PROXY_MIN_HEIGHT 48
+
+void flush_plan_cache(void);
+
+// quality controller: when the average plan cycle time stays above QCTL_DEGRADE_RATIO of the frame period
+// for QCTL_DEGRADE_CYCLES cycles, playback quality is lowered, then the most expensive single channel filters
+// are bypassed. These are restored in reverse order once it stays below QCTL_RESTORE_RATIO
+// for QCTL_RESTORE_CYCLES. After each change, no further change is made for QCTL_SETTLE_CYCLES
+// (only when prefs->pbq_adaptive is set). Whilst it is active, update_effort() leaves playback quality to it
+#define QCTL_SMOOTHING .2
+#define QCTL_DEGRADE_RATIO 1.
+#define QCTL_RESTORE_RATIO .6
+#define QCTL_DEGRADE_CYCLES 8
+#define QCTL_RESTORE_CYCLES 50
+#define QCTL_SETTLE_CYCLES 25
+#define QCTL_MAX_SKIPS 4
+
+void qctl_reset(void);
+boolean qctl_active(void);
+int qctl_pb_quality(int pb_quality); ///< pb_quality adjusted for the current degrade level
+
 void postpone_planning(void);
 void continue_planning(void);
 
@@ -971,6 +1043,9 @@ void exec_plan_free(exec_plan_t *);
 
 void plan_cycle_trigger(exec_plan_t *cycle);
 
+void plan_cycle_prefetch(exec_plan_t *cycle);
+boolean plan_cycle_adopt_prefetch(exec_plan_t *cycle, int track, frames64_t frame);
+
 void display_plan(exec_plan_t *);
 
 void find_best_routes(lives_nodemodel_t *nodemodel, double *thresh);
@@ -20,6 +20,8 @@
 #include "resample.h"
 #include "clip_load_save.h"
 #include "nodemodel.h"
+#include "costmodel.h"
+#include "genqueue.h"
 
 static boolean _start_playback(int play_type) {
   // play types: (some are no longer valid)
@@ -41,6 +43,7 @@ static boolean _start_playback(int play_type) {
   player_desensitize();
 
   mainw->player_proc = self;
+  sched_policy_apply(SCHED_CLASS_PLAYER);
 
   switch (play_type) {
   case 8: case 6: case 0:
@@ -320,6 +323,8 @@ static void post_playback(void) {
   // do this and update widgets BEFORE closing gen
   reset_mainwin_size();
 
+  genq_stop_all();
+
   if (!mainw->preview && CURRENT_CLIP_IS_VALID && cfile->clip_type == CLIP_TYPE_GENERATOR) {
     mainw->osc_block = TRUE;
     weed_generator_end((weed_instance_t *)get_primary_inst(cfile));
@@ -758,6 +763,9 @@ void play_file(void) {
   }
 
   mainw->refresh_model = TRUE;
+  flush_edge_costs();
+  flush_plan_cache();
+  qctl_reset();
 
   fg_service_wake();
 
@@ -1145,7 +1153,7 @@ void play_file(void) {
       unregister_aux_audio_channels(1);
     if (AUD_SRC_EXTERNAL) {
       if (prefs->audio_opts & AUDIO_OPTS_EXT_FX)
-        unregister_audio_client(FALSE);
+        unregister_audio_client(NULL);
     }
 
     if (mainw->jackd_read || mainw->aud_rec_fd != -1)
@@ -1279,6 +1287,9 @@ void play_file(void) {
 
   // nodemodel / plan
   if (mainw->nodemodel) cleanup_nodemodel(&mainw->nodemodel);
+  flush_plan_cache();
+  // the plan runners only collect samples, we write them out here rather than in the middle of playback
+  cost_model_save();
 
   //  ann_roll_cancel();
 
@@ -812,7 +812,8 @@ no_precache:
     //MSGMODE_OFF(DEBUG);
 skip_precache:
     if (!mainw->frame_layer) {
-      if (mainw->plan_cycle) mainw->plan_cycle->frame_idx[0] = frame;
+      if (mainw->plan_cycle && !plan_cycle_adopt_prefetch(mainw->plan_cycle, 0, frame))
+        mainw->plan_cycle->frame_idx[0] = frame;
       //lives_layer_set_status(mainw->layers[0], LAYER_STATUS_PREPARED);
     }
   }
@@ -1173,6 +1174,8 @@ weed_layer_t *load_frame_image(frames_t frame) {
         plan_cycle_trigger(mainw->plan_cycle);
       }
       mainw->plan_cycle->tdata->actual_start = lives_get_session_time();
+      // start loading the next frames while this cycle is processed
+      plan_cycle_prefetch(mainw->plan_cycle);
     }
 
     if (!mainw->multitrack &&
@@ -1930,8 +1933,6 @@ static double audio_start;
 
 static lives_time_source_t last_time_source;
 
-static double jitter = 0.;
-
 static weed_timecode_t event_start = 0;
 
 void ready_player_one(weed_timecode_t estart) {
@@ -1956,12 +1957,26 @@ void ready_player_one(weed_timecode_t estart) {
 const char *get_cache_stats(void) {
   static char buff[1024];
   lives_snprintf(buff, 1024, "preload caches = %d, hits = %d "
-                 "misses = %d,\nframe jitter = %.03f milliseconds.",
-                 cache_hits + cache_misses, cache_hits, cache_misses, jitter * 1000.);
+                 "misses = %d,\nframe jitter = %.03f milliseconds (p%d).",
+                 cache_hits + cache_misses, cache_hits, cache_misses,
+                 (double)fpacer_jitter_percentile(FPACE_PCT) / TICKS_PER_SECOND_DBL * 1000., FPACE_PCT);
   return buff;
 }
 
 
+static void pace_player(lives_clip_t *sfile) {
+  // if nothing needs doing before the next frame is due, wait for it rather than looping
+  // event list playback and fixed rate output are timed differently, so we do not pace those
+  double fps;
+  if (mainw->force_show || mainw->refresh_model || !mainw->video_seek_ready || mainw->event_list
+      || mainw->scratch != SCRATCH_NONE || sfile->play_paused || sfile->delivery == LIVES_DELIVERY_PUSH
+      || mainw->fixed_fpsd > 0. || (mainw->vpp && mainw->vpp->fixed_fpsd > 0. && mainw->ext_playback)) return;
+  fps = fabs(sfile->pb_fps * sfile->fps_scale);
+  if (fps < 0.001) return;
+  fpacer_wait(mainw->startticks + (ticks_t)(TICKS_PER_SECOND_DBL / fps));
+}
+
+
 frames_t reachable_frame(int clipno, lives_decoder_t *dplug, frames_t stframe, frames_t enframe,
                          frames_t base, double fps, double * ttime, double * tconf) {
   // check range from stframe to enframe
@@ -2297,7 +2312,7 @@ static int process_one(void) {
         register_aux_audio_channels(1);
       if (AUD_SRC_EXTERNAL) {
         if (prefs->audio_opts & AUDIO_OPTS_EXT_FX)
-          register_audio_client(FALSE);
+          register_audio_client(NULL);
         mainw->jackd->in_use = TRUE;
       }
     }
@@ -2764,7 +2779,8 @@ close_clip:
   }
   /////////////
 
-  mainw->audio_stretch = 1.;
+  // vary the audio rate slightly to absorb any a/v drift; if it gets too large this sets SCRATCH_JUMP
+  mainw->audio_stretch = avsync_ctl_update(mainw->playing_file);
 
   if (mainw->record_starting) {
     IF_APLAYER_JACK(jack_get_rec_avals(mainw->jackd);)
@@ -3052,7 +3068,7 @@ close_clip:
           if (mainw->fixed_fpsd <= 0. && (!mainw->vpp || mainw->vpp->fixed_fpsd <= 0. || !mainw->ext_playback)) {
             show_frame = TRUE;
           }
-          if (prefs->show_dev_opts) jitter = (double)(mainw->currticks - new_ticks) / TICKS_PER_SECOND_DBL;
+          fpacer_frame_shown(mainw->currticks - new_ticks);
         }
         sfile->last_req_frame = requested_frame;
       }
@@ -3215,7 +3231,7 @@ update_effort:
 
           //g_print("eff2 fric %.8f\n", friction);
           update_effort(friction);
-          if (prefs->pb_quality != future_prefs->pb_quality)
+          if (prefs->pb_quality != qctl_pb_quality(future_prefs->pb_quality))
             mainw->refresh_model = TRUE;
         }
       }
@@ -3862,7 +3878,10 @@ update_effort:
     if (!CURRENT_CLIP_IS_VALID) mainw->cancelled = CANCEL_INTERNAL_ERROR;
   }
 
-  if (mainw->cancelled == CANCEL_NONE) goto player_loop;
+  if (mainw->cancelled == CANCEL_NONE) {
+    if (prefs->frame_pacing && CURRENT_CLIP_IS_VALID) pace_player(mainw->files[mainw->playing_file]);
+    goto player_loop;
+  }
 
   retval = MILLIONS(2) + mainw->cancelled;
 
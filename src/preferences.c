@@ -82,6 +82,11 @@ void init_prefs(void) {
 
   DEFINE_PREF_INT64(PBTIMER_MAXDIFF, pbtimer_maxdiff, 1200000, 0);
   DEFINE_PREF_DOUBLE(PBTIMER_RESYNC_X, pbtimer_resync_factor, .001, 0);
+  DEFINE_PREF_BOOL(FRAME_PACING, frame_pacing, TRUE, 0);
+  DEFINE_PREF_INT(RT_SCHED_POLICY, rt_sched_policy, RT_SCHED_NONE, PREF_FLAG_EXPERIMENTAL);
+  DEFINE_PREF_STRING(RT_CORES, rt_cores, 256, "", PREF_FLAG_EXPERIMENTAL);
+  DEFINE_PREF_BOOL(NUMA_WORKERS, numa_workers, FALSE, PREF_FLAG_EXPERIMENTAL);
+  DEFINE_PREF_BOOL(GEN_RUNAHEAD, gen_runahead, FALSE, PREF_FLAG_EXPERIMENTAL);
 
   DEFINE_PREF_DOUBLE(REC_STOP_GB, rec_stop_gb, DEF_REC_STOP_GB, 0);
   DEFINE_PREF_INT(REC_STOP_QUOTA, rec_stop_quota, 90, 0);
@@ -93,6 +98,8 @@ void init_prefs(void) {
 
   DEFINE_PREF_BOOL(PB_HIDE_GUI, pb_hide_gui, FALSE, PREF_FLAG_EXPERIMENTAL);
   DEFINE_PREF_BOOL(SELF_TRANS, tr_self, FALSE, PREF_FLAG_EXPERIMENTAL);
+  DEFINE_PREF_INT(RENDER_SEGS, render_segs, 0, PREF_FLAG_EXPERIMENTAL);
+  DEFINE_PREF_BOOL(RENDER_SEG_CHECK, render_seg_check, FALSE, PREF_FLAG_EXPERIMENTAL);
   //DEFINE_PREF_BOOL(GENQ_MODE, genq_mode, FALSE);
   DEFINE_PREF_INT(DLOAD_MATMET, dload_matmet, LIVES_MATCH_CHOICE, 0);
   DEFINE_PREF_INT(WEBCAM_MATMET, webcam_matmet, LIVES_MATCH_AT_MOST, 0);
@@ -1830,6 +1837,14 @@ boolean pref_factory_int(const char *prefidx, int *pref, int newval, boolean per
     goto success;
   }
 
+  if (!lives_strcmp(prefidx, PREF_PROXY_DIV_CE) || !lives_strcmp(prefidx, PREF_PROXY_DIV_SEPWIN)
+      || !lives_strcmp(prefidx, PREF_PROXY_DIV_MT)) {
+    if (pref && *pref == newval) goto fail;
+    // processing size is set when the model is built
+    if (LIVES_IS_PLAYING) mainw->refresh_model = TRUE;
+    goto success;
+  }
+
   goto success;
 
 fail:
@@ -2844,6 +2859,14 @@ boolean apply_prefs(boolean skip_warn) {
 
   pref_factory_bool(PREF_PBQ_ADAPTIVE, pbq_adap, TRUE);
 
+  // combo index 0, 1, 2 -> divisor 1, 2, 4
+  pref_factory_int(PREF_PROXY_DIV_CE, &prefs->proxy_div_ce,
+                   1 << lives_combo_get_active_index(LIVES_COMBO(prefsw->proxy_ce_combo)), TRUE);
+  pref_factory_int(PREF_PROXY_DIV_SEPWIN, &prefs->proxy_div_sepwin,
+                   1 << lives_combo_get_active_index(LIVES_COMBO(prefsw->proxy_sepwin_combo)), TRUE);
+  pref_factory_int(PREF_PROXY_DIV_MT, &prefs->proxy_div_mt,
+                   1 << lives_combo_get_active_index(LIVES_COMBO(prefsw->proxy_mt_combo)), TRUE);
+
   // video open command
   if (lives_strcmp(prefs->video_open_command, video_open_command)) {
     lives_snprintf(prefs->video_open_command, PATH_MAX * 2, "%s", video_open_command);
@@ -4248,6 +4271,7 @@ _prefsw *create_prefs_dialog(LiVESWidget * saved_dialog) {
   LiVESList *textsizes_list;
   LiVESList *rmodelist = NULL;
   LiVESList *radjlist = NULL;
+  LiVESList *proxylist = NULL;
 
   lives_colRGBA64_t rgba;
 
@@ -4992,6 +5016,30 @@ _prefsw *create_prefs_dialog(LiVESWidget * saved_dialog) {
 
   toggle_sets_sensitive(LIVES_TOGGLE_BUTTON(prefsw->pbq_adaptive), prefsw->pbq_combo, TRUE);
 
+  lives_layout_add_row(LIVES_LAYOUT(layout));
+  lives_layout_add_label(LIVES_LAYOUT(layout), _("Process effects for preview at:"), TRUE);
+
+  proxylist = lives_list_append(proxylist, _("Full size"));
+  proxylist = lives_list_append(proxylist, _("1/2 size"));
+  proxylist = lives_list_append(proxylist, _("1/4 size"));
+
+  hbox = lives_layout_hbox_new(LIVES_LAYOUT(layout));
+  prefsw->proxy_ce_combo = lives_standard_combo_new(_("Embedded player"), proxylist, LIVES_BOX(hbox), NULL);
+  lives_combo_set_active_index(LIVES_COMBO(prefsw->proxy_ce_combo), prefs->proxy_div_ce >> 1);
+
+  hbox = lives_layout_hbox_new(LIVES_LAYOUT(layout));
+  prefsw->proxy_sepwin_combo = lives_standard_combo_new(_("Separate window"), proxylist, LIVES_BOX(hbox), NULL);
+  lives_combo_set_active_index(LIVES_COMBO(prefsw->proxy_sepwin_combo), prefs->proxy_div_sepwin >> 1);
+
+  hbox = lives_layout_hbox_new(LIVES_LAYOUT(layout));
+  prefsw->proxy_mt_combo = lives_standard_combo_new(_("Multitrack preview"), proxylist, LIVES_BOX(hbox),
+                           (tmp = H_("Effects are applied to a reduced size frame, which is then scaled up "
+                                     "to fit the player.\nThis can make previews of heavy effects much smoother.\n"
+                                     "Does not affect rendering, or output via playback plugins.")));
+  lives_free(tmp);
+  lives_combo_set_active_index(LIVES_COMBO(prefsw->proxy_mt_combo), prefs->proxy_div_mt >> 1);
+  lives_list_free_all(&proxylist);
+
   lives_layout_add_fill(LIVES_LAYOUT(layout), FALSE);
   hbox = lives_layout_row_new(LIVES_LAYOUT(layout));
 
@@ -7491,6 +7539,9 @@ _prefsw *create_prefs_dialog(LiVESWidget * saved_dialog) {
   ACTIVE(pbq_adaptive, TOGGLED);
 
   ACTIVE(pbq_combo, CHANGED);
+  ACTIVE(proxy_ce_combo, CHANGED);
+  ACTIVE(proxy_sepwin_combo, CHANGED);
+  ACTIVE(proxy_mt_combo, CHANGED);
   lives_signal_sync_connect(LIVES_GUI_OBJECT(pp_combo), LIVES_WIDGET_CHANGED_SIGNAL,
                             LIVES_GUI_CALLBACK(apply_button_set_enabled), NULL);
   ACTIVE(audp_combo, CHANGED);
@@ -105,6 +105,14 @@ typedef struct {
 
   boolean pbq_adaptive;
 
+  // processing size divisors for preview, per player window
+#define PROXY_DIV_FULL 1
+#define PROXY_DIV_HALF 2
+#define PROXY_DIV_QUARTER 4
+  int proxy_div_ce; ///< embedded player in the clip editor
+  int proxy_div_sepwin; ///< separate play window
+  int proxy_div_mt; ///< multitrack preview
+
   _encoder encoder; ///< from main.h
 
   short audio_player;
@@ -534,6 +542,9 @@ typedef struct {
   char def_autotrans[256];
 
   int nfx_threads;
+  int render_segs; ///< max segments for parallel rendering of multitrack layouts, 0 for auto, -1 to disable,
+  ///< 1 for a single pipelined segment
+  boolean render_seg_check; ///< compare parallel render output with a single pass render
 
   boolean alpha_post; ///< set to TRUE to force use of post alpha internally
 
@@ -555,6 +566,15 @@ typedef struct {
   ticks_t pbtimer_maxdiff;
   double pbtimer_resync_factor;
 
+  boolean frame_pacing; ///< player sleeps until the next frame is due, see fpacer_wait()
+
+  // scheduling and placement of the player, audio and worker threads, see sched_policy_apply()
+  int rt_sched_policy; ///< one of RT_SCHED_*, used for the player and audio threads if permitted and rt_cores is set
+  char rt_cores[256]; ///< cpu list, e.g "2-3", reserved for the player and audio threads; empty for no reservation
+  boolean numa_workers; ///< keep each pool thread on a single NUMA node
+
+  boolean gen_runahead; ///< render stateless generators ahead of the player, see genqueue.h
+
   boolean force64bit;
 
   boolean auto_trim_audio;
@@ -801,6 +821,9 @@ typedef struct {
   LiVESWidget *spinbutton_def_fps;
   LiVESWidget *pbq_combo;
   LiVESWidget *pbq_adaptive;
+  LiVESWidget *proxy_ce_combo;
+  LiVESWidget *proxy_sepwin_combo;
+  LiVESWidget *proxy_mt_combo;
   LiVESWidget *ofmt_combo;
   LiVESWidget *audp_combo;
   LiVESWidget *pa_gens;
@@ -1197,6 +1220,7 @@ void apply_button_set_enabled(LiVESWidget *widget, livespointer func_data);
 #define PREF_PASTARTOPTS "pa_start_opts"
 
 #define PREF_DEF_AUTHOR "default_author_name"
+#define PREF_RT_CORES "rt_cores"
 
 #ifdef ENABLE_JACK
 #define PREF_JACK_TDRIVER "jack_transport_driver"
@@ -1397,6 +1421,9 @@ void apply_button_set_enabled(LiVESWidget *widget, livespointer func_data);
 #define PREF_GENQ_MODE "genq_mode"
 #define PREF_PARESTART "pa_restart"
 #define PREF_PBQ_ADAPTIVE "pb_quality_adaptive"
+#define PREF_PROXY_DIV_CE "proxy_divisor_ce"
+#define PREF_PROXY_DIV_SEPWIN "proxy_divisor_sepwin"
+#define PREF_PROXY_DIV_MT "proxy_divisor_mt"
 #define PREF_EXTRA_COLOURS "extra_colours"
 #define PREF_SHOW_MSGS "show_messages"
 #define PREF_SHOW_SUBS "show_subtitles" /// add to prefs window
@@ -1419,6 +1446,9 @@ void apply_button_set_enabled(LiVESWidget *widget, livespointer func_data);
 #define PREF_PB_HIDE_GUI "hide_main_window_during_playback"
 
 #define PREF_SELF_TRANS "self_transition"
+#define PREF_RENDER_SEGS "max_render_segments"
+#define PREF_RENDER_SEGS_OLD "render_segments" ///< used 1 to disable
+#define PREF_RENDER_SEG_CHECK "render_segment_check"
 
 #define PREF_POGO_MODE "pogo_mode"
 
@@ -1434,6 +1464,10 @@ void apply_button_set_enabled(LiVESWidget *widget, livespointer func_data);
 
 #define PREF_PBTIMER_MAXDIFF "pbtimer_maxdif"
 #define PREF_PBTIMER_RESYNC_X "pbtimer_resync_factor"
+#define PREF_FRAME_PACING "frame_pacing"
+#define PREF_RT_SCHED_POLICY "rt_sched_policy"
+#define PREF_NUMA_WORKERS "numa_workers"
+#define PREF_GEN_RUNAHEAD "generator_runahead"
 
 ///////// float values
 #define PREF_AHOLD_THRESHOLD "ahold_threshold"
@@ -72,17 +72,37 @@ static void pulse_success_cb(pa_stream *stream, int i, void *userdata) {pa_threa
 static void stream_underflow_callback(pa_stream *s, void *userdata) {
   // we get isolated cases when the GUI is very busy, for example right after playback
   // we should ignore these isolated cases, except in DEBUGy mode.
-  // otherwise - increase tlen and possibly maxlen ?
-  // e.g. pa_stream_set_buffer_attr(s, battr, success_cb, NULL);
+  // for playback, the count is picked up by alat_adapt() which will increase tlength
+  pulse_driver_t *pulsed = (pulse_driver_t *)userdata;
 
   if (prefs->show_dev_opts) {
     fprintf(stderr, "PA Stream underrun.\n");
   }
 
+  if (pulsed) alat_underrun(&pulsed->alat);
   mainw->uflow_count++;
 }
 
 
+static void pulse_set_target_latency(pulse_driver_t *pulsed) {
+  // called from the write callback, which runs with the mainloop lock held
+  // tlength follows the adapted target, minreq is kept at a quarter of it
+  const pa_buffer_attr *cattr = pa_stream_get_buffer_attr(pulsed->pstream);
+  size_t fbytes = pulsed->out_achans * (pulsed->out_asamps >> 3);
+  pa_buffer_attr battr;
+  pa_operation *paop;
+
+  if (!cattr) return;
+  battr = *cattr;
+  battr.tlength = pulsed->alat.target_frames * fbytes;
+  if (battr.tlength > battr.maxlength) battr.tlength = battr.maxlength;
+  battr.minreq = battr.tlength >> 2;
+  battr.prebuf = 0;
+  paop = pa_stream_set_buffer_attr(pulsed->pstream, &battr, NULL, NULL);
+  if (paop) pa_operation_unref(paop);
+}
+
+
 static void stream_overflow_callback(pa_stream *s, void *userdata) {
   pa_operation *paop;
   //pulse_driver_t *pulsed = (pulse_driver_t *)userdata;
@@ -240,6 +260,7 @@ static void sample_silence_pulse(pulse_driver_t *pulsed, ssize_t nbytes) {
   size_t xbytes;
   uint8_t *pa_buff;
 #endif
+  lives_aarena_t *aar;
   size_t nsamples;
   int ret = 0;
   boolean no_add = !mainw->audio_seek_ready;
@@ -292,11 +313,12 @@ static void sample_silence_pulse(pulse_driver_t *pulsed, ssize_t nbytes) {
 
   if (no_add) goto done;
 
-  if (mainw->afbuffer && prefs->audio_src != AUDIO_SRC_EXT
-      && (!mainw->event_list || mainw->record || mainw->record_paused))  {
+  if (prefs->audio_src != AUDIO_SRC_EXT && (!mainw->event_list || mainw->record || mainw->record_paused)
+      && (aar = audio_arena_ref())) {
     // silbuffer audio for any generators
     // interleaved, so we paste all to channel 0
-    append_to_audio_buffer16(silbuff, nsamples, 2);
+    append_to_audio_buffer16(aar, silbuff, nsamples, 2);
+    audio_arena_unref();
   }
 
   if (!pulsed->is_paused) pulsed->frames_written += nsamples;
@@ -507,6 +529,13 @@ static void pulse_audio_write_process(pa_stream *pstream, size_t nbytes, void *a
     dets = NULL;
   }
 
+  if (LIVES_IS_PLAYING) {
+    size_t fbytes = pulsed->out_achans * (pulsed->out_asamps >> 3);
+    alat_callback(&pulsed->alat, nsamples, pulsed->out_arate);
+    if (alat_adapt(&pulsed->alat, pulsed->out_arate, (LIVES_PA_BUFF_TARGET >> 2) / fbytes,
+                   LIVES_PA_BUFF_MAXLEN / fbytes)) pulse_set_target_latency(pulsed);
+  } else pulsed->alat.last_cb = 0;
+
   if (!mainw->is_ready || !pulsed || (!LIVES_IS_PLAYING && !pulsed->msgq)) {
     sample_silence_pulse(pulsed, -nbytes);
     //g_print("pt a1 %ld %d %p %d %p %ld\n",nsamples, mainw->is_ready, pulsed, mainw->playing_file, pulsed->msgq, nbytes);
@@ -1842,7 +1871,8 @@ int pulse_driver_activate(pulse_driver_t *pdriver) {
     // set write callback
     pa_stream_set_write_callback(pdriver->pstream, pulse_audio_write_process, pdriver);
 
-    /* pa_stream_set_underflow_callback(pdriver->pstream, stream_underflow_callback, pdriver); */
+    alat_reset(&pdriver->alat, pa_battr.tlength / (pdriver->out_achans * (pdriver->out_asamps >> 3)));
+    pa_stream_set_underflow_callback(pdriver->pstream, stream_underflow_callback, pdriver);
     /* pa_stream_set_overflow_callback(pdriver->pstream, stream_overflow_callback, pdriver); */
     /* pa_stream_set_moved_callback(pdriver->pstream, stream_moved_callback, pdriver); */
     /* pa_stream_set_buffer_attr_callback(pdriver->pstream, stream_buffer_attr_callback, pdriver); */
@@ -2301,7 +2331,7 @@ void pulse_aud_pb_ready(pulse_driver_t *pulsed, int fileno) {
     /* } */
 
     if (mainw->agen_key != 0 && !mainw->multitrack) pulsed->in_use = TRUE; // audio generator is active
-    if (AUD_SRC_EXTERNAL && (prefs->audio_opts & AUDIO_OPTS_EXT_FX)) register_audio_client(FALSE);
+    if (AUD_SRC_EXTERNAL && (prefs->audio_opts & AUDIO_OPTS_EXT_FX)) register_audio_client(NULL);
 
     if ((mainw->agen_key != 0 || mainw->agen_needs_reinit)
         && !mainw->multitrack && !mainw->preview) pulsed->in_use = TRUE; // audio generator is active
@@ -18,6 +18,8 @@
 #include <pulse/proplist.h>
 #include <pulse/error.h>
 
+#include "audio.h"
+
 #define PULSE_MAX_OUTPUT_CHANS PA_CHANNEL_POSITION_MAX
 
 // pb and rec
@@ -122,6 +124,8 @@ typedef struct {
   volatile float abs_maxvol_heard;
 
   volatile boolean is_corked;
+
+  lives_alatency_t alat; ///< callback jitter stats, used to adapt tlength / minreq
 } pulse_driver_t;
 
 // TODO - rationalise names
@@ -266,6 +266,59 @@ static weed_plant_t *copy_with_check(weed_plant_t *event, weed_plant_t *out_list
 }
 
 
+typedef struct {
+  weed_event_t *in_init_event;
+  weed_event_t *out_init_event;
+  int nparams;
+  weed_event_t **tails;
+} pchain_tails_t;
+
+static weed_event_t **get_pchain_tails(LiVESList **tlist, weed_event_t *in_init_event, weed_event_t *out_init_event,
+                                       int nparams) {
+  // quantise_events() appends each param change to the end of its NEXT_CHANGE chain in out_list; rather than
+  // following the chain from the start each time, we remember the last change for each param of each active filter
+  pchain_tails_t *pct = NULL;
+  LiVESList *list;
+  for (list = *tlist; list; list = list->next) {
+    pct = (pchain_tails_t *)list->data;
+    if (pct->in_init_event == in_init_event) break;
+  }
+  if (!list) {
+    pct = (pchain_tails_t *)lives_calloc(1, sizeof(pchain_tails_t));
+    pct->in_init_event = in_init_event;
+    *tlist = lives_list_prepend(*tlist, pct);
+  }
+  if (pct->out_init_event != out_init_event || pct->nparams != nparams) {
+    lives_freep((void **)&pct->tails);
+    pct->out_init_event = out_init_event;
+    pct->nparams = nparams;
+    if (nparams > 0) pct->tails = (weed_event_t **)lives_calloc(nparams, sizeof(weed_event_t *));
+  }
+  return pct->tails;
+}
+
+
+static void drop_pchain_tails(LiVESList **tlist, weed_event_t *in_init_event) {
+  for (LiVESList *list = *tlist; list; list = list->next) {
+    pchain_tails_t *pct = (pchain_tails_t *)list->data;
+    if (pct->in_init_event == in_init_event) {
+      lives_freep((void **)&pct->tails);
+      *tlist = lives_list_remove_node(*tlist, list, TRUE);
+      return;
+    }
+  }
+}
+
+
+static void free_pchain_tails(LiVESList **tlist) {
+  for (LiVESList *list = *tlist; list; list = list->next) {
+    pchain_tails_t *pct = (pchain_tails_t *)list->data;
+    lives_freep((void **)&pct->tails);
+  }
+  lives_list_free_all(tlist);
+}
+
+
 #define READJ_MIN_TIME 4.0
 #define READJ_MIN_RATIO 0.9
 #define READJ_MAX_RATIO 1.1
@@ -548,6 +601,7 @@ weed_plant_t *quantise_events(weed_plant_t *in_list, double qfps, boolean allow_
 
   LiVESResponseType response;
   LiVESList *init_events = NULL, *deinit_events = NULL, *list;
+  LiVESList *pchain_tails = NULL;
 
   void **eevents = NULL, **xeevents;
 
@@ -804,6 +858,7 @@ weed_plant_t *quantise_events(weed_plant_t *in_list, double qfps, boolean allow_
         case WEED_EVENT_TYPE_FILTER_DEINIT:
           /// if init_event is in list, discard it + this event
           init_event = weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL);
+          drop_pchain_tails(&pchain_tails, init_event);
           if (noquant) list = NULL;
           else {
             for (list = init_events; list; list = list->next) {
@@ -868,7 +923,7 @@ weed_plant_t *quantise_events(weed_plant_t *in_list, double qfps, boolean allow_
           }
           if (!list) {
             void **pchanges;
-            weed_event_t *pch_event, *init_event, *pchange, *npchange;
+            weed_event_t *pch_event, *init_event, *pchange, *npchange, **tails;
             int nchanges, pnum;
             if (!(xout_list = copy_with_check(event, out_list, noquant ? in_tc - offset_tc : out_tc,
                                               what, 0, &pch_event))) {
@@ -878,22 +933,25 @@ weed_plant_t *quantise_events(weed_plant_t *in_list, double qfps, boolean allow_
             }
             // now we need to set PREV_CHANGE and NEXT_CHANGE
             // starting at init_event, we check all init pchanges until we find the matching INDEX
-            // then follow the NEXT_CHANGE ptrs until we get to NULL
+            // then go to the last change we added for that param, and follow any NEXT_CHANGE ptrs until we get to NULL
             // then finally set NEXT_CHANGE to point to event, and PREV_CHANGE to point backwards
 
             out_list = xout_list;
 
             init_event = weed_get_voidptr_value(pch_event, WEED_LEAF_INIT_EVENT, NULL);
             pchanges = weed_get_voidptr_array_counted(init_event, WEED_LEAF_IN_PARAMETERS, &nchanges);
+            tails = get_pchain_tails(&pchain_tails, weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL),
+                                     init_event, nchanges);
             pnum = weed_get_int_value(pch_event, WEED_LEAF_INDEX, NULL);
             for (i = 0; i < nchanges; i++) {
               pchange = (weed_event_t *)pchanges[i];
               if (!pchange) {
-                pchanges[i] = pch_event;
+                pchanges[i] = tails[i] = pch_event;
                 weed_set_voidptr_array(init_event, WEED_LEAF_IN_PARAMETERS, nchanges, pchanges);
                 break;
               }
               if (weed_get_int_value(pchange, WEED_LEAF_INDEX, NULL) == pnum) {
+                if (tails[i]) pchange = tails[i];
                 npchange = weed_get_voidptr_value((weed_plant_t *)pchange, WEED_LEAF_NEXT_CHANGE, NULL);
                 while (npchange) {
                   pchange = npchange;
@@ -901,6 +959,7 @@ weed_plant_t *quantise_events(weed_plant_t *in_list, double qfps, boolean allow_
                 }
                 weed_set_voidptr_value(pchange, WEED_LEAF_NEXT_CHANGE, pch_event);
                 weed_set_voidptr_value(pch_event, WEED_LEAF_PREV_CHANGE, pchange);
+                tails[i] = pch_event;
                 break;
               }
             }
@@ -1056,6 +1115,7 @@ weed_plant_t *quantise_events(weed_plant_t *in_list, double qfps, boolean allow_
           //if (out_tc == 0) mainw->debug_ptr = newframe;
           if (response == LIVES_RESPONSE_CANCEL) {
             event_list_free(out_list);
+            free_pchain_tails(&pchain_tails);
             lives_free(what);
             return NULL;
           }
@@ -1310,6 +1370,7 @@ q_done:
 
   lives_list_free(init_events);
   lives_list_free(deinit_events);
+  free_pchain_tails(&pchain_tails);
   lives_free(what);
   reset_ttable();
   return out_list;
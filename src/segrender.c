@@ -0,0 +1,1022 @@
+// segrender.c
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// parallel rendering of multitrack layouts
+// see segrender.h for an overview
+
+#include "main.h"
+#include "segrender.h"
+
+#define RSEG_HASH_INIT 0xCBF29CE484222325ull
+#define RSEG_HASH_PRIME 0x100000001B3ull
+
+#define RSEG_MSEC_PER_FRAME(ticks, n) ((n) ? (double)(ticks) / (double)(n) / TICKS_PER_SECOND_DBL * 1000. : 0.)
+
+typedef struct {
+  int idx; ///< also used as the track number for the segment's clip sources
+  weed_event_t *start; ///< first event processed
+  weed_event_t *first; ///< event from which output is kept, NULL to keep from start
+  weed_event_t *end; ///< first event after the segment, or NULL
+  void **inits; ///< video filter init events active at start
+  int ninits;
+  weed_event_t *filter_map; ///< filter map active at start
+  frames_t out_start; ///< output frame number of the first kept frame
+  frames_t nout; ///< planned number of output frames
+  boolean preroll;
+  boolean dry_run; ///< compute checksums but do not save
+  uint64_t *hashes; ///< checksum of each output frame, for check mode
+  volatile frames_t done;
+  volatile lives_render_error_t error;
+  char *err_fname;
+  ticks_t ticks;
+  lives_proc_thread_t lpt;
+
+  // pipeline
+  struct _rseg_frame *ring[RENDER_SEG_DECODE_AHEAD]; ///< frames loaded ahead of the worker
+  int rhead, rcount;
+  pthread_mutex_t rmutex; ///< protects the ring, error, err_fname and the encode stats
+  pthread_cond_t rcond;
+  volatile boolean stop, loader_done;
+  lives_proc_thread_t loader;
+  LiVESList *srcclips; ///< clips for which the loader cloned sources
+  struct _rseg_save *saves[RENDER_SEG_ENCODERS]; ///< frames being encoded
+  int nextsave;
+
+  // time spent and frames processed in each stage
+  volatile ticks_t t_decode, t_fx, t_encode;
+  volatile frames_t ndecode, nfx, nencode;
+} lives_render_seg_t;
+
+typedef struct {
+  lives_render_seg_t *segs;
+  int nsegs;
+  lives_render_seg_t chk; ///< single pass over the whole range, for check mode
+  boolean check;
+  int clipno;
+  int width, height;
+  int gamma_type;
+  lives_img_type_t img_type;
+  int comp;
+  double fps;
+  boolean intimg, letterbox;
+  int ntracks;
+  volatile boolean abort;
+} render_segs_ctx_t;
+
+typedef struct {
+  weed_event_t *init_event;
+  weed_instance_t *inst;
+  void **pchain;
+} rseg_fx_t;
+
+typedef struct _rseg_frame {
+  weed_event_t *event;
+  weed_layer_t **layers; ///< one per track, loaded if needed as input or output
+  int ntracks;
+} rseg_frame_t;
+
+typedef struct _rseg_save {
+  render_segs_ctx_t *ctx;
+  lives_render_seg_t *seg;
+  weed_layer_t *layer;
+  frames_t frame;
+  lives_proc_thread_t lpt;
+} rseg_save_t;
+
+static render_segs_ctx_t *rsctx = NULL;
+
+// filter templates, plugin init / deinit and clip source lists are shared between all segments
+static pthread_mutex_t rseg_fx_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t rseg_src_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static weed_filter_t *rseg_get_filter(weed_event_t *init_event) {
+  char *fhash = weed_get_string_value(init_event, WEED_LEAF_FILTER, NULL);
+  int idx = weed_get_idx_for_hashname(fhash, TRUE);
+  lives_free(fhash);
+  if (idx == -1) return NULL;
+  return get_weed_filter(idx);
+}
+
+
+LIVES_LOCAL_INLINE boolean rseg_filter_ok(weed_filter_t *filter) {
+  // we can only give private instances to simple video filters
+  return num_compound_fx(filter) == 1 && has_video_chans_in(filter, FALSE) && has_video_chans_out(filter, FALSE);
+}
+
+
+LIVES_LOCAL_INLINE boolean rseg_filter_stateful(weed_filter_t *filter) {
+  return !!(weed_filter_get_flags(filter) & WEED_FILTER_HINT_STATEFUL);
+}
+
+
+static boolean rseg_frame_is_output(weed_event_t *event, frames_t out_frame, double fps) {
+  // must give the same result as the test in render_events()
+  weed_event_t *next = get_next_frame_event(event);
+  weed_timecode_t tc = get_event_timecode(event);
+  weed_timecode_t next_out_tc = q_gint64((weed_timecode_t)(out_frame / fps * TICKS_PER_SECOND_DBL), fps);
+  if (next) {
+    weed_timecode_t next_tc = get_event_timecode(next);
+    if (next_tc < next_out_tc || next_tc - next_out_tc < next_out_tc - tc) return FALSE;
+  } else if (next_out_tc > tc) return FALSE;
+  return TRUE;
+}
+
+
+static boolean rseg_frame_ok(weed_event_t *event, int *ntracks) {
+  // frames must come from clips which can be given a private source
+  int *clips = weed_get_int_array_counted(event, WEED_LEAF_CLIPS, ntracks);
+  int64_t *frames = weed_get_int64_array(event, WEED_LEAF_FRAMES, NULL);
+  boolean ok = TRUE;
+  for (int i = 0; i < *ntracks && ok; i++) {
+    if (clips[i] > 0 && frames[i] > 0) {
+      lives_clip_t *sfile = RETURN_VALID_CLIP(clips[i]);
+      if (!sfile || clips[i] == mainw->scrap_file
+          || (sfile->clip_type != CLIP_TYPE_DISK && sfile->clip_type != CLIP_TYPE_FILE)) ok = FALSE;
+    }
+  }
+  lives_freep((void **)&clips);
+  lives_freep((void **)&frames);
+  return ok;
+}
+
+
+static void rseg_get_state(weed_event_list_t *event_list, lives_render_seg_t *seg) {
+  // find the video filters and filter map active just before seg->start
+  LiVESList *inits = NULL, *list;
+  weed_event_t *event, *init_event;
+  weed_filter_t *filter;
+  int i = 0;
+
+  for (event = get_first_event(event_list); event && event != seg->start; event = get_next_event(event)) {
+    switch (get_event_type(event)) {
+    case WEED_EVENT_TYPE_FILTER_INIT:
+      filter = rseg_get_filter(event);
+      if (filter && !is_pure_audio(filter, FALSE)) inits = lives_list_append(inits, event);
+      break;
+    case WEED_EVENT_TYPE_FILTER_DEINIT:
+      init_event = (weed_event_t *)weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL);
+      inits = lives_list_remove(inits, init_event);
+      break;
+    case WEED_EVENT_TYPE_FILTER_MAP:
+      seg->filter_map = event;
+      break;
+    default: break;
+    }
+  }
+  seg->ninits = lives_list_length(inits);
+  if (seg->ninits) {
+    seg->inits = (void **)lives_calloc(seg->ninits, sizeof(void *));
+    for (list = inits; list; list = list->next) seg->inits[i++] = list->data;
+    lives_list_free(inits);
+  }
+}
+
+
+static int rseg_plan(render_segs_ctx_t *ctx, weed_event_list_t *event_list, weed_event_t *start,
+                     frames_t out_frame, int nsegs) {
+  // split the layout into at most nsegs segments, returns the number created, or 0 if the layout
+  // cannot be rendered by segments. A layout too short to split becomes a single segment, which still
+  // gets the pipeline
+  LiVESList *stateful = NULL;
+  lives_render_seg_t *seg;
+  weed_event_t *event, *init_event, *pe;
+  weed_filter_t *filter;
+  frames_t out = out_frame, tot = 0, target, seglen = 0;
+  int ntracks, n = 1;
+
+  // pass 1: check every filter and clip can be used privately, and count the output frames
+  for (event = start; event; event = get_next_event(event)) {
+    switch (get_event_type(event)) {
+    case WEED_EVENT_TYPE_FILTER_INIT:
+      filter = rseg_get_filter(event);
+      if (!filter) return 0;
+      if (!is_pure_audio(filter, FALSE) && !rseg_filter_ok(filter)) return 0;
+      break;
+    case WEED_EVENT_TYPE_FRAME:
+      if (!rseg_frame_ok(event, &ntracks)) return 0;
+      if (ntracks > ctx->ntracks) ctx->ntracks = ntracks;
+      if (rseg_frame_is_output(event, out_frame + tot, ctx->fps)) tot++;
+      break;
+    default: break;
+    }
+  }
+
+  if (!tot) return 0;
+  if (tot / RENDER_SEG_MIN_FRAMES < nsegs) nsegs = tot / RENDER_SEG_MIN_FRAMES;
+  if (nsegs < 1) nsegs = 1;
+  target = tot / nsegs;
+
+  ctx->segs = (lives_render_seg_t *)lives_calloc(nsegs, sizeof(lives_render_seg_t));
+  ctx->segs[0].start = start;
+  ctx->segs[0].out_start = out_frame;
+
+  // pass 2: find the cut points
+  for (event = start; event && n < nsegs; event = get_next_event(event)) {
+    switch (get_event_type(event)) {
+    case WEED_EVENT_TYPE_FILTER_INIT:
+      filter = rseg_get_filter(event);
+      if (!is_pure_audio(filter, FALSE) && rseg_filter_stateful(filter))
+        stateful = lives_list_prepend(stateful, event);
+      break;
+    case WEED_EVENT_TYPE_FILTER_DEINIT:
+      init_event = (weed_event_t *)weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL);
+      stateful = lives_list_remove(stateful, init_event);
+      break;
+    case WEED_EVENT_TYPE_FRAME:
+      if (rseg_frame_is_output(event, out, ctx->fps)) {
+        out++;
+        seglen++;
+      }
+      if (seglen < target || !get_next_event(event)) break;
+      // cut cleanly if we can, otherwise wait a little for a clean cut before resorting to preroll
+      if (stateful && seglen < target + target / RENDER_SEG_SLACK) break;
+      seg = &ctx->segs[n];
+      seg->first = seg->start = get_next_event(event);
+      seg->out_start = out;
+      if (stateful) {
+        seg->preroll = TRUE;
+        for (int i = 1; i < RENDER_SEG_PREROLL && get_prev_frame_event(event); i++)
+          event = get_prev_frame_event(event);
+        pe = get_prev_frame_event(event);
+        seg->start = pe ? get_next_event(pe) : start;
+        event = get_prev_event(seg->first);
+      }
+      seglen = 0;
+      n++;
+      break;
+    default: break;
+    }
+  }
+  lives_list_free(stateful);
+
+  for (int i = 0; i < n; i++) {
+    seg = &ctx->segs[i];
+    seg->idx = i;
+    if (i < n - 1) {
+      seg->end = ctx->segs[i + 1].first;
+      seg->nout = ctx->segs[i + 1].out_start - seg->out_start;
+    } else seg->nout = out_frame + tot - seg->out_start;
+    if (!seg->preroll) seg->first = NULL;
+    rseg_get_state(event_list, seg);
+  }
+  return n;
+}
+
+
+static uint64_t rseg_layer_hash(weed_layer_t *layer) {
+  int nplanes, *rowstrides = weed_layer_get_rowstrides(layer, &nplanes);
+  uint8_t *pdata = weed_layer_get_pixel_data(layer);
+  int height = weed_layer_get_height(layer);
+  size_t rowbytes = weed_layer_get_width(layer) * pixel_size(weed_layer_get_palette(layer));
+  uint64_t hash = RSEG_HASH_INIT;
+
+  if (pdata && rowstrides) {
+    for (int i = 0; i < height; i++) {
+      uint8_t *row = pdata + (size_t)i * rowstrides[0];
+      for (size_t j = 0; j < rowbytes; j++) hash = (hash ^ row[j]) * RSEG_HASH_PRIME;
+    }
+  }
+  lives_freep((void **)&rowstrides);
+  return hash;
+}
+
+
+/////////////// filters ///////////////
+
+static rseg_fx_t *rseg_fx_new(weed_event_t *init_event) {
+  // create and init a private instance for init_event, in the same way as render_events() does for the shared one
+  weed_filter_t *filter = rseg_get_filter(init_event);
+  weed_plant_t **citmpl = NULL, **cotmpl = NULL, **bitmpl = NULL, **botmpl = NULL;
+  weed_plant_t **in_params;
+  weed_instance_t *inst;
+  rseg_fx_t *fx;
+  int *in_count = NULL;
+  int num_in_count = 0, num_in_channels = 0, num_out_channels = 0, nparams = 0, num_params, i;
+
+  if (!filter || is_pure_audio(filter, FALSE)) return NULL;
+
+  in_count = weed_get_int_array_counted(init_event, WEED_LEAF_IN_COUNT, &num_in_count);
+
+  pthread_mutex_lock(&rseg_fx_mutex);
+  citmpl = weed_get_plantptr_array_counted(filter, WEED_LEAF_IN_CHANNEL_TEMPLATES, &num_in_channels);
+  if (num_in_channels != num_in_count) num_in_channels = 0;
+  if (num_in_channels > 0) {
+    bitmpl = (weed_plant_t **)lives_malloc(num_in_channels * sizeof(weed_plant_t *));
+    for (i = 0; i < num_in_channels; i++) {
+      bitmpl[i] = weed_plant_copy(citmpl[i]);
+      if (in_count[i] > 0) {
+        weed_set_boolean_value(citmpl[i], WEED_LEAF_HOST_DISABLED, WEED_FALSE);
+        weed_set_int_value(citmpl[i], WEED_LEAF_HOST_REPEATS, in_count[i]);
+      } else weed_set_boolean_value(citmpl[i], WEED_LEAF_HOST_DISABLED, WEED_TRUE);
+    }
+  }
+  cotmpl = weed_get_plantptr_array_counted(filter, WEED_LEAF_OUT_CHANNEL_TEMPLATES, &num_out_channels);
+  if (num_out_channels > 0) {
+    botmpl = (weed_plant_t **)lives_malloc(num_out_channels * sizeof(weed_plant_t *));
+    for (i = 0; i < num_out_channels; i++) {
+      botmpl[i] = weed_plant_copy(cotmpl[i]);
+      if (!weed_plant_has_leaf(cotmpl[i], WEED_LEAF_HOST_DISABLED))
+        weed_set_boolean_value(cotmpl[i], WEED_LEAF_HOST_DISABLED, WEED_FALSE);
+    }
+  }
+
+  inst = weed_instance_from_filter(filter);
+
+  for (i = 0; i < num_in_channels; i++) {
+    lives_leaf_copy_or_delete(citmpl[i], WEED_LEAF_HOST_DISABLED, bitmpl[i]);
+    lives_leaf_copy_or_delete(citmpl[i], WEED_LEAF_HOST_REPEATS, bitmpl[i]);
+    weed_plant_free(bitmpl[i]);
+  }
+  for (i = 0; i < num_out_channels; i++) {
+    lives_leaf_copy_or_delete(cotmpl[i], WEED_LEAF_HOST_DISABLED, botmpl[i]);
+    lives_leaf_copy_or_delete(cotmpl[i], WEED_LEAF_HOST_REPEATS, botmpl[i]);
+    weed_plant_free(botmpl[i]);
+  }
+  pthread_mutex_unlock(&rseg_fx_mutex);
+
+  lives_freep((void **)&bitmpl);
+  lives_freep((void **)&botmpl);
+  lives_freep((void **)&citmpl);
+  lives_freep((void **)&cotmpl);
+  lives_freep((void **)&in_count);
+
+  if (weed_plant_has_leaf(filter, WEED_LEAF_HOST_FPS))
+    lives_leaf_copy(inst, WEED_LEAF_TARGET_FPS, filter, WEED_LEAF_HOST_FPS);
+  else if (weed_plant_has_leaf(filter, WEED_LEAF_PREFERRED_FPS))
+    lives_leaf_copy(inst, WEED_LEAF_TARGET_FPS, filter, WEED_LEAF_PREFERRED_FPS);
+
+  fx = (rseg_fx_t *)lives_calloc(1, sizeof(rseg_fx_t));
+  fx->init_event = init_event;
+  fx->inst = inst;
+
+  if (weed_plant_has_leaf(init_event, WEED_LEAF_IN_PARAMETERS)) {
+    void **xpchain = weed_get_voidptr_array_counted(init_event, WEED_LEAF_IN_PARAMETERS, &nparams);
+    fx->pchain = (void **)lives_calloc(nparams + 1, sizeof(void *));
+    for (i = 0; i < nparams; i++) fx->pchain[i] = xpchain[i];
+    lives_free(xpchain);
+  }
+
+  num_params = num_in_params(inst, FALSE, FALSE);
+  if (num_params > 0 && fx->pchain) {
+    in_params = weed_get_plantptr_array(inst, WEED_LEAF_IN_PARAMETERS, NULL);
+    for (i = 0; i < num_params && i < nparams; i++) {
+      if (fx->pchain[i] && is_init_pchange(init_event, (weed_plant_t *)fx->pchain[i]))
+        lives_leaf_copy(in_params[i], WEED_LEAF_VALUE, (weed_plant_t *)fx->pchain[i], WEED_LEAF_VALUE);
+    }
+    lives_free(in_params);
+  }
+
+  THREADVAR(random_seed) = weed_get_int64_value(init_event, WEED_LEAF_RANDOM_SEED, NULL);
+  pthread_mutex_lock(&rseg_fx_mutex);
+  weed_call_init_func(inst);
+  pthread_mutex_unlock(&rseg_fx_mutex);
+  THREADVAR(random_seed) = 0;
+
+  return fx;
+}
+
+
+static void rseg_fx_free(rseg_fx_t *fx) {
+  pthread_mutex_lock(&rseg_fx_mutex);
+  weed_call_deinit_func(fx->inst);
+  pthread_mutex_unlock(&rseg_fx_mutex);
+  weed_instance_unref(fx->inst);
+  lives_freep((void **)&fx->pchain);
+  lives_free(fx);
+}
+
+
+static LiVESList *rseg_fx_find(LiVESList *fxlist, weed_event_t *init_event) {
+  for (; fxlist; fxlist = fxlist->next) if (((rseg_fx_t *)fxlist->data)->init_event == init_event) return fxlist;
+  return NULL;
+}
+
+
+static void rseg_apply_filter_map(LiVESList *fxlist, weed_event_t *filter_map, weed_layer_t **layers,
+                                  int *clips, int ntracks, int width, int height, weed_timecode_t tc) {
+  // apply the private instances in map order, cf. weed_apply_filter_map()
+  void **init_events;
+  int ninits;
+
+  if (!filter_map) return;
+  init_events = weed_get_voidptr_array_counted(filter_map, WEED_LEAF_INIT_EVENTS, &ninits);
+
+  for (int i = 0; i < ninits; i++) {
+    LiVESList *list = rseg_fx_find(fxlist, (weed_event_t *)init_events[i]);
+    lives_filter_error_t filter_error;
+    rseg_fx_t *fx;
+    boolean is_valid = FALSE;
+    int nintracks, *in_tracks;
+
+    if (!list) continue;
+    fx = (rseg_fx_t *)list->data;
+
+    // avoid applying to non-active tracks
+    in_tracks = weed_get_int_array_counted(fx->init_event, WEED_LEAF_IN_TRACKS, &nintracks);
+    for (int j = 0; j < nintracks; j++) {
+      if (in_tracks[j] >= 0 && in_tracks[j] < ntracks && clips[in_tracks[j]] > 0) {
+        is_valid = TRUE;
+        break;
+      }
+    }
+    lives_freep((void **)&in_tracks);
+    if (!is_valid) continue;
+
+    if (!mainw->unordered_blocks && fx->pchain) interpolate_params(fx->inst, fx->pchain, tc);
+
+    filter_error = weed_apply_instance(fx->inst, fx->init_event, layers, width, height, tc);
+    if (filter_error == FILTER_ERROR_NEEDS_REINIT) {
+      pthread_mutex_lock(&rseg_fx_mutex);
+      weed_call_deinit_func(fx->inst);
+      weed_call_init_func(fx->inst);
+      pthread_mutex_unlock(&rseg_fx_mutex);
+    }
+  }
+  lives_freep((void **)&init_events);
+}
+
+
+/////////////// rendering ///////////////
+
+static lives_clipsrc_group_t *rseg_get_srcgrp(lives_render_seg_t *seg, int clip, LiVESList **srcclips) {
+  // each segment loads frames through its own clone of the clip's sources
+  lives_clipsrc_group_t *srcgrp;
+  pthread_mutex_lock(&rseg_src_mutex);
+  srcgrp = get_srcgrp(clip, seg->idx, SRC_PURPOSE_RENDER);
+  if (!srcgrp) {
+    srcgrp = clone_srcgrp(clip, clip, seg->idx, SRC_PURPOSE_RENDER);
+    if (srcgrp) {
+      srcgrp->status = SRC_STATUS_READY;
+      *srcclips = lives_list_prepend(*srcclips, LIVES_INT_TO_POINTER(clip));
+    }
+  }
+  pthread_mutex_unlock(&rseg_src_mutex);
+  return srcgrp;
+}
+
+
+LIVES_LOCAL_INLINE weed_timecode_t rseg_event_tc(weed_event_t *event) {
+  if (weed_plant_has_leaf(event, LIVES_LEAF_FAKE_TC))
+    return weed_get_int64_value(event, LIVES_LEAF_FAKE_TC, NULL);
+  return get_event_timecode(event);
+}
+
+
+static rseg_frame_t *rseg_load_frame(render_segs_ctx_t *ctx, lives_render_seg_t *seg, weed_event_t *filter_map,
+                                     weed_event_t *event) {
+  // stage 1: create the layers for a frame event and load the ones which will be needed, i.e. the input tracks
+  // for filters in the map, plus the frontmost track as output. Other tracks can never be seen, so they are left blank.
+  // Since every layer used later is either loaded or blank, the worker never needs to touch the clip sources
+  rseg_frame_t *frame = (rseg_frame_t *)lives_calloc(1, sizeof(rseg_frame_t));
+  weed_timecode_t tc = rseg_event_tc(event);
+  boolean *needed;
+  int64_t *frames;
+  int *clips;
+  int ntracks, front = -1, i;
+
+  clips = weed_get_int_array_counted(event, WEED_LEAF_CLIPS, &ntracks);
+  frames = weed_get_int64_array(event, WEED_LEAF_FRAMES, NULL);
+  needed = (boolean *)lives_calloc(ntracks + 1, sizeof(boolean));
+
+  if (filter_map) {
+    int ninits;
+    void **init_events = weed_get_voidptr_array_counted(filter_map, WEED_LEAF_INIT_EVENTS, &ninits);
+    for (i = 0; i < ninits; i++) {
+      int nintracks, *in_tracks;
+      if (!init_events[i]) continue;
+      in_tracks = weed_get_int_array_counted((weed_event_t *)init_events[i], WEED_LEAF_IN_TRACKS, &nintracks);
+      for (int j = 0; j < nintracks; j++)
+        if (in_tracks[j] >= 0 && in_tracks[j] < ntracks) needed[in_tracks[j]] = TRUE;
+      lives_freep((void **)&in_tracks);
+    }
+    lives_freep((void **)&init_events);
+  }
+
+  frame->event = event;
+  frame->ntracks = ntracks;
+  frame->layers = (weed_layer_t **)lives_calloc(ntracks + 1, sizeof(weed_layer_t *));
+
+  for (i = 0; i < ntracks; i++) {
+    weed_layer_t *layer;
+    if (clips[i] > 0 && frames[i] > 0 && (needed[i] || front == -1)) {
+      const char *img_ext = get_image_ext_for_type(mainw->files[clips[i]]->img_type);
+      boolean ok;
+      layer = lives_layer_new_for_frame(clips[i], frames[i]);
+      lives_layer_set_srcgrp(layer, rseg_get_srcgrp(seg, clips[i], &seg->srcclips));
+      // filter inputs are loaded at full size, the output can be loaded at the final size
+      if (needed[i]) ok = pull_frame(layer, img_ext, tc);
+      else ok = pull_frame_at_size(layer, img_ext, tc, ctx->width, ctx->height, WEED_PALETTE_END);
+      if (ok) wait_layer_ready(layer, TRUE);
+      if (!ok || !weed_layer_get_pixel_data(layer)) {
+        weed_layer_pixel_data_free(layer);
+        create_blank_layer(layer, img_ext, ctx->width, ctx->height, WEED_PALETTE_END);
+      }
+      if (front == -1) front = i;
+    } else layer = lives_layer_new_for_frame(-1, 0);
+    lives_layer_set_track(layer, i);
+    frame->layers[i] = layer;
+  }
+
+  lives_free(needed);
+  lives_free(clips);
+  lives_free(frames);
+  return frame;
+}
+
+
+static void rseg_frame_free(rseg_frame_t *frame) {
+  if (frame->layers) {
+    for (int i = 0; i < frame->ntracks; i++) if (frame->layers[i]) weed_layer_unref(frame->layers[i]);
+    lives_free(frame->layers);
+  }
+  lives_free(frame);
+}
+
+
+static boolean rseg_ring_push(lives_render_seg_t *seg, rseg_frame_t *frame) {
+  // blocks while the ring is full; returns FALSE if the worker has stopped
+  boolean ret = FALSE;
+  pthread_mutex_lock(&seg->rmutex);
+  while (seg->rcount == RENDER_SEG_DECODE_AHEAD && !seg->stop) pthread_cond_wait(&seg->rcond, &seg->rmutex);
+  if (!seg->stop) {
+    seg->ring[(seg->rhead + seg->rcount) % RENDER_SEG_DECODE_AHEAD] = frame;
+    seg->rcount++;
+    ret = TRUE;
+    pthread_cond_broadcast(&seg->rcond);
+  }
+  pthread_mutex_unlock(&seg->rmutex);
+  return ret;
+}
+
+
+static rseg_frame_t *rseg_ring_pop(lives_render_seg_t *seg) {
+  // blocks until the loader has a frame ready; returns NULL if the loader has finished
+  rseg_frame_t *frame = NULL;
+  pthread_mutex_lock(&seg->rmutex);
+  while (!seg->rcount && !seg->loader_done && !seg->stop) pthread_cond_wait(&seg->rcond, &seg->rmutex);
+  if (seg->rcount) {
+    frame = seg->ring[seg->rhead];
+    seg->ring[seg->rhead] = NULL;
+    seg->rhead = (seg->rhead + 1) % RENDER_SEG_DECODE_AHEAD;
+    seg->rcount--;
+    pthread_cond_broadcast(&seg->rcond);
+  }
+  pthread_mutex_unlock(&seg->rmutex);
+  return frame;
+}
+
+
+static boolean rseg_loader(lives_render_seg_t *seg) {
+  // walks the same events as the worker, loading frames up to RENDER_SEG_DECODE_AHEAD ahead of it
+  render_segs_ctx_t *ctx = rsctx;
+  weed_event_t *event, *filter_map = seg->filter_map;
+  rseg_frame_t *frame;
+  ticks_t t0;
+
+  for (event = seg->start; event && event != seg->end; event = get_next_event(event)) {
+    int etype = get_event_type(event);
+    if (etype == WEED_EVENT_TYPE_FILTER_MAP) filter_map = event;
+    if (etype != WEED_EVENT_TYPE_FRAME) continue;
+    if (seg->stop) break;
+    t0 = lives_get_current_ticks();
+    frame = rseg_load_frame(ctx, seg, filter_map, event);
+    seg->t_decode += lives_get_current_ticks() - t0;
+    seg->ndecode++;
+    if (!rseg_ring_push(seg, frame)) {
+      rseg_frame_free(frame);
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&seg->rmutex);
+  seg->loader_done = TRUE;
+  pthread_cond_broadcast(&seg->rcond);
+  pthread_mutex_unlock(&seg->rmutex);
+  return TRUE;
+}
+
+
+static weed_layer_t *rseg_render_frame(render_segs_ctx_t *ctx, rseg_frame_t *frame, LiVESList *fxlist,
+                                       weed_event_t *filter_map) {
+  // stage 2: apply the filters to the loaded layers and produce the output layer, resized, converted
+  // and gamma corrected as in render_events(); the layers are consumed
+  weed_layer_t **layers = frame->layers, *layer = NULL;
+  weed_event_t *event = frame->event;
+  weed_timecode_t tc = rseg_event_tc(event);
+  int *clips;
+  int ntracks, output = -1, width, height, i;
+  boolean was_lbox = FALSE;
+
+  clips = weed_get_int_array_counted(event, WEED_LEAF_CLIPS, &ntracks);
+  if (ntracks > frame->ntracks) ntracks = frame->ntracks;
+
+  rseg_apply_filter_map(fxlist, filter_map, layers, clips, ntracks, ctx->width, ctx->height, tc);
+
+  // the frontmost non blank layer is the output, cf. weed_apply_effects()
+  for (i = 0; i < frame->ntracks; i++) {
+    if (!weed_layer_get_pixel_data(layers[i])) wait_layer_ready(layers[i], FALSE);
+    if (output == -1 && lives_layer_get_clip(layers[i]) > 0 && weed_layer_get_pixel_data(layers[i])) {
+      output = i;
+      continue;
+    }
+    weed_layer_unref(layers[i]);
+  }
+
+  if (output == -1) layer = create_blank_layer(NULL, NULL, ctx->width, ctx->height, WEED_PALETTE_END);
+  else layer = layers[output];
+
+  lives_freep((void **)&frame->layers);
+  lives_free(clips);
+
+  wait_layer_ready(layer, TRUE);
+  width = weed_layer_get_width_pixels(layer);
+  height = weed_layer_get_height(layer);
+
+  if (ctx->letterbox) {
+    calc_maxspect(ctx->width, ctx->height, &width, &height);
+    if (weed_layer_get_palette(layer) != WEED_PALETTE_RGB24 && (ctx->width > width || ctx->height > height))
+      convert_layer_palette(layer, WEED_PALETTE_RGB24, 0);
+    letterbox_layer(layer, ctx->width, ctx->height, width, height, LIVES_INTERP_BEST, WEED_PALETTE_RGB24, 0);
+    was_lbox = TRUE;
+  } else resize_layer(layer, ctx->width, ctx->height, LIVES_INTERP_BEST, WEED_PALETTE_RGB24, 0);
+
+  convert_layer_palette(layer, WEED_PALETTE_RGB24, 0);
+
+  if (!was_lbox) gamma_convert_layer(ctx->gamma_type, layer);
+  else gamma_convert_sub_layer(ctx->gamma_type, 1.0, layer, (ctx->width - width) / 2, (ctx->height - height) / 2,
+                                 width, height, TRUE);
+
+  if (weed_plant_has_leaf(event, WEED_LEAF_OVERLAY_TEXT)) {
+    char *texto = weed_get_string_value(event, WEED_LEAF_OVERLAY_TEXT, NULL);
+    render_text_overlay(layer, texto, DEF_OVERLAY_SCALING);
+    lives_free(texto);
+  }
+  return layer;
+}
+
+
+static char *rseg_save_frame(render_segs_ctx_t *ctx, weed_layer_t *layer, frames_t frame) {
+  // returns NULL on success, otherwise the name of the file which could not be written
+  char *fname = make_image_file_name(mainw->files[ctx->clipno], frame, get_image_ext_for_type(ctx->img_type));
+  boolean ret;
+
+  THREADVAR(write_failed) = 0;
+  if (ctx->intimg) ret = layer_to_png(layer, fname, ctx->comp);
+  else {
+    LiVESError *error = NULL;
+    LiVESPixbuf *pixbuf = layer_to_pixbuf(layer, TRUE, FALSE);
+    ret = pixbuf_to_png(pixbuf, fname, ctx->img_type, ctx->comp, ctx->width, ctx->height, &error);
+    if (pixbuf) lives_widget_object_unref(pixbuf);
+    if (error) {
+      lives_error_free(error);
+      ret = FALSE;
+    }
+  }
+  if (THREADVAR(write_failed)) ret = FALSE;
+
+  if (ret) lives_freep((void **)&fname);
+  return fname;
+}
+
+
+static boolean rseg_encoder(rseg_save_t *job) {
+  lives_render_seg_t *seg = job->seg;
+  ticks_t t0 = lives_get_current_ticks();
+  char *fname = rseg_save_frame(job->ctx, job->layer, job->frame);
+
+  weed_layer_unref(job->layer);
+  job->layer = NULL;
+
+  pthread_mutex_lock(&seg->rmutex);
+  if (fname) {
+    if (!seg->error) {
+      seg->error = LIVES_RENDER_ERROR_WRITE_FRAME;
+      seg->err_fname = fname;
+    } else lives_free(fname);
+  }
+  seg->t_encode += lives_get_current_ticks() - t0;
+  seg->nencode++;
+  pthread_mutex_unlock(&seg->rmutex);
+  return TRUE;
+}
+
+
+static void rseg_encode_join(lives_render_seg_t *seg, int i) {
+  rseg_save_t *job = seg->saves[i];
+  if (!job) return;
+  lives_proc_thread_join(job->lpt);
+  lives_free(job);
+  seg->saves[i] = NULL;
+}
+
+
+static void rseg_encode(render_segs_ctx_t *ctx, lives_render_seg_t *seg, weed_layer_t *layer, frames_t frame) {
+  // stage 3: pass the layer to an encoder thread, which will free it; if all encoders are busy,
+  // wait for the oldest to finish
+  rseg_save_t *job;
+  rseg_encode_join(seg, seg->nextsave);
+  job = (rseg_save_t *)lives_calloc(1, sizeof(rseg_save_t));
+  job->ctx = ctx;
+  job->seg = seg;
+  job->layer = layer;
+  job->frame = frame;
+  job->lpt = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, rseg_encoder, WEED_SEED_BOOLEAN, "v", job);
+  seg->saves[seg->nextsave] = job;
+  seg->nextsave = (seg->nextsave + 1) % RENDER_SEG_ENCODERS;
+}
+
+
+static boolean rseg_worker(lives_render_seg_t *seg) {
+  render_segs_ctx_t *ctx = rsctx;
+  LiVESList *fxlist = NULL, *list;
+  weed_event_t *event, *init_event, *filter_map = seg->filter_map;
+  weed_layer_t *layer;
+  rseg_frame_t *frame;
+  rseg_fx_t *fx;
+  ticks_t t0 = lives_get_current_ticks(), t1;
+  frames_t out_frame = seg->out_start;
+  boolean keep = !seg->first;
+
+  pthread_mutex_init(&seg->rmutex, NULL);
+  pthread_cond_init(&seg->rcond, NULL);
+  seg->loader = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, rseg_loader, WEED_SEED_BOOLEAN, "v", seg);
+
+  for (int i = 0; i < seg->ninits; i++) {
+    if ((fx = rseg_fx_new((weed_event_t *)seg->inits[i]))) fxlist = lives_list_append(fxlist, fx);
+  }
+
+  for (event = seg->start; event && event != seg->end; event = get_next_event(event)) {
+    if (ctx->abort || mainw->cancelled != CANCEL_NONE) break;
+    if (event == seg->first) keep = TRUE;
+
+    switch (get_event_type(event)) {
+    case WEED_EVENT_TYPE_FILTER_INIT:
+      if ((fx = rseg_fx_new(event))) fxlist = lives_list_append(fxlist, fx);
+      break;
+    case WEED_EVENT_TYPE_FILTER_DEINIT:
+      init_event = (weed_event_t *)weed_get_voidptr_value(event, WEED_LEAF_INIT_EVENT, NULL);
+      if ((list = rseg_fx_find(fxlist, init_event))) {
+        rseg_fx_free((rseg_fx_t *)list->data);
+        fxlist = lives_list_delete_link(fxlist, list);
+      }
+      break;
+    case WEED_EVENT_TYPE_FILTER_MAP:
+      filter_map = event;
+      break;
+    case WEED_EVENT_TYPE_FRAME:
+      // the loader sees the same frame events in the same order, so this should never fail
+      frame = rseg_ring_pop(seg);
+      if (!frame || frame->event != event) {
+        if (frame) rseg_frame_free(frame);
+        seg->stop = TRUE;
+        break;
+      }
+      // frames which are not output, and preroll frames, must still be processed for the sake of stateful filters
+      t1 = lives_get_current_ticks();
+      layer = rseg_render_frame(ctx, frame, fxlist, filter_map);
+      rseg_frame_free(frame);
+      seg->t_fx += lives_get_current_ticks() - t1;
+      seg->nfx++;
+      if (keep && rseg_frame_is_output(event, out_frame, ctx->fps)) {
+        if (seg->hashes && out_frame - seg->out_start < seg->nout)
+          seg->hashes[out_frame - seg->out_start] = rseg_layer_hash(layer);
+        if (!seg->dry_run) rseg_encode(ctx, seg, layer, out_frame);
+        else weed_layer_unref(layer);
+        out_frame++;
+        seg->done++;
+      } else weed_layer_unref(layer);
+      break;
+    default: break;
+    }
+    if (seg->error || seg->stop) break;
+  }
+
+  // let the encoders finish, then stop the loader
+  for (int i = 0; i < RENDER_SEG_ENCODERS; i++) rseg_encode_join(seg, (seg->nextsave + i) % RENDER_SEG_ENCODERS);
+
+  pthread_mutex_lock(&seg->rmutex);
+  seg->stop = TRUE;
+  pthread_cond_broadcast(&seg->rcond);
+  pthread_mutex_unlock(&seg->rmutex);
+  lives_proc_thread_join(seg->loader);
+  seg->loader = NULL;
+
+  while ((frame = rseg_ring_pop(seg))) rseg_frame_free(frame);
+  pthread_cond_destroy(&seg->rcond);
+  pthread_mutex_destroy(&seg->rmutex);
+
+  for (list = fxlist; list; list = list->next) rseg_fx_free((rseg_fx_t *)list->data);
+  lives_list_free(fxlist);
+
+  pthread_mutex_lock(&rseg_src_mutex);
+  for (list = seg->srcclips; list; list = list->next)
+    srcgrp_remove(LIVES_POINTER_TO_INT(list->data), seg->idx, SRC_PURPOSE_RENDER);
+  pthread_mutex_unlock(&rseg_src_mutex);
+  lives_list_free(seg->srcclips);
+  seg->srcclips = NULL;
+
+  seg->ticks = lives_get_current_ticks() - t0;
+  return TRUE;
+}
+
+
+/////////////// control ///////////////
+
+static void rseg_free(lives_render_seg_t *seg) {
+  lives_freep((void **)&seg->inits);
+  lives_freep((void **)&seg->hashes);
+  lives_freep((void **)&seg->err_fname);
+}
+
+
+static void render_segs_free(render_segs_ctx_t *ctx) {
+  for (int i = 0; i < ctx->nsegs; i++) rseg_free(&ctx->segs[i]);
+  rseg_free(&ctx->chk);
+  lives_free(ctx->segs);
+  lives_free(ctx);
+}
+
+
+static void render_segs_join(render_segs_ctx_t *ctx) {
+  for (int i = 0; i < ctx->nsegs; i++) {
+    if (ctx->segs[i].lpt) lives_proc_thread_join(ctx->segs[i].lpt);
+    ctx->segs[i].lpt = NULL;
+  }
+  if (ctx->chk.lpt) lives_proc_thread_join(ctx->chk.lpt);
+  ctx->chk.lpt = NULL;
+}
+
+
+boolean render_segs_start(weed_event_list_t *event_list, weed_event_t *start, frames_t out_frame) {
+  // begin rendering the video from start in parallel segments; if this returns TRUE, the caller should
+  // render only audio, and poll render_segs_running() until it returns FALSE
+  render_segs_ctx_t *ctx;
+  int nsegs = prefs->render_segs;
+
+  if (rsctx || nsegs < 0 || !start || !mainw->multitrack || THREAD_INTENTION != OBJ_INTENTION_RENDER
+      || !CURRENT_CLIP_IS_VALID || cfile->old_frames > 0) return FALSE;
+  // each segment keeps around two cores busy, one loading and one applying effects, with encoding in between
+  if (!nsegs) nsegs = (capable->hw.ncpus + 1) / 2;
+
+  ctx = (render_segs_ctx_t *)lives_calloc(1, sizeof(render_segs_ctx_t));
+  ctx->clipno = mainw->current_file;
+  ctx->width = cfile->hsize;
+  ctx->height = cfile->vsize;
+  ctx->fps = cfile->fps;
+  ctx->gamma_type = cfile->gamma_type;
+  ctx->img_type = cfile->img_type;
+  ctx->intimg = cfile->img_type == IMG_TYPE_PNG;
+  ctx->comp = 100 - prefs->ocp;
+  ctx->letterbox = prefs->letterbox_mt;
+
+  ctx->nsegs = rseg_plan(ctx, event_list, start, out_frame, nsegs);
+  if (!ctx->nsegs) {
+    render_segs_free(ctx);
+    return FALSE;
+  }
+
+  ctx->check = prefs->render_seg_check;
+  if (ctx->check) {
+    lives_render_seg_t *chk = &ctx->chk;
+    for (int i = 0; i < ctx->nsegs; i++)
+      ctx->segs[i].hashes = (uint64_t *)lives_calloc(ctx->segs[i].nout + 1, sizeof(uint64_t));
+    chk->idx = ctx->nsegs;
+    chk->start = start;
+    chk->out_start = out_frame;
+    chk->nout = ctx->segs[ctx->nsegs - 1].out_start + ctx->segs[ctx->nsegs - 1].nout - out_frame;
+    chk->dry_run = TRUE;
+    chk->hashes = (uint64_t *)lives_calloc(chk->nout + 1, sizeof(uint64_t));
+    rseg_get_state(event_list, chk);
+  }
+
+  // weed_apply_instance() checks track numbers against this
+  mainw->num_tracks = ctx->ntracks;
+
+  rsctx = ctx;
+  for (int i = 0; i < ctx->nsegs; i++)
+    ctx->segs[i].lpt = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, rseg_worker, WEED_SEED_BOOLEAN,
+                       "v", &ctx->segs[i]);
+  return TRUE;
+}
+
+
+boolean render_segs_running(frames_t *ndone) {
+  // returns TRUE while any segment, or the check pass, is still rendering
+  // ndone is set to the number of frames output so far
+  render_segs_ctx_t *ctx = rsctx;
+  boolean running = FALSE;
+  frames_t done = 0;
+
+  if (ctx) {
+    for (int i = 0; i < ctx->nsegs; i++) {
+      done += ctx->segs[i].done;
+      if (!ctx->segs[i].error && !lives_proc_thread_check_finished(ctx->segs[i].lpt)) running = TRUE;
+    }
+    if (!running && ctx->check && !ctx->abort && mainw->cancelled == CANCEL_NONE) {
+      if (!ctx->chk.lpt) {
+        boolean failed = FALSE;
+        for (int i = 0; i < ctx->nsegs; i++) if (ctx->segs[i].error) failed = TRUE;
+        if (!failed) {
+          ctx->chk.lpt = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, rseg_worker, WEED_SEED_BOOLEAN,
+                                                  "v", &ctx->chk);
+          running = TRUE;
+        }
+      } else if (!lives_proc_thread_check_finished(ctx->chk.lpt)) running = TRUE;
+    }
+  }
+  if (ndone) *ndone = done;
+  return running;
+}
+
+
+static void render_segs_check_report(render_segs_ctx_t *ctx) {
+  lives_render_seg_t *chk = &ctx->chk;
+  frames_t ndiff = 0, ntot = 0;
+
+  for (int i = 0; i < ctx->nsegs; i++) {
+    lives_render_seg_t *seg = &ctx->segs[i];
+    frames_t sdiff = 0, first = -1;
+    for (frames_t j = 0; j < seg->done && j < seg->nout; j++) {
+      frames_t k = seg->out_start + j - chk->out_start;
+      if (k >= chk->done || seg->hashes[j] != chk->hashes[k]) {
+        if (first == -1) first = seg->out_start + j;
+        sdiff++;
+      }
+    }
+    if (sdiff) d_print(_("Render check: segment %d (%s) has %d frames which differ, the first being frame %d\n"),
+                         i + 1, seg->preroll ? _("preroll cut") : _("clean cut"), sdiff, first);
+    ndiff += sdiff;
+    ntot += seg->done;
+  }
+  if (ntot != chk->done) d_print(_("Render check: %d frames were rendered in segments, but %d in a single pass\n"),
+                                   ntot, chk->done);
+  d_print(_("Render check: %d of %d frames differ from a single pass render\n"), ndiff, ntot);
+}
+
+
+lives_render_error_t render_segs_finish(frames_t *out_frame) {
+  // join the segment renderers and free resources; out_frame is set to the frame after the last one output
+  render_segs_ctx_t *ctx = rsctx;
+  lives_render_error_t error = LIVES_RENDER_ERROR_NONE;
+  frames_t done = 0;
+
+  if (!ctx) return LIVES_RENDER_ERROR_NONE;
+  render_segs_join(ctx);
+
+  for (int i = 0; i < ctx->nsegs; i++) {
+    lives_render_seg_t *seg = &ctx->segs[i];
+    if (seg->error && !error) {
+      error = seg->error;
+      if (seg->err_fname) do_write_failed_error_s(seg->err_fname, NULL);
+    }
+    done += seg->done;
+    if (prefs->dev_show_timing)
+      d_print("render segment %d: frames %d to %d%s, %.2f sec, decode %.2f / fx %.2f / encode %.2f ms per frame\n",
+              i + 1, seg->out_start, seg->out_start + seg->done - 1, seg->preroll ? " (preroll)" : "",
+              (double)seg->ticks / TICKS_PER_SECOND_DBL, RSEG_MSEC_PER_FRAME(seg->t_decode, seg->ndecode),
+              RSEG_MSEC_PER_FRAME(seg->t_fx, seg->nfx), RSEG_MSEC_PER_FRAME(seg->t_encode, seg->nencode));
+  }
+  if (!error && ctx->check && ctx->chk.ticks) render_segs_check_report(ctx);
+
+  if (out_frame) *out_frame = ctx->segs[0].out_start + done;
+  rsctx = NULL;
+  render_segs_free(ctx);
+  return error;
+}
+
+
+boolean render_segs_get_timings(double *decode, double *fx, double *encode) {
+  // average time per frame in milliseconds spent in each stage of the pipelines, over all segments
+  render_segs_ctx_t *ctx = rsctx;
+  ticks_t td = 0, tf = 0, te = 0;
+  frames_t nd = 0, nf = 0, ne = 0;
+
+  if (!ctx) return FALSE;
+  for (int i = 0; i <= ctx->nsegs; i++) {
+    lives_render_seg_t *seg = i < ctx->nsegs ? &ctx->segs[i] : &ctx->chk;
+    td += seg->t_decode;
+    nd += seg->ndecode;
+    tf += seg->t_fx;
+    nf += seg->nfx;
+    te += seg->t_encode;
+    ne += seg->nencode;
+  }
+  if (decode) *decode = RSEG_MSEC_PER_FRAME(td, nd);
+  if (fx) *fx = RSEG_MSEC_PER_FRAME(tf, nf);
+  if (encode) *encode = RSEG_MSEC_PER_FRAME(te, ne);
+  return TRUE;
+}
+
+
+void render_segs_abort(void) {
+  render_segs_ctx_t *ctx = rsctx;
+  if (!ctx) return;
+  ctx->abort = TRUE;
+  render_segs_join(ctx);
+  rsctx = NULL;
+  render_segs_free(ctx);
+}
@@ -0,0 +1,39 @@
+// segrender.h
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// parallel rendering of multitrack layouts
+
+#ifndef HAS_LIVES_SEGRENDER_H
+#define HAS_LIVES_SEGRENDER_H
+
+// the video part of a layout is split into segments which are rendered concurrently, each with its own
+// filter instances and clip sources. Output frames are written directly to their final position in the clip,
+// whilst render_events() renders the audio in order, as usual.
+//
+// segments are preferably cut where no stateful filter is active. If there is no such point near the
+// ideal cut, the segment begins RENDER_SEG_PREROLL frames early, and output from the extra frames is discarded,
+// giving stateful filters time to settle.
+//
+// each segment is rendered as a three stage pipeline: a loader thread decodes up to RENDER_SEG_DECODE_AHEAD frames
+// ahead, the segment thread applies the filters and converts the output, and up to RENDER_SEG_ENCODERS threads
+// encode and write the images. A layout which is too short to split is rendered as a single pipelined segment.
+//
+// in check mode, once the segments are complete the whole layout is rendered again in a single pass without
+// saving, and a checksum of each frame is compared with the output of the segments
+
+#define RENDER_SEG_MIN_FRAMES 100 ///< do not create segments shorter than this
+#define RENDER_SEG_PREROLL 25 ///< frames processed ahead of a cut through a stateful filter
+#define RENDER_SEG_SLACK 4 ///< look for a clean cut up to 1 / SLACK of the segment length past the ideal point
+#define RENDER_SEG_DECODE_AHEAD 8 ///< frames loaded ahead of the filters, per segment
+#define RENDER_SEG_ENCODERS 2 ///< frames being encoded at once, per segment
+
+boolean render_segs_start(weed_event_list_t *, weed_event_t *start, frames_t out_frame);
+boolean render_segs_running(frames_t *ndone);
+lives_render_error_t render_segs_finish(frames_t *out_frame);
+boolean render_segs_get_timings(double *decode, double *fx, double *encode);
+void render_segs_abort(void);
+
+#endif
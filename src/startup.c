@@ -753,10 +753,20 @@ static void pre_init2(void) {
 #endif
   what_sup = pre_init2_sup;
 
+  // 1 used to disable segment rendering; that is now -1, and 1 renders a single pipelined segment
+  if (has_pref(PREF_RENDER_SEGS_OLD)) {
+    int nsegs = get_int_prefd(PREF_RENDER_SEGS_OLD, 0);
+    set_int_pref(PREF_RENDER_SEGS, nsegs == 1 ? -1 : nsegs);
+    delete_pref(PREF_RENDER_SEGS_OLD);
+  }
+
   //////////////////////////
   load_prefs();
   //////////////////////////
 
+  // must be done before the threadpool is started
+  sched_policy_init();
+
   capable->uid = get_int64_prefd(PREF_UID, 0);
 
   if (!capable->uid) {
@@ -3143,6 +3153,16 @@ static boolean lives_init(_ign_opts * ign_opts) {
 
   prefs->pbq_adaptive = get_boolean_prefd(PREF_PBQ_ADAPTIVE, TRUE);
 
+  prefs->proxy_div_ce = get_int_prefd(PREF_PROXY_DIV_CE, PROXY_DIV_FULL);
+  if (prefs->proxy_div_ce != PROXY_DIV_HALF && prefs->proxy_div_ce != PROXY_DIV_QUARTER)
+    prefs->proxy_div_ce = PROXY_DIV_FULL;
+  prefs->proxy_div_sepwin = get_int_prefd(PREF_PROXY_DIV_SEPWIN, PROXY_DIV_FULL);
+  if (prefs->proxy_div_sepwin != PROXY_DIV_HALF && prefs->proxy_div_sepwin != PROXY_DIV_QUARTER)
+    prefs->proxy_div_sepwin = PROXY_DIV_FULL;
+  prefs->proxy_div_mt = get_int_prefd(PREF_PROXY_DIV_MT, PROXY_DIV_FULL);
+  if (prefs->proxy_div_mt != PROXY_DIV_HALF && prefs->proxy_div_mt != PROXY_DIV_QUARTER)
+    prefs->proxy_div_mt = PROXY_DIV_FULL;
+
   prefs->loop_recording = TRUE;
   prefs->ocp = get_int_prefd(PREF_OPEN_COMPRESSION_PERCENT, 15);
 
@@ -3529,6 +3529,9 @@ static void *_lives_thread_data_create(void *pslot_id) {
     tdata->vars.var_thrd_type = tdata->thrd_type;
     tdata->vars.var_slot_id = tdata->slot_id = slot_id;
 
+    // place pool threads according to the scheduling policy; this is a no op for other threads
+    if (tdata->thrd_type == THRD_TYPE_WORKER) sched_policy_apply(SCHED_CLASS_WORKER);
+
     pthread_rwlock_wrlock(&all_tdata_rwlock);
     all_tdatas = lives_list_prepend(all_tdatas, (livespointer)tdata);
     pthread_rwlock_unlock(&all_tdata_rwlock);
@@ -3825,7 +3828,10 @@ static boolean do_something_useful(lives_thread_data_t *tdata) {
 
   // RUN TASK
   mywork->flags |= LIVES_THRDFLAG_RUNNING;
+  if (tdata->vars.var_sched_class == SCHED_CLASS_NONE) sched_policy_apply(SCHED_CLASS_WORKER);
   (*mywork->func)(mywork->arg);
+  // the task may have changed the class, e.g. to run the player
+  if (tdata->vars.var_sched_class != SCHED_CLASS_WORKER) sched_policy_apply(SCHED_CLASS_WORKER);
   mywork->flags = (mywork->flags & ~LIVES_THRDFLAG_RUNNING) | LIVES_THRDFLAG_CONCLUDED;
 
   /* lives_widget_context_invoke_full(tdata->vars.var_guictx, mywork->attrs & LIVES_THRDATTR_PRIORITY */
@@ -4427,6 +4433,28 @@ static lives_result_t print_function(void *data) {
 }
 
 
+char *get_thread_placement(void) {
+  // involuntary context switches are the ones which matter here: a thread with a realtime class
+  // should see few of them, compared to its voluntary switches (waits and sleeps)
+  char *msg = lives_strdup("Thread placement (slot / tid / class / cpu / voluntary / involuntary switches):\n"), *tmp;
+  int64_t nvol, ninvol;
+  int cpu;
+  pthread_rwlock_rdlock(&all_tdata_rwlock);
+  for (LiVESList *list = all_tdatas; list; list = list->next) {
+    lives_thread_data_t *tdata  = (lives_thread_data_t *)list->data;
+    if (!tdata) continue;
+    if (!get_thread_sched_stats(tdata->vars.var_tid, &cpu, &nvol, &ninvol)) continue;
+    tmp = lives_strdup_printf("%s%d\t%d\t%s\t%d\t%"PRId64"\t%"PRId64"\n", msg, tdata->slot_id,
+                              tdata->vars.var_tid, sched_class_name(tdata->vars.var_sched_class),
+                              cpu, nvol, ninvol);
+    lives_free(msg);
+    msg = tmp;
+  }
+  pthread_rwlock_unlock(&all_tdata_rwlock);
+  return msg;
+}
+
+
 char *get_threadstats(void) {
   int totthreads = 0, actthreads = 0;
   char *msg = NULL;
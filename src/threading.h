@@ -150,6 +150,7 @@ typedef struct {
   const void *var_stackaddr;
   size_t var_stacksize;
   int var_core_id;
+  int var_sched_class; // SCHED_CLASS_*, set by sched_policy_apply()
   volatile float *var_core_load_ptr; // pointer to value that monitors core load
 
   int var_sig_act;
@@ -1061,6 +1062,7 @@ char *get_lpt_id(lives_proc_thread_t);
 void dump_fn_stack(LiVESList *fnstack);
 
 char *get_threadstats(void);
+char *get_thread_placement(void); ///< scheduling class, cpu and context switches for each known thread
 void thread_stackdump(void);
 
 // utility funcs (called from widget-helper.c)
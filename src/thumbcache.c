@@ -0,0 +1,524 @@
+// thumbcache.c
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// asynchronous thumbnail service
+// see thumbcache.h for an overview
+
+#include <dirent.h>
+
+#include "main.h"
+#include "cvirtual.h"
+#include "thumbcache.h"
+
+#define THUMB_CACHE_QUALITY 90 ///< favour speed over size when writing cached thumbnails
+
+typedef struct {
+  char *path;
+  time_t mtime;
+  off_t size;
+} thumb_cfile_t;
+
+typedef struct {
+  int clipno;
+  uint64_t uid; ///< unique_id of the clip when the request was made, in case the clip is closed and its number reused
+  frames_t frame;
+  int width, height;
+  boolean noblanks; ///< if the frame is blank, try later frames, as for mt_make_thumb()
+  int priority; ///< lower values are served first
+  uint64_t gen; ///< view in which the request was last made
+  frames_t nframes;
+  double fps;
+  char *img_ext;
+  char *cache_dir;
+  char *cache_key; ///< for virtual frames; for image frames the key is made from the image file
+  char *img_file;
+  lives_thumb_ready_f ready_func;
+  livespointer data;
+  LiVESPixbuf *pixbuf;
+} thumb_req_t;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond; ///< signalled when requests are added or finished
+  LiVESList *queue; ///< pending requests, in the order they will be served
+  int qlen;
+  LiVESList *done; ///< finished requests awaiting delivery in the GUI thread
+  boolean deliver_queued;
+  thumb_req_t *busy[THUMB_SERVICE_THREADS]; ///< request being served by each worker
+  int busy_clip[THUMB_SERVICE_THREADS]; ///< clip whose sources each worker is releasing, or -1
+  int src_clip[THUMB_SERVICE_THREADS]; ///< clip for which each worker holds sources, or -1
+  lives_proc_thread_t workers[THUMB_SERVICE_THREADS];
+  boolean started;
+  uint64_t view_id, gen;
+  volatile boolean stop;
+} thumb_service_t;
+
+static thumb_service_t tsvc = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+// clone_srcgrp() is not safe to call concurrently for the same clip
+static pthread_mutex_t thumb_src_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void thumb_req_free(thumb_req_t *req) {
+  if (req->pixbuf) lives_widget_object_unref(req->pixbuf);
+  lives_freep((void **)&req->img_ext);
+  lives_freep((void **)&req->cache_dir);
+  lives_freep((void **)&req->cache_key);
+  lives_freep((void **)&req->img_file);
+  lives_free(req);
+}
+
+
+LIVES_LOCAL_INLINE boolean thumb_req_matches(thumb_req_t *req, int clipno, frames_t frame, int width, int height,
+    boolean noblanks) {
+  return req->clipno == clipno && req->frame == frame && req->width == width && req->height == height
+         && req->noblanks == noblanks;
+}
+
+
+static void thumb_queue_insert(thumb_req_t *req) {
+  // must be called with tsvc.mutex locked
+  LiVESList *list;
+  int pos = 0;
+  for (list = tsvc.queue; list; list = list->next, pos++) {
+    thumb_req_t *xreq = (thumb_req_t *)list->data;
+    if (xreq->gen < req->gen || (xreq->gen == req->gen && xreq->priority > req->priority)) break;
+  }
+  tsvc.queue = lives_list_insert(tsvc.queue, req, pos);
+  tsvc.qlen++;
+
+  // drop whatever would be served last
+  while (tsvc.qlen > THUMB_QUEUE_MAX) {
+    list = lives_list_last(tsvc.queue);
+    thumb_req_free((thumb_req_t *)list->data);
+    tsvc.queue = lives_list_delete_link(tsvc.queue, list);
+    tsvc.qlen--;
+  }
+}
+
+
+/////////////// worker ///////////////
+
+static lives_clipsrc_group_t *thumb_get_src(int clipno, int track) {
+  lives_clipsrc_group_t *srcgrp;
+  pthread_mutex_lock(&thumb_src_mutex);
+  srcgrp = get_srcgrp(clipno, track, SRC_PURPOSE_THUMBNAIL);
+  if (!srcgrp) {
+    srcgrp = clone_srcgrp(clipno, clipno, track, SRC_PURPOSE_THUMBNAIL);
+    if (srcgrp) srcgrp->status = SRC_STATUS_READY;
+  }
+  pthread_mutex_unlock(&thumb_src_mutex);
+  return srcgrp;
+}
+
+
+static void thumb_release_src(int clipno, int track) {
+  pthread_mutex_lock(&thumb_src_mutex);
+  srcgrp_remove(clipno, track, SRC_PURPOSE_THUMBNAIL);
+  pthread_mutex_unlock(&thumb_src_mutex);
+}
+
+
+static char *thumb_cache_file(thumb_req_t *req) {
+  char *key, *fname, *path;
+  if (req->cache_key) key = lives_strdup(req->cache_key);
+  else {
+    struct stat st;
+    if (!req->img_file || stat(req->img_file, &st)) return NULL;
+    // renumbering frames renames the files, keeping their mtime, and frames written together often share
+    // the same second, so the inode and size are needed as well as the full mtime
+    key = lives_strdup_printf("i%d_%" PRId64 ".%09ld_%" PRIu64 "_%" PRId64, req->frame, (int64_t)st.st_mtim.tv_sec,
+                              (long)st.st_mtim.tv_nsec, (uint64_t)st.st_ino, (int64_t)st.st_size);
+  }
+  fname = lives_strdup_printf("%s%s.%s", key, req->noblanks ? "n" : "", LIVES_FILE_EXT_PNG);
+  path = lives_build_filename(req->cache_dir, fname, NULL);
+  lives_free(fname);
+  lives_free(key);
+  return path;
+}
+
+
+static LiVESPixbuf *thumb_load_cached(thumb_req_t *req, const char *path) {
+  LiVESPixbuf *pixbuf;
+  LiVESError *error = NULL;
+
+  if (!lives_file_test(path, LIVES_FILE_TEST_EXISTS)) return NULL;
+  pixbuf = lives_pixbuf_new_from_file(path, &error);
+  if (error) {
+    lives_error_free(error);
+    if (pixbuf) lives_widget_object_unref(pixbuf);
+    pixbuf = NULL;
+  }
+  if (pixbuf && (lives_pixbuf_get_width(pixbuf) != req->width || lives_pixbuf_get_height(pixbuf) != req->height)) {
+    lives_widget_object_unref(pixbuf);
+    pixbuf = NULL;
+  }
+  // an unreadable file will be replaced
+  if (!pixbuf) lives_rm(path);
+  // the mtime of a cached file is the time it was last used, see thumb_cache_prune()
+  else utimes(path, NULL);
+  return pixbuf;
+}
+
+
+static int thumb_cfile_cmp(const void *a, const void *b) {
+  time_t ta = ((const thumb_cfile_t *)a)->mtime, tb = ((const thumb_cfile_t *)b)->mtime;
+  return ta < tb ? -1 : ta > tb;
+}
+
+
+static void thumb_cache_prune(const char *cache_dir) {
+  // removes thumbnails unused for THUMB_CACHE_MAX_AGE, then the least recently used ones until the total
+  // size is within THUMB_CACHE_MAX_SIZE. Stale thumbnails are never read again, so they end up here
+  thumb_cfile_t *cfiles = NULL;
+  struct dirent *dent;
+  struct stat st;
+  DIR *dir;
+  time_t now = time(NULL);
+  off_t totsize = 0;
+  char *path;
+  int ncfiles = 0, nalloc = 0, i;
+
+  if (!(dir = opendir(cache_dir))) return;
+  while ((dent = readdir(dir))) {
+    // skip files still being written
+    if (!lives_str_ends_with(dent->d_name, ".%s", LIVES_FILE_EXT_PNG)) continue;
+    path = lives_build_filename(cache_dir, dent->d_name, NULL);
+    if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+      lives_free(path);
+      continue;
+    }
+    if (now - st.st_mtime > THUMB_CACHE_MAX_AGE) {
+      lives_rm(path);
+      lives_free(path);
+      continue;
+    }
+    if (ncfiles == nalloc) {
+      nalloc = nalloc ? nalloc * 2 : 64;
+      cfiles = (thumb_cfile_t *)lives_realloc(cfiles, nalloc * sizeof(thumb_cfile_t));
+    }
+    cfiles[ncfiles].path = path;
+    cfiles[ncfiles].mtime = st.st_mtime;
+    cfiles[ncfiles++].size = st.st_size;
+    totsize += st.st_size;
+  }
+  closedir(dir);
+
+  if (totsize > THUMB_CACHE_MAX_SIZE) {
+    qsort(cfiles, ncfiles, sizeof(thumb_cfile_t), thumb_cfile_cmp);
+    for (i = 0; i < ncfiles && totsize > THUMB_CACHE_MAX_SIZE; i++) {
+      lives_rm(cfiles[i].path);
+      totsize -= cfiles[i].size;
+    }
+  }
+  for (i = 0; i < ncfiles; i++) lives_free(cfiles[i].path);
+  lives_freep((void **)&cfiles);
+}
+
+
+static void thumb_save_cached(thumb_req_t *req, const char *path, LiVESPixbuf *pixbuf) {
+  // write to a temporary file, then rename it, so a reader never sees a partial thumbnail
+  LiVESError *error = NULL;
+  char *tmpfile = lives_strdup_printf("%s.%s", path, LIVES_FILE_EXT_TMP);
+  lives_mkdir_with_parents(req->cache_dir, capable->umask);
+  if (pixbuf_to_png(pixbuf, tmpfile, IMG_TYPE_PNG, THUMB_CACHE_QUALITY, req->width, req->height, &error)
+      && !error) {
+    if (rename(tmpfile, path)) lives_rm(tmpfile);
+  } else lives_rm(tmpfile);
+  if (error) lives_error_free(error);
+  lives_free(tmpfile);
+}
+
+
+static LiVESPixbuf *thumb_make(thumb_req_t *req, int track) {
+  // cf. mt_make_thumb(), but loading through the worker's own clip sources
+  LiVESPixbuf *thumbnail = NULL, *pixbuf;
+  lives_clipsrc_group_t *srcgrp;
+  frames_t frame = req->frame;
+  boolean noblanks = req->noblanks, tried_all = FALSE;
+  int palette = strcmp(req->img_ext, LIVES_FILE_EXT_PNG) ? WEED_PALETTE_RGB24 : WEED_PALETTE_ANY;
+
+  do {
+    weed_timecode_t tc = (frame - 1.) / req->fps * TICKS_PER_SECOND;
+    weed_layer_t *layer = lives_layer_new_for_frame(req->clipno, frame);
+    if ((srcgrp = thumb_get_src(req->clipno, track))) lives_layer_set_srcgrp(layer, srcgrp);
+    if (pull_frame_at_size(layer, req->img_ext, tc, req->width, req->height, palette))
+      thumbnail = layer_to_pixbuf(layer, TRUE, TRUE);
+    weed_layer_unref(layer);
+
+    if (thumbnail && (lives_pixbuf_get_width(thumbnail) != req->width
+                      || lives_pixbuf_get_height(thumbnail) != req->height)) {
+      pixbuf = lives_pixbuf_scale_simple(thumbnail, req->width, req->height, LIVES_INTERP_FAST);
+      lives_widget_object_unref(thumbnail);
+      thumbnail = pixbuf;
+    }
+
+    if (tried_all) noblanks = FALSE;
+    if (noblanks && thumbnail && !lives_pixbuf_is_all_black(thumbnail, FALSE)) noblanks = FALSE;
+    if (noblanks) {
+      frames_t nframe = frame + req->nframes / 10.;
+      if (nframe == frame) nframe++;
+      if (nframe > req->nframes) {
+        nframe = req->frame;
+        tried_all = TRUE;
+      }
+      frame = nframe;
+      if (thumbnail) lives_widget_object_unref(thumbnail);
+      thumbnail = NULL;
+    }
+  } while (noblanks && !tsvc.stop);
+
+  return thumbnail;
+}
+
+
+static boolean thumb_deliver(livespointer data) {
+  // runs in the GUI thread
+  LiVESList *done, *list;
+
+  pthread_mutex_lock(&tsvc.mutex);
+  done = tsvc.done;
+  tsvc.done = NULL;
+  tsvc.deliver_queued = FALSE;
+  pthread_mutex_unlock(&tsvc.mutex);
+
+  for (list = done; list; list = list->next) {
+    thumb_req_t *req = (thumb_req_t *)list->data;
+    lives_clip_t *sfile = RETURN_VALID_CLIP(req->clipno);
+    if (sfile && sfile->unique_id == req->uid && req->ready_func) {
+      (*req->ready_func)(req->clipno, req->frame, req->width, req->height, req->pixbuf, req->data);
+      req->pixbuf = NULL;
+    }
+    thumb_req_free(req);
+  }
+  lives_list_free(done);
+  return FALSE;
+}
+
+
+static boolean thumb_worker(livespointer data) {
+  int n = LIVES_POINTER_TO_INT(data), track = THUMB_SRC_TRACK - n;
+  thumb_req_t *req;
+  char *path;
+  int clipno, nsaved = 0;
+
+  pthread_mutex_lock(&tsvc.mutex);
+  while (1) {
+    while (!tsvc.queue && !tsvc.stop) {
+      // release the clip sources while idle
+      if (tsvc.src_clip[n] != -1) {
+        clipno = tsvc.busy_clip[n] = tsvc.src_clip[n];
+        tsvc.src_clip[n] = -1;
+        pthread_mutex_unlock(&tsvc.mutex);
+        thumb_release_src(clipno, track);
+        pthread_mutex_lock(&tsvc.mutex);
+        tsvc.busy_clip[n] = -1;
+        pthread_cond_broadcast(&tsvc.cond);
+        continue;
+      }
+      pthread_cond_wait(&tsvc.cond, &tsvc.mutex);
+    }
+    if (tsvc.stop) break;
+
+    req = (thumb_req_t *)tsvc.queue->data;
+    tsvc.queue = lives_list_delete_link(tsvc.queue, tsvc.queue);
+    tsvc.qlen--;
+    tsvc.busy[n] = req;
+    clipno = -1;
+    if (tsvc.src_clip[n] != req->clipno) {
+      // keep sources for one clip at most
+      clipno = tsvc.busy_clip[n] = tsvc.src_clip[n];
+      tsvc.src_clip[n] = req->clipno;
+    }
+    pthread_mutex_unlock(&tsvc.mutex);
+
+    if (clipno != -1) thumb_release_src(clipno, track);
+
+    if (req->cache_dir && (path = thumb_cache_file(req))) {
+      if (!(req->pixbuf = thumb_load_cached(req, path))) {
+        if ((req->pixbuf = thumb_make(req, track))) {
+          thumb_save_cached(req, path, req->pixbuf);
+          if (!(nsaved++ % THUMB_CACHE_PRUNE_INTERVAL)) thumb_cache_prune(req->cache_dir);
+        }
+      }
+      lives_free(path);
+    } else req->pixbuf = thumb_make(req, track);
+
+    pthread_mutex_lock(&tsvc.mutex);
+    tsvc.busy[n] = NULL;
+    tsvc.busy_clip[n] = -1;
+    if (req->pixbuf) {
+      tsvc.done = lives_list_append(tsvc.done, req);
+      if (!tsvc.deliver_queued) {
+        tsvc.deliver_queued = TRUE;
+        lives_idle_add(thumb_deliver, NULL);
+      }
+    } else thumb_req_free(req);
+    pthread_cond_broadcast(&tsvc.cond);
+  }
+  pthread_mutex_unlock(&tsvc.mutex);
+
+  if (tsvc.src_clip[n] != -1) thumb_release_src(tsvc.src_clip[n], track);
+  tsvc.src_clip[n] = -1;
+  return TRUE;
+}
+
+
+/////////////// requests ///////////////
+
+void thumb_request_view(uint64_t view_id) {
+  // requests made after this are served before those made in any previous view
+  pthread_mutex_lock(&tsvc.mutex);
+  if (view_id != tsvc.view_id) {
+    tsvc.view_id = view_id;
+    tsvc.gen++;
+  }
+  pthread_mutex_unlock(&tsvc.mutex);
+}
+
+
+boolean thumb_request(int clipno, frames_t frame, int width, int height, boolean noblanks, int priority,
+                      lives_thumb_ready_f ready_func, livespointer data) {
+  // request a thumbnail of frame from clipno, to be passed to ready_func when it is made
+  // returns FALSE if the clip cannot be handled by the service, in which case the caller should make the thumbnail itself
+  lives_clip_t *sfile = RETURN_VALID_CLIP(clipno);
+  thumb_req_t *req;
+  LiVESList *list;
+  char *clipdir, *sizestr;
+  int i;
+
+  if (!sfile || clipno == mainw->scrap_file || clipno == mainw->ascrap_file || tsvc.stop
+      || (sfile->clip_type != CLIP_TYPE_DISK && sfile->clip_type != CLIP_TYPE_FILE)
+      || frame < 1 || frame > sfile->frames || width < 4 || height < 4) return FALSE;
+
+  pthread_mutex_lock(&tsvc.mutex);
+  for (i = 0; i < THUMB_SERVICE_THREADS; i++) {
+    if (tsvc.busy[i] && thumb_req_matches(tsvc.busy[i], clipno, frame, width, height, noblanks)) {
+      pthread_mutex_unlock(&tsvc.mutex);
+      return TRUE;
+    }
+  }
+  for (list = tsvc.done; list; list = list->next) {
+    if (thumb_req_matches((thumb_req_t *)list->data, clipno, frame, width, height, noblanks)) {
+      pthread_mutex_unlock(&tsvc.mutex);
+      return TRUE;
+    }
+  }
+  for (list = tsvc.queue; list; list = list->next) {
+    req = (thumb_req_t *)list->data;
+    if (thumb_req_matches(req, clipno, frame, width, height, noblanks)) {
+      // requested again, move it to its place in the current view
+      tsvc.queue = lives_list_delete_link(tsvc.queue, list);
+      tsvc.qlen--;
+      req->gen = tsvc.gen;
+      req->priority = priority;
+      req->ready_func = ready_func;
+      req->data = data;
+      thumb_queue_insert(req);
+      pthread_mutex_unlock(&tsvc.mutex);
+      return TRUE;
+    }
+  }
+  pthread_mutex_unlock(&tsvc.mutex);
+
+  req = (thumb_req_t *)lives_calloc(1, sizeof(thumb_req_t));
+  req->clipno = clipno;
+  req->uid = sfile->unique_id;
+  req->frame = frame;
+  req->width = width;
+  req->height = height;
+  req->noblanks = noblanks;
+  req->priority = priority;
+  req->nframes = sfile->frames;
+  req->fps = sfile->fps;
+  req->img_ext = lives_strdup(get_image_ext_for_type(sfile->img_type));
+  req->ready_func = ready_func;
+  req->data = data;
+
+  if (sfile->clip_type == CLIP_TYPE_FILE && is_virtual_frame(clipno, frame))
+    req->cache_key = lives_strdup_printf("v%d", sfile->frame_index[frame - 1]);
+  else req->img_file = make_image_file_name(sfile, frame, req->img_ext);
+
+  clipdir = get_clip_dir(clipno);
+  sizestr = lives_strdup_printf("%dx%d", width, height);
+  req->cache_dir = lives_build_filename(clipdir, THUMB_CACHE_DIR, sizestr, NULL);
+  lives_free(sizestr);
+  lives_free(clipdir);
+
+  pthread_mutex_lock(&tsvc.mutex);
+  if (!tsvc.started) {
+    tsvc.started = TRUE;
+    for (i = 0; i < THUMB_SERVICE_THREADS; i++) {
+      tsvc.busy_clip[i] = tsvc.src_clip[i] = -1;
+      tsvc.workers[i] = lives_proc_thread_create(LIVES_THRDATTR_NO_GUI, thumb_worker, WEED_SEED_BOOLEAN, "v",
+                        LIVES_INT_TO_POINTER(i));
+    }
+  }
+  req->gen = tsvc.gen;
+  thumb_queue_insert(req);
+  pthread_cond_broadcast(&tsvc.cond);
+  pthread_mutex_unlock(&tsvc.mutex);
+  return TRUE;
+}
+
+
+void thumb_service_drop_clip(int clipno) {
+  // must be called before the clip's sources are freed: forgets any requests for the clip,
+  // and waits for workers which are using it
+  LiVESList *list, *next;
+  int i;
+
+  pthread_mutex_lock(&tsvc.mutex);
+  if (!tsvc.started) {
+    pthread_mutex_unlock(&tsvc.mutex);
+    return;
+  }
+  for (list = tsvc.queue; list; list = next) {
+    thumb_req_t *req = (thumb_req_t *)list->data;
+    next = list->next;
+    if (req->clipno != clipno) continue;
+    thumb_req_free(req);
+    tsvc.queue = lives_list_delete_link(tsvc.queue, list);
+    tsvc.qlen--;
+  }
+  while (1) {
+    for (i = 0; i < THUMB_SERVICE_THREADS; i++)
+      if (tsvc.busy_clip[i] == clipno || (tsvc.busy[i] && tsvc.busy[i]->clipno == clipno)) break;
+    if (i == THUMB_SERVICE_THREADS) break;
+    pthread_cond_wait(&tsvc.cond, &tsvc.mutex);
+  }
+  // the sources are about to be freed along with the clip's others
+  for (i = 0; i < THUMB_SERVICE_THREADS; i++) if (tsvc.src_clip[i] == clipno) tsvc.src_clip[i] = -1;
+  pthread_mutex_unlock(&tsvc.mutex);
+}
+
+
+void thumb_service_shutdown(void) {
+  LiVESList *list;
+
+  pthread_mutex_lock(&tsvc.mutex);
+  if (!tsvc.started) {
+    pthread_mutex_unlock(&tsvc.mutex);
+    return;
+  }
+  tsvc.stop = TRUE;
+  pthread_cond_broadcast(&tsvc.cond);
+  pthread_mutex_unlock(&tsvc.mutex);
+
+  for (int i = 0; i < THUMB_SERVICE_THREADS; i++) {
+    if (tsvc.workers[i]) lives_proc_thread_join(tsvc.workers[i]);
+    tsvc.workers[i] = NULL;
+  }
+
+  for (list = tsvc.queue; list; list = list->next) thumb_req_free((thumb_req_t *)list->data);
+  lives_list_free(tsvc.queue);
+  tsvc.queue = NULL;
+  tsvc.qlen = 0;
+  for (list = tsvc.done; list; list = list->next) thumb_req_free((thumb_req_t *)list->data);
+  lives_list_free(tsvc.done);
+  tsvc.done = NULL;
+  tsvc.started = FALSE;
+}
@@ -0,0 +1,45 @@
+// thumbcache.h
+// LiVES
+// (c) G. Finch 2005 - 2023 <salsaman+lives@gmail.com>
+// released under the GNU GPL 3 or later
+// see file ../COPYING or www.gnu.org for licensing details
+
+// asynchronous thumbnail service, shared by the multitrack timeline and the clip thumbnails window
+
+#ifndef HAS_LIVES_THUMBCACHE_H
+#define HAS_LIVES_THUMBCACHE_H
+
+// requests are queued and served by worker threads, each loading frames through its own clip sources.
+// The queue is ordered by view, then by priority: when the caller starts a new view (e.g. the timeline is scrolled
+// or zoomed), requests from older views are served only after all those from the current view.
+// If the queue grows beyond THUMB_QUEUE_MAX, the requests which would be served last are dropped.
+//
+// finished thumbnails are written to a cache in the clip directory, THUMB_CACHE_DIR/<width>x<height>/,
+// and handed to the caller's ready function in the GUI thread. Cached files are named after the frame contents
+// rather than the frame number, so edits to the clip do not make them stale: virtual frames use the frame
+// number in the source video, image frames the frame number with the modification time, inode and size of the image.
+//
+// each worker prunes the directory it writes to on its first write, then every THUMB_CACHE_PRUNE_INTERVAL writes:
+// thumbnails not used for THUMB_CACHE_MAX_AGE seconds are removed, then the least recently used ones until
+// the directory holds at most THUMB_CACHE_MAX_SIZE bytes
+
+#define THUMB_CACHE_DIR "thumbs"
+#define THUMB_SERVICE_THREADS 2
+#define THUMB_QUEUE_MAX 512
+#define THUMB_SRC_TRACK -2 ///< worker n loads frames through clip sources for track THUMB_SRC_TRACK - n
+#define THUMB_CACHE_MAX_SIZE (64 << 20) ///< bytes per clip and thumbnail size
+#define THUMB_CACHE_MAX_AGE (30 * 24 * 60 * 60) ///< seconds
+#define THUMB_CACHE_PRUNE_INTERVAL 256
+
+/// called in the GUI thread with a new reference to the thumbnail, only if it was made successfully
+typedef void (*lives_thumb_ready_f)(int clipno, frames_t frame, int width, int height, LiVESPixbuf *,
+                                    livespointer data);
+
+boolean thumb_request(int clipno, frames_t frame, int width, int height, boolean noblanks, int priority,
+                      lives_thumb_ready_f ready_func, livespointer data);
+void thumb_request_view(uint64_t view_id);
+
+void thumb_service_drop_clip(int clipno);
+void thumb_service_shutdown(void);
+
+#endif
@@ -197,6 +197,7 @@ void reset_playback_clock(ticks_t origticks) {
   drift = 0;
   owed_ticks = 0;
   catchup = 0.1;
+  fpacer_reset();
 }
 
 double get_pbtimer_load(void) {return timer_load * 100.;}
@@ -462,3 +463,114 @@ get_time:
   return Itime;
 }
 
+
+
+///////////////// frame pacing /////////////////////////////
+
+static ticks_t fp_late[FPACE_WINDOW]; ///< ring of frame lateness values
+static int fp_idx, fp_nsamples;
+static uint32_t fp_hist[FPACE_NBINS]; ///< histogram of the values currently in the ring
+static ticks_t fp_spin, fp_oversleep; ///< current spin time, smoothed oversleep of clock_nanosleep
+static uint64_t fp_nwaits;
+
+void fpacer_reset(void) {
+  lives_memset(fp_late, 0, sizeof(fp_late));
+  lives_memset(fp_hist, 0, sizeof(fp_hist));
+  fp_idx = fp_nsamples = 0;
+  fp_spin = FPACE_SPIN_MIN << 2;
+  fp_oversleep = 0;
+  fp_nwaits = 0;
+}
+
+
+void fpacer_wait(ticks_t due) {
+  // should only be called from the player, after lives_get_current_playback_ticks()
+  ticks_t delta = due - mainw->currticks, sys_due, wake_at, now;
+  double ratio = R * X;
+
+  if (delta <= 0) return;
+  delta = (ticks_t)((double)delta / ratio);
+  if (delta > FPACE_MAX_WAIT) delta = FPACE_MAX_WAIT;
+
+  // system time when currticks was measured, plus the delta
+  sys_due = mainw->clock_ticks + mainw->origticks + susp_ticks + delta;
+  wake_at = sys_due - fp_spin;
+  now = lives_get_current_ticks();
+
+  if (wake_at > now) {
+#if _POSIX_TIMERS
+    struct timespec ts;
+    uint64_t nsec = TICKS_TO_NSEC(wake_at);
+    ts.tv_sec = nsec / ONE_BILLION;
+    ts.tv_nsec = nsec % ONE_BILLION;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+    lives_nanosleep(TICKS_TO_NSEC(wake_at - now));
+#endif
+    // adjust the spin time to cover the usual oversleep
+    now = lives_get_current_ticks();
+    fp_oversleep = (fp_oversleep * 7 + (now > wake_at ? now - wake_at : 0)) >> 3;
+    fp_spin = fp_oversleep << 1;
+    if (fp_spin < FPACE_SPIN_MIN) fp_spin = FPACE_SPIN_MIN;
+    if (fp_spin > FPACE_SPIN_MAX) fp_spin = FPACE_SPIN_MAX;
+    fp_nwaits++;
+  }
+
+  while (now < sys_due) now = lives_get_current_ticks();
+}
+
+
+void fpacer_frame_shown(ticks_t lateness) {
+  int bin = 0;
+  if (lateness < 0) lateness = -lateness;
+  if (fp_nsamples == FPACE_WINDOW) {
+    // remove the oldest value from the histogram
+    ticks_t old = fp_late[fp_idx];
+    int obin = 0;
+    while (obin < FPACE_NBINS - 1 && old >= (FPACE_BIN_BASE << obin)) obin++;
+    fp_hist[obin]--;
+  } else fp_nsamples++;
+  fp_late[fp_idx] = lateness;
+  if (++fp_idx == FPACE_WINDOW) fp_idx = 0;
+  while (bin < FPACE_NBINS - 1 && lateness >= (FPACE_BIN_BASE << bin)) bin++;
+  fp_hist[bin]++;
+}
+
+
+static int cmp_ticks(const void *a, const void *b) {
+  ticks_t ta = *(const ticks_t *)a, tb = *(const ticks_t *)b;
+  return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+
+ticks_t fpacer_jitter_percentile(int pct) {
+  ticks_t vals[FPACE_WINDOW];
+  int n = fp_nsamples;
+  if (!n) return 0;
+  lives_memcpy(vals, fp_late, n * sizeof(ticks_t));
+  qsort(vals, n, sizeof(ticks_t), cmp_ticks);
+  return vals[(n - 1) * pct / 100];
+}
+
+
+char *fpacer_report(void) {
+  char *hist = lives_strdup(""), *tmp, *msg;
+  for (int i = 0; i < FPACE_NBINS; i++) {
+    if (i < FPACE_NBINS - 1)
+      tmp = lives_strdup_printf("%s <%.1f: %d", hist, (double)(FPACE_BIN_BASE << i) / TICKS_PER_SECOND_DBL * 1000.,
+                                fp_hist[i]);
+    else tmp = lives_strdup_printf("%s more: %d", hist, fp_hist[i]);
+    lives_free(hist);
+    hist = tmp;
+  }
+  msg = lives_strdup_printf(_("Frame jitter (ms) p50 %.2f, p%d %.2f, max %.2f\n"
+                              "Frame jitter histogram (ms):%s\n"
+                              "Frame pacing: %lu waits, oversleep %.3f ms, spin %.3f ms\n"),
+                            (double)fpacer_jitter_percentile(50) / TICKS_PER_SECOND_DBL * 1000.,
+                            FPACE_PCT, (double)fpacer_jitter_percentile(FPACE_PCT) / TICKS_PER_SECOND_DBL * 1000.,
+                            (double)fpacer_jitter_percentile(100) / TICKS_PER_SECOND_DBL * 1000., hist,
+                            fp_nwaits, (double)fp_oversleep / TICKS_PER_SECOND_DBL * 1000.,
+                            (double)fp_spin / TICKS_PER_SECOND_DBL * 1000.);
+  lives_free(hist);
+  return msg;
+}
@@ -56,3 +56,20 @@ void show_pbtimer_stats(void);
 void reset_playback_clock(ticks_t origticks);
 ticks_t lives_get_current_playback_ticks(ticks_t origticks, lives_time_source_t *time_source);
 
+
+/// frame pacing: rather than looping continuously, the player sleeps until shortly before the next frame is due,
+/// then spins for the remainder. The deadline is in playback ticks and is converted to system time with the current
+/// clock ratio, so when the playback clock follows the soundcard, frames are paced by the audio clock
+#define FPACE_MAX_WAIT (TICKS_PER_SECOND / 100) ///< longest single wait, so the player stays responsive
+#define FPACE_SPIN_MIN (TICKS_PER_SECOND / 10000) ///< 100 usec
+#define FPACE_SPIN_MAX (TICKS_PER_SECOND / 500) ///< 2 msec
+#define FPACE_WINDOW 512 ///< number of frames in the rolling lateness window
+#define FPACE_NBINS 10 ///< histogram bins; bin 0 is < FPACE_BIN_BASE, bin n < FPACE_BIN_BASE * 2 ** n
+#define FPACE_BIN_BASE (TICKS_PER_SECOND / 10000) ///< 100 usec
+#define FPACE_PCT 95
+
+void fpacer_reset(void);
+void fpacer_wait(ticks_t due);
+void fpacer_frame_shown(ticks_t lateness); ///< lateness = playback time when shown - ideal time of the frame
+ticks_t fpacer_jitter_percentile(int pct);
+char *fpacer_report(void);
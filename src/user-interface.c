@@ -956,6 +956,18 @@ align:
 }
 
 
+int get_player_proxy_div(void) {
+  // return the divisor for processing size in the current player window (1, 2 or 4)
+  // the effect chain runs at the player size divided by this, and the result is upscaled at the sink
+  // output plugins and rendering always get full size frames
+  if (lives_get_status() == LIVES_STATUS_RENDERING) return 1;
+  if (mainw->ext_playback && mainw->vpp) return 1;
+  if (mainw->play_window && LIVES_IS_WIDGET(mainw->preview_image)) return prefs->proxy_div_sepwin;
+  if (mainw->multitrack) return prefs->proxy_div_mt;
+  return prefs->proxy_div_ce;
+}
+
+
 void reset_mainwin_size(void) {
   RECURSE_GUARD_START;
   int scr_width = GUI_SCREEN_WIDTH;
@@ -19,6 +19,7 @@ void player_desensitize(void);
 
 void get_player_size(int *opwidth, int *opheight);
 boolean get_play_screen_size(int *opwidth, int *opheight);
+int get_player_proxy_div(void);
 
 void set_drawing_area_from_pixbuf(LiVESDrawingArea *da, LiVESPixbuf *pixbuf);
 